@@ -0,0 +1,254 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "audit_record.h"
+
+void audit_record_seal(audit_record_t *rec, const uint8_t prev[SHA256_DIGEST_SIZE]) {
+    uint8_t msg[SHA256_BLOCK_SIZE];
+    memcpy(msg, prev, SHA256_DIGEST_SIZE);
+    memcpy(msg + SHA256_DIGEST_SIZE, rec, AUDIT_BODY_SIZE);
+    sha256_64(msg, rec->hash);
+}
+
+bool audit_record_check(const audit_record_t *rec, const uint8_t prev[SHA256_DIGEST_SIZE]) {
+    uint8_t msg[SHA256_BLOCK_SIZE];
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    memcpy(msg, prev, SHA256_DIGEST_SIZE);
+    memcpy(msg + SHA256_DIGEST_SIZE, rec, AUDIT_BODY_SIZE);
+    sha256_64(msg, digest);
+    return memcmp(digest, rec->hash, SHA256_DIGEST_SIZE) == 0;
+}
+
+#define NUMBER_VALUE_MASK ((1u << AUDIT_NUMBER_DIGITS_SHIFT) - 1)
+
+_Static_assert(99999999u <= NUMBER_VALUE_MASK, "O valor de 8 digitos precisa caber abaixo da contagem");
+
+uint32_t audit_number_parse(const uint8_t *digits, size_t len) {
+    if (len == 0 || len > AUDIT_NUMBER_DIGITS_MAX) return 0;
+    uint32_t value = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (digits[i] < '0' || digits[i] > '9') return 0;
+        value = value * 10 + (uint32_t)(digits[i] - '0');
+    }
+    return ((uint32_t)len << AUDIT_NUMBER_DIGITS_SHIFT) | value;
+}
+
+void audit_number_format(uint32_t number, char out[AUDIT_NUMBER_TEXT_MAX]) {
+    unsigned digits = number >> AUDIT_NUMBER_DIGITS_SHIFT;
+    if (digits == 0 || digits > AUDIT_NUMBER_DIGITS_MAX) {
+        snprintf(out, AUDIT_NUMBER_TEXT_MAX, "%u", (unsigned)number);
+    } else {
+        snprintf(out, AUDIT_NUMBER_TEXT_MAX, "%0*u", (int)digits, (unsigned)(number & NUMBER_VALUE_MASK));
+    }
+}
+
+void audit_tally_reset(audit_tally_t *tally) {
+    memset(tally, 0, sizeof(*tally));
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// Cargo de um voto, branco ou nulo; os registros sem cargo são do cargo 0
+static bool record_office(const audit_record_t *rec, size_t at, uint8_t *office) {
+    *office = rec->len > at ? rec->data[at] : 0;
+    return *office < AUDIT_MAX_OFFICES;
+}
+
+static audit_office_tally_t *office_tally(audit_tally_t *tally, uint8_t office) {
+    if (office >= tally->offices) tally->offices = (uint8_t)(office + 1);
+    return &tally->office[office];
+}
+
+// Ordem das entradas: por cargo e, dentro do cargo, por número
+static int entry_cmp(const audit_tally_entry_t *e, uint8_t office, uint32_t number) {
+    if (e->office != office) return e->office < office ? -1 : 1;
+    if (e->number != number) return e->number < number ? -1 : 1;
+    return 0;
+}
+
+// Posição da entrada (cargo, número), ou de onde ela entraria
+static uint16_t entry_search(const audit_tally_t *tally, uint8_t office, uint32_t number, bool *found) {
+    uint16_t lo = 0, hi = tally->count;
+    while (lo < hi) {
+        uint16_t mid = (uint16_t)(lo + (hi - lo) / 2);
+        int c = entry_cmp(&tally->entries[mid], office, number);
+        if (c == 0) {
+            *found = true;
+            return mid;
+        }
+        if (c < 0) lo = (uint16_t)(mid + 1);
+        else hi = mid;
+    }
+    *found = false;
+    return lo;
+}
+
+static void add_vote(audit_tally_t *tally, uint8_t office, uint32_t number) {
+    audit_office_tally_t *t = office_tally(tally, office);
+    t->votes++;
+    tally->votes++;
+    bool found;
+    uint16_t at = entry_search(tally, office, number, &found);
+    if (found) {
+        tally->entries[at].votes++;
+        return;
+    }
+    if (tally->count == AUDIT_MAX_CANDIDATES) {
+        t->overflow++;
+        tally->overflow++;
+        return;
+    }
+    memmove(&tally->entries[at + 1], &tally->entries[at], (tally->count - at) * sizeof(tally->entries[0]));
+    tally->entries[at] = (audit_tally_entry_t){.number = number, .votes = 1, .office = office};
+    tally->count++;
+}
+
+void audit_tally_apply(audit_tally_t *tally, const audit_record_t *rec) {
+    uint8_t office;
+    switch (rec->type) {
+    case AUDIT_VOTE:
+        if (rec->len >= 4 && record_office(rec, 4, &office)) add_vote(tally, office, get_u32(rec->data));
+        break;
+    case AUDIT_NULL:
+        if (record_office(rec, 4, &office)) {
+            office_tally(tally, office)->null++;
+            tally->null++;
+        }
+        break;
+    case AUDIT_BLANK:
+        if (record_office(rec, 0, &office)) {
+            office_tally(tally, office)->blank++;
+            tally->blank++;
+        }
+        break;
+    case AUDIT_START:
+        audit_tally_reset(tally);
+        break;
+    default:
+        break;
+    }
+}
+
+bool audit_tally_equal(const audit_tally_t *a, const audit_tally_t *b) {
+    if (a->votes != b->votes || a->blank != b->blank || a->null != b->null ||
+        a->overflow != b->overflow || a->offices != b->offices || a->count != b->count) {
+        return false;
+    }
+    if (memcmp(a->office, b->office, a->offices * sizeof(a->office[0])) != 0) return false;
+    for (uint16_t i = 0; i < a->count; i++) {
+        bool found;
+        uint16_t at = entry_search(b, a->entries[i].office, a->entries[i].number, &found);
+        if (!found || b->entries[at].votes != a->entries[i].votes) return false;
+    }
+    return true;
+}
+
+static size_t entry_records(size_t entries) {
+    return (entries + AUDIT_TALLY_PER_RECORD - 1) / AUDIT_TALLY_PER_RECORD;
+}
+
+size_t audit_checkpoint_records(const audit_tally_t *tally) {
+    return 1 + tally->offices + entry_records(tally->count);
+}
+
+size_t audit_checkpoint_interval(const audit_tally_t *tally) {
+    size_t spaced = AUDIT_CHECKPOINT_SPACING * audit_checkpoint_records(tally);
+    return spaced > AUDIT_CHECKPOINT_EVERY ? spaced : AUDIT_CHECKPOINT_EVERY;
+}
+
+void audit_checkpoint_encode(const audit_tally_t *tally, size_t index, audit_record_t *out) {
+    memset(out, 0, sizeof(*out));
+    if (index == 0) {
+        audit_checkpoint_t cp = {
+            .votes = tally->votes,
+            .blank = tally->blank,
+            .null = tally->null,
+            .overflow = tally->overflow,
+            .entries = tally->count,
+            .offices = tally->offices,
+        };
+        out->type = AUDIT_CHECKPOINT;
+        out->len = sizeof(cp);
+        memcpy(out->data, &cp, sizeof(cp));
+        return;
+    }
+
+    if (index <= tally->offices) {
+        const audit_office_tally_t *t = &tally->office[index - 1];
+        audit_office_record_t office = {
+            .office = (uint8_t)(index - 1),
+            .votes = t->votes,
+            .blank = t->blank,
+            .null = t->null,
+            .overflow = t->overflow,
+        };
+        out->type = AUDIT_OFFICE;
+        out->len = sizeof(office);
+        memcpy(out->data, &office, sizeof(office));
+        return;
+    }
+
+    size_t first = (index - 1 - tally->offices) * AUDIT_TALLY_PER_RECORD;
+    size_t n = tally->count - first;
+    if (n > AUDIT_TALLY_PER_RECORD) n = AUDIT_TALLY_PER_RECORD;
+    out->type = AUDIT_TALLY;
+    out->len = (uint8_t)(n * sizeof(audit_tally_entry_t));
+    memcpy(out->data, &tally->entries[first], out->len);
+}
+
+size_t audit_checkpoint_tally_records(const audit_record_t *checkpoint) {
+    audit_checkpoint_t cp;
+    memcpy(&cp, checkpoint->data, sizeof(cp));
+    return cp.offices + entry_records(cp.entries);
+}
+
+bool audit_checkpoint_decode(const audit_record_t *records, size_t count, audit_tally_t *tally) {
+    if (count == 0 || records[0].type != AUDIT_CHECKPOINT || records[0].len != sizeof(audit_checkpoint_t)) {
+        return false;
+    }
+    audit_checkpoint_t cp;
+    memcpy(&cp, records[0].data, sizeof(cp));
+    if (cp.entries > AUDIT_MAX_CANDIDATES || cp.offices > AUDIT_MAX_OFFICES ||
+        count < 1 + audit_checkpoint_tally_records(&records[0])) {
+        return false;
+    }
+
+    audit_tally_reset(tally);
+    tally->votes = cp.votes;
+    tally->blank = cp.blank;
+    tally->null = cp.null;
+    tally->overflow = cp.overflow;
+    tally->offices = cp.offices;
+    // Os cargos vêm em ordem, um registro cada
+    for (uint8_t o = 0; o < cp.offices; o++) {
+        const audit_record_t *rec = &records[1 + o];
+        audit_office_record_t office;
+        if (rec->type != AUDIT_OFFICE || rec->len != sizeof(office)) return false;
+        memcpy(&office, rec->data, sizeof(office));
+        if (office.office != o) return false;
+        tally->office[o] = (audit_office_tally_t){office.votes, office.blank, office.null, office.overflow};
+    }
+    for (size_t r = 1 + cp.offices; tally->count < cp.entries; r++) {
+        if (records[r].type != AUDIT_TALLY) return false;
+        size_t n = records[r].len / sizeof(audit_tally_entry_t);
+        if (n == 0 || n > AUDIT_TALLY_PER_RECORD || tally->count + n > cp.entries) return false;
+        for (size_t i = 0; i < n; i++) {
+            audit_tally_entry_t e;
+            memcpy(&e, records[r].data + i * sizeof(e), sizeof(e));
+            if (e.office >= cp.offices) return false;
+            // Vêm em ordem desde que a apuração é ordenada; os checkpoints
+            // mais antigos são ordenados aqui
+            bool found;
+            uint16_t at = entry_search(tally, e.office, e.number, &found);
+            if (found) return false;
+            memmove(&tally->entries[at + 1], &tally->entries[at], (tally->count - at) * sizeof(e));
+            tally->entries[at] = e;
+            tally->count++;
+        }
+    }
+    return true;
+}
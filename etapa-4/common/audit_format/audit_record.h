@@ -0,0 +1,209 @@
+/**
+ * @file audit_record.h
+ *
+ * Formato binário do log de auditoria (auditoria.bin).
+ *
+ * O arquivo é uma sequência de registros de 64 bytes (8 por setor do SD),
+ * sem cabeçalho, em little-endian. Cada registro tem 32 bytes de conteúdo e
+ * 32 bytes de hash:
+ *
+ *     hash[i] = SHA-256(hash[i-1] || conteúdo[i])     hash[-1] = 32 zeros
+ *
+ * Alterar, remover ou reordenar qualquer registro quebra todos os elos
+ * seguintes. A mensagem de cada elo tem exatamente 64 bytes, o que permite
+ * usar o caminho rápido sha256_64().
+ *
+ * Votos, brancos e nulos trazem o cargo (índice na cédula da urna): cargos
+ * diferentes podem usar os mesmos números.
+ *
+ * A cada audit_checkpoint_interval() registros (e no fim da eleição) o auditor
+ * grava um CHECKPOINT seguido de um registro OFFICE por cargo (nominais,
+ * brancos e nulos dele) e de registros TALLY com os votos de cada
+ * candidato.
+ * O verificador confere cada checkpoint contra a sua própria contagem, e o
+ * auditor usa o último checkpoint para retomar a contagem após reiniciar
+ * sem precisar reler o arquivo inteiro.
+ */
+
+#ifndef AUDIT_RECORD_H
+#define AUDIT_RECORD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sha256.h"
+
+#define AUDIT_RECORD_SIZE 64
+#define AUDIT_BODY_SIZE 32
+#define AUDIT_DATA_SIZE 20
+
+// Registros entre checkpoints; com muitos candidatos, pelo menos
+// AUDIT_CHECKPOINT_SPACING vezes o tamanho do próprio checkpoint
+#define AUDIT_CHECKPOINT_EVERY 256
+#define AUDIT_CHECKPOINT_SPACING 4
+
+// Cargos da cédula (BALLOT_OFFICES_MAX na urna)
+#define AUDIT_MAX_OFFICES 8
+
+// Candidatos distintos acompanhados na apuração, somando todos os cargos
+// (BALLOT_CANDIDATES_MAX na urna): toda cédula válida cabe na apuração
+#define AUDIT_MAX_CANDIDATES 512
+
+// Números de candidato guardam a quantidade de dígitos junto do valor, como
+// o índice da urna: "05" e "5" são candidatos diferentes
+#define AUDIT_NUMBER_DIGITS_MAX 8
+#define AUDIT_NUMBER_DIGITS_SHIFT 27
+#define AUDIT_NUMBER_TEXT_MAX 11     // audit_number_format, com o '\0'
+
+// Entradas de apuração por registro TALLY
+#define AUDIT_TALLY_PER_RECORD 2
+
+typedef enum {
+    AUDIT_BOOT = 1,        // Auditor (re)iniciado
+    AUDIT_TEXT = 2,        // Evento não reconhecido; data = texto (pode continuar no próximo)
+    AUDIT_KEY = 3,         // data[0] = tecla
+    AUDIT_VOTE = 4,        // data = número do candidato (uint32, audit_number_parse), cargo (uint8)
+    AUDIT_NULL = 5,        // Voto nulo; data = número digitado (uint32, audit_number_parse), cargo (uint8)
+    AUDIT_BLANK = 6,       // Voto em branco; data[0] = cargo
+    AUDIT_START = 7,       // Nova eleição: zera a apuração
+    AUDIT_ENABLE = 8,      // Urna liberada para o próximo eleitor
+    AUDIT_END = 9,         // Eleição encerrada
+    AUDIT_CONFIG = 10,     // data = quantidade de candidatos (uint32)
+    AUDIT_CHECKPOINT = 11, // Apuração parcial, ver audit_checkpoint_t
+    AUDIT_TALLY = 12,      // Até AUDIT_TALLY_PER_RECORD audit_tally_entry_t
+    AUDIT_OFFICE = 13,     // Apuração de um cargo, ver audit_office_record_t
+} audit_type_t;
+
+typedef struct {
+    uint32_t seq;      // Posição do registro no arquivo (0, 1, 2, ...)
+    uint32_t time_ms;  // Instante no auditor (ms desde o boot)
+    uint8_t type;      // audit_type_t
+    uint8_t len;       // Bytes válidos em data
+    uint16_t boot;     // Contador de inicializações do auditor
+    uint8_t data[AUDIT_DATA_SIZE];
+    uint8_t hash[SHA256_DIGEST_SIZE];
+} audit_record_t;
+
+_Static_assert(sizeof(audit_record_t) == AUDIT_RECORD_SIZE, "Registro de auditoria deve ter 64 bytes");
+
+typedef struct __attribute__((packed)) {
+    uint32_t number;   // audit_number_parse
+    uint32_t votes;
+    uint8_t office;
+    uint8_t reserved;
+} audit_tally_entry_t;
+
+_Static_assert(AUDIT_TALLY_PER_RECORD * sizeof(audit_tally_entry_t) <= AUDIT_DATA_SIZE, "Entradas nao cabem no registro");
+
+typedef struct {
+    uint32_t votes;    // Votos nominais
+    uint32_t blank;
+    uint32_t null;
+    uint32_t overflow; // Votos de candidatos além de AUDIT_MAX_CANDIDATES (log inválido)
+} audit_office_tally_t;
+
+// Conteúdo de um registro CHECKPOINT: os totais de todos os cargos
+typedef struct __attribute__((packed)) {
+    uint32_t votes;
+    uint32_t blank;
+    uint32_t null;
+    uint32_t overflow;
+    uint16_t entries;  // Entradas nos registros TALLY
+    uint8_t offices;   // Registros OFFICE, antes dos TALLY
+} audit_checkpoint_t;
+
+_Static_assert(sizeof(audit_checkpoint_t) <= AUDIT_DATA_SIZE, "Checkpoint nao cabe no registro");
+
+// Conteúdo de um registro OFFICE
+typedef struct __attribute__((packed)) {
+    uint8_t office;
+    uint32_t votes;
+    uint32_t blank;
+    uint32_t null;
+    uint32_t overflow;
+} audit_office_record_t;
+
+_Static_assert(sizeof(audit_office_record_t) <= AUDIT_DATA_SIZE, "Cargo nao cabe no registro");
+
+/**
+ * @brief Apuração reconstruída a partir dos registros.
+ */
+typedef struct {
+    uint32_t votes;    // Totais de todos os cargos
+    uint32_t blank;
+    uint32_t null;
+    uint32_t overflow;
+    uint8_t offices;   // Maior cargo com voto + 1
+    audit_office_tally_t office[AUDIT_MAX_OFFICES];
+    uint16_t count;
+    audit_tally_entry_t entries[AUDIT_MAX_CANDIDATES]; // Por cargo e número
+} audit_tally_t;
+
+/**
+ * @brief Calcula o hash do registro encadeado ao anterior.
+ */
+void audit_record_seal(audit_record_t *rec, const uint8_t prev[SHA256_DIGEST_SIZE]);
+
+/**
+ * @brief Confere o hash do registro em relação ao anterior.
+ */
+bool audit_record_check(const audit_record_t *rec, const uint8_t prev[SHA256_DIGEST_SIZE]);
+
+/**
+ * @brief Codifica um número de candidato em texto (só dígitos).
+ * @return 0 se não é um número de 1 a AUDIT_NUMBER_DIGITS_MAX dígitos.
+ */
+uint32_t audit_number_parse(const uint8_t *digits, size_t len);
+
+/**
+ * @brief Escreve o número com os dígitos originais (zeros à esquerda). Os
+ * registros anteriores à contagem de dígitos saem como o valor simples.
+ */
+void audit_number_format(uint32_t number, char out[AUDIT_NUMBER_TEXT_MAX]);
+
+void audit_tally_reset(audit_tally_t *tally);
+
+/**
+ * @brief Aplica à apuração o efeito de um registro (votos e START).
+ */
+void audit_tally_apply(audit_tally_t *tally, const audit_record_t *rec);
+
+/**
+ * @brief Compara duas apurações, cargo a cargo, sem depender da ordem dos
+ * candidatos.
+ */
+bool audit_tally_equal(const audit_tally_t *a, const audit_tally_t *b);
+
+/**
+ * @brief Quantidade de registros (CHECKPOINT + OFFICE + TALLY) de um
+ * checkpoint.
+ */
+size_t audit_checkpoint_records(const audit_tally_t *tally);
+
+/**
+ * @brief Registros entre um checkpoint e o próximo: AUDIT_CHECKPOINT_EVERY,
+ * ou mais quando o checkpoint é grande, para ele não ocupar o log.
+ */
+size_t audit_checkpoint_interval(const audit_tally_t *tally);
+
+/**
+ * @brief Monta o conteúdo (type, len, data) do registro 'index' do
+ * checkpoint: 0 é o CHECKPOINT, depois vêm os OFFICE e os TALLY. Falta
+ * selar.
+ */
+void audit_checkpoint_encode(const audit_tally_t *tally, size_t index, audit_record_t *out);
+
+/**
+ * @brief Quantidade de registros (OFFICE + TALLY) que seguem um CHECKPOINT.
+ */
+size_t audit_checkpoint_tally_records(const audit_record_t *checkpoint);
+
+/**
+ * @brief Reconstrói a apuração de um CHECKPOINT e dos OFFICE e TALLY
+ * seguintes.
+ * @return false se os registros não formam um checkpoint válido.
+ */
+bool audit_checkpoint_decode(const audit_record_t *records, size_t count, audit_tally_t *tally);
+
+#endif // AUDIT_RECORD_H
@@ -0,0 +1,141 @@
+#include <string.h>
+
+#include "sha256.h"
+
+const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+const uint32_t sha256_h0[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+#define S0(x) (ROTR(x, 2) ^ ROTR(x, 13) ^ ROTR(x, 22))
+#define S1(x) (ROTR(x, 6) ^ ROTR(x, 11) ^ ROTR(x, 25))
+#define s0(x) (ROTR(x, 7) ^ ROTR(x, 18) ^ ((x) >> 3))
+#define s1(x) (ROTR(x, 17) ^ ROTR(x, 19) ^ ((x) >> 10))
+#define CH(x, y, z) (((x) & (y)) ^ (~(x) & (z)))
+#define MAJ(x, y, z) (((x) & (y)) ^ ((x) & (z)) ^ ((y) & (z)))
+
+// 64 rodadas sobre uma expansão W já pronta (com K somado)
+static void rounds(uint32_t state[8], const uint32_t wk[64]) {
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+    for (int i = 0; i < 64; i++) {
+        uint32_t t1 = h + S1(e) + CH(e, f, g) + wk[i];
+        uint32_t t2 = S0(a) + MAJ(a, b, c);
+        h = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+
+    state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+    state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+static void expand(const uint8_t *block, uint32_t wk[64]) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++) {
+        w[i] = ((uint32_t)block[4 * i] << 24) | ((uint32_t)block[4 * i + 1] << 16) |
+               ((uint32_t)block[4 * i + 2] << 8) | block[4 * i + 3];
+    }
+    for (int i = 16; i < 64; i++) {
+        w[i] = s1(w[i - 2]) + w[i - 7] + s0(w[i - 15]) + w[i - 16];
+    }
+    for (int i = 0; i < 64; i++) wk[i] = w[i] + sha256_k[i];
+}
+
+void sha256_compress(uint32_t state[8], const uint8_t *blocks, size_t count) {
+    uint32_t wk[64];
+    while (count--) {
+        expand(blocks, wk);
+        rounds(state, wk);
+        blocks += SHA256_BLOCK_SIZE;
+    }
+}
+
+void sha256_init(sha256_ctx_t *ctx) {
+    memcpy(ctx->state, sha256_h0, sizeof(ctx->state));
+    ctx->length = 0;
+    ctx->block_len = 0;
+}
+
+void sha256_update(sha256_ctx_t *ctx, const void *data, size_t len) {
+    const uint8_t *src = data;
+    ctx->length += len;
+
+    if (ctx->block_len) {
+        size_t take = SHA256_BLOCK_SIZE - ctx->block_len;
+        if (take > len) take = len;
+        memcpy(ctx->block + ctx->block_len, src, take);
+        ctx->block_len += take;
+        src += take;
+        len -= take;
+        if (ctx->block_len < SHA256_BLOCK_SIZE) return;
+        sha256_compress(ctx->state, ctx->block, 1);
+        ctx->block_len = 0;
+    }
+    size_t whole = len / SHA256_BLOCK_SIZE;
+    sha256_compress(ctx->state, src, whole);
+    src += whole * SHA256_BLOCK_SIZE;
+    len -= whole * SHA256_BLOCK_SIZE;
+    memcpy(ctx->block, src, len);
+    ctx->block_len = len;
+}
+
+static void store_digest(const uint32_t state[8], uint8_t digest[SHA256_DIGEST_SIZE]) {
+    for (int i = 0; i < 8; i++) {
+        digest[4 * i] = (uint8_t)(state[i] >> 24);
+        digest[4 * i + 1] = (uint8_t)(state[i] >> 16);
+        digest[4 * i + 2] = (uint8_t)(state[i] >> 8);
+        digest[4 * i + 3] = (uint8_t)state[i];
+    }
+}
+
+void sha256_final(sha256_ctx_t *ctx, uint8_t digest[SHA256_DIGEST_SIZE]) {
+    uint64_t bits = ctx->length * 8;
+
+    ctx->block[ctx->block_len++] = 0x80;
+    if (ctx->block_len > SHA256_BLOCK_SIZE - 8) {
+        memset(ctx->block + ctx->block_len, 0, SHA256_BLOCK_SIZE - ctx->block_len);
+        sha256_compress(ctx->state, ctx->block, 1);
+        ctx->block_len = 0;
+    }
+    memset(ctx->block + ctx->block_len, 0, SHA256_BLOCK_SIZE - 8 - ctx->block_len);
+    for (int i = 0; i < 8; i++) {
+        ctx->block[SHA256_BLOCK_SIZE - 1 - i] = (uint8_t)(bits >> (8 * i));
+    }
+    sha256_compress(ctx->state, ctx->block, 1);
+    store_digest(ctx->state, digest);
+}
+
+// Expansão do bloco de padding de uma mensagem de 64 bytes (0x80, zeros e
+// o tamanho de 512 bits), calculada na primeira chamada
+static uint32_t pad64_wk[64];
+static int pad64_ready;
+
+void sha256_64_finish(uint32_t state[8], uint8_t digest[SHA256_DIGEST_SIZE]) {
+    if (!pad64_ready) {
+        uint8_t pad[SHA256_BLOCK_SIZE] = {0x80};
+        pad[SHA256_BLOCK_SIZE - 2] = 0x02; // 512 bits, big-endian
+        expand(pad, pad64_wk);
+        pad64_ready = 1;
+    }
+    rounds(state, pad64_wk);
+    store_digest(state, digest);
+}
+
+void sha256_64(const uint8_t msg[SHA256_BLOCK_SIZE], uint8_t digest[SHA256_DIGEST_SIZE]) {
+    uint32_t state[8];
+    memcpy(state, sha256_h0, sizeof(state));
+    sha256_compress(state, msg, 1);
+    sha256_64_finish(state, digest);
+}
@@ -0,0 +1,55 @@
+/**
+ * @file sha256.h
+ *
+ * SHA-256 em C puro, sem alocação, usado pelo auditor e pelo verificador.
+ *
+ * Além da interface incremental há um caminho específico para mensagens de
+ * exatamente 64 bytes (um elo da cadeia de auditoria): o bloco de padding
+ * dessas mensagens é sempre o mesmo, então sua expansão é calculada uma vez.
+ */
+
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHA256_DIGEST_SIZE 32
+#define SHA256_BLOCK_SIZE 64
+
+typedef struct {
+    uint32_t state[8];
+    uint64_t length;              // Bytes processados
+    uint8_t block[SHA256_BLOCK_SIZE];
+    size_t block_len;
+} sha256_ctx_t;
+
+void sha256_init(sha256_ctx_t *ctx);
+void sha256_update(sha256_ctx_t *ctx, const void *data, size_t len);
+void sha256_final(sha256_ctx_t *ctx, uint8_t digest[SHA256_DIGEST_SIZE]);
+
+/**
+ * @brief Função de compressão: processa 'count' blocos de 64 bytes.
+ */
+void sha256_compress(uint32_t state[8], const uint8_t *blocks, size_t count);
+
+/**
+ * @brief SHA-256 de uma mensagem de exatamente 64 bytes.
+ */
+void sha256_64(const uint8_t msg[SHA256_BLOCK_SIZE], uint8_t digest[SHA256_DIGEST_SIZE]);
+
+/**
+ * @brief Estado inicial (H0) e constantes de rodada do SHA-256, para quem
+ * implementa a compressão por conta própria (ex.: instruções SHA do
+ * processador no verificador).
+ */
+extern const uint32_t sha256_h0[8];
+extern const uint32_t sha256_k[64];
+
+/**
+ * @brief Termina o hash de uma mensagem de 64 bytes a partir do estado após
+ * o primeiro bloco: aplica o bloco de padding constante e gera o digest.
+ */
+void sha256_64_finish(uint32_t state[8], uint8_t digest[SHA256_DIGEST_SIZE]);
+
+#endif // SHA256_H
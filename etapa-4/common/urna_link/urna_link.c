@@ -0,0 +1,406 @@
+#include <string.h>
+
+#include "urna_link.h"
+
+#define WINDOW_MASK (URNA_LINK_WINDOW - 1)
+
+_Static_assert((URNA_LINK_WINDOW & WINDOW_MASK) == 0, "URNA_LINK_WINDOW deve ser potencia de 2");
+_Static_assert(URNA_LINK_WINDOW < 128, "A janela precisa caber em meio espaco de sequencia");
+_Static_assert(URNA_LINK_MAX_PAYLOAD <= 255, "O tamanho do payload e guardado em um byte");
+
+// Tabela do CRC-32 (IEEE 802.3, forma refletida), gerada uma única vez
+static uint32_t crc_table[256];
+static bool crc_table_ready;
+
+static void crc_table_init(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+        }
+        crc_table[i] = crc;
+    }
+    crc_table_ready = true;
+}
+
+uint32_t urna_link_crc32_update(uint32_t crc, const uint8_t *data, size_t len) {
+    if (!crc_table_ready) crc_table_init();
+    crc = ~crc;
+    while (len--) {
+        crc = (crc >> 8) ^ crc_table[(uint8_t)(crc ^ *data++)];
+    }
+    return ~crc;
+}
+
+uint32_t urna_link_crc32(const uint8_t *data, size_t len) {
+    return urna_link_crc32_update(0, data, len);
+}
+
+size_t urna_link_cobs_encode(const uint8_t *src, size_t len, uint8_t *dst) {
+    size_t code_pos = 0; // Onde vai o código do bloco corrente
+    size_t out = 1;
+    uint8_t code = 1;
+
+    for (size_t i = 0; i < len; i++) {
+        if (src[i] == 0) {
+            dst[code_pos] = code;
+            code_pos = out++;
+            code = 1;
+        } else {
+            dst[out++] = src[i];
+            if (++code == 0xFF) {
+                // Bloco de 254 bytes sem zero: fecha sem zero implícito
+                dst[code_pos] = code;
+                code_pos = out++;
+                code = 1;
+            }
+        }
+    }
+    dst[code_pos] = code;
+    return out;
+}
+
+size_t urna_link_cobs_decode(const uint8_t *src, size_t len, uint8_t *dst, size_t cap) {
+    size_t in = 0, out = 0;
+
+    while (in < len) {
+        uint8_t code = src[in++];
+        if (code == 0 || in + code - 1 > len) return 0;
+        for (uint8_t i = 1; i < code; i++) {
+            if (src[in] == 0 || out == cap) return 0;
+            dst[out++] = src[in++];
+        }
+        // O zero implícito não existe no fim do quadro nem após blocos cheios
+        if (code != 0xFF && in < len) {
+            if (out == cap) return 0;
+            dst[out++] = 0;
+        }
+    }
+    return out;
+}
+
+static uint32_t now_ms(urna_link_t *link) {
+    return link->io.now_ms(link->io.ctx);
+}
+
+// Diferença com sinal entre instantes, correta na virada do contador
+static bool elapsed(uint32_t now, uint32_t since, uint32_t ms) {
+    return (int32_t)(now - since) >= (int32_t)ms;
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void send_frame(urna_link_t *link, uint8_t type, uint8_t seq, const uint8_t *payload, size_t len) {
+    uint8_t raw[URNA_LINK_MAX_FRAME];
+    uint8_t encoded[URNA_LINK_MAX_ENCODED];
+
+    raw[0] = type;
+    raw[1] = seq;
+    if (len) memcpy(&raw[2], payload, len);
+    put_u32(&raw[len + 2], urna_link_crc32(raw, len + 2));
+
+    // O 0x00 inicial encerra qualquer lixo recebido antes (ruído, troca de taxa)
+    encoded[0] = 0x00;
+    size_t n = 1 + urna_link_cobs_encode(raw, len + 6, &encoded[1]);
+    encoded[n++] = 0x00;
+    link->io.write(link->io.ctx, encoded, n);
+    link->stats.tx_frames++;
+    link->last_tx_ms = now_ms(link);
+}
+
+static void send_u32_seq(urna_link_t *link, uint8_t type, uint8_t seq, uint32_t value) {
+    uint8_t payload[4];
+    put_u32(payload, value);
+    send_frame(link, type, seq, payload, sizeof(payload));
+}
+
+static void send_u32(urna_link_t *link, uint8_t type, uint32_t value) {
+    send_u32_seq(link, type, 0, value);
+}
+
+static void set_baud(urna_link_t *link, uint32_t baud) {
+    if (link->io.set_baud) link->io.set_baud(link->io.ctx, baud);
+    link->baud = baud;
+    link->last_rx_ms = now_ms(link); // O silêncio passa a contar da troca
+    link->rx_len = 0;
+    link->rx_overflow = false;
+}
+
+// Coloca um quadro confiável na janela e o transmite
+static bool enqueue(urna_link_t *link, uint8_t type, const void *payload, size_t len) {
+    if (len > URNA_LINK_MAX_PAYLOAD) return false;
+    if ((uint8_t)(link->tx_next - link->tx_base) >= URNA_LINK_WINDOW) return false;
+
+    if (link->tx_next == link->tx_base) link->tx_timer_ms = now_ms(link);
+    urna_link_slot_t *slot = &link->tx_slots[link->tx_next & WINDOW_MASK];
+    slot->type = type;
+    slot->len = (uint8_t)len;
+    if (len) memcpy(slot->payload, payload, len);
+    send_frame(link, type, link->tx_next, slot->payload, len);
+    link->tx_next++;
+    return true;
+}
+
+void urna_link_init(urna_link_t *link, const urna_link_io_t *io, uint32_t session) {
+    memset(link, 0, sizeof(*link));
+    link->io = *io;
+    link->baud = URNA_LINK_BASE_BAUD;
+    link->last_rx_ms = now_ms(link);
+    link->tx_session = session;
+
+    uint8_t payload[4];
+    put_u32(payload, session);
+    enqueue(link, URNA_LINK_RESET, payload, sizeof(payload));
+}
+
+bool urna_link_send(urna_link_t *link, const void *payload, size_t len) {
+    return enqueue(link, URNA_LINK_DATA, payload, len);
+}
+
+size_t urna_link_tx_free(const urna_link_t *link) {
+    return URNA_LINK_WINDOW - (uint8_t)(link->tx_next - link->tx_base);
+}
+
+// ACK cumulativo: 'next' é o próximo número que o outro lado espera
+static void handle_ack(urna_link_t *link, uint8_t next) {
+    uint8_t acked = (uint8_t)(next - link->tx_base);
+    uint8_t in_flight = (uint8_t)(link->tx_next - link->tx_base);
+    if (acked == 0 || acked > in_flight) return; // Repetido ou de outra sessão
+    link->tx_base = next;
+    link->tx_timer_ms = now_ms(link);
+}
+
+static void handle_data(urna_link_t *link, uint8_t seq, const uint8_t *payload, size_t len) {
+    if (!link->rx_synced) {
+        // Este lado reiniciou no meio da transmissão: pede o início da janela
+        link->sync_pending = true;
+        return;
+    }
+    link->ack_pending = true;
+
+    if (seq == link->rx_expected) {
+        link->rx_expected++;
+        link->stats.delivered++;
+        if (link->io.deliver) link->io.deliver(link->io.ctx, payload, len);
+    } else if ((uint8_t)(link->rx_expected - seq) <= URNA_LINK_WINDOW) {
+        link->stats.rx_duplicates++;
+    } else {
+        link->stats.rx_out_of_order++;
+    }
+}
+
+static void handle_reset(urna_link_t *link, uint8_t seq, const uint8_t *payload, size_t len) {
+    if (len != 4) return;
+    uint32_t session = get_u32(payload);
+    if (!link->rx_synced || session != link->rx_session) {
+        link->rx_session = session;
+        link->rx_expected = (uint8_t)(seq + 1);
+        link->rx_synced = true;
+    } else if (seq == link->rx_expected) {
+        // Um SYNC chegou antes do RESET (que se perdeu): a janela começa nele
+        link->rx_expected++;
+    }
+    link->ack_pending = true;
+}
+
+static void handle_sync(urna_link_t *link, uint8_t seq, const uint8_t *payload, size_t len) {
+    if (len != 4 || link->rx_synced) return;
+    link->rx_session = get_u32(payload);
+    link->rx_expected = seq;
+    link->rx_synced = true;
+    link->ack_pending = true;
+}
+
+static void handle_baud_req(urna_link_t *link, const uint8_t *payload, size_t len) {
+    if (len != 4) return;
+    uint32_t rate = get_u32(payload);
+    bool ok = link->io.set_baud && rate >= URNA_LINK_BASE_BAUD && rate <= URNA_LINK_MAX_BAUD;
+
+    // A resposta sai na taxa antiga; a troca espera a transmissão terminar
+    send_u32(link, URNA_LINK_BAUD_ACK, ok ? rate : 0);
+    if (ok && rate != link->baud) set_baud(link, rate);
+}
+
+// Próxima taxa da lista; 'delay_ms' dá tempo ao outro lado de voltar à base
+static void next_candidate(urna_link_t *link, uint32_t delay_ms) {
+    link->baud_index++;
+    link->baud_state = URNA_LINK_BAUD_IDLE;
+    link->baud_timer_ms = now_ms(link) + delay_ms;
+}
+
+static void handle_baud_ack(urna_link_t *link, const uint8_t *payload, size_t len) {
+    if (len != 4 || link->baud_state != URNA_LINK_BAUD_REQUESTED) return;
+    uint32_t rate = get_u32(payload);
+    if (rate != link->baud_candidates[link->baud_index]) {
+        next_candidate(link, 0); // Recusada
+        return;
+    }
+    set_baud(link, rate);
+    link->baud_state = URNA_LINK_BAUD_PROBING;
+    link->baud_tries = 1;
+    link->baud_timer_ms = now_ms(link);
+    send_frame(link, URNA_LINK_PING, 0, NULL, 0);
+}
+
+void urna_link_rx_frame(urna_link_t *link, const uint8_t *encoded, size_t len) {
+    uint8_t raw[URNA_LINK_MAX_FRAME];
+
+    if (len == 0) return;
+    size_t n = urna_link_cobs_decode(encoded, len, raw, sizeof(raw));
+    if (n < 6 || urna_link_crc32(raw, n - 4) != get_u32(&raw[n - 4])) {
+        link->stats.rx_crc_errors++;
+        return;
+    }
+
+    link->stats.rx_frames++;
+    link->last_rx_ms = now_ms(link);
+    // Qualquer quadro válido na taxa nova confirma a negociação
+    if (link->baud_state == URNA_LINK_BAUD_PROBING) {
+        link->baud_state = URNA_LINK_BAUD_IDLE;
+        link->baud_index = link->baud_count;
+    }
+
+    uint8_t type = raw[0], seq = raw[1];
+    const uint8_t *payload = &raw[2];
+    size_t payload_len = n - 6;
+
+    switch (type) {
+    case URNA_LINK_DATA:
+        handle_data(link, seq, payload, payload_len);
+        break;
+    case URNA_LINK_ACK:
+        handle_ack(link, seq);
+        break;
+    case URNA_LINK_RESET:
+        handle_reset(link, seq, payload, payload_len);
+        break;
+    case URNA_LINK_BAUD_REQ:
+        handle_baud_req(link, payload, payload_len);
+        break;
+    case URNA_LINK_BAUD_ACK:
+        handle_baud_ack(link, payload, payload_len);
+        break;
+    case URNA_LINK_SYNC_REQ:
+        send_u32_seq(link, URNA_LINK_SYNC, link->tx_base, link->tx_session);
+        break;
+    case URNA_LINK_SYNC:
+        handle_sync(link, seq, payload, payload_len);
+        break;
+    case URNA_LINK_PING:
+        // Sem numeração conhecida um ACK poderia confirmar quadros errados
+        if (link->rx_synced) link->ack_pending = true;
+        break;
+    default:
+        break;
+    }
+}
+
+void urna_link_rx_bytes(urna_link_t *link, const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        uint8_t b = data[i];
+        if (b == 0x00) {
+            if (link->rx_overflow) {
+                link->stats.rx_crc_errors++;
+            } else {
+                urna_link_rx_frame(link, link->rx_buf, link->rx_len);
+            }
+            link->rx_len = 0;
+            link->rx_overflow = false;
+        } else if (link->rx_len < sizeof(link->rx_buf)) {
+            link->rx_buf[link->rx_len++] = b;
+        } else {
+            link->rx_overflow = true; // Descarta até o próximo delimitador
+        }
+    }
+}
+
+static void poll_baud(urna_link_t *link, uint32_t now) {
+    switch (link->baud_state) {
+    case URNA_LINK_BAUD_IDLE:
+        // Só troca de taxa com a janela vazia, para não perder quadros em voo
+        if (link->baud_index >= link->baud_count || link->tx_next != link->tx_base) return;
+        if (!elapsed(now, link->baud_timer_ms, 0)) return;
+        link->baud_state = URNA_LINK_BAUD_REQUESTED;
+        link->baud_tries = 1;
+        link->baud_timer_ms = now;
+        send_u32(link, URNA_LINK_BAUD_REQ, link->baud_candidates[link->baud_index]);
+        break;
+
+    case URNA_LINK_BAUD_REQUESTED:
+        if (!elapsed(now, link->baud_timer_ms, URNA_LINK_RETX_MS)) return;
+        if (link->baud_tries >= URNA_LINK_BAUD_RETRIES) {
+            // O BAUD_ACK pode ter se perdido com o outro lado já na taxa nova
+            next_candidate(link, URNA_LINK_FALLBACK_MS);
+            return;
+        }
+        link->baud_tries++;
+        link->baud_timer_ms = now;
+        send_u32(link, URNA_LINK_BAUD_REQ, link->baud_candidates[link->baud_index]);
+        break;
+
+    case URNA_LINK_BAUD_PROBING:
+        if (!elapsed(now, link->baud_timer_ms, URNA_LINK_RETX_MS)) return;
+        if (link->baud_tries >= URNA_LINK_BAUD_RETRIES) {
+            set_baud(link, URNA_LINK_BASE_BAUD);
+            link->stats.baud_fallbacks++;
+            next_candidate(link, URNA_LINK_FALLBACK_MS);
+            return;
+        }
+        link->baud_tries++;
+        link->baud_timer_ms = now;
+        send_frame(link, URNA_LINK_PING, 0, NULL, 0);
+        break;
+    }
+}
+
+void urna_link_poll(urna_link_t *link) {
+    uint32_t now = now_ms(link);
+
+    if (link->ack_pending) {
+        link->ack_pending = false;
+        send_frame(link, URNA_LINK_ACK, link->rx_expected, NULL, 0);
+    }
+    if (link->sync_pending) {
+        link->sync_pending = false;
+        send_frame(link, URNA_LINK_SYNC_REQ, 0, NULL, 0);
+    }
+
+    // Go-Back-N: sem ACK a tempo, reenvia tudo a partir do mais antigo
+    if (link->tx_next != link->tx_base && elapsed(now, link->tx_timer_ms, URNA_LINK_RETX_MS)) {
+        for (uint8_t seq = link->tx_base; seq != link->tx_next; seq++) {
+            urna_link_slot_t *slot = &link->tx_slots[seq & WINDOW_MASK];
+            send_frame(link, slot->type, seq, slot->payload, slot->len);
+            link->stats.tx_retransmits++;
+        }
+        link->tx_timer_ms = now;
+    }
+
+    poll_baud(link, now);
+
+    if (link->baud != URNA_LINK_BASE_BAUD && link->baud_state == URNA_LINK_BAUD_IDLE) {
+        if (elapsed(now, link->last_rx_ms, URNA_LINK_FALLBACK_MS)) {
+            // Nada válido há muito tempo: os dois lados voltam à taxa base
+            set_baud(link, URNA_LINK_BASE_BAUD);
+            link->stats.baud_fallbacks++;
+        } else if (elapsed(now, link->last_tx_ms, URNA_LINK_KEEPALIVE_MS)) {
+            send_frame(link, URNA_LINK_PING, 0, NULL, 0);
+        }
+    }
+}
+
+void urna_link_negotiate_baud(urna_link_t *link, const uint32_t *rates, size_t count) {
+    link->baud_candidates = rates;
+    link->baud_count = count;
+    link->baud_index = 0;
+    link->baud_state = URNA_LINK_BAUD_IDLE;
+    link->baud_timer_ms = now_ms(link);
+}
@@ -0,0 +1,193 @@
+/**
+ * @file urna_link.h
+ *
+ * Protocolo de enlace binário entre a urna (MCU 1) e o auditor (MCU 2).
+ *
+ * Cada quadro tem o formato
+ *
+ *     +------+-----+-----------------+-----------+
+ *     | tipo | seq | payload (0..N)  | CRC-32    |
+ *     +------+-----+-----------------+-----------+
+ *
+ * codificado com COBS e cercado por bytes 0x00: o 0x00 nunca aparece dentro
+ * do quadro e serve como delimitador no fluxo da UART. Quadros vazios (dois
+ * delimitadores seguidos) são ignorados.
+ * O CRC é o CRC-32 IEEE (o mesmo do Ethernet e do zlib), calculado sobre
+ * tipo, seq e payload e enviado em big-endian. Com payloads de até 240 bytes
+ * e uma UART ruidosa a vários Mbaud, os 16 bits de um CRC-16 deixariam passar
+ * quadros corrompidos com frequência mensurável.
+ *
+ * A entrega é confiável e em ordem (Go-Back-N): o transmissor mantém até
+ * URNA_LINK_WINDOW quadros sem confirmação e os retransmite se o ACK
+ * cumulativo não chegar em URNA_LINK_RETX_MS. O receptor só aceita o número
+ * de sequência esperado e confirma com o próximo número que espera receber.
+ *
+ * A velocidade da UART pode ser renegociada em tempo de execução
+ * (urna_link_negotiate_baud): o transmissor propõe uma taxa, o receptor
+ * confirma e ambos trocam. Se nenhum quadro válido passar na nova taxa, os
+ * dois lados voltam sozinhos para URNA_LINK_BASE_BAUD.
+ *
+ * O módulo não depende do SDK do Pico: o acesso à UART e ao relógio é feito
+ * pelas funções de urna_link_io_t, o que permite usá-lo nos dois firmwares.
+ */
+
+#ifndef URNA_LINK_H
+#define URNA_LINK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define URNA_LINK_BASE_BAUD 115200
+#define URNA_LINK_MAX_BAUD 3000000
+
+// Payload máximo por quadro e tamanho máximo do quadro codificado (com os 0x00)
+#define URNA_LINK_MAX_PAYLOAD 240
+#define URNA_LINK_MAX_FRAME (2 + URNA_LINK_MAX_PAYLOAD + 4)
+#define URNA_LINK_MAX_ENCODED (URNA_LINK_MAX_FRAME + URNA_LINK_MAX_FRAME / 254 + 3)
+
+// Quadros sem confirmação em voo (potência de 2, menor que 128)
+#define URNA_LINK_WINDOW 8
+
+#define URNA_LINK_RETX_MS 200         // Espera pelo ACK antes de retransmitir
+#define URNA_LINK_BAUD_RETRIES 3      // Tentativas de cada etapa da negociação
+#define URNA_LINK_KEEPALIVE_MS 500    // PING quando ocioso fora da taxa base
+#define URNA_LINK_FALLBACK_MS 1500    // Silêncio que faz voltar à taxa base
+
+typedef enum {
+    URNA_LINK_DATA = 0x01,     // Payload da aplicação (confiável)
+    URNA_LINK_ACK = 0x02,      // seq = próximo número esperado
+    URNA_LINK_RESET = 0x03,    // Ressincroniza a numeração; payload: sessão (uint32 BE)
+    URNA_LINK_BAUD_REQ = 0x04, // Payload: taxa proposta (uint32 BE)
+    URNA_LINK_BAUD_ACK = 0x05, // Payload: taxa aceita (0 = recusada)
+    URNA_LINK_PING = 0x06,     // Pede um ACK (teste de vida)
+    URNA_LINK_SYNC_REQ = 0x07, // Receptor sem numeração pede um SYNC
+    URNA_LINK_SYNC = 0x08,     // seq = início da janela; payload: sessão (uint32 BE)
+} urna_link_type_t;
+
+/**
+ * @brief Acesso ao meio físico, fornecido por cada firmware.
+ */
+typedef struct {
+    // Envia bytes já codificados (quadro completo, com os delimitadores)
+    void (*write)(void *ctx, const uint8_t *data, size_t len);
+    // Troca a taxa da UART depois que a transmissão pendente terminou (pode ser NULL)
+    void (*set_baud)(void *ctx, uint32_t baud);
+    // Relógio em milissegundos
+    uint32_t (*now_ms)(void *ctx);
+    // Entrega, em ordem e sem duplicatas, o payload de um quadro DATA
+    void (*deliver)(void *ctx, const uint8_t *payload, size_t len);
+    void *ctx;
+} urna_link_io_t;
+
+/**
+ * @brief Contadores de diagnóstico do enlace.
+ */
+typedef struct {
+    uint32_t tx_frames;      // Quadros enviados (inclui retransmissões e controle)
+    uint32_t tx_retransmits; // Quadros DATA/RESET retransmitidos
+    uint32_t rx_frames;      // Quadros válidos recebidos
+    uint32_t rx_crc_errors;  // Quadros com CRC ou COBS inválido
+    uint32_t rx_out_of_order; // DATA fora de ordem descartados
+    uint32_t rx_duplicates;  // DATA repetidos (já entregues)
+    uint32_t delivered;      // Payloads entregues à aplicação
+    uint32_t baud_fallbacks; // Voltas forçadas para a taxa base
+} urna_link_stats_t;
+
+typedef enum {
+    URNA_LINK_BAUD_IDLE,      // Nenhuma negociação em andamento
+    URNA_LINK_BAUD_REQUESTED, // BAUD_REQ enviado, aguardando BAUD_ACK
+    URNA_LINK_BAUD_PROBING,   // Taxa trocada, aguardando o ACK do PING
+} urna_link_baud_state_t;
+
+typedef struct {
+    uint8_t type;
+    uint8_t len;
+    uint8_t payload[URNA_LINK_MAX_PAYLOAD];
+} urna_link_slot_t;
+
+typedef struct {
+    urna_link_io_t io;
+
+    // Transmissão: janela [tx_base, tx_next)
+    urna_link_slot_t tx_slots[URNA_LINK_WINDOW];
+    uint8_t tx_base;
+    uint8_t tx_next;
+    uint32_t tx_timer_ms;   // Início da espera pelo ACK do quadro mais antigo
+    uint32_t last_tx_ms;
+    uint32_t tx_session;
+
+    // Recepção
+    bool rx_synced;         // Já conhece a numeração do outro lado
+    uint8_t rx_expected;
+    uint32_t rx_session;    // Sessão do último RESET aceito
+    bool ack_pending;       // ACK cumulativo a enviar no próximo poll
+    bool sync_pending;      // SYNC_REQ a enviar no próximo poll
+    uint32_t last_rx_ms;
+    uint8_t rx_buf[URNA_LINK_MAX_ENCODED]; // Montagem de quadros (urna_link_rx_bytes)
+    size_t rx_len;
+    bool rx_overflow;
+
+    // Negociação de taxa
+    uint32_t baud;
+    urna_link_baud_state_t baud_state;
+    const uint32_t *baud_candidates;
+    size_t baud_count;
+    size_t baud_index;
+    uint8_t baud_tries;
+    uint32_t baud_timer_ms;
+
+    urna_link_stats_t stats;
+} urna_link_t;
+
+/**
+ * @brief Inicializa o enlace na taxa base e envia um RESET de numeração.
+ *
+ * @param session Identificador desta inicialização (ex.: get_rand_32()). O
+ * receptor só reinicia a numeração quando a sessão muda, para não confundir
+ * um RESET retransmitido com uma reinicialização do outro lado.
+ */
+void urna_link_init(urna_link_t *link, const urna_link_io_t *io, uint32_t session);
+
+/**
+ * @brief Enfileira um payload para entrega confiável.
+ * @return false se a janela está cheia ou o payload é grande demais.
+ */
+bool urna_link_send(urna_link_t *link, const void *payload, size_t len);
+
+/**
+ * @brief Espaço livre na janela de transmissão, em quadros.
+ */
+size_t urna_link_tx_free(const urna_link_t *link);
+
+/**
+ * @brief Processa um quadro já separado pelo delimitador 0x00 (sem ele).
+ */
+void urna_link_rx_frame(urna_link_t *link, const uint8_t *encoded, size_t len);
+
+/**
+ * @brief Processa bytes brutos da UART, separando os quadros pelo 0x00.
+ */
+void urna_link_rx_bytes(urna_link_t *link, const uint8_t *data, size_t len);
+
+/**
+ * @brief Temporizadores: retransmissão, ACKs pendentes, PING e fallback.
+ * Deve ser chamada periodicamente pelo loop principal.
+ */
+void urna_link_poll(urna_link_t *link);
+
+/**
+ * @brief Negocia a maior taxa possível da lista (em ordem decrescente).
+ * Cada taxa recusada ou que falha no teste faz tentar a próxima.
+ */
+void urna_link_negotiate_baud(urna_link_t *link, const uint32_t *rates, size_t count);
+
+// Codificação COBS. Retornam o tamanho de saída (0 em caso de erro).
+size_t urna_link_cobs_encode(const uint8_t *src, size_t len, uint8_t *dst);
+size_t urna_link_cobs_decode(const uint8_t *src, size_t len, uint8_t *dst, size_t cap);
+
+uint32_t urna_link_crc32(const uint8_t *data, size_t len);
+// Continua um CRC-32 já calculado (0 no começo), para dados em partes
+uint32_t urna_link_crc32_update(uint32_t crc, const uint8_t *data, size_t len);
+
+#endif // URNA_LINK_H
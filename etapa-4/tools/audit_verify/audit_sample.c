@@ -0,0 +1,228 @@
+/**
+ * @file audit_sample.c
+ *
+ * Gera um log de auditoria sintético, no formato do auditor, para testar o
+ * audit_verify com cédulas grandes.
+ *
+ * Os candidatos são distribuídos entre os cargos, cada cargo com a sua
+ * quantidade de dígitos (2 a 5). Cada eleitor vota em todos os cargos: em
+ * um candidato sorteado, em branco ou nulo. A cada
+ * audit_checkpoint_interval() registros, e no fim, vem um checkpoint montado
+ * com audit_checkpoint_encode, como o auditor grava.
+ *
+ * Antes de gravar, a própria ferramenta refaz a apuração dos registros (com
+ * audit_tally_apply, como o verificador) e confere cada candidato contra a
+ * contagem feita na geração, e o último checkpoint contra a apuração. Com
+ * mais candidatos que AUDIT_MAX_CANDIDATES a apuração tem de acusar votos
+ * não apurados, e o audit_verify tem de recusar o arquivo.
+ *
+ * Compilação (a partir desta pasta):
+ *
+ *     cc -O2 -o audit_sample audit_sample.c \
+ *        ../../common/audit_format/audit_record.c \
+ *        ../../common/audit_format/sha256.c \
+ *        -I../../common/audit_format
+ *
+ * Uso: audit_sample [-c candidatos] [-o cargos] [-n eleitores] [-s semente] arquivo.bin
+ *      (padrão: 100 candidatos em 4 cargos, 100000 eleitores)
+ *
+ * Exemplos:
+ *
+ *     audit_sample -c 100 amostra.bin && audit_verify amostra.bin   # sai com 0
+ *     audit_sample -c 600 amostra.bin; audit_verify amostra.bin     # sai com 1
+ *
+ * Sai com 0 se a apuração refeita confere com a gerada, 1 caso contrário.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "audit_record.h"
+
+#define CANDIDATES_LIMIT 4096
+
+typedef struct {
+    uint8_t office;
+    uint32_t number;   // audit_number_parse
+    uint32_t votes;    // Contagem da geração
+} candidate_t;
+
+static candidate_t candidates[CANDIDATES_LIMIT];
+
+static audit_record_t *records;
+static size_t count, capacity;
+static uint8_t prev_hash[SHA256_DIGEST_SIZE];
+static audit_tally_t writer_tally;  // Apuração do "auditor", para os checkpoints
+static size_t since_checkpoint;
+
+static void append(audit_record_t *rec) {
+    if (count == capacity) {
+        capacity = capacity ? capacity * 2 : 4096;
+        records = realloc(records, capacity * sizeof(*records));
+        if (!records) {
+            perror("realloc");
+            exit(2);
+        }
+    }
+    rec->seq = (uint32_t)count;
+    rec->time_ms = (uint32_t)count * 7;
+    rec->boot = 1;
+    audit_record_seal(rec, prev_hash);
+    memcpy(prev_hash, rec->hash, sizeof(prev_hash));
+    records[count++] = *rec;
+    since_checkpoint++;
+}
+
+static void checkpoint(void) {
+    size_t n = audit_checkpoint_records(&writer_tally);
+    for (size_t i = 0; i < n; i++) {
+        audit_record_t rec;
+        audit_checkpoint_encode(&writer_tally, i, &rec);
+        append(&rec);
+    }
+    since_checkpoint = 0;
+}
+
+// Um evento, aplicado à apuração do auditor como no audit_log
+static void event(audit_type_t type, const void *data, size_t len) {
+    audit_record_t rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.type = (uint8_t)type;
+    rec.len = (uint8_t)len;
+    if (len) memcpy(rec.data, data, len);
+    append(&rec);
+    audit_tally_apply(&writer_tally, &rec);
+    if (type == AUDIT_END || since_checkpoint >= audit_checkpoint_interval(&writer_tally)) checkpoint();
+}
+
+static uint32_t number_with_digits(uint32_t value, unsigned digits) {
+    char text[AUDIT_NUMBER_DIGITS_MAX + 1];
+    snprintf(text, sizeof(text), "%0*u", (int)digits, (unsigned)value);
+    return audit_number_parse((const uint8_t *)text, digits);
+}
+
+int main(int argc, char **argv) {
+    unsigned n_candidates = 100, n_offices = 4, seed = 1;
+    unsigned long voters = 100000;
+    int opt;
+    while ((opt = getopt(argc, argv, "c:o:n:s:")) != -1) {
+        switch (opt) {
+        case 'c': n_candidates = (unsigned)strtoul(optarg, NULL, 10); break;
+        case 'o': n_offices = (unsigned)strtoul(optarg, NULL, 10); break;
+        case 'n': voters = strtoul(optarg, NULL, 10); break;
+        case 's': seed = (unsigned)strtoul(optarg, NULL, 10); break;
+        default: optind = argc + 1; break;
+        }
+    }
+    if (optind != argc - 1 || n_offices == 0 || n_offices > AUDIT_MAX_OFFICES ||
+        n_candidates < n_offices || n_candidates > CANDIDATES_LIMIT) {
+        fprintf(stderr, "Uso: %s [-c candidatos] [-o cargos (1 a %d)] [-n eleitores] [-s semente] arquivo.bin\n",
+                argv[0], AUDIT_MAX_OFFICES);
+        return 2;
+    }
+    const char *path = argv[optind];
+    srand(seed);
+
+    // Candidatos em rodízio pelos cargos; o cargo k usa 2 + k % 4 dígitos
+    unsigned per_office[AUDIT_MAX_OFFICES] = {0};
+    for (unsigned i = 0; i < n_candidates; i++) {
+        uint8_t office = (uint8_t)(i % n_offices);
+        candidates[i] = (candidate_t){office, number_with_digits(10 + per_office[office]++, 2 + office % 4), 0};
+    }
+    uint32_t blank[AUDIT_MAX_OFFICES] = {0}, null[AUDIT_MAX_OFFICES] = {0};
+
+    audit_tally_reset(&writer_tally);
+    event(AUDIT_BOOT, NULL, 0);
+    uint32_t config = n_candidates;
+    event(AUDIT_CONFIG, &config, sizeof(config));
+    event(AUDIT_START, NULL, 0);
+    for (unsigned long v = 0; v < voters; v++) {
+        event(AUDIT_ENABLE, NULL, 0);
+        for (uint8_t office = 0; office < n_offices; office++) {
+            unsigned r = (unsigned)rand() % 100;
+            uint8_t data[5];
+            if (r < 4) {
+                blank[office]++;
+                event(AUDIT_BLANK, &office, 1);
+            } else if (r < 8) {
+                // Nulo: um número que nenhum candidato usa
+                uint32_t number = number_with_digits(9, 1);
+                memcpy(data, &number, 4);
+                data[4] = office;
+                null[office]++;
+                event(AUDIT_NULL, data, sizeof(data));
+            } else {
+                unsigned k = office + n_offices * ((unsigned)rand() % per_office[office]);
+                candidates[k].votes++;
+                memcpy(data, &candidates[k].number, 4);
+                data[4] = office;
+                event(AUDIT_VOTE, data, sizeof(data));
+            }
+        }
+    }
+    event(AUDIT_END, NULL, 0);
+
+    // Apuração refeita a partir do arquivo, como no audit_verify
+    audit_tally_t tally;
+    audit_tally_reset(&tally);
+    size_t last_checkpoint = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (records[i].type == AUDIT_CHECKPOINT) last_checkpoint = i;
+        audit_tally_apply(&tally, &records[i]);
+    }
+
+    unsigned failures = 0;
+    uint32_t expected_overflow = 0;
+    for (unsigned i = 0; i < n_candidates; i++) {
+        bool found = false;
+        for (uint16_t e = 0; e < tally.count; e++) {
+            if (tally.entries[e].office != candidates[i].office || tally.entries[e].number != candidates[i].number) continue;
+            found = true;
+            if (tally.entries[e].votes != candidates[i].votes && failures++ < 10) {
+                printf("FALHA: candidato %u do cargo %u com %u votos, esperado %u\n", i,
+                       candidates[i].office, tally.entries[e].votes, candidates[i].votes);
+            }
+        }
+        if (!found) expected_overflow += candidates[i].votes;
+    }
+    for (uint16_t e = 1; e < tally.count; e++) {
+        const audit_tally_entry_t *a = &tally.entries[e - 1], *b = &tally.entries[e];
+        if (a->office > b->office || (a->office == b->office && a->number >= b->number)) {
+            if (failures++ < 10) printf("FALHA: entradas fora de ordem na posicao %u\n", e);
+        }
+    }
+    for (uint8_t o = 0; o < n_offices; o++) {
+        if (tally.office[o].blank != blank[o] || tally.office[o].null != null[o]) {
+            if (failures++ < 10) printf("FALHA: brancos ou nulos do cargo %u\n", o);
+        }
+    }
+    if (tally.overflow != expected_overflow) {
+        printf("FALHA: %u votos nao apurados, esperado %u\n", tally.overflow, expected_overflow);
+        failures++;
+    }
+    if (n_candidates > AUDIT_MAX_CANDIDATES ? tally.overflow == 0 : tally.overflow != 0) {
+        printf("FALHA: %u candidatos com limite %d e %u votos nao apurados\n", n_candidates,
+               AUDIT_MAX_CANDIDATES, tally.overflow);
+        failures++;
+    }
+    audit_tally_t snapshot;
+    if (!audit_checkpoint_decode(&records[last_checkpoint], count - last_checkpoint, &snapshot) ||
+        !audit_tally_equal(&snapshot, &tally)) {
+        printf("FALHA: o ultimo checkpoint nao confere com a apuracao\n");
+        failures++;
+    }
+
+    FILE *fp = fopen(path, "wb");
+    if (!fp || fwrite(records, sizeof(*records), count, fp) != count || fclose(fp) != 0) {
+        perror(path);
+        return 2;
+    }
+    printf("%s: %zu registros, %u candidatos em %u cargos, %u apurados, %u votos nao apurados; %s\n",
+           path, count, n_candidates, n_offices, tally.count, tally.overflow, failures ? "FALHOU" : "OK");
+    free(records);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,311 @@
+/**
+ * @file audit_verify.c
+ *
+ * Verificador do log de auditoria (auditoria.bin) para o computador.
+ *
+ * Em uma única passada sobre o arquivo mapeado em memória:
+ *   - confere a posição (seq) e o hash encadeado de cada registro;
+ *   - refaz a apuração a partir dos registros de voto;
+ *   - compara cada checkpoint gravado pelo auditor com a apuração refeita.
+ *
+ * A apuração acompanha até AUDIT_MAX_CANDIDATES candidatos, o máximo da
+ * cédula da urna; votos em candidatos além disso não podem ser conferidos
+ * um a um, e o log é dado como inválido.
+ *
+ * Em processadores x86-64 com as instruções SHA (Intel Goldmont/Ice Lake em
+ * diante, AMD Zen) o hash usa essas instruções; nos demais, o SHA-256 em C
+ * do firmware.
+ *
+ * Compilação (a partir desta pasta):
+ *
+ *     cc -O2 -o audit_verify audit_verify.c \
+ *        ../../common/audit_format/audit_record.c \
+ *        ../../common/audit_format/sha256.c \
+ *        -I../../common/audit_format
+ *
+ * Uso: audit_verify [-v] auditoria.bin
+ *   -v  lista cada elo inválido e cada checkpoint conferido
+ *
+ * Sai com 0 se a cadeia e todos os checkpoints conferem e a apuração está
+ * completa, 1 caso contrário.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+#define USE_MMAP 0
+#else
+#define USE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "audit_record.h"
+#include "sha256.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define HAVE_SHA_NI 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+typedef void (*hash64_fn)(const uint8_t msg[64], uint8_t digest[32]);
+
+#ifdef HAVE_SHA_NI
+
+__attribute__((target("sha,sse4.1")))
+static void compress_sha_ni(uint32_t state[8], const uint8_t block[64]) {
+    const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+    // As instruções trabalham com o estado na ordem ABEF / CDGH
+    __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[0]), 0xB1);
+    __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[4]), 0x1B);
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+    const __m128i abef = state0, cdgh = state1;
+
+    __m128i w[16];
+    for (int g = 0; g < 16; g++) {
+        if (g < 4) {
+            w[g] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(block + 16 * g)), mask);
+        } else {
+            w[g] = _mm_sha256msg2_epu32(
+                _mm_add_epi32(_mm_sha256msg1_epu32(w[g - 4], w[g - 3]), _mm_alignr_epi8(w[g - 1], w[g - 2], 4)),
+                w[g - 1]);
+        }
+        __m128i wk = _mm_add_epi32(w[g], _mm_loadu_si128((const __m128i *)&sha256_k[4 * g]));
+        state1 = _mm_sha256rnds2_epu32(state1, state0, wk);
+        state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(wk, 0x0E));
+    }
+
+    state0 = _mm_add_epi32(state0, abef);
+    state1 = _mm_add_epi32(state1, cdgh);
+
+    tmp = _mm_shuffle_epi32(state0, 0x1B);
+    state1 = _mm_shuffle_epi32(state1, 0xB1);
+    _mm_storeu_si128((__m128i *)&state[0], _mm_blend_epi16(tmp, state1, 0xF0));
+    _mm_storeu_si128((__m128i *)&state[4], _mm_alignr_epi8(state1, tmp, 8));
+}
+
+static void hash64_sha_ni(const uint8_t msg[64], uint8_t digest[32]) {
+    static const uint8_t pad[64] = {[0] = 0x80, [62] = 0x02}; // 512 bits
+    uint32_t state[8];
+    memcpy(state, sha256_h0, sizeof(state));
+    compress_sha_ni(state, msg);
+    compress_sha_ni(state, pad);
+    for (int i = 0; i < 8; i++) {
+        digest[4 * i] = (uint8_t)(state[i] >> 24);
+        digest[4 * i + 1] = (uint8_t)(state[i] >> 16);
+        digest[4 * i + 2] = (uint8_t)(state[i] >> 8);
+        digest[4 * i + 3] = (uint8_t)state[i];
+    }
+}
+
+static bool cpu_has_sha_ni(void) {
+    unsigned a, b, c, d;
+    if (!__get_cpuid_count(7, 0, &a, &b, &c, &d)) return false;
+    bool sha = b & (1u << 29);
+    if (!__get_cpuid(1, &a, &b, &c, &d)) return false;
+    bool ssse3 = c & (1u << 9), sse41 = c & (1u << 19);
+    return sha && ssse3 && sse41;
+}
+
+#endif // HAVE_SHA_NI
+
+static hash64_fn select_hash(const char **name) {
+#ifdef HAVE_SHA_NI
+    if (cpu_has_sha_ni()) {
+        // Confere a implementação acelerada contra a portável antes de usá-la
+        uint8_t msg[64], a[32], b[32];
+        for (int i = 0; i < 64; i++) msg[i] = (uint8_t)(i * 37 + 1);
+        hash64_sha_ni(msg, a);
+        sha256_64(msg, b);
+        if (memcmp(a, b, sizeof(a)) == 0) {
+            *name = "SHA-NI";
+            return hash64_sha_ni;
+        }
+    }
+#endif
+    *name = "C";
+    return sha256_64;
+}
+
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+#if USE_MMAP
+    int fd;
+#endif
+} mapped_file_t;
+
+static bool map_file(const char *path, mapped_file_t *f) {
+    memset(f, 0, sizeof(*f));
+#if USE_MMAP
+    f->fd = open(path, O_RDONLY);
+    if (f->fd < 0) return false;
+    struct stat st;
+    if (fstat(f->fd, &st) != 0) return false;
+    f->size = (size_t)st.st_size;
+    if (f->size == 0) return true;
+    void *p = mmap(NULL, f->size, PROT_READ, MAP_PRIVATE, f->fd, 0);
+    if (p == MAP_FAILED) return false;
+    madvise(p, f->size, MADV_SEQUENTIAL);
+    f->data = p;
+    return true;
+#else
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return false;
+    fseek(fp, 0, SEEK_END);
+    f->size = (size_t)ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    uint8_t *buf = malloc(f->size ? f->size : 1);
+    bool ok = buf && fread(buf, 1, f->size, fp) == f->size;
+    fclose(fp);
+    f->data = buf;
+    return ok;
+#endif
+}
+
+static void unmap_file(mapped_file_t *f) {
+#if USE_MMAP
+    if (f->data) munmap((void *)f->data, f->size);
+    if (f->fd >= 0) close(f->fd);
+#else
+    free((void *)f->data);
+#endif
+}
+
+static double now_s(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv) {
+    bool verbose = false;
+    const char *path = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-v") == 0) {
+            verbose = true;
+        } else {
+            path = argv[i];
+        }
+    }
+    if (!path) {
+        fprintf(stderr, "Uso: %s [-v] auditoria.bin\n", argv[0]);
+        return 2;
+    }
+
+    mapped_file_t file;
+    if (!map_file(path, &file)) {
+        perror(path);
+        return 2;
+    }
+
+    const char *hash_name;
+    hash64_fn hash64 = select_hash(&hash_name);
+
+    double t0 = now_s();
+    const audit_record_t *records = (const audit_record_t *)file.data;
+    size_t count = file.size / AUDIT_RECORD_SIZE;
+
+    // O auditor pré-aloca o arquivo com zeros: os dados terminam no último
+    // registro não zerado (nenhum registro gravado é todo zeros)
+    static const uint8_t zero_record[AUDIT_RECORD_SIZE];
+    size_t unused = 0;
+    while (count > 0 && memcmp(&records[count - 1], zero_record, AUDIT_RECORD_SIZE) == 0) {
+        count--;
+        unused++;
+    }
+
+    uint8_t msg[64];
+    uint8_t digest[32];
+    memset(msg, 0, SHA256_DIGEST_SIZE); // hash[-1] = zeros
+
+    audit_tally_t tally;
+    audit_tally_reset(&tally);
+    size_t broken = 0, first_broken = 0, bad_seq = 0;
+    size_t checkpoints = 0, bad_checkpoints = 0, boots = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        const audit_record_t *rec = &records[i];
+
+        // A mensagem de cada elo é hash anterior || conteúdo deste registro
+        memcpy(msg + SHA256_DIGEST_SIZE, rec, AUDIT_BODY_SIZE);
+        hash64(msg, digest);
+        if (memcmp(digest, rec->hash, SHA256_DIGEST_SIZE) != 0) {
+            if (broken++ == 0) first_broken = i;
+            if (verbose) printf("Elo invalido no registro %zu\n", i);
+        }
+        // Os próximos elos são conferidos contra o hash gravado
+        memcpy(msg, rec->hash, SHA256_DIGEST_SIZE);
+
+        if (rec->seq != (uint32_t)i) bad_seq++;
+
+        switch (rec->type) {
+        case AUDIT_BOOT:
+            boots++;
+            break;
+        case AUDIT_CHECKPOINT: {
+            audit_tally_t snapshot;
+            checkpoints++;
+            bool ok = audit_checkpoint_decode(rec, count - i, &snapshot) && audit_tally_equal(&snapshot, &tally);
+            if (!ok) bad_checkpoints++;
+            if (verbose || !ok) {
+                printf("Checkpoint no registro %zu: %s\n", i, ok ? "confere" : "NAO CONFERE");
+            }
+            break;
+        }
+        default:
+            audit_tally_apply(&tally, rec);
+            break;
+        }
+    }
+    double elapsed = now_s() - t0;
+
+    printf("Arquivo: %s\n", path);
+    printf("Registros: %zu (%zu inicializacoes do auditor)\n", count, boots);
+    if (unused) printf("Espaco pre-alocado livre: %zu registros\n", unused);
+    if (file.size % AUDIT_RECORD_SIZE) {
+        printf("AVISO: %zu bytes incompletos no fim do arquivo\n", file.size % AUDIT_RECORD_SIZE);
+    }
+    if (broken) {
+        printf("Cadeia: %zu elo(s) INVALIDO(S), o primeiro no registro %zu\n", broken, first_broken);
+    } else {
+        printf("Cadeia: integra\n");
+    }
+    if (bad_seq) printf("Posicoes fora de ordem: %zu\n", bad_seq);
+    printf("Checkpoints: %zu conferidos, %zu divergentes\n", checkpoints - bad_checkpoints, bad_checkpoints);
+
+    // As entradas já estão por cargo e número
+    printf("\nApuracao (desde o ultimo INICIO):\n");
+    uint16_t next = 0;
+    for (uint8_t o = 0; o < tally.offices; o++) {
+        const audit_office_tally_t *office = &tally.office[o];
+        printf("  Cargo %u\n", o);
+        for (; next < tally.count && tally.entries[next].office == o; next++) {
+            char number[AUDIT_NUMBER_TEXT_MAX];
+            audit_number_format(tally.entries[next].number, number);
+            printf("    %-10s %u\n", number, tally.entries[next].votes);
+        }
+        printf("    Brancos    %u\n    Nulos      %u\n", office->blank, office->null);
+        if (office->overflow) printf("    NAO APURADOS %u (candidatos acima do limite)\n", office->overflow);
+    }
+    if (tally.overflow) {
+        printf("\nApuracao INCOMPLETA: %u votos em candidatos alem dos %d da cedula\n",
+               tally.overflow, AUDIT_MAX_CANDIDATES);
+    }
+
+    printf("\n%.3f s (%.1f MB/s, hash %s)\n", elapsed,
+           elapsed > 0 ? file.size / elapsed / 1e6 : 0.0, hash_name);
+
+    unmap_file(&file);
+    return (broken || bad_seq || bad_checkpoints || tally.overflow) ? 1 : 0;
+}
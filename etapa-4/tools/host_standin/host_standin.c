@@ -0,0 +1,603 @@
+/**
+ * @file host_standin.c
+ *
+ * Teste do host_link da urna contra um servidor que faz o papel do
+ * computador da mesa, tudo no computador e pela pilha TCP de verdade
+ * (loopback).
+ *
+ * O host_link.c do firmware é compilado sem mudanças; as poucas funções da
+ * API raw do lwIP que ele usa são implementadas aqui sobre sockets POSIX
+ * (os cabeçalhos em stub/ só declaram essas funções). O servidor substituto
+ * roda no mesmo laço e recebe eventos numerados, {"seq":N}: eles precisam
+ * chegar todos, na ordem, sem repetição, e o tempo total dá a vazão.
+ *
+ * O servidor passa por três comportamentos, nesta ordem:
+ *
+ *   pipeline  HTTP/1.1 mantendo a conexão, como o Flask com
+ *             protocol_version = "HTTP/1.1": as requisições chegam em
+ *             pipeline e nunca podem passar de HOST_LINK_PIPELINE;
+ *   quedas    HTTP/1.1, mas a conexão é fechada sem aviso depois de 10 a 40
+ *             respostas, com o resto do pipeline lido e jogado fora: os
+ *             eventos sem resposta têm de ser reenviados na mesma ordem.
+ *             Cada queda custa o intervalo mínimo de reconexão (250 ms),
+ *             então este modo usa um décimo dos eventos;
+ *   flask     o servidor padrão do Flask (Werkzeug, HTTP/1.0): responde a
+ *             primeira requisição com HTTP/1.0 e Connection: close, fecha e
+ *             descarta as outras do pipeline. A urna tem de cair para uma
+ *             requisição por conexão, e nenhuma conexão depois da primeira
+ *             pode levar mais de uma.
+ *
+ * Compilação (a partir desta pasta):
+ *
+ *     cc -O2 -o host_standin host_standin.c \
+ *        ../../urna_eletronica/host_link/host_link.c \
+ *        -Istub -I../../urna_eletronica/host_link
+ *
+ * Uso: host_standin [-n eventos] [-s semente]
+ *      (padrão: 5000 eventos; 500 no modo quedas)
+ *
+ * Sai com 0 se os três comportamentos passaram, 1 caso contrário.
+ */
+
+#define _GNU_SOURCE // memmem
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lwip/pbuf.h"
+#include "lwip/sys.h"
+#include "lwip/tcp.h"
+
+#include "host_link.h"
+
+#define MODE_TIMEOUT_MS 60000
+#define MAX_CONNS 16
+// Modo quedas: respostas por conexão antes do fechamento
+#define DROP_AFTER_MIN 10
+#define DROP_AFTER_MAX 40
+
+// ---------------------------------------------------------------------------
+// lwIP sobre sockets
+// ---------------------------------------------------------------------------
+
+struct tcp_pcb {
+    int fd;
+    void *arg;
+    tcp_recv_fn recv;
+    tcp_sent_fn sent;
+    tcp_err_fn errf;
+    tcp_connected_fn connected;
+    bool connecting;
+    bool fin;                   // FIN já entregue ao recv
+    bool dead;                  // Fechado pela aplicação ou pelo par; liberado no fim do laço
+    uint8_t out[TCP_SND_BUF];   // Escrito pelo tcp_write e ainda não enviado
+    size_t out_len;
+    uint16_t out_segs;
+    size_t acked;               // Enviado, a avisar pelo callback sent
+    struct tcp_pcb *next;
+};
+
+static struct tcp_pcb *pcbs;
+static uint16_t standin_port;   // Porta do servidor substituto (a do HOST_PORT é ignorada)
+
+static void set_nonblocking(int fd) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+uint32_t sys_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000u + ts.tv_nsec / 1000000);
+}
+
+uint8_t pbuf_free(struct pbuf *p) {
+    while (p) {
+        struct pbuf *next = p->next;
+        free(p);
+        p = next;
+    }
+    return 1;
+}
+
+int ipaddr_aton(const char *text, ip_addr_t *addr) {
+    addr->addr = 0;
+    return text != NULL;
+}
+
+struct tcp_pcb *tcp_new(void) {
+    struct tcp_pcb *pcb = calloc(1, sizeof(*pcb));
+    if (!pcb) return NULL;
+    pcb->fd = -1;
+    pcb->next = pcbs;
+    pcbs = pcb;
+    return pcb;
+}
+
+void tcp_arg(struct tcp_pcb *pcb, void *arg) { pcb->arg = arg; }
+void tcp_recv(struct tcp_pcb *pcb, tcp_recv_fn recv) { pcb->recv = recv; }
+void tcp_sent(struct tcp_pcb *pcb, tcp_sent_fn sent) { pcb->sent = sent; }
+void tcp_err(struct tcp_pcb *pcb, tcp_err_fn err) { pcb->errf = err; }
+void tcp_recved(struct tcp_pcb *pcb, u16_t len) { (void)pcb; (void)len; }
+
+void tcp_nagle_disable(struct tcp_pcb *pcb) {
+    (void)pcb; // TCP_NODELAY é ligado no connect, quando o socket existe
+}
+
+err_t tcp_connect(struct tcp_pcb *pcb, const ip_addr_t *addr, u16_t port, tcp_connected_fn connected) {
+    (void)addr;
+    (void)port;
+    pcb->fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (pcb->fd < 0) return ERR_MEM;
+    int one = 1;
+    setsockopt(pcb->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    set_nonblocking(pcb->fd);
+
+    struct sockaddr_in sa = {0};
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(standin_port);
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(pcb->fd, (struct sockaddr *)&sa, sizeof(sa)) < 0 && errno != EINPROGRESS) {
+        return ERR_CONN;
+    }
+    pcb->connected = connected;
+    pcb->connecting = true;
+    return ERR_OK;
+}
+
+u16_t tcp_sndbuf(const struct tcp_pcb *pcb) {
+    return (u16_t)(sizeof(pcb->out) - pcb->out_len);
+}
+
+u16_t tcp_sndqueuelen(const struct tcp_pcb *pcb) {
+    return pcb->out_segs;
+}
+
+err_t tcp_write(struct tcp_pcb *pcb, const void *data, u16_t len, u8_t flags) {
+    (void)flags;
+    if (pcb->dead || len > tcp_sndbuf(pcb) || pcb->out_segs >= TCP_SND_QUEUELEN) return ERR_MEM;
+    memcpy(pcb->out + pcb->out_len, data, len);
+    pcb->out_len += len;
+    pcb->out_segs++;
+    return ERR_OK;
+}
+
+// Fecha o socket; o PCB continua na lista até o fim da volta do laço, como
+// no lwIP, onde ele não pode mais ser usado depois do close
+static void pcb_kill(struct tcp_pcb *pcb, bool reset) {
+    if (pcb->fd >= 0) {
+        if (reset) {
+            struct linger lg = {1, 0};
+            setsockopt(pcb->fd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+        }
+        close(pcb->fd);
+        pcb->fd = -1;
+    }
+    pcb->dead = true;
+}
+
+// Conexão perdida: o lwIP libera o PCB e avisa pelo callback de erro
+static void pcb_fail(struct tcp_pcb *pcb, err_t err) {
+    tcp_err_fn errf = pcb->errf;
+    pcb_kill(pcb, true);
+    if (errf) errf(pcb->arg, err);
+}
+
+err_t tcp_output(struct tcp_pcb *pcb) {
+    if (pcb->dead || pcb->connecting || pcb->out_len == 0) return ERR_OK;
+    ssize_t n = send(pcb->fd, pcb->out, pcb->out_len, MSG_NOSIGNAL);
+    if (n < 0) {
+        return errno == EAGAIN || errno == EWOULDBLOCK ? ERR_OK : ERR_CONN;
+    }
+    memmove(pcb->out, pcb->out + n, pcb->out_len - (size_t)n);
+    pcb->out_len -= (size_t)n;
+    if (pcb->out_len == 0) pcb->out_segs = 0;
+    pcb->acked += (size_t)n;
+    return ERR_OK;
+}
+
+err_t tcp_close(struct tcp_pcb *pcb) {
+    pcb_kill(pcb, false);
+    return ERR_OK;
+}
+
+void tcp_abort(struct tcp_pcb *pcb) {
+    pcb_fail(pcb, ERR_ABRT);
+}
+
+static void pcb_events(struct tcp_pcb *pcb, short revents) {
+    if (pcb->connecting) {
+        if (!(revents & (POLLOUT | POLLERR | POLLHUP))) return;
+        int err = 0;
+        socklen_t len = sizeof(err);
+        getsockopt(pcb->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+        if (err) {
+            pcb_fail(pcb, ERR_CONN);
+            return;
+        }
+        pcb->connecting = false;
+        if (pcb->connected) pcb->connected(pcb->arg, pcb, ERR_OK);
+        if (pcb->dead) return;
+    }
+
+    if (revents & (POLLIN | POLLHUP | POLLERR)) {
+        uint8_t buf[2048];
+        ssize_t n = recv(pcb->fd, buf, sizeof(buf), 0);
+        if (n > 0) {
+            struct pbuf *p = malloc(sizeof(*p) + (size_t)n);
+            p->next = NULL;
+            p->payload = p + 1;
+            p->len = p->tot_len = (uint16_t)n;
+            memcpy(p->payload, buf, (size_t)n);
+            if (pcb->recv) pcb->recv(pcb->arg, pcb, p, ERR_OK);
+            else pbuf_free(p);
+        } else if (n == 0 && !pcb->fin) {
+            pcb->fin = true;
+            if (pcb->recv) pcb->recv(pcb->arg, pcb, NULL, ERR_OK);
+            else tcp_close(pcb);
+        } else if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            pcb_fail(pcb, ERR_RST);
+        }
+        if (pcb->dead) return;
+    }
+
+    if ((revents & POLLOUT) && tcp_output(pcb) != ERR_OK) {
+        pcb_fail(pcb, ERR_RST);
+        return;
+    }
+    if (pcb->acked > 0) {
+        u16_t acked = (u16_t)(pcb->acked > 0xFFFF ? 0xFFFF : pcb->acked);
+        pcb->acked -= acked;
+        if (pcb->sent) pcb->sent(pcb->arg, pcb, acked);
+    }
+}
+
+static void pcb_reap(void) {
+    for (struct tcp_pcb **link = &pcbs; *link;) {
+        struct tcp_pcb *pcb = *link;
+        if (pcb->dead) {
+            *link = pcb->next;
+            free(pcb);
+        } else {
+            link = &pcb->next;
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Servidor substituto
+// ---------------------------------------------------------------------------
+
+typedef enum { MODE_PIPELINE, MODE_DROPS, MODE_FLASK } standin_mode_t;
+
+static const char *const MODE_NAMES[] = {"pipeline", "quedas", "flask"};
+
+// Respostas como as do Werkzeug, nas duas versões do protocolo
+static const char RESPONSE_11[] =
+    "HTTP/1.1 200 OK\r\n"
+    "Server: Werkzeug/3.0.1 Python/3.11.2\r\n"
+    "Content-Type: application/json\r\n"
+    "Content-Length: 16\r\n\r\n"
+    "{\"status\":\"ok\"}\n";
+static const char RESPONSE_10[] =
+    "HTTP/1.0 200 OK\r\n"
+    "Server: Werkzeug/3.0.1 Python/3.11.2\r\n"
+    "Content-Type: application/json\r\n"
+    "Content-Length: 16\r\n"
+    "Connection: close\r\n\r\n"
+    "{\"status\":\"ok\"}\n";
+
+typedef struct {
+    int fd;
+    char in[8192];
+    size_t in_len;
+    unsigned answered;
+    unsigned budget;            // Modo quedas: respostas até o fechamento
+} conn_t;
+
+static struct {
+    standin_mode_t mode;
+    int listen_fd;
+    conn_t conns[MAX_CONNS];
+    uint32_t next_seq;          // Próximo evento esperado
+    uint32_t duplicates;
+    uint32_t out_of_order;
+    uint32_t malformed;
+    uint32_t accepted;          // Conexões aceitas
+    uint32_t discarded;         // Requisições lidas e jogadas fora no fechamento
+    uint32_t first_received;    // Modo flask: requisições da primeira conexão
+    uint32_t multi_after_first; // Modo flask: conexões seguintes com mais de uma
+    uint32_t max_batch;         // Maior número de requisições lidas de uma vez
+} srv;
+
+static void conn_close(conn_t *c, unsigned unanswered) {
+    srv.discarded += unanswered;
+    if (srv.mode == MODE_FLASK) {
+        unsigned received = c->answered + unanswered;
+        if (srv.accepted == 1) srv.first_received = received;
+        else if (received > 1) srv.multi_after_first++;
+    }
+    // Como o socketserver do Python: shutdown e close, sem ler o resto
+    shutdown(c->fd, SHUT_WR);
+    close(c->fd);
+    c->fd = -1;
+}
+
+static void record_seq(const char *body, size_t len) {
+    unsigned seq;
+    char text[HOST_LINK_EVENT_MAX + 1];
+    if (len > HOST_LINK_EVENT_MAX) len = HOST_LINK_EVENT_MAX;
+    memcpy(text, body, len);
+    text[len] = '\0';
+    if (sscanf(text, "{\"seq\":%u}", &seq) != 1) {
+        srv.malformed++;
+        return;
+    }
+    if (seq == srv.next_seq) {
+        srv.next_seq++;
+    } else if (seq < srv.next_seq) {
+        if (srv.duplicates++ < 5) fprintf(stderr, "  evento %u repetido (esperado %u)\n", seq, srv.next_seq);
+    } else {
+        if (srv.out_of_order++ < 5) fprintf(stderr, "  evento %u fora de ordem (esperado %u)\n", seq, srv.next_seq);
+        srv.next_seq = seq + 1;
+    }
+}
+
+// Quantas requisições completas há no começo do buffer
+static unsigned count_requests(const char *data, size_t len) {
+    unsigned count = 0;
+    const char *end;
+    while ((end = memmem(data, len, "\r\n\r\n", 4)) != NULL) {
+        size_t header_len = (size_t)(end + 4 - data);
+        const char *cl = memmem(data, header_len, "Content-Length:", 15);
+        size_t body_len = cl ? strtoul(cl + 15, NULL, 10) : 0;
+        if (len < header_len + body_len) break;
+        data += header_len + body_len;
+        len -= header_len + body_len;
+        count++;
+    }
+    return count;
+}
+
+static void conn_read(conn_t *c) {
+    ssize_t n = recv(c->fd, c->in + c->in_len, sizeof(c->in) - c->in_len, 0);
+    if (n <= 0) {
+        if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) conn_close(c, count_requests(c->in, c->in_len));
+        return;
+    }
+    c->in_len += (size_t)n;
+
+    unsigned batch = count_requests(c->in, c->in_len);
+    if (batch > srv.max_batch) srv.max_batch = batch;
+
+    size_t pos = 0;
+    for (unsigned i = 0; i < batch; i++) {
+        const char *req = c->in + pos;
+        const char *end = memmem(req, c->in_len - pos, "\r\n\r\n", 4);
+        if (!end) break;
+        size_t header_len = (size_t)(end + 4 - req);
+        const char *cl = memmem(req, header_len, "Content-Length:", 15);
+        size_t body_len = cl ? strtoul(cl + 15, NULL, 10) : 0;
+        if (strncmp(req, "POST /comando HTTP/1.1\r\n", 24) != 0) srv.malformed++;
+        record_seq(req + header_len, body_len);
+        pos += header_len + body_len;
+        c->answered++;
+
+        if (srv.mode == MODE_FLASK) {
+            send(c->fd, RESPONSE_10, sizeof(RESPONSE_10) - 1, MSG_NOSIGNAL);
+            conn_close(c, batch - i - 1);
+            return;
+        }
+        send(c->fd, RESPONSE_11, sizeof(RESPONSE_11) - 1, MSG_NOSIGNAL);
+        if (srv.mode == MODE_DROPS && c->answered == c->budget) {
+            conn_close(c, batch - i - 1);
+            return;
+        }
+    }
+    memmove(c->in, c->in + pos, c->in_len - pos);
+    c->in_len -= pos;
+}
+
+static void conn_accept(void) {
+    int fd = accept(srv.listen_fd, NULL, NULL);
+    if (fd < 0) return;
+    for (int i = 0; i < MAX_CONNS; i++) {
+        conn_t *c = &srv.conns[i];
+        if (c->fd >= 0) continue;
+        set_nonblocking(fd);
+        c->fd = fd;
+        c->in_len = 0;
+        c->answered = 0;
+        c->budget = DROP_AFTER_MIN + (unsigned)(rand() % (DROP_AFTER_MAX - DROP_AFTER_MIN + 1));
+        srv.accepted++;
+        return;
+    }
+    close(fd);
+}
+
+static bool server_open(void) {
+    for (int i = 0; i < MAX_CONNS; i++) srv.conns[i].fd = -1;
+    srv.listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (srv.listen_fd < 0) return false;
+    struct sockaddr_in sa = {0};
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(sa);
+    if (bind(srv.listen_fd, (struct sockaddr *)&sa, sizeof(sa)) < 0 ||
+        listen(srv.listen_fd, 16) < 0 ||
+        getsockname(srv.listen_fd, (struct sockaddr *)&sa, &len) < 0) {
+        return false;
+    }
+    set_nonblocking(srv.listen_fd);
+    standin_port = ntohs(sa.sin_port);
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Laço e verificação
+// ---------------------------------------------------------------------------
+
+// Uma volta: espera até timeout_ms por atividade no servidor ou no host_link;
+// devolve false se nada aconteceu
+static bool net_poll(int timeout_ms) {
+    struct pollfd fds[1 + MAX_CONNS + 8];
+    struct tcp_pcb *owners[8];
+    conn_t *conns[MAX_CONNS];
+    nfds_t n = 0, n_conns = 0, n_pcbs = 0;
+
+    fds[n++] = (struct pollfd){srv.listen_fd, POLLIN, 0};
+    for (int i = 0; i < MAX_CONNS; i++) {
+        if (srv.conns[i].fd < 0) continue;
+        conns[n_conns++] = &srv.conns[i];
+        fds[n++] = (struct pollfd){srv.conns[i].fd, POLLIN, 0};
+    }
+    for (struct tcp_pcb *pcb = pcbs; pcb && n_pcbs < 8; pcb = pcb->next) {
+        if (pcb->dead || pcb->fd < 0) continue;
+        short events = (short)(pcb->fin ? 0 : POLLIN);
+        if (pcb->connecting || pcb->out_len > 0) events |= POLLOUT;
+        owners[n_pcbs++] = pcb;
+        fds[n++] = (struct pollfd){pcb->fd, events, 0};
+    }
+    if (poll(fds, n, timeout_ms) <= 0) return false;
+
+    if (fds[0].revents & POLLIN) conn_accept();
+    for (nfds_t i = 0; i < n_conns; i++) {
+        if (fds[1 + i].revents && conns[i]->fd >= 0) conn_read(conns[i]);
+    }
+    for (nfds_t i = 0; i < n_pcbs; i++) {
+        short revents = fds[1 + n_conns + i].revents;
+        if (!owners[i]->dead) pcb_events(owners[i], revents);
+    }
+    pcb_reap();
+    return true;
+}
+
+static bool run_mode(standin_mode_t mode, uint32_t events) {
+    host_link_stats_t before, st;
+    host_link_stats(&before);
+    srv.mode = mode;
+    srv.next_seq = srv.duplicates = srv.out_of_order = srv.malformed = 0;
+    srv.accepted = srv.discarded = srv.first_received = srv.multi_after_first = srv.max_batch = 0;
+
+    uint32_t produced = 0;
+    uint32_t start = sys_now();
+    bool timed_out = false;
+    bool idle = false;
+    for (;;) {
+        host_link_stats(&st);
+        // Cada evento aceito pela fila tem o próximo número
+        while (produced < events && st.pending < HOST_LINK_QUEUE_LEN) {
+            if (host_link_event("{\"seq\":%u}", (unsigned)produced)) produced++;
+            host_link_stats(&st);
+        }
+        if (produced == events && st.pending == 0) break;
+        if (sys_now() - start > MODE_TIMEOUT_MS) {
+            timed_out = true;
+            break;
+        }
+        host_link_poll();
+        // Só dorme quando a volta anterior não teve nada: a espera fixa
+        // entraria na vazão medida
+        idle = !net_poll(idle ? 1 : 0);
+    }
+    uint32_t elapsed = sys_now() - start;
+
+    // O modo seguinte começa com conexões novas
+    for (int i = 0; i < MAX_CONNS; i++) {
+        if (srv.conns[i].fd >= 0) conn_close(&srv.conns[i], 0);
+    }
+    for (int i = 0; i < 20; i++) {
+        host_link_poll();
+        net_poll(1);
+    }
+
+    host_link_stats(&st);
+    uint32_t delivered = st.delivered - before.delivered;
+    printf("%-8s  %6u eventos em %5u ms: %8.0f eventos/s, %5u conexoes, "
+           "%5u descartados pelo servidor, ate %u por leitura\n",
+           MODE_NAMES[mode], (unsigned)delivered, (unsigned)elapsed,
+           elapsed ? delivered * 1000.0 / elapsed : 0.0,
+           (unsigned)srv.accepted, (unsigned)srv.discarded, (unsigned)srv.max_batch);
+
+    bool ok = true;
+    if (timed_out) {
+        printf("  FALHA: %u de %u eventos entregues em %u ms\n",
+               (unsigned)srv.next_seq, (unsigned)events, MODE_TIMEOUT_MS);
+        ok = false;
+    }
+    if (srv.next_seq != events || delivered != events) {
+        printf("  FALHA: servidor recebeu ate o evento %u, host_link contou %u entregues\n",
+               (unsigned)srv.next_seq, (unsigned)delivered);
+        ok = false;
+    }
+    if (srv.duplicates || srv.out_of_order || srv.malformed) {
+        printf("  FALHA: %u repetidos, %u fora de ordem, %u malformados\n",
+               (unsigned)srv.duplicates, (unsigned)srv.out_of_order, (unsigned)srv.malformed);
+        ok = false;
+    }
+    if (st.dropped != before.dropped) {
+        printf("  FALHA: %u eventos perdidos com a fila cheia\n", (unsigned)(st.dropped - before.dropped));
+        ok = false;
+    }
+    if (srv.max_batch > HOST_LINK_PIPELINE) {
+        printf("  FALHA: %u requisicoes em pipeline (limite %d)\n", (unsigned)srv.max_batch, HOST_LINK_PIPELINE);
+        ok = false;
+    }
+    if (mode == MODE_DROPS && events > DROP_AFTER_MAX && srv.discarded == 0) {
+        printf("  FALHA: nenhuma queda pegou requisicoes em pipeline\n");
+        ok = false;
+    }
+    if (mode == MODE_FLASK) {
+        printf("          primeira conexao: %u requisicoes, %u descartadas; "
+               "%u conexoes seguintes com mais de uma\n",
+               (unsigned)srv.first_received, (unsigned)(srv.first_received ? srv.first_received - 1 : 0),
+               (unsigned)srv.multi_after_first);
+        if (srv.first_received < 2 || srv.multi_after_first > 0) {
+            printf("  FALHA: esperado um pipeline na primeira conexao e uma requisicao por conexao depois\n");
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    uint32_t events = 5000;
+    unsigned seed = 1;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:s:")) != -1) {
+        switch (opt) {
+        case 'n': events = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case 's': seed = (unsigned)strtoul(optarg, NULL, 10); break;
+        default:
+            fprintf(stderr, "Uso: %s [-n eventos] [-s semente]\n", argv[0]);
+            return 1;
+        }
+    }
+    srand(seed);
+    if (!server_open()) {
+        perror("servidor");
+        return 1;
+    }
+
+    // O modo flask fica por último: depois dele a urna fica em HTTP/1.0
+    bool ok = true;
+    ok &= run_mode(MODE_PIPELINE, events);
+    ok &= run_mode(MODE_DROPS, events / 10 ? events / 10 : 1);
+    ok &= run_mode(MODE_FLASK, events);
+
+    host_link_stats_t st;
+    host_link_stats(&st);
+    printf("%u conexoes abertas pelo host_link; %s\n", (unsigned)st.reconnects, ok ? "OK" : "FALHOU");
+    return ok ? 0 : 1;
+}
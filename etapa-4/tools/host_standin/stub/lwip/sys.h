@@ -0,0 +1,8 @@
+#ifndef STANDIN_LWIP_SYS_H
+#define STANDIN_LWIP_SYS_H
+
+#include <stdint.h>
+
+uint32_t sys_now(void);
+
+#endif
@@ -0,0 +1,60 @@
+/**
+ * @file tcp.h
+ *
+ * O pedaço da API raw TCP do lwIP usado por host_link.c, implementado em
+ * host_standin.c sobre sockets POSIX. Só para compilar o módulo no
+ * computador.
+ */
+
+#ifndef STANDIN_LWIP_TCP_H
+#define STANDIN_LWIP_TCP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lwip/pbuf.h"
+
+typedef int8_t err_t;
+typedef uint8_t u8_t;
+typedef uint16_t u16_t;
+typedef uint32_t u32_t;
+
+#define ERR_OK 0
+#define ERR_MEM -1
+#define ERR_CONN -11
+#define ERR_ABRT -13
+#define ERR_RST -14
+
+#define TCP_SND_BUF (8 * 1460)
+#define TCP_SND_QUEUELEN 32
+#define TCP_WRITE_FLAG_COPY 0x01
+#define TCP_WRITE_FLAG_MORE 0x02
+
+typedef struct {
+    uint32_t addr;
+} ip_addr_t;
+
+struct tcp_pcb;
+typedef err_t (*tcp_recv_fn)(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err);
+typedef err_t (*tcp_sent_fn)(void *arg, struct tcp_pcb *pcb, u16_t len);
+typedef err_t (*tcp_connected_fn)(void *arg, struct tcp_pcb *pcb, err_t err);
+typedef void (*tcp_err_fn)(void *arg, err_t err);
+
+int ipaddr_aton(const char *text, ip_addr_t *addr);
+struct tcp_pcb *tcp_new(void);
+void tcp_arg(struct tcp_pcb *pcb, void *arg);
+void tcp_recv(struct tcp_pcb *pcb, tcp_recv_fn recv);
+void tcp_sent(struct tcp_pcb *pcb, tcp_sent_fn sent);
+void tcp_err(struct tcp_pcb *pcb, tcp_err_fn err);
+void tcp_nagle_disable(struct tcp_pcb *pcb);
+err_t tcp_connect(struct tcp_pcb *pcb, const ip_addr_t *addr, u16_t port, tcp_connected_fn connected);
+err_t tcp_write(struct tcp_pcb *pcb, const void *data, u16_t len, u8_t flags);
+err_t tcp_output(struct tcp_pcb *pcb);
+u16_t tcp_sndbuf(const struct tcp_pcb *pcb);
+u16_t tcp_sndqueuelen(const struct tcp_pcb *pcb);
+void tcp_recved(struct tcp_pcb *pcb, u16_t len);
+err_t tcp_close(struct tcp_pcb *pcb);
+void tcp_abort(struct tcp_pcb *pcb);
+
+#endif
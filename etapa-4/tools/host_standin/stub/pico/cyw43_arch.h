@@ -0,0 +1,8 @@
+#ifndef STANDIN_CYW43_ARCH_H
+#define STANDIN_CYW43_ARCH_H
+
+// Um só laço no computador: não há o que travar
+static inline void cyw43_arch_lwip_begin(void) {}
+static inline void cyw43_arch_lwip_end(void) {}
+
+#endif
@@ -0,0 +1,482 @@
+/**
+ * @file http_parser_fuzz.c
+ *
+ * Teste do parser HTTP da urna (urna_eletronica/http_server/http_parser.c)
+ * no computador, com requisições gravadas do app, do navegador e do curl.
+ *
+ * Etapas:
+ *   - cada requisição gravada, inteira, confere com o resultado esperado
+ *     (requisições completas e o status do erro, se houver);
+ *   - a mesma requisição dividida em dois pedaços em cada posição possível,
+ *     byte a byte e em pedaços aleatórios: o resultado tem que ser idêntico
+ *     ao da requisição inteira (mesmos cabeçalhos, caminho, corpo e erro);
+ *   - requisições gravadas com bytes trocados, inseridos e apagados, também
+ *     em pedaços aleatórios: nada pode sair dos limites (compile com
+ *     -fsanitize=address,undefined) e o resultado não depende dos pedaços;
+ *   - vazão: o conjunto gravado repetido, em segmentos do tamanho do MSS.
+ *
+ * Como no servidor, o que sobra de um pedaço depois do fim de uma
+ * requisição vai para a seguinte, e um erro encerra a conexão.
+ *
+ * Compilação (a partir desta pasta):
+ *
+ *     cc -O2 -o http_parser_fuzz http_parser_fuzz.c \
+ *        ../../urna_eletronica/http_server/http_parser.c \
+ *        -I../../urna_eletronica/http_server
+ *
+ * Uso: http_parser_fuzz [iterações]   (padrão: 200000)
+ *
+ * Sai com 0 se todas as etapas passam, 1 caso contrário.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "http_parser.h"
+
+#define STREAM_MAX (64 * 1024)
+#define TCP_MSS 1460
+#define THROUGHPUT_BYTES (64u * 1024 * 1024)
+
+// Requisição gravada e o que o parser deve fazer com ela
+typedef struct {
+    const char *name;
+    const char *text;           // NULL: gerada por build()
+    void (*build)(char *out, size_t size);
+    int requests;               // Requisições completas esperadas
+    int error;                  // Status do erro no fim, 0 se nenhum
+} recorded_t;
+
+// Resultado de uma passada: tudo o que os callbacks viram, resumido em um
+// hash, e as contagens
+typedef struct {
+    uint64_t hash;
+    int requests;
+    int error;
+    uint64_t body_bytes;
+    bool broken;                // Alguma invariante falhou
+    char why[96];
+} trace_t;
+
+// Contexto dos callbacks durante um pedaço
+typedef struct {
+    trace_t *trace;
+    const http_parser_t *parser;
+    const uint8_t *chunk;
+    size_t chunk_len;
+    uint32_t body_seen;
+} run_ctx_t;
+
+static uint32_t rng_state = 12345;
+static uint32_t rnd(void) {
+    rng_state = rng_state * 1103515245u + 12345u;
+    return (rng_state >> 8) & 0xFFFFFF;
+}
+
+// FNV-1a, 64 bits
+static void hash_bytes(trace_t *t, const void *data, size_t len) {
+    const uint8_t *p = data;
+    for (size_t i = 0; i < len; i++) {
+        t->hash ^= p[i];
+        t->hash *= 1099511628211ull;
+    }
+}
+
+static void hash_str(trace_t *t, const char *s) {
+    hash_bytes(t, s, strlen(s) + 1);
+}
+
+static void broken(trace_t *t, const char *why) {
+    if (!t->broken) snprintf(t->why, sizeof(t->why), "%s", why);
+    t->broken = true;
+}
+
+static int on_header(void *ctx, const char *name, const char *value) {
+    run_ctx_t *c = ctx;
+    size_t name_len = strnlen(name, HTTP_HEADER_NAME_MAX);
+    if (name_len == HTTP_HEADER_NAME_MAX || strnlen(value, HTTP_HEADER_VALUE_MAX) == HTTP_HEADER_VALUE_MAX) {
+        broken(c->trace, "cabecalho sem '\\0' dentro do limite");
+    }
+    for (size_t i = 0; i < name_len; i++) {
+        if (name[i] >= 'A' && name[i] <= 'Z') broken(c->trace, "nome de cabecalho com maiuscula");
+    }
+    hash_str(c->trace, "H");
+    hash_str(c->trace, name);
+    hash_str(c->trace, value);
+    return 0;
+}
+
+static int on_headers_done(void *ctx) {
+    run_ctx_t *c = ctx;
+    const http_parser_t *p = c->parser;
+    if (strnlen(p->path, HTTP_PATH_MAX) == HTTP_PATH_MAX) broken(c->trace, "caminho sem '\\0'");
+    uint8_t head[3] = {(uint8_t)p->method, p->version_minor, 0};
+    hash_str(c->trace, "D");
+    hash_bytes(c->trace, head, sizeof(head));
+    hash_str(c->trace, p->path);
+    hash_bytes(c->trace, &p->content_length, sizeof(p->content_length));
+    c->body_seen = 0;
+    return 0;
+}
+
+static int on_body(void *ctx, const uint8_t *data, size_t len) {
+    run_ctx_t *c = ctx;
+    // O corpo aponta para o pedaço recebido, sem cópia
+    if (len == 0 || data < c->chunk || data + len > c->chunk + c->chunk_len) {
+        broken(c->trace, "trecho do corpo fora do pedaco");
+        return 0;
+    }
+    hash_bytes(c->trace, data, len);
+    c->body_seen += (uint32_t)len;
+    c->trace->body_bytes += len;
+    return 0;
+}
+
+static void on_complete(void *ctx) {
+    run_ctx_t *c = ctx;
+    if (c->body_seen != c->parser->content_length) broken(c->trace, "corpo com tamanho diferente do Content-Length");
+    hash_str(c->trace, "C");
+    c->trace->requests++;
+}
+
+static const http_parser_callbacks_t callbacks = {on_header, on_headers_done, on_body, on_complete};
+
+/**
+ * Passa o fluxo pelo parser nos pedaços dados por 'cuts' (posições em
+ * ordem crescente, sem 0 nem len), como o servidor faz com cada pbuf.
+ */
+static void run(const uint8_t *data, size_t len, const size_t *cuts, size_t ncuts, trace_t *t) {
+    static http_parser_t parser;
+    memset(t, 0, sizeof(*t));
+    t->hash = 14695981039346656037ull;
+    run_ctx_t c = {t, &parser, NULL, 0, 0};
+    http_parser_init(&parser);
+
+    size_t start = 0;
+    for (size_t k = 0; k <= ncuts && !t->error; k++) {
+        size_t end = k < ncuts ? cuts[k] : len;
+        const uint8_t *chunk = data + start;
+        size_t left = end - start;
+        while (left > 0) {
+            c.chunk = chunk;
+            c.chunk_len = left;
+            size_t used = http_parser_feed(&parser, chunk, left, &callbacks, &c);
+            if (used > left) {
+                broken(t, "consumiu mais do que recebeu");
+                return;
+            }
+            if (http_parser_failed(&parser)) {
+                t->error = parser.error;
+                if (t->error < 400 || t->error > 599) broken(t, "erro sem status HTTP");
+                hash_bytes(t, &t->error, sizeof(t->error));
+                break;
+            }
+            if (http_parser_done(&parser)) {
+                http_parser_init(&parser);
+            } else if (used < left) {
+                broken(t, "parou no meio sem terminar nem falhar");
+                return;
+            }
+            chunk += used;
+            left -= used;
+        }
+        start = end;
+    }
+}
+
+static bool same(const trace_t *a, const trace_t *b) {
+    return a->hash == b->hash && a->requests == b->requests && a->error == b->error &&
+           a->body_bytes == b->body_bytes && !a->broken && !b->broken;
+}
+
+static const char *why(const trace_t *whole, const trace_t *t) {
+    if (whole->broken) return whole->why;
+    if (t->broken) return t->why;
+    return "resultado diferente do da requisicao inteira";
+}
+
+// Cortes aleatórios: muitos pedaços pequenos ou poucos do tamanho do MSS
+static size_t random_cuts(size_t len, size_t *cuts, size_t max) {
+    size_t n = 0, pos = 0;
+    uint32_t scale = rnd() % 4 == 0 ? TCP_MSS : 1u + rnd() % 64;
+    while (n < max) {
+        pos += 1 + rnd() % scale;
+        if (pos >= len) break;
+        cuts[n++] = pos;
+    }
+    return n;
+}
+
+// Corpo do POST /configure como o app manda: quatro cargos, em uma linha
+static void build_configure(char *out, size_t size) {
+    char body[STREAM_MAX / 2];
+    size_t n = 0;
+    n += (size_t)snprintf(body + n, sizeof(body) - n, "{\"offices\":[");
+    for (int o = 0; o < 4; o++) {
+        n += (size_t)snprintf(body + n, sizeof(body) - n, "%s{\"name\":\"Cargo %d\",\"candidates\":[", o ? "," : "", o);
+        for (int i = 0; i < 60; i++) {
+            n += (size_t)snprintf(body + n, sizeof(body) - n, "%s{\"name\":\"Candidato %d\",\"number\":\"%d%03d\"}",
+                                  i ? "," : "", i, o + 1, i);
+        }
+        n += (size_t)snprintf(body + n, sizeof(body) - n, "]}");
+    }
+    n += (size_t)snprintf(body + n, sizeof(body) - n, "]}");
+    snprintf(out, size,
+             "POST /configure HTTP/1.1\r\n"
+             "Host: 192.168.4.1\r\n"
+             "Content-Type: application/json\r\n"
+             "Content-Length: %zu\r\n"
+             "User-Agent: okhttp/4.9.2\r\n"
+             "Accept-Encoding: gzip\r\n"
+             "Connection: Keep-Alive\r\n\r\n%s", n, body);
+}
+
+// O app consultando o /status em sequência, sem esperar as respostas
+static void build_pipeline(char *out, size_t size) {
+    size_t n = 0;
+    for (int i = 0; i < 8; i++) {
+        n += (size_t)snprintf(out + n, size - n,
+                              "GET /status HTTP/1.1\r\nHost: 192.168.4.1\r\nIf-None-Match: \"%d\"\r\n\r\n", i);
+    }
+}
+
+static void build_huge_head(char *out, size_t size) {
+    size_t n = (size_t)snprintf(out, size, "GET /status HTTP/1.1\r\n");
+    for (int i = 0; i < 60; i++) {
+        n += (size_t)snprintf(out + n, size - n, "X-Padding-%02d: %070d\r\n", i, i);
+    }
+    snprintf(out + n, size - n, "\r\n");
+}
+
+static const recorded_t recorded[] = {
+    {"GET /status (app)",
+     "GET /status HTTP/1.1\r\n"
+     "Accept: application/json, text/plain, */*\r\n"
+     "If-None-Match: \"4f2a91\"\r\n"
+     "Host: 192.168.4.1\r\n"
+     "Connection: Keep-Alive\r\n"
+     "Accept-Encoding: gzip\r\n"
+     "User-Agent: okhttp/4.9.2\r\n\r\n", NULL, 1, 0},
+    {"GET /status (CBOR)",
+     "GET /status HTTP/1.1\r\nHost: 192.168.4.1\r\nAccept: application/cbor\r\n\r\n", NULL, 1, 0},
+    {"GET /events (navegador)",
+     "GET /events HTTP/1.1\r\n"
+     "Host: 192.168.4.1\r\n"
+     "Accept: text/event-stream\r\n"
+     "Cache-Control: no-cache\r\n"
+     "Last-Event-ID: 41\r\n"
+     "User-Agent: Mozilla/5.0 (Linux; Android 13) AppleWebKit/537.36 Chrome/120.0 Mobile Safari/537.36\r\n"
+     "Accept-Language: pt-BR,pt;q=0.9\r\n\r\n", NULL, 1, 0},
+    {"Upgrade para /ws",
+     "GET /ws HTTP/1.1\r\n"
+     "Host: 192.168.4.1\r\n"
+     "Upgrade: websocket\r\n"
+     "Connection: Upgrade\r\n"
+     "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+     "Sec-WebSocket-Version: 13\r\n\r\n", NULL, 1, 0},
+    {"OPTIONS /configure (CORS)",
+     "OPTIONS /configure HTTP/1.1\r\n"
+     "Host: 192.168.4.1\r\n"
+     "Origin: http://localhost:8081\r\n"
+     "Access-Control-Request-Method: POST\r\n"
+     "Access-Control-Request-Headers: content-type\r\n\r\n", NULL, 1, 0},
+    {"HEAD /status HTTP/1.0", "HEAD /status HTTP/1.0\r\n\r\n", NULL, 1, 0},
+    {"GET /start?t=1 (curl, so LF)",
+     "GET /start?t=1 HTTP/1.1\nHost: 192.168.4.1\nUser-Agent: curl/8.5.0\nAccept: */*\n\n", NULL, 1, 0},
+    {"POST /configure (240 candidatos)", NULL, build_configure, 1, 0},
+    {"8 GET /status seguidos", NULL, build_pipeline, 8, 0},
+    {"Metodo desconhecido", "BREW /pot HTTP/1.1\r\n\r\n", NULL, 1, 0},
+    {"HTTP/2.0", "GET /status HTTP/2.0\r\n\r\n", NULL, 0, 505},
+    {"Corpo chunked",
+     "POST /configure HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n5\r\nhello\r\n0\r\n\r\n", NULL, 0, 501},
+    {"Caminho longo",
+     "GET /aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa HTTP/1.1\r\n\r\n", NULL, 0, 414},
+    {"Cabecalhos alem de HTTP_HEAD_MAX", NULL, build_huge_head, 0, 431},
+    {"Content-Length invalido", "POST /configure HTTP/1.1\r\nContent-Length: 12a\r\n\r\n", NULL, 0, 400},
+    {"Content-Length enorme", "POST /configure HTTP/1.1\r\nContent-Length: 9999999999\r\n\r\n", NULL, 0, 413},
+    {"Lixo binario", "\x16\x03\x01\x02\xfc\x03\x03", NULL, 0, 400},
+};
+
+#define RECORDED_COUNT (sizeof(recorded) / sizeof(recorded[0]))
+
+static char streams[RECORDED_COUNT][STREAM_MAX];
+static size_t stream_len[RECORDED_COUNT];
+
+static void load_recorded(void) {
+    for (size_t i = 0; i < RECORDED_COUNT; i++) {
+        if (recorded[i].text) {
+            snprintf(streams[i], STREAM_MAX, "%s", recorded[i].text);
+        } else {
+            recorded[i].build(streams[i], STREAM_MAX);
+        }
+        stream_len[i] = strlen(streams[i]);
+    }
+}
+
+// Resultado da requisição inteira e de todas as divisões em dois pedaços
+static bool run_recorded(size_t idx) {
+    const uint8_t *data = (const uint8_t *)streams[idx];
+    size_t len = stream_len[idx];
+    trace_t whole, t;
+    run(data, len, NULL, 0, &whole);
+    bool ok = !whole.broken && whole.requests == recorded[idx].requests && whole.error == recorded[idx].error;
+    if (!ok) {
+        printf("  %-34s FALHOU: %d requisicoes, erro %d (esperado %d, %d) %s\n", recorded[idx].name,
+               whole.requests, whole.error, recorded[idx].requests, recorded[idx].error, whole.why);
+        return false;
+    }
+
+    for (size_t cut = 1; cut < len; cut++) {
+        run(data, len, &cut, 1, &t);
+        if (!same(&whole, &t)) {
+            printf("  %-34s FALHOU dividida em %zu: %s\n", recorded[idx].name, cut, why(&whole, &t));
+            return false;
+        }
+    }
+
+    static size_t cuts[STREAM_MAX];
+    for (size_t i = 0; i + 1 < len; i++) cuts[i] = i + 1;
+    run(data, len, cuts, len - 1, &t);
+    if (!same(&whole, &t)) {
+        printf("  %-34s FALHOU byte a byte: %s\n", recorded[idx].name, why(&whole, &t));
+        return false;
+    }
+    printf("  %-34s ok (%zu bytes, %d req., erro %d)\n", recorded[idx].name, len, whole.requests, whole.error);
+    return true;
+}
+
+static bool run_random_splits(uint32_t iterations) {
+    static size_t cuts[STREAM_MAX];
+    trace_t whole, t;
+    for (uint32_t it = 0; it < iterations; it++) {
+        size_t idx = rnd() % RECORDED_COUNT;
+        const uint8_t *data = (const uint8_t *)streams[idx];
+        size_t len = stream_len[idx];
+        run(data, len, NULL, 0, &whole);
+        size_t n = random_cuts(len, cuts, STREAM_MAX);
+        run(data, len, cuts, n, &t);
+        if (!same(&whole, &t)) {
+            printf("  %s em %zu pedacos: FALHOU %s\n", recorded[idx].name, n + 1, why(&whole, &t));
+            return false;
+        }
+    }
+    return true;
+}
+
+// Troca, insere ou apaga alguns bytes de uma requisição gravada; às vezes
+// junta duas
+static size_t mutate(uint8_t *out, size_t size) {
+    size_t idx = rnd() % RECORDED_COUNT;
+    size_t len = stream_len[idx];
+    memcpy(out, streams[idx], len);
+    if (rnd() % 4 == 0) {
+        size_t other = rnd() % RECORDED_COUNT;
+        if (len + stream_len[other] <= size) {
+            memcpy(out + len, streams[other], stream_len[other]);
+            len += stream_len[other];
+        }
+    }
+    static const char interesting[] = "\r\n: /?\t\0\x7f\xff" "0123456789";
+    int edits = 1 + (int)(rnd() % 8);
+    for (int e = 0; e < edits && len > 0; e++) {
+        size_t pos = rnd() % len;
+        uint8_t byte = rnd() % 2 ? (uint8_t)interesting[rnd() % (sizeof(interesting) - 1)] : (uint8_t)rnd();
+        switch (rnd() % 3) {
+        case 0:
+            out[pos] = byte;
+            break;
+        case 1:
+            if (len < size) {
+                memmove(out + pos + 1, out + pos, len - pos);
+                out[pos] = byte;
+                len++;
+            }
+            break;
+        default:
+            memmove(out + pos, out + pos + 1, len - pos - 1);
+            len--;
+            break;
+        }
+    }
+    return len;
+}
+
+static bool run_mutations(uint32_t iterations, int *errors) {
+    static uint8_t data[2 * STREAM_MAX];
+    static size_t cuts[2 * STREAM_MAX];
+    trace_t whole, t;
+    for (uint32_t it = 0; it < iterations; it++) {
+        size_t len = mutate(data, sizeof(data));
+        run(data, len, NULL, 0, &whole);
+        size_t n = random_cuts(len, cuts, sizeof(cuts) / sizeof(cuts[0]));
+        run(data, len, cuts, n, &t);
+        if (!same(&whole, &t)) {
+            printf("  mutacao %u: FALHOU %s\n", it, why(&whole, &t));
+            fwrite(data, 1, len, stdout);
+            printf("\n");
+            return false;
+        }
+        if (whole.error) (*errors)++;
+    }
+    return true;
+}
+
+static double seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Só as requisições válidas, repetidas, em segmentos de TCP_MSS bytes
+static void run_throughput(void) {
+    static uint8_t data[STREAM_MAX * 4];
+    size_t len = 0;
+    int per_pass = 0;
+    for (size_t i = 0; i < RECORDED_COUNT; i++) {
+        if (recorded[i].error || len + stream_len[i] > sizeof(data)) continue;
+        memcpy(data + len, streams[i], stream_len[i]);
+        len += stream_len[i];
+        per_pass += recorded[i].requests;
+    }
+    static size_t cuts[sizeof(data) / TCP_MSS + 1];
+    size_t n = 0;
+    for (size_t pos = TCP_MSS; pos < len; pos += TCP_MSS) cuts[n++] = pos;
+
+    trace_t t;
+    uint32_t passes = THROUGHPUT_BYTES / (uint32_t)len + 1;
+    double start = seconds();
+    for (uint32_t i = 0; i < passes; i++) run(data, len, cuts, n, &t);
+    double elapsed = seconds() - start;
+    double bytes = (double)len * passes;
+    printf("Vazao: %.1f MB/s, %.0f requisicoes/s (%u passadas de %zu bytes em segmentos de %d)\n",
+           bytes / elapsed / 1e6, (double)per_pass * passes / elapsed, passes, len, TCP_MSS);
+}
+
+int main(int argc, char **argv) {
+    long iterations = argc > 1 ? strtol(argv[1], NULL, 10) : 200000;
+    if (iterations <= 0) {
+        fprintf(stderr, "Uso: %s [iteracoes]\n", argv[0]);
+        return 2;
+    }
+    load_recorded();
+    bool ok = true;
+
+    printf("Requisicoes gravadas, inteiras, em dois pedacos e byte a byte:\n");
+    for (size_t i = 0; i < RECORDED_COUNT; i++) ok &= run_recorded(i);
+
+    bool splits = run_random_splits((uint32_t)iterations);
+    printf("Pedacos aleatorios: %s\n", splits ? "ok" : "FALHOU");
+    ok &= splits;
+
+    int errors = 0;
+    bool mutations = run_mutations((uint32_t)iterations, &errors);
+    printf("Requisicoes alteradas: %s (%d de %ld recusadas)\n", mutations ? "ok" : "FALHOU", errors, iterations);
+    ok &= mutations;
+
+    run_throughput();
+    return ok ? 0 : 1;
+}
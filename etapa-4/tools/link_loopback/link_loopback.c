@@ -0,0 +1,308 @@
+/**
+ * @file link_loopback.c
+ *
+ * Teste do protocolo de enlace urna <-> auditor (common/urna_link) no
+ * computador, com as duas pontas ligadas por um fio emulado.
+ *
+ * Etapas:
+ *   - quadros de controle perdidos em padrões fixos (o RESET inicial, o
+ *     SYNC, os ACKs...), que precisam ser entregues mesmo assim;
+ *   - milhões de quadros por um fio que perde quadros, inverte bits e não
+ *     funciona a 3 Mbaud, com a negociação de taxa e reinicializações das
+ *     duas pontas no meio;
+ *   - casos de borda do COBS e o valor de conferência do CRC-32.
+ *
+ * Cada payload carrega o seu número de ordem e bytes derivados dele: o
+ * receptor confere que tudo chega em ordem, sem lacunas e intacto.
+ *
+ * Compilação (a partir desta pasta):
+ *
+ *     cc -O2 -o link_loopback link_loopback.c \
+ *        ../../common/urna_link/urna_link.c -I../../common/urna_link
+ *
+ * Uso: link_loopback [quadros]   (padrão: 2000000)
+ *
+ * Sai com 0 se todas as etapas passam, 1 caso contrário.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "urna_link.h"
+
+#define WIRE_QUEUE (64 * 1024)
+#define BROKEN_BAUD 3000000     // Taxa em que o fio emulado só entrega lixo
+#define DROP_RULES_MAX 4
+
+// Perde a n-ésima ocorrência (a partir de 0) de um tipo de quadro
+typedef struct {
+    uint8_t type;
+    uint32_t first, count;      // Ocorrências [first, first + count)
+} drop_rule_t;
+
+// Uma ponta: o que chega para ela e o que ela já entregou
+typedef struct {
+    urna_link_t link;
+    urna_link_io_t io;
+    uint32_t baud;
+    uint8_t queue[WIRE_QUEUE];
+    size_t queued;
+    uint64_t next_expected;     // Número de ordem do próximo payload
+    bool failed;
+    // Fio de saída desta ponta
+    uint32_t loss_ppm, corrupt_ppm;
+    drop_rule_t drops[DROP_RULES_MAX];
+    uint32_t seen[256];         // Quadros enviados de cada tipo
+} end_t;
+
+static end_t a, b;              // a: urna (transmite), b: auditor
+static uint32_t clock_ms;
+
+static uint32_t rng_state = 12345;
+static uint32_t rnd(void) {
+    rng_state = rng_state * 1103515245u + 12345u;
+    return (rng_state >> 8) & 0xFFFFFF;
+}
+
+static end_t *peer_of(end_t *e) {
+    return e == &a ? &b : &a;
+}
+
+// Tipo do quadro codificado (com os delimitadores), ou -1 se não decodifica
+static int frame_type(const uint8_t *data, size_t len) {
+    uint8_t raw[URNA_LINK_MAX_FRAME];
+    if (len < 2) return -1;
+    size_t n = urna_link_cobs_decode(data + 1, len - 2, raw, sizeof(raw));
+    return n ? raw[0] : -1;
+}
+
+static bool dropped_by_rule(end_t *e, const uint8_t *data, size_t len) {
+    int type = frame_type(data, len);
+    if (type < 0) return false;
+    uint32_t n = e->seen[type]++;
+    for (int i = 0; i < DROP_RULES_MAX; i++) {
+        const drop_rule_t *r = &e->drops[i];
+        if (r->count && r->type == type && n >= r->first && n < r->first + r->count) return true;
+    }
+    return false;
+}
+
+static void wire_write(void *ctx, const uint8_t *data, size_t len) {
+    end_t *e = ctx, *o = peer_of(e);
+    if (dropped_by_rule(e, data, len)) return;
+    if (rnd() % 1000000 < e->loss_ppm) return;
+    for (size_t i = 0; i < len; i++) {
+        uint8_t byte = data[i];
+        if (e->baud != o->baud || e->baud == BROKEN_BAUD) {
+            byte = (uint8_t)rnd(); // Taxas diferentes: o outro lado vê lixo
+        } else if (rnd() % 1000000 < e->corrupt_ppm) {
+            byte ^= (uint8_t)(1u << (rnd() % 8));
+        }
+        if (o->queued < sizeof(o->queue)) o->queue[o->queued++] = byte;
+    }
+}
+
+static void wire_set_baud(void *ctx, uint32_t baud) {
+    ((end_t *)ctx)->baud = baud;
+}
+
+static uint32_t wire_now_ms(void *ctx) {
+    (void)ctx;
+    return clock_ms;
+}
+
+static void wire_deliver(void *ctx, const uint8_t *payload, size_t len) {
+    end_t *e = ctx;
+    uint64_t order;
+    if (len < sizeof(order)) {
+        e->failed = true;
+        return;
+    }
+    memcpy(&order, payload, sizeof(order));
+    if (order != e->next_expected && !e->failed) {
+        printf("  fora de ordem: chegou %llu, esperado %llu\n",
+               (unsigned long long)order, (unsigned long long)e->next_expected);
+        e->failed = true;
+    }
+    for (size_t i = sizeof(order); i < len; i++) {
+        if (payload[i] != (uint8_t)(order + i)) e->failed = true;
+    }
+    e->next_expected = order + 1;
+}
+
+static void end_init(end_t *e, uint32_t session) {
+    e->baud = URNA_LINK_BASE_BAUD;
+    e->queued = 0;
+    e->io = (urna_link_io_t){wire_write, wire_set_baud, wire_now_ms, wire_deliver, e};
+    urna_link_init(&e->link, &e->io, session);
+}
+
+static void reset_wires(void) {
+    memset(&a, 0, sizeof(a));
+    memset(&b, 0, sizeof(b));
+    clock_ms = 0;
+}
+
+// Entrega o que está no fio e roda os temporizadores das duas pontas
+static void step(void) {
+    static uint8_t tmp[WIRE_QUEUE];
+    end_t *ends[] = {&a, &b};
+    for (int i = 0; i < 2; i++) {
+        end_t *e = ends[i];
+        size_t n = e->queued;
+        memcpy(tmp, e->queue, n);
+        e->queued = 0;
+        urna_link_rx_bytes(&e->link, tmp, n);
+    }
+    urna_link_poll(&a.link);
+    urna_link_poll(&b.link);
+}
+
+static uint64_t next_to_send;
+
+static bool send_next(void) {
+    uint8_t payload[URNA_LINK_MAX_PAYLOAD];
+    size_t len = sizeof(next_to_send) + rnd() % (sizeof(payload) - sizeof(next_to_send) + 1);
+    memcpy(payload, &next_to_send, sizeof(next_to_send));
+    for (size_t i = sizeof(next_to_send); i < len; i++) payload[i] = (uint8_t)(next_to_send + i);
+    if (!urna_link_send(&a.link, payload, len)) return false;
+    next_to_send++;
+    return true;
+}
+
+typedef struct {
+    const char *name;
+    drop_rule_t a_drops[DROP_RULES_MAX]; // Quadros da urna perdidos
+    drop_rule_t b_drops[DROP_RULES_MAX]; // Quadros do auditor perdidos
+} drop_pattern_t;
+
+static const drop_pattern_t patterns[] = {
+    {"RESET inicial perdido", {{URNA_LINK_RESET, 0, 1}}, {{0}}},
+    {"RESET e a primeira retransmissao perdidos", {{URNA_LINK_RESET, 0, 2}}, {{0}}},
+    {"RESET e SYNC perdidos", {{URNA_LINK_RESET, 0, 1}, {URNA_LINK_SYNC, 0, 1}}, {{0}}},
+    {"RESET e SYNC_REQ perdidos", {{URNA_LINK_RESET, 0, 1}}, {{URNA_LINK_SYNC_REQ, 0, 1}}},
+    {"RESET perdido e ACKs perdidos", {{URNA_LINK_RESET, 0, 1}}, {{URNA_LINK_ACK, 0, 3}}},
+    {"Primeiro DATA perdido", {{URNA_LINK_DATA, 0, 1}}, {{0}}},
+    {"Janela inteira perdida duas vezes", {{URNA_LINK_DATA, 0, 2 * URNA_LINK_WINDOW}}, {{0}}},
+};
+
+#define PATTERN_FRAMES 40
+#define PATTERN_TIMEOUT_MS 20000
+
+static bool run_pattern(const drop_pattern_t *p) {
+    reset_wires();
+    memcpy(a.drops, p->a_drops, sizeof(a.drops));
+    memcpy(b.drops, p->b_drops, sizeof(b.drops));
+    end_init(&b, 222);
+    end_init(&a, 111);
+    next_to_send = 0;
+
+    while (b.next_expected < PATTERN_FRAMES && clock_ms < PATTERN_TIMEOUT_MS && !b.failed) {
+        while (next_to_send < PATTERN_FRAMES && send_next()) {}
+        step();
+        clock_ms++;
+    }
+    bool ok = !b.failed && b.next_expected == PATTERN_FRAMES;
+    printf("  %-44s %s (%llu/%d em %u ms)\n", p->name, ok ? "ok" : "FALHOU",
+           (unsigned long long)b.next_expected, PATTERN_FRAMES, clock_ms);
+    return ok;
+}
+
+static const uint32_t rates[] = {3000000, 2000000, 1000000};
+
+static bool run_stress(uint64_t total) {
+    reset_wires();
+    a.loss_ppm = b.loss_ppm = 10000;        // 1% dos quadros
+    a.corrupt_ppm = b.corrupt_ppm = 300;    // Um bit a cada ~3300 bytes
+    end_init(&b, 222);
+    end_init(&a, 111);
+    urna_link_negotiate_baud(&a.link, rates, sizeof(rates) / sizeof(rates[0]));
+    next_to_send = 0;
+
+    int phase = 0;
+    uint64_t progress = 0;
+    uint32_t progress_ms = 0;
+    while (b.next_expected < total && !b.failed) {
+        for (int k = 0; k < 4 && next_to_send < total && send_next(); k++) {}
+        step();
+        if (rnd() % 4 == 0) clock_ms++;
+        // Nenhum quadro entregue por um minuto simulado: enlace travado
+        if (b.next_expected != progress) {
+            progress = b.next_expected;
+            progress_ms = clock_ms;
+        } else if (clock_ms - progress_ms > 60000) {
+            printf("  enlace travado em %llu quadros\n", (unsigned long long)progress);
+            break;
+        }
+
+        if (phase == 0 && b.next_expected > total / 3) {
+            phase = 1;
+            printf("  auditor reinicia depois de %llu quadros\n", (unsigned long long)b.next_expected);
+            uint64_t expected = b.next_expected;
+            end_init(&b, 333);
+            b.next_expected = expected;
+        } else if (phase == 1 && b.next_expected > 2 * total / 3) {
+            phase = 2;
+            printf("  urna reinicia depois de %llu quadros\n", (unsigned long long)b.next_expected);
+            end_init(&a, 444);
+            next_to_send = b.next_expected; // A janela em voo se perde com a urna
+            urna_link_negotiate_baud(&a.link, rates, sizeof(rates) / sizeof(rates[0]));
+        }
+    }
+
+    const urna_link_stats_t *sa = &a.link.stats, *sb = &b.link.stats;
+    printf("  entregues %llu de %llu em %u ms simulados, taxa final %u/%u\n",
+           (unsigned long long)b.next_expected, (unsigned long long)total, clock_ms, a.baud, b.baud);
+    printf("  urna: %u quadros, %u retransmitidos, %u com CRC invalido, %u voltas a taxa base\n",
+           sa->tx_frames, sa->tx_retransmits, sa->rx_crc_errors, sa->baud_fallbacks);
+    printf("  auditor: %u quadros, %u com CRC invalido, %u repetidos, %u fora de ordem\n",
+           sb->rx_frames, sb->rx_crc_errors, sb->rx_duplicates, sb->rx_out_of_order);
+    return !b.failed && b.next_expected == total && a.baud != BROKEN_BAUD;
+}
+
+static bool run_cobs_crc(void) {
+    static uint8_t src[600], enc[700], dec[700];
+    for (size_t len = 0; len < sizeof(src); len++) {
+        for (int pattern = 0; pattern < 3; pattern++) {
+            for (size_t i = 0; i < len; i++) {
+                src[i] = pattern == 0 ? 0 : pattern == 1 ? (uint8_t)(i % 255 + 1) : (uint8_t)rnd();
+            }
+            size_t n = urna_link_cobs_encode(src, len, enc);
+            if (n > len + len / 254 + 1 || memchr(enc, 0, n)) return false;
+            size_t m = urna_link_cobs_decode(enc, n, dec, sizeof(dec));
+            if (m != len || memcmp(src, dec, len) != 0) return false;
+        }
+    }
+    static const uint8_t check[] = "123456789";
+    uint32_t crc = urna_link_crc32(check, 9);
+    uint32_t parts = urna_link_crc32_update(urna_link_crc32(check, 4), check + 4, 5);
+    return crc == 0xCBF43926u && parts == crc;
+}
+
+int main(int argc, char **argv) {
+    uint64_t total = argc > 1 ? strtoull(argv[1], NULL, 10) : 2000000;
+    if (total == 0) {
+        fprintf(stderr, "Uso: %s [quadros]\n", argv[0]);
+        return 2;
+    }
+    bool ok = true;
+
+    printf("Perdas fixas de quadros:\n");
+    for (size_t i = 0; i < sizeof(patterns) / sizeof(patterns[0]); i++) {
+        ok &= run_pattern(&patterns[i]);
+    }
+
+    printf("Fio com perdas, bits trocados e 3 Mbaud inutil:\n");
+    bool stress = run_stress(total);
+    printf("  %s\n", stress ? "ok" : "FALHOU");
+    ok &= stress;
+
+    bool cobs = run_cobs_crc();
+    printf("COBS e CRC-32: %s\n", cobs ? "ok" : "FALHOU");
+    ok &= cobs;
+
+    return ok ? 0 : 1;
+}
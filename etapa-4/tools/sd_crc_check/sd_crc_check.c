@@ -0,0 +1,127 @@
+/**
+ * @file sd_crc_check.c
+ *
+ * Teste no computador do CRC16 de quatro em quatro bytes (crc16_slice4)
+ * que o driver do cartão SD da urna de auditoria usa nos blocos escritos e
+ * nos lidos sem o sniffer da DMA.
+ *
+ * Compara crc16_slice4 com o crc16 original, byte a byte, em:
+ *
+ *   - valores conhecidos do CRC16 do SD (CCITT/XMODEM): "123456789" dá
+ *     0x31C3 e um bloco de 512 bytes 0xFF dá 0x7FA1;
+ *   - todos os tamanhos de 0 a 2048 bytes, com dados aleatórios e
+ *     começando em cada um dos quatro alinhamentos;
+ *   - buffers de 1 a 8 blocos de 512 bytes, como nas leituras e escritas
+ *     de vários blocos;
+ *   - update_crc16 acumulado em pedaços, que tem de dar o mesmo valor.
+ *
+ * No fim mede as duas versões em blocos de 512 bytes (no computador a
+ * proporção não é a do RP2040, mas mostra se a tabela está sendo usada).
+ *
+ * Compilação (a partir desta pasta):
+ *
+ *     cc -O2 -o sd_crc_check sd_crc_check.c \
+ *        ../../urna_auditoria/lib/no-OS-FatFS-SD-SPI-RPi-Pico/FatFs_SPI/sd_driver/crc.c \
+ *        -I../../urna_auditoria/lib/no-OS-FatFS-SD-SPI-RPi-Pico/FatFs_SPI/sd_driver
+ *
+ * Uso: sd_crc_check [semente]
+ *
+ * Sai com 0 se todos os valores conferem, 1 caso contrário.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "crc.h"
+
+#define BLOCK_SIZE 512
+#define MAX_BLOCKS 8
+#define MAX_LEN 2048
+#define BENCH_BLOCKS 200000
+
+static uint8_t buf[MAX_BLOCKS * BLOCK_SIZE + 4];
+static unsigned failures;
+
+static void check(const char *what, size_t len, uint16_t got, uint16_t expected) {
+    if (got == expected) return;
+    if (failures++ < 10) {
+        printf("FALHA: %s, %zu bytes: %04x, esperado %04x\n", what, len, got, expected);
+    }
+}
+
+static void fill_random(uint8_t *p, size_t len) {
+    for (size_t i = 0; i < len; i++) p[i] = (uint8_t)rand();
+}
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv) {
+    unsigned seed = argc > 1 ? (unsigned)strtoul(argv[1], NULL, 10) : 1;
+    srand(seed);
+
+    // Valores de referência
+    const char *digits = "123456789";
+    check("\"123456789\" crc16", 9, crc16(digits, 9), 0x31C3);
+    check("\"123456789\" slice4", 9, crc16_slice4(digits, 9), 0x31C3);
+    memset(buf, 0xFF, BLOCK_SIZE);
+    check("bloco 0xFF crc16", BLOCK_SIZE, crc16((const char *)buf, BLOCK_SIZE), 0x7FA1);
+    check("bloco 0xFF slice4", BLOCK_SIZE, crc16_slice4(buf, BLOCK_SIZE), 0x7FA1);
+
+    // Todos os tamanhos, nos quatro alinhamentos
+    unsigned compared = 0;
+    for (size_t offset = 0; offset < 4; offset++) {
+        for (size_t len = 0; len <= MAX_LEN; len++) {
+            uint8_t *p = buf + offset;
+            fill_random(p, len);
+            check("slice4 x crc16", len, crc16_slice4(p, len), crc16((const char *)p, (int)len));
+            compared++;
+        }
+    }
+
+    // Vários blocos de uma vez, e o mesmo CRC acumulado em pedaços
+    for (unsigned round = 0; round < 1000; round++) {
+        size_t len = (size_t)(1 + rand() % MAX_BLOCKS) * BLOCK_SIZE;
+        fill_random(buf, len);
+        uint16_t expected = crc16((const char *)buf, (int)len);
+        check("blocos slice4 x crc16", len, crc16_slice4(buf, len), expected);
+
+        unsigned short acc = 0;
+        for (size_t pos = 0; pos < len;) {
+            size_t piece = (size_t)(1 + rand() % 700);
+            if (piece > len - pos) piece = len - pos;
+            update_crc16(&acc, (const char *)buf + pos, piece);
+            pos += piece;
+        }
+        check("update_crc16 em pedacos", len, acc, expected);
+        compared += 2;
+    }
+    printf("%u comparacoes, %u falhas\n", compared, failures);
+
+    // Vazão em blocos de 512 bytes
+    fill_random(buf, BLOCK_SIZE);
+    uint16_t sum_bytes = 0, sum_slice = 0;
+    double t0 = now_s();
+    for (unsigned i = 0; i < BENCH_BLOCKS; i++) {
+        buf[0] = (uint8_t)i;
+        sum_bytes += crc16((const char *)buf, BLOCK_SIZE);
+    }
+    double t1 = now_s();
+    for (unsigned i = 0; i < BENCH_BLOCKS; i++) {
+        buf[0] = (uint8_t)i;
+        sum_slice += crc16_slice4(buf, BLOCK_SIZE);
+    }
+    double t2 = now_s();
+    check("soma da medicao", BLOCK_SIZE, sum_slice, sum_bytes);
+    double mb = (double)BENCH_BLOCKS * BLOCK_SIZE / 1e6;
+    printf("crc16: %.0f MB/s, crc16_slice4: %.0f MB/s (%.1fx)\n",
+           mb / (t1 - t0), mb / (t2 - t1), (t1 - t0) / (t2 - t1));
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,245 @@
+/**
+ * @file status_check.c
+ *
+ * Teste no computador do documento de status da urna (GET /status), com o
+ * status.c e o ballot.c do firmware sem mudanças.
+ *
+ * Confere, em JSON e em CBOR:
+ *
+ *   - qual caminho cada cédula toma: o documento em cache (status_body),
+ *     igual ao inteiro, enquanto cabe em HTTP_RESPONSE_MAX, e NULL (envio em
+ *     partes) a partir daí; mostra até quantos candidatos cabem;
+ *   - o envio em partes (status_stream) contra o documento inteiro
+ *     (status_encode), em cédulas de 0 a 512 candidatos e com trechos de 1
+ *     a 2040 bytes, inclusive nomes que viram \u00XX e contadores no máximo;
+ *   - votos no meio do envio: o de um candidato já enviado não aparece, o de
+ *     um que ainda não foi aparece, e o documento continua igual ao de uma
+ *     apuração só com o segundo voto;
+ *   - que uma cédula nova no meio do envio, ou um trecho fora de ordem,
+ *     interrompe o envio, e que os contextos são liberados no fim.
+ *
+ * No fim compara o tempo para gerar o documento de 512 candidatos em
+ * trechos do tamanho de um segmento TCP: com o cursor e recodificando o
+ * documento desde o começo a cada trecho, como antes.
+ *
+ * Compilação (a partir desta pasta):
+ *
+ *     cc -O2 -o status_check status_check.c \
+ *        ../../urna_eletronica/status/status.c \
+ *        ../../urna_eletronica/ballot/ballot.c \
+ *        ../../urna_eletronica/candidate_index/candidate_index.c \
+ *        -I../../urna_eletronica
+ *
+ * Uso: status_check
+ *
+ * Sai com 0 se tudo confere, 1 caso contrário.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "status/status.h"
+
+#define DOC_MAX (256 * 1024)
+#define SEGMENT 1452
+
+static ballot_t ballot, expected_ballot;
+static uint8_t doc[DOC_MAX], streamed[DOC_MAX];
+static unsigned failures;
+static const char *format_names[STATUS_FORMATS] = {"JSON", "CBOR"};
+
+static void fail(const char *what, status_format_t format, unsigned candidates) {
+    if (failures++ < 10) printf("FALHA: %s (%s, %u candidatos)\n", what, format_names[format], candidates);
+}
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Cédula com 'candidates' candidatos em 'offices' cargos, com votos
+static void make_ballot(ballot_t *b, unsigned offices, unsigned candidates, bool odd_names) {
+    ballot_clear(b);
+    for (unsigned o = 0; o < offices; o++) {
+        char name[BALLOT_NAME_MAX];
+        snprintf(name, sizeof(name), odd_names ? "\"C\\%u\x01" : "Cargo %u", o);
+        ballot_add_office(b, name);
+        unsigned count = candidates / offices + (o < candidates % offices);
+        for (unsigned i = 0; i < count; i++) {
+            char number[CANDIDATE_INDEX_DIGITS + 1];
+            snprintf(number, sizeof(number), "%0*u", 3 + o % 3, 100 + i);
+            if (odd_names) {
+                memset(name, '\x1f', BALLOT_NAME_MAX - 1);
+                name[BALLOT_NAME_MAX - 1] = '\0';
+            } else {
+                snprintf(name, sizeof(name), "Cand. %03u", i % 1000);
+            }
+            ballot_add_candidate(b, number, name);
+        }
+    }
+    for (uint16_t i = 0; i < ballot_tally_len(b); i++) b->tally[i] = odd_names ? UINT32_MAX : i * 37u % 1000;
+}
+
+// Documento inteiro pelo status_stream, em trechos de 'chunk' bytes;
+// 'between' roda depois do primeiro trecho
+static size_t stream_all(status_format_t format, size_t chunk, void (*between)(void), bool *error) {
+    void *ctx = status_stream_open(&ballot, 2, format);
+    *error = ctx == NULL;
+    size_t len = 0;
+    while (ctx) {
+        size_t max = chunk < DOC_MAX - len ? chunk : DOC_MAX - len;
+        size_t n = status_stream(ctx, len, streamed + len, max);
+        if (n == HTTP_STREAM_ERROR || n > max) {
+            *error = true;
+            break;
+        }
+        if (n == 0) break;
+        len += n;
+        if (between && len == n) between();
+    }
+    if (ctx) status_stream(ctx, len, NULL, 0);
+    return len;
+}
+
+// Dois cargos: o primeiro, pequeno, sai inteiro no primeiro trecho (no
+// nível de cima e na lista de cargos); o último candidato do segundo, não
+static void make_uneven_ballot(ballot_t *b) {
+    ballot_clear(b);
+    ballot_add_office(b, "Prefeito");
+    ballot_add_candidate(b, "10", "Candidato A");
+    ballot_add_candidate(b, "20", "Candidato B");
+    ballot_add_office(b, "Vereador");
+    for (unsigned i = 0; i < 100; i++) {
+        char number[CANDIDATE_INDEX_DIGITS + 1];
+        snprintf(number, sizeof(number), "%03u", 100 + i);
+        ballot_add_candidate(b, number, "Candidato");
+    }
+    for (uint16_t i = 0; i < ballot_tally_len(b); i++) b->tally[i] = i;
+}
+
+static uint16_t last_candidate_slot(const ballot_t *b) {
+    const ballot_office_t *office = &b->offices[b->num_offices - 1];
+    return (uint16_t)(office->tally + office->count - 1);
+}
+
+static void vote_first_and_last(void) {
+    ballot.tally[0] += 1000;
+    ballot.tally[last_candidate_slot(&ballot)] += 100000;
+}
+
+static void reconfigure(void) {
+    ballot_clear(&ballot);
+}
+
+static void check_ballot(unsigned offices, unsigned candidates, bool odd_names) {
+    static const size_t chunks[] = {1, 7, 100, SEGMENT, 2040};
+    make_ballot(&ballot, offices, candidates, odd_names);
+    for (int f = 0; f < STATUS_FORMATS; f++) {
+        size_t len = status_encode(&ballot, 2, (status_format_t)f, doc, 0, DOC_MAX);
+        for (size_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++) {
+            bool error;
+            size_t got = stream_all((status_format_t)f, chunks[c], NULL, &error);
+            if (error || got != len || memcmp(streamed, doc, len) != 0) fail("envio em partes difere", f, candidates);
+        }
+    }
+}
+
+int main(void) {
+    unsigned checked = 0;
+    check_ballot(1, 0, false);
+    ballot_clear(&ballot);
+    for (int f = 0; f < STATUS_FORMATS; f++) {
+        bool error;
+        size_t len = status_encode(&ballot, 2, (status_format_t)f, doc, 0, DOC_MAX);
+        if (stream_all((status_format_t)f, 5, NULL, &error) != len || error || memcmp(streamed, doc, len) != 0) {
+            fail("cedula vazia", f, 0);
+        }
+    }
+    for (unsigned candidates = 1; candidates <= BALLOT_CANDIDATES_MAX; candidates = candidates * 3 + 1) {
+        check_ballot(1 + candidates % BALLOT_OFFICES_MAX, candidates, false);
+        checked++;
+    }
+    check_ballot(BALLOT_OFFICES_MAX, BALLOT_CANDIDATES_MAX, false);
+    check_ballot(BALLOT_OFFICES_MAX, BALLOT_CANDIDATES_MAX, true);
+    printf("%u cedulas conferidas em partes, nos dois formatos\n", checked + 3);
+
+    // Caminho de cada cédula: cache enquanto cabe, envio em partes depois
+    uint32_t version = 1;
+    for (int f = 0; f < STATUS_FORMATS; f++) {
+        unsigned cached_max = 0;
+        bool streamed_before = false;
+        for (unsigned candidates = 1; candidates <= BALLOT_CANDIDATES_MAX; candidates++) {
+            make_ballot(&ballot, 1, candidates, false);
+            size_t len = status_encode(&ballot, 2, (status_format_t)f, doc, 0, DOC_MAX);
+            http_shared_body_t *body = status_body(&ballot, 2, (status_format_t)f, ++version);
+            if (body != status_body(&ballot, 2, (status_format_t)f, version)) fail("mesma versao, outro documento", f, candidates);
+            if (len <= HTTP_RESPONSE_MAX) {
+                if (!body || body->len != len || memcmp(body->data, doc, len) != 0) fail("documento pequeno fora do cache", f, candidates);
+                if (streamed_before) fail("cache depois de um documento maior", f, candidates);
+                cached_max = candidates;
+            } else {
+                if (body) fail("documento grande no cache", f, candidates);
+                streamed_before = true;
+            }
+        }
+        printf("%s: ate %u candidatos (nomes de 9 letras) no cache, acima disso em partes\n", format_names[f],
+               cached_max);
+        // Uma cédula pequena de novo volta ao cache
+        make_ballot(&ballot, 1, 3, false);
+        if (!status_body(&ballot, 2, (status_format_t)f, ++version)) fail("cedula pequena nao voltou ao cache", f, 3);
+    }
+
+    // Votos no meio: o primeiro candidato já foi, o último do último cargo não
+    for (int f = 0; f < STATUS_FORMATS; f++) {
+        make_uneven_ballot(&ballot);
+        expected_ballot = ballot;
+        expected_ballot.tally[last_candidate_slot(&expected_ballot)] += 100000;
+        size_t len = status_encode(&expected_ballot, 2, (status_format_t)f, doc, 0, DOC_MAX);
+        bool error;
+        size_t got = stream_all((status_format_t)f, SEGMENT, vote_first_and_last, &error);
+        if (error || got != len || memcmp(streamed, doc, len) != 0) fail("votos no meio do envio", f, 102);
+
+        make_ballot(&ballot, BALLOT_OFFICES_MAX, BALLOT_CANDIDATES_MAX, false);
+        stream_all((status_format_t)f, SEGMENT, reconfigure, &error);
+        if (!error) fail("cedula nova no meio nao interrompeu", f, 512);
+    }
+
+    // Trecho fora de ordem e contextos esgotados
+    make_ballot(&ballot, 2, 10, false);
+    void *ctx[STATUS_STREAMS];
+    for (int i = 0; i < STATUS_STREAMS; i++) {
+        ctx[i] = status_stream_open(&ballot, 1, STATUS_JSON);
+        if (!ctx[i]) fail("contexto livre nao encontrado", STATUS_JSON, 10);
+    }
+    if (status_stream_open(&ballot, 1, STATUS_JSON)) fail("mais contextos que STATUS_STREAMS", STATUS_JSON, 10);
+    if (ctx[0] && status_stream(ctx[0], 0, streamed, 10) != 10) fail("primeiro trecho", STATUS_JSON, 10);
+    if (ctx[0] && status_stream(ctx[0], 0, streamed, 10) != HTTP_STREAM_ERROR) fail("trecho repetido aceito", STATUS_JSON, 10);
+    for (int i = 0; i < STATUS_STREAMS; i++) {
+        if (ctx[i]) status_stream(ctx[i], 0, NULL, 0);
+    }
+    ctx[0] = status_stream_open(&ballot, 1, STATUS_JSON);
+    if (!ctx[0]) fail("contexto nao liberado", STATUS_JSON, 10);
+    else status_stream(ctx[0], 0, NULL, 0);
+
+    // Tempo: cursor x documento refeito desde o começo a cada trecho
+    make_ballot(&ballot, BALLOT_OFFICES_MAX, BALLOT_CANDIDATES_MAX, false);
+    size_t len = status_encode(&ballot, 2, STATUS_JSON, doc, 0, DOC_MAX);
+    double t0 = now_s();
+    bool error;
+    for (int r = 0; r < 20; r++) stream_all(STATUS_JSON, SEGMENT, NULL, &error);
+    double t1 = now_s();
+    for (int r = 0; r < 20; r++) {
+        for (size_t pos = 0; pos < len; pos += SEGMENT) status_encode(&ballot, 2, STATUS_JSON, streamed, pos, SEGMENT);
+    }
+    double t2 = now_s();
+    printf("documento de %zu bytes em trechos de %d: cursor %.2f ms, refazendo do comeco %.2f ms\n", len, SEGMENT,
+           (t1 - t0) * 1000 / 20, (t2 - t1) * 1000 / 20);
+
+    printf("%u falhas\n", failures);
+    return failures ? 1 : 0;
+}
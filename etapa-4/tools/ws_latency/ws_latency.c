@@ -0,0 +1,344 @@
+/**
+ * @file ws_latency.c
+ *
+ * Cliente de teste do WebSocket /ws da urna: mede o tempo de ida e volta
+ * dos comandos do mesário por uma conexão só, como o app faz.
+ *
+ * Abre a conexão, confere o Sec-WebSocket-Accept (com o mesmo código do
+ * firmware) e manda os comandos um de cada vez, [comando, id], esperando a
+ * resposta [comando | 0x80, id, resultado]. As mensagens de estado que a
+ * urna empurra no meio (WS_PUSH_FULL/WS_PUSH_DELTA) são contadas e
+ * ignoradas. Com -H, mede também o mesmo comando pelo HTTP, com uma conexão
+ * nova a cada pedido, para comparar.
+ *
+ * O comando padrão é WS_CMD_STATUS, que não muda nada na urna. Com
+ * "-c enable" cada comando libera um eleitor (a urna recusa enquanto houver
+ * um votando, mas a resposta chega do mesmo jeito).
+ *
+ * Compilação (a partir desta pasta):
+ *
+ *     cc -O2 -o ws_latency ws_latency.c \
+ *        ../../urna_eletronica/http_server/websocket.c \
+ *        -I../../urna_eletronica/http_server
+ *
+ * Uso: ws_latency [-n comandos] [-c status|enable] [-p porta] [-H] [endereço]
+ *      (padrão: 1000 comandos status em 192.168.4.1:80)
+ *
+ * Sai com 0 se todos os comandos tiveram resposta, 1 caso contrário.
+ */
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "websocket.h"
+
+// Protocolo do /ws (urna_eletronica.c)
+#define WS_CMD_ENABLE 0x02
+#define WS_CMD_STATUS 0x04
+#define WS_REPLY 0x80
+#define WS_PUSH_FULL 0x40
+#define WS_PUSH_DELTA 0x41
+
+#define TIMEOUT_MS 2000
+#define RX_MAX 8192
+
+typedef struct {
+    const char *name;
+    uint8_t ws_cmd;
+    const char *http_path;
+} command_t;
+
+static const command_t commands[] = {
+    {"status", WS_CMD_STATUS, "/status"},
+    {"enable", WS_CMD_ENABLE, "/enable"},
+};
+
+typedef struct {
+    int fd;
+    uint8_t rx[RX_MAX];
+    size_t rx_len;
+    uint32_t pushes;            // Mensagens de estado recebidas
+} ws_conn_t;
+
+static double now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int tcp_connect(const char *host, const char *port) {
+    struct addrinfo hints = {0}, *res;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, port, &hints, &res) != 0) return -1;
+    int fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (fd >= 0 && connect(fd, res->ai_addr, res->ai_addrlen) != 0) {
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+    if (fd < 0) return -1;
+
+    // Comandos pequenos saem na hora, sem esperar o ACK do anterior
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    struct timeval tv = {TIMEOUT_MS / 1000, (TIMEOUT_MS % 1000) * 1000};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    return fd;
+}
+
+static bool send_all(int fd, const void *data, size_t len) {
+    const uint8_t *p = data;
+    while (len > 0) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        p += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+static bool fill(ws_conn_t *c) {
+    if (c->rx_len == sizeof(c->rx)) return false;
+    ssize_t n = recv(c->fd, c->rx + c->rx_len, sizeof(c->rx) - c->rx_len, 0);
+    if (n <= 0) return false;
+    c->rx_len += (size_t)n;
+    return true;
+}
+
+static void consume(ws_conn_t *c, size_t n) {
+    memmove(c->rx, c->rx + n, c->rx_len - n);
+    c->rx_len -= n;
+}
+
+// Quadro do cliente: sempre mascarado (RFC 6455, 5.3)
+static bool ws_send(ws_conn_t *c, uint8_t opcode, const uint8_t *data, size_t len) {
+    uint8_t frame[4 + 4 + WS_CONTROL_MAX];
+    if (len > WS_CONTROL_MAX) return false;
+    size_t n = 0;
+    frame[n++] = 0x80 | opcode;
+    frame[n++] = 0x80 | (uint8_t)len;
+    uint32_t mask = (uint32_t)rand();
+    memcpy(frame + n, &mask, 4);
+    n += 4;
+    for (size_t i = 0; i < len; i++) frame[n + i] = data[i] ^ frame[2 + i % 4];
+    return send_all(c->fd, frame, n + len);
+}
+
+/**
+ * Lê o próximo quadro do servidor (sem máscara). Pings são respondidos
+ * aqui mesmo.
+ * @return Tamanho do payload, copiado em 'out', ou -1 em erro/fechamento.
+ */
+static int ws_recv(ws_conn_t *c, uint8_t *opcode, uint8_t *out, size_t max) {
+    for (;;) {
+        if (c->rx_len >= 2) {
+            size_t hdr = 2;
+            uint64_t len = c->rx[1] & 0x7F;
+            if (len == 126) hdr = 4;
+            if (len == 127) hdr = 10;
+            if (c->rx_len >= hdr) {
+                if (hdr == 4) len = (uint64_t)c->rx[2] << 8 | c->rx[3];
+                if (hdr == 10) {
+                    len = 0;
+                    for (int i = 0; i < 8; i++) len = len << 8 | c->rx[2 + i];
+                }
+                if (c->rx[1] & 0x80 || len > sizeof(c->rx) - hdr) return -1;
+                if (c->rx_len >= hdr + len) {
+                    uint8_t op = c->rx[0] & 0x0F;
+                    size_t n = len < max ? (size_t)len : max;
+                    memcpy(out, c->rx + hdr, n);
+                    consume(c, hdr + (size_t)len);
+                    if (op == WS_OP_CLOSE) return -1;
+                    if (op == WS_OP_PING) {
+                        if (!ws_send(c, WS_OP_PONG, out, n)) return -1;
+                        continue;
+                    }
+                    *opcode = op;
+                    return (int)n;
+                }
+            }
+        }
+        if (!fill(c)) return -1;
+    }
+}
+
+static bool ws_open(ws_conn_t *c, const char *host, const char *port) {
+    c->fd = tcp_connect(host, port);
+    c->rx_len = 0;
+    c->pushes = 0;
+    if (c->fd < 0) return false;
+
+    static const char key[] = "dGhlIHNhbXBsZSBub25jZQ==";
+    char req[256];
+    int n = snprintf(req, sizeof(req),
+                     "GET /ws HTTP/1.1\r\nHost: %s\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                     "Sec-WebSocket-Key: %s\r\nSec-WebSocket-Version: 13\r\n\r\n", host, key);
+    if (!send_all(c->fd, req, (size_t)n)) return false;
+
+    // Resposta do upgrade até a linha vazia; o que vier depois já é quadro
+    char *end;
+    while (c->rx[c->rx_len] = '\0', (end = strstr((char *)c->rx, "\r\n\r\n")) == NULL) {
+        if (c->rx_len + 1 >= sizeof(c->rx) || !fill(c)) return false;
+    }
+    char accept[WS_ACCEPT_LEN + 1];
+    ws_accept_key(key, accept);
+    bool ok = strncmp((char *)c->rx, "HTTP/1.1 101", 12) == 0 && strstr((char *)c->rx, accept) != NULL;
+    if (!ok) fprintf(stderr, "Upgrade recusado:\n%.*s\n", (int)(end - (char *)c->rx), (char *)c->rx);
+    consume(c, (size_t)(end + 4 - (char *)c->rx));
+    return ok;
+}
+
+// Um comando e a sua resposta; -1 se a resposta não chegou
+static double ws_round_trip(ws_conn_t *c, uint8_t cmd, uint8_t id, uint8_t *result) {
+    uint8_t msg[2] = {cmd, id};
+    double start = now_us();
+    if (!ws_send(c, WS_OP_BINARY, msg, sizeof(msg))) return -1;
+    for (;;) {
+        uint8_t op, reply[RX_MAX];
+        int n = ws_recv(c, &op, reply, sizeof(reply));
+        if (n < 0) return -1;
+        if (op != WS_OP_BINARY || n < 1) continue;
+        if (reply[0] == WS_PUSH_FULL || reply[0] == WS_PUSH_DELTA) {
+            c->pushes++;
+            continue;
+        }
+        if (n >= 3 && reply[0] == (cmd | WS_REPLY) && reply[1] == id) {
+            *result = reply[2];
+            return now_us() - start;
+        }
+    }
+}
+
+// O mesmo comando pelo HTTP: conexão nova, pedido, resposta até o fim
+static double http_round_trip(const char *host, const char *port, const char *path) {
+    double start = now_us();
+    int fd = tcp_connect(host, port);
+    if (fd < 0) return -1;
+    char req[256], buf[4096];
+    int n = snprintf(req, sizeof(req), "GET %s HTTP/1.1\r\nHost: %s\r\nConnection: close\r\n\r\n", path, host);
+    bool ok = send_all(fd, req, (size_t)n);
+    ssize_t got;
+    size_t total = 0;
+    while (ok && (got = recv(fd, buf, sizeof(buf), 0)) > 0) total += (size_t)got;
+    close(fd);
+    return ok && total > 0 ? now_us() - start : -1;
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void report(const char *label, double *samples, int count, int lost) {
+    if (count == 0) {
+        printf("%s: nenhuma resposta (%d perdidas)\n", label, lost);
+        return;
+    }
+    qsort(samples, (size_t)count, sizeof(samples[0]), compare_double);
+    double sum = 0;
+    for (int i = 0; i < count; i++) sum += samples[i];
+    printf("%s: %d respostas, %d perdidas\n", label, count, lost);
+    printf("  min %.2f ms  mediana %.2f ms  p90 %.2f ms  p99 %.2f ms  max %.2f ms  media %.2f ms\n",
+           samples[0] / 1e3, samples[count / 2] / 1e3, samples[count * 9 / 10] / 1e3,
+           samples[count * 99 / 100] / 1e3, samples[count - 1] / 1e3, sum / count / 1e3);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Uso: %s [-n comandos] [-c status|enable] [-p porta] [-H] [endereco]\n", prog);
+}
+
+int main(int argc, char **argv) {
+    int count = 1000;
+    const command_t *cmd = &commands[0];
+    const char *port = "80";
+    const char *host = "192.168.4.1";
+    bool http = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:c:p:H")) != -1) {
+        switch (opt) {
+        case 'n': count = atoi(optarg); break;
+        case 'p': port = optarg; break;
+        case 'H': http = true; break;
+        case 'c':
+            cmd = NULL;
+            for (size_t i = 0; i < sizeof(commands) / sizeof(commands[0]); i++) {
+                if (strcmp(optarg, commands[i].name) == 0) cmd = &commands[i];
+            }
+            if (!cmd) {
+                usage(argv[0]);
+                return 2;
+            }
+            break;
+        default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (optind < argc) host = argv[optind];
+    if (count <= 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    double *samples = malloc(sizeof(double) * (size_t)count);
+    if (!samples) return 2;
+    srand((unsigned)time(NULL));
+
+    static ws_conn_t ws;
+    double open_start = now_us();
+    if (!ws_open(&ws, host, port)) {
+        fprintf(stderr, "Sem conexao WebSocket com %s:%s\n", host, port);
+        return 1;
+    }
+    printf("WebSocket aberto em %.2f ms; %d comandos %s\n", (now_us() - open_start) / 1e3, count, cmd->name);
+
+    int done = 0, lost = 0, rejected = 0;
+    for (int i = 0; i < count; i++) {
+        uint8_t result = 0;
+        double rtt = ws_round_trip(&ws, cmd->ws_cmd, (uint8_t)i, &result);
+        if (rtt < 0) {
+            // Conexão perdida: reabre e segue, contando a perda
+            lost++;
+            close(ws.fd);
+            if (!ws_open(&ws, host, port)) break;
+            continue;
+        }
+        if (result != 0) rejected++;
+        samples[done++] = rtt;
+    }
+    close(ws.fd);
+    report("WebSocket", samples, done, lost);
+    if (rejected) printf("  %d recusados pela urna (resposta recebida)\n", rejected);
+    printf("  %u mensagens de estado recebidas no meio\n", ws.pushes);
+    bool ok = lost == 0 && done == count;
+
+    if (http) {
+        int http_done = 0, http_lost = 0;
+        for (int i = 0; i < count; i++) {
+            double rtt = http_round_trip(host, port, cmd->http_path);
+            if (rtt < 0) {
+                http_lost++;
+            } else {
+                samples[http_done++] = rtt;
+            }
+        }
+        char label[64];
+        snprintf(label, sizeof(label), "HTTP GET %s (conexao nova)", cmd->http_path);
+        report(label, samples, http_done, http_lost);
+        ok &= http_lost == 0;
+    }
+    free(samples);
+    return ok ? 0 : 1;
+}
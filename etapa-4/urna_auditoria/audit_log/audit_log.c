@@ -0,0 +1,267 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/time.h"
+
+#include "audit_log.h"
+
+// Registros lidos por vez na retomada (um setor)
+#define READ_CHUNK (SD_LOGGER_SECTOR_SIZE / AUDIT_RECORD_SIZE)
+
+// CHECKPOINT + OFFICE de todos os cargos + TALLY de todos os candidatos
+#define CHECKPOINT_MAX_RECORDS \
+    (1 + AUDIT_MAX_OFFICES + (AUDIT_MAX_CANDIDATES + AUDIT_TALLY_PER_RECORD - 1) / AUDIT_TALLY_PER_RECORD)
+
+// Releitura do checkpoint na retomada; fora da pilha por causa do tamanho
+static audit_record_t checkpoint_buf[CHECKPOINT_MAX_RECORDS];
+
+// ARG_NUMBER é uma quantidade; ARG_OFFICE é o cargo, e ARG_CANDIDATE é o
+// cargo e o número ("cargo;número"), com a quantidade de dígitos
+// (audit_number_parse)
+typedef enum { ARG_NONE, ARG_CHAR, ARG_NUMBER, ARG_OFFICE, ARG_CANDIDATE } arg_kind_t;
+
+// Eventos de texto enviados pela urna e o registro correspondente
+static const struct {
+    const char *name;
+    audit_type_t type;
+    arg_kind_t arg;
+} events[] = {
+    {"TECLA", AUDIT_KEY, ARG_CHAR},
+    {"VOTO", AUDIT_VOTE, ARG_CANDIDATE},
+    {"NULO", AUDIT_NULL, ARG_CANDIDATE},
+    {"BRANCO", AUDIT_BLANK, ARG_OFFICE},
+    {"INICIO", AUDIT_START, ARG_NONE},
+    {"LIBERADA", AUDIT_ENABLE, ARG_NONE},
+    {"ENCERRADA", AUDIT_END, ARG_NONE},
+    {"CONFIG", AUDIT_CONFIG, ARG_NUMBER},
+};
+
+static bool read_records(audit_log_t *log, uint32_t first, audit_record_t *dst, uint32_t count) {
+    return sd_logger_read(log->logger, (FSIZE_t)first * AUDIT_RECORD_SIZE, dst, count * AUDIT_RECORD_SIZE);
+}
+
+// Posição do último CHECKPOINT, procurando do fim para o início
+static bool find_last_checkpoint(audit_log_t *log, uint32_t count, uint32_t *found) {
+    audit_record_t chunk[READ_CHUNK];
+    uint32_t end = count;
+
+    while (end > 0) {
+        uint32_t first = (end - 1) / READ_CHUNK * READ_CHUNK; // Alinhado ao setor
+        if (!read_records(log, first, chunk, end - first)) return false;
+        for (uint32_t i = end; i > first; i--) {
+            if (chunk[i - 1 - first].type == AUDIT_CHECKPOINT) {
+                *found = i - 1;
+                return true;
+            }
+        }
+        end = first;
+    }
+    *found = UINT32_MAX; // Nenhum checkpoint: a apuração começa do zero
+    return true;
+}
+
+// Relê o fim do arquivo: último hash, próxima posição e apuração
+static bool audit_log_recover(audit_log_t *log) {
+    sd_logger_t *logger = log->logger;
+    if (!logger->open && !sd_logger_sync(logger)) return false;
+
+    FSIZE_t size = sd_logger_size(logger);
+    if (size % AUDIT_RECORD_SIZE) {
+        printf("AVISO: Registro incompleto no fim do log, descartado\n");
+        size -= size % AUDIT_RECORD_SIZE;
+        if (!sd_logger_truncate(logger, size)) return false;
+    }
+    uint32_t count = (uint32_t)(size / AUDIT_RECORD_SIZE);
+
+    memset(log->prev, 0, sizeof(log->prev));
+    log->seq = 0;
+    log->boot = 0;
+    log->since_checkpoint = 0;
+    audit_tally_reset(&log->tally);
+
+    if (count > 0) {
+        uint32_t checkpoint;
+        if (!find_last_checkpoint(log, count, &checkpoint)) return false;
+
+        uint32_t start = 0;   // Primeiro registro a conferir
+        uint32_t replay = 0;  // Primeiro registro a aplicar na apuração
+        if (checkpoint != UINT32_MAX) {
+            audit_record_t *cp = checkpoint_buf;
+            uint32_t n = count - checkpoint;
+            if (n > CHECKPOINT_MAX_RECORDS) n = CHECKPOINT_MAX_RECORDS;
+            if (!read_records(log, checkpoint, cp, n)) return false;
+            if (audit_checkpoint_decode(cp, n, &log->tally)) {
+                start = checkpoint;
+                replay = checkpoint + 1 + (uint32_t)audit_checkpoint_tally_records(&cp[0]);
+            } else {
+                printf("AVISO: Checkpoint invalido no registro %lu\n", (unsigned long)checkpoint);
+                audit_tally_reset(&log->tally);
+            }
+        }
+
+        // Confere os elos a partir do checkpoint e reaplica os votos seguintes
+        audit_record_t chunk[READ_CHUNK];
+        if (start > 0) {
+            if (!read_records(log, start - 1, chunk, 1)) return false;
+            memcpy(log->prev, chunk[0].hash, sizeof(log->prev));
+        }
+        uint32_t broken = 0;
+        for (uint32_t first = start; first < count; first += READ_CHUNK) {
+            uint32_t n = count - first < READ_CHUNK ? count - first : READ_CHUNK;
+            if (!read_records(log, first, chunk, n)) return false;
+            for (uint32_t i = 0; i < n; i++) {
+                if (!audit_record_check(&chunk[i], log->prev)) broken++;
+                memcpy(log->prev, chunk[i].hash, sizeof(log->prev));
+                if (first + i >= replay) audit_tally_apply(&log->tally, &chunk[i]);
+                log->boot = chunk[i].boot;
+            }
+        }
+        if (broken) {
+            printf("AVISO: %lu elo(s) da cadeia invalido(s) no fim do log\n", (unsigned long)broken);
+        }
+        log->seq = count;
+        log->boot++;
+        log->since_checkpoint = checkpoint != UINT32_MAX ? count - checkpoint : count;
+    }
+
+    log->recovered = true;
+    printf("Log de auditoria: %lu registros, inicializacao %u\n", (unsigned long)count, log->boot);
+    return true;
+}
+
+static bool append(audit_log_t *log, audit_record_t *rec) {
+    rec->seq = log->seq;
+    rec->time_ms = to_ms_since_boot(get_absolute_time());
+    rec->boot = log->boot;
+    audit_record_seal(rec, log->prev);
+
+    if (!sd_logger_append(log->logger, rec, sizeof(*rec))) {
+        // O registro pode ter ficado no buffer ou ter sido perdido: a
+        // cadeia é retomada do arquivo antes do próximo registro
+        log->recovered = false;
+        return false;
+    }
+    memcpy(log->prev, rec->hash, sizeof(log->prev));
+    log->seq++;
+    log->since_checkpoint++;
+    audit_tally_apply(&log->tally, rec);
+    return true;
+}
+
+// Retoma a cadeia se preciso; o primeiro registro de cada boot é um BOOT
+static bool ensure_ready(audit_log_t *log) {
+    if (!log->recovered && !audit_log_recover(log)) return false;
+    if (!log->boot_logged) {
+        audit_record_t rec;
+        memset(&rec, 0, sizeof(rec));
+        rec.type = AUDIT_BOOT;
+        if (!append(log, &rec)) return false;
+        log->boot_logged = true;
+    }
+    return true;
+}
+
+static bool append_event(audit_log_t *log, audit_type_t type, const void *data, size_t len) {
+    if (!ensure_ready(log)) return false;
+
+    audit_record_t rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.type = (uint8_t)type;
+    rec.len = (uint8_t)len;
+    if (len) memcpy(rec.data, data, len);
+    if (!append(log, &rec)) return false;
+
+    if (type == AUDIT_END || log->since_checkpoint >= audit_checkpoint_interval(&log->tally)) {
+        return audit_log_checkpoint(log);
+    }
+    return true;
+}
+
+bool audit_log_open(audit_log_t *log, sd_logger_t *logger) {
+    memset(log, 0, sizeof(*log));
+    log->logger = logger;
+    return ensure_ready(log);
+}
+
+bool audit_log_checkpoint(audit_log_t *log) {
+    if (!ensure_ready(log)) return false;
+
+    // Registro a registro, para não montar o checkpoint inteiro na pilha;
+    // CHECKPOINT e TALLY não alteram a apuração no meio do caminho
+    size_t n = audit_checkpoint_records(&log->tally);
+    for (size_t i = 0; i < n; i++) {
+        audit_record_t rec;
+        audit_checkpoint_encode(&log->tally, i, &rec);
+        if (!append(log, &rec)) return false;
+    }
+    log->since_checkpoint = 0;
+    return true;
+}
+
+static bool parse_number(const uint8_t *s, size_t len, uint32_t *out) {
+    if (len == 0 || len > 9) return false;
+    uint32_t v = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (s[i] < '0' || s[i] > '9') return false;
+        v = v * 10 + (s[i] - '0');
+    }
+    *out = v;
+    return true;
+}
+
+static bool parse_office(const uint8_t *s, size_t len, uint8_t *out) {
+    uint32_t office;
+    if (!parse_number(s, len, &office) || office >= AUDIT_MAX_OFFICES) return false;
+    *out = (uint8_t)office;
+    return true;
+}
+
+// "cargo;número": o número com a quantidade de dígitos e o cargo depois dele
+static bool parse_candidate(const uint8_t *s, size_t len, uint8_t out[5]) {
+    const uint8_t *sep = memchr(s, ';', len);
+    if (!sep || !parse_office(s, (size_t)(sep - s), &out[4])) return false;
+    uint32_t number = audit_number_parse(sep + 1, len - (size_t)(sep + 1 - s));
+    if (number == 0) return false;
+    memcpy(out, &number, sizeof(number));
+    return true;
+}
+
+bool audit_log_event(audit_log_t *log, const uint8_t *text, size_t len) {
+    for (size_t e = 0; e < sizeof(events) / sizeof(events[0]); e++) {
+        size_t name_len = strlen(events[e].name);
+        if (len < name_len || memcmp(text, events[e].name, name_len) != 0) continue;
+
+        const uint8_t *arg = text + name_len;
+        size_t arg_len = len - name_len;
+        if (events[e].arg == ARG_NONE && arg_len == 0) {
+            return append_event(log, events[e].type, NULL, 0);
+        }
+        if (arg_len < 2 || arg[0] != ';') continue;
+        arg++;
+        arg_len--;
+
+        uint32_t number;
+        uint8_t data[5];
+        if (events[e].arg == ARG_CHAR && arg_len == 1) {
+            return append_event(log, events[e].type, arg, 1);
+        }
+        if (events[e].arg == ARG_NUMBER && parse_number(arg, arg_len, &number)) {
+            return append_event(log, events[e].type, &number, sizeof(number));
+        }
+        if (events[e].arg == ARG_OFFICE && parse_office(arg, arg_len, &data[0])) {
+            return append_event(log, events[e].type, data, 1);
+        }
+        if (events[e].arg == ARG_CANDIDATE && parse_candidate(arg, arg_len, data)) {
+            return append_event(log, events[e].type, data, sizeof(data));
+        }
+    }
+
+    // Evento desconhecido: texto em pedaços de AUDIT_DATA_SIZE bytes
+    do {
+        size_t chunk = len < AUDIT_DATA_SIZE ? len : AUDIT_DATA_SIZE;
+        if (!append_event(log, AUDIT_TEXT, text, chunk)) return false;
+        text += chunk;
+        len -= chunk;
+    } while (len > 0);
+    return true;
+}
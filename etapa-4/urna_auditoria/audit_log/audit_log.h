@@ -0,0 +1,56 @@
+/**
+ * @file audit_log.h
+ *
+ * Log de auditoria encadeado por hash, gravado pelo sd_logger.
+ *
+ * Cada evento recebido da urna vira um registro binário de 64 bytes
+ * (audit_record.h) cujo hash inclui o hash do registro anterior. O auditor
+ * mantém a sua própria apuração a partir dos eventos de voto e grava
+ * checkpoints periódicos com ela.
+ *
+ * Ao abrir, o fim do arquivo existente é relido para continuar a cadeia e
+ * a apuração: basta ler a partir do último checkpoint, não o arquivo todo.
+ */
+
+#ifndef AUDIT_LOG_H
+#define AUDIT_LOG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "audit_record.h"
+#include "sd_logger.h"
+
+typedef struct {
+    sd_logger_t *logger;
+    bool recovered;          // Cadeia e apuração sincronizadas com o arquivo
+    bool boot_logged;        // BOOT desta inicialização já gravado
+    uint8_t prev[SHA256_DIGEST_SIZE]; // Hash do último registro gravado
+    uint32_t seq;            // Posição do próximo registro
+    uint16_t boot;           // Inicialização corrente do auditor
+    uint32_t since_checkpoint;
+    audit_tally_t tally;     // Apuração do auditor
+} audit_log_t;
+
+/**
+ * @brief Retoma a cadeia do arquivo aberto em 'logger' e grava um BOOT.
+ *
+ * Se o cartão não estiver disponível, a retomada é refeita no próximo
+ * evento, antes de gravar qualquer registro.
+ */
+bool audit_log_open(audit_log_t *log, sd_logger_t *logger);
+
+/**
+ * @brief Converte um evento de texto da urna (ex.: "VOTO;0;12", voto no 12
+ * do primeiro cargo) em registro.
+ * Eventos desconhecidos são guardados como texto.
+ */
+bool audit_log_event(audit_log_t *log, const uint8_t *text, size_t len);
+
+/**
+ * @brief Grava um checkpoint com a apuração corrente.
+ */
+bool audit_log_checkpoint(audit_log_t *log);
+
+#endif // AUDIT_LOG_H
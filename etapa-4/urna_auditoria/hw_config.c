@@ -62,6 +62,9 @@ static spi_t spis[] = {  // One for each SPI.
         .mosi_gpio = 19,
         .sck_gpio = 18,
 
+        // Starting rate: after initialization, the driver steps SCK up
+        // (up to SD_SPEED_MAX_BAUD_RATE) while CRC-checked reads keep working.
+        // See sd_get_speed().
         // .baud_rate = 1000 * 1000
         .baud_rate = 12500 * 1000
         // .baud_rate = 25 * 1000 * 1000 // Actual frequency: 20833333.
@@ -32,10 +32,13 @@ specific language governing permissions and limitations under the License.
 #define SD_CRC_H
 
 #include <stddef.h>
+#include <stdint.h>
     
 char crc7(const char* data, int length);
 unsigned short crc16(const char* data, int length);
 void update_crc16(unsigned short *pCrc16, const char data[], size_t length);
+// Same result as crc16(), four bytes per step (slice-by-4 tables)
+uint16_t crc16_slice4(const void *data, size_t length);
 
 #endif
 
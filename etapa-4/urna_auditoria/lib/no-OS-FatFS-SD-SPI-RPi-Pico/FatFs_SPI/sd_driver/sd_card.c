@@ -163,6 +163,7 @@ specific language governing permissions and limitations under the License.
 #include <inttypes.h>
 #include <string.h>
 //
+#include "hardware/clocks.h"
 #include "pico/mutex.h"
 //
 #include "hw_config.h"  // Hardware Configuration of the SPI and SD Card "objects"
@@ -184,6 +185,17 @@ specific language governing permissions and limitations under the License.
 static bool crc_on = true;
 #endif
 
+// Step SCK up from the configured spi_t baud_rate after initialization, as
+// long as CRC-checked reads keep working (needs SD_CRC_ENABLED)
+#ifndef SD_SPEED_PROBE
+#define SD_SPEED_PROBE 1
+#endif
+// Highest SCK rate the probe tries. 25 MHz is the limit of the SD default
+// speed mode, which is what SPI mode uses.
+#ifndef SD_SPEED_MAX_BAUD_RATE
+#define SD_SPEED_MAX_BAUD_RATE (25 * 1000 * 1000)
+#endif
+
 #define TRACE_PRINTF(fmt, args...)
 // #define TRACE_PRINTF printf
 
@@ -450,6 +462,13 @@ static const char *cmd2str(const cmdSupported cmd) {
 #define SD_COMMAND_RETRIES 3 /*!< Times SPI cmd is retried when there is no response */
 #define SD_COMMAND_TIMEOUT 2000 /*!< Timeout in ms for response */
 
+static bool read_ahead = true;
+
+void sd_set_read_ahead(bool enable) { read_ahead = enable; }
+bool sd_get_read_ahead(void) { return read_ahead; }
+
+static int sd_read_stream_stop(sd_card_t *pSD);
+
 static int sd_cmd(sd_card_t *pSD, const cmdSupported cmd, uint32_t arg,
                   bool isAcmd, uint32_t *resp) {
     TRACE_PRINTF("%s(%s(0x%08lx)): ", __FUNCTION__, cmd2str(cmd), arg);
@@ -457,6 +476,11 @@ static int sd_cmd(sd_card_t *pSD, const cmdSupported cmd, uint32_t arg,
     int32_t status = SD_BLOCK_DEVICE_ERROR_NONE;
     uint32_t response;
 
+    // Any other command ends an open read stream first
+    if (pSD->read_stream && CMD12_STOP_TRANSMISSION != cmd) {
+        sd_read_stream_stop(pSD);
+    }
+
     // No need to wait for card to be ready when sending the stop command
     if (CMD12_STOP_TRANSMISSION != cmd) {
         if (false == sd_wait_ready(pSD, SD_COMMAND_TIMEOUT)) {
@@ -628,6 +652,7 @@ bool sd_card_detect(sd_card_t *pSD) {
         // The socket is now empty
         pSD->m_Status |= (STA_NODISK | STA_NOINIT);
         pSD->card_type = SDCARD_NONE;
+        pSD->read_stream = false;
         printf("No SD card detected!\r\n");
         return false;
     }
@@ -797,7 +822,7 @@ static int sd_read_bytes(sd_card_t *pSD, uint8_t *buffer, uint32_t length) {
     if (crc_on) {
         uint32_t crc_result;
         // Compute and verify checksum
-        crc_result = crc16((void *)buffer, length);
+        crc_result = crc16_slice4(buffer, length);
         if ((uint16_t)crc_result != crc) {
             DBG_PRINTF("_read_bytes: Invalid CRC received 0x%" PRIx16
                        " result of computation 0x%" PRIx16 "\r\n",
@@ -809,43 +834,62 @@ static int sd_read_bytes(sd_card_t *pSD, uint8_t *buffer, uint32_t length) {
 
     return 0;
 }
-static int sd_read_block(sd_card_t *pSD, uint8_t *buffer, uint32_t length) {
-    uint16_t crc;
-
-    // read until start byte (0xFE)
-    if (false == sd_wait_token(pSD, SPI_START_BLOCK)) {
-        DBG_PRINTF("%s:%d Read timeout\r\n", __FILE__, __LINE__);
-        return SD_BLOCK_DEVICE_ERROR_NO_RESPONSE;
-    }
-    // read data
-    // bool spi_transfer(const uint8_t *tx, uint8_t *rx, size_t length)
-    if (!sd_spi_transfer(pSD, NULL, buffer, length)) {
-        return SD_BLOCK_DEVICE_ERROR_NO_RESPONSE;
+static uint16_t sd_block_crc(const uint8_t *buffer, uint32_t length) {
+#if SD_CRC_ENABLED
+    if (crc_on) {
+        return crc16_slice4(buffer, length);
     }
-    // Read the CRC16 checksum for the data block
-    crc = (sd_spi_write(pSD, SPI_FILL_CHAR) << 8);
-    crc |= sd_spi_write(pSD, SPI_FILL_CHAR);
+#endif
+    return (uint16_t)(~0);
+}
 
+// Check a received block against the CRC16 that followed it. sniffed is the
+// CRC16 computed by the DMA while receiving the block, or -1.
+static int sd_check_block(const uint8_t *buffer, uint32_t length,
+                          const uint8_t crc_bytes[2], int32_t sniffed) {
 #if SD_CRC_ENABLED
     if (crc_on) {
-        uint32_t crc_result;
-        // Compute and verify checksum
-        crc_result = crc16((void *)buffer, length);
-        if ((uint16_t)crc_result != crc) {
+        uint16_t crc = (crc_bytes[0] << 8) | crc_bytes[1];
+        uint16_t crc_result =
+            sniffed >= 0 ? sniffed : sd_block_crc(buffer, length);
+        if (crc_result != crc) {
             DBG_PRINTF("%s: Invalid CRC received 0x%" PRIx16
                        " result of computation 0x%" PRIx16 "\r\n",
-                       __FUNCTION__, crc, (uint16_t)crc_result);
+                       __FUNCTION__, crc, crc_result);
             return SD_BLOCK_DEVICE_ERROR_CRC;
         }
     }
 #endif
+    return SD_BLOCK_DEVICE_ERROR_NONE;
+}
 
+// Wait for the start token and queue the transfers of the block and of its
+// CRC16. They are left running: the caller must sd_spi_transfer_wait.
+static int sd_read_block_start(sd_card_t *pSD, uint8_t *buffer,
+                               uint32_t length, uint8_t crc_bytes[2],
+                               int32_t *sniffed) {
+    // read until start byte (0xFE)
+    if (false == sd_wait_token(pSD, SPI_START_BLOCK)) {
+        DBG_PRINTF("%s:%d Read timeout\r\n", __FILE__, __LINE__);
+        return SD_BLOCK_DEVICE_ERROR_NO_RESPONSE;
+    }
+    // read data and the CRC16 checksum for the data block
+    if (!sd_spi_transfer_start_crc16(pSD, buffer, length, sniffed) ||
+        !sd_spi_transfer_start(pSD, NULL, crc_bytes, 2)) {
+        return SD_BLOCK_DEVICE_ERROR_NO_RESPONSE;
+    }
     return SD_BLOCK_DEVICE_ERROR_NONE;
 }
 
+static int sd_read_stream_stop(sd_card_t *pSD) {
+    pSD->read_stream = false;
+    return sd_cmd(pSD, CMD12_STOP_TRANSMISSION, 0x0, false, 0);
+}
+
 static int in_sd_read_blocks(sd_card_t *pSD, uint8_t *buffer,
                              uint64_t ulSectorNumber, uint32_t ulSectorCount) {
     uint32_t blockCnt = ulSectorCount;
+    uint8_t *const first_block = buffer;
 
     if (ulSectorNumber + blockCnt > pSD->sectors)
         return SD_BLOCK_DEVICE_ERROR_PARAMETER;
@@ -854,35 +898,72 @@ static int in_sd_read_blocks(sd_card_t *pSD, uint8_t *buffer,
 
     int status = SD_BLOCK_DEVICE_ERROR_NONE;
 
-    uint64_t addr;
-    // SDSC Card (CCS=0) uses byte unit address
-    // SDHC and SDXC Cards (CCS=1) use block unit address (512 Bytes unit)
-    if (SDCARD_V2HC == pSD->card_type) {
-        addr = ulSectorNumber;
-    } else {
-        addr = ulSectorNumber * _block_size;
-    }
-    // Write command ro receive data
-    if (blockCnt > 1) {
-        status = sd_cmd(pSD, CMD18_READ_MULTIPLE_BLOCK, addr, false, 0);
-    } else {
-        status = sd_cmd(pSD, CMD17_READ_SINGLE_BLOCK, addr, false, 0);
-    }
-    if (SD_BLOCK_DEVICE_ERROR_NONE != status) {
-        return status;
+    // A read that continues the open CMD18 stream needs no command at all.
+    // A sequential read that doesn't opens one and leaves it open, unless it
+    // reaches the end of the card.
+    bool resume = pSD->read_stream && ulSectorNumber == pSD->read_next;
+    bool stream = read_ahead && ulSectorNumber == pSD->read_next &&
+                  ulSectorNumber + blockCnt < pSD->sectors;
+    bool multi = resume || stream || blockCnt > 1;
+
+    if (!resume) {
+        uint64_t addr;
+        // SDSC Card (CCS=0) uses byte unit address
+        // SDHC and SDXC Cards (CCS=1) use block unit address (512 Bytes unit)
+        if (SDCARD_V2HC == pSD->card_type) {
+            addr = ulSectorNumber;
+        } else {
+            addr = ulSectorNumber * _block_size;
+        }
+        // Write command ro receive data (closes a stream left elsewhere)
+        if (multi) {
+            status = sd_cmd(pSD, CMD18_READ_MULTIPLE_BLOCK, addr, false, 0);
+        } else {
+            status = sd_cmd(pSD, CMD17_READ_SINGLE_BLOCK, addr, false, 0);
+        }
+        if (SD_BLOCK_DEVICE_ERROR_NONE != status) {
+            return status;
+        }
     }
-    // receive the data : one block at a time
+    // receive the data : one block at a time. The CRC of each block is
+    // checked while the next one is on the wire.
     int rd_status = 0;
+    uint8_t crc_bytes[2][2];
+    int32_t sniffed[2];
+    const uint8_t *unchecked = NULL;  // Received, CRC not checked yet
+    unsigned cur = 0;
     while (blockCnt) {
-        if (0 != sd_read_block(pSD, buffer, _block_size)) {
+        rd_status = sd_read_block_start(pSD, buffer, _block_size, crc_bytes[cur],
+                                        &sniffed[cur]);
+        if (!rd_status && unchecked)
+            rd_status = sd_check_block(unchecked, _block_size, crc_bytes[cur ^ 1],
+                                       sniffed[cur ^ 1]);
+        if (!sd_spi_transfer_wait(pSD) && !rd_status)
             rd_status = SD_BLOCK_DEVICE_ERROR_NO_RESPONSE;
-            break;
-        }
+        if (rd_status) break;
+        unchecked = buffer;
+        cur ^= 1;
         buffer += _block_size;
         --blockCnt;
     }
-    // Send CMD12(0x00000000) to stop the transmission for multi-block transfer
-    if (ulSectorCount > 1) {
+    if (!rd_status && unchecked)
+        rd_status = sd_check_block(unchecked, _block_size, crc_bytes[cur ^ 1],
+                                   sniffed[cur ^ 1]);
+    pSD->read_stream = false;
+    if (resume && rd_status) {
+        // The stream may have been disturbed while it was idle: start over
+        // with a fresh command
+        DBG_PRINTF("%s: read stream failed, restarting\r\n", __FUNCTION__);
+        sd_cmd(pSD, CMD12_STOP_TRANSMISSION, 0x0, false, 0);
+        pSD->read_next = UINT64_MAX;
+        return in_sd_read_blocks(pSD, first_block, ulSectorNumber, ulSectorCount);
+    }
+    pSD->read_next = ulSectorNumber + ulSectorCount;
+    if (stream && !rd_status) {
+        // Left open: the next sequential read continues from here
+        pSD->read_stream = true;
+    } else if (multi) {
+        // Send CMD12(0x00000000) to stop the transmission for multi-block transfer
         status = sd_cmd(pSD, CMD12_STOP_TRANSMISSION, 0x0, false, 0);
     }
     return rd_status ? rd_status : status;
@@ -898,31 +979,26 @@ int sd_read_blocks(sd_card_t *pSD, uint8_t *buffer, uint64_t ulSectorNumber,
     return status;
 }
 
+// The CRC16 of the block is computed while its data is on the wire
 static uint8_t sd_write_block(sd_card_t *pSD, const uint8_t *buffer,
                               uint8_t token, uint32_t length) {
-    uint16_t crc = (~0);
+    uint8_t crc_bytes[2];
     uint8_t response = 0xFF;
 
-    // indicate start of block
-    sd_spi_write(pSD, token);
-
-    // write the data
-    bool ret = sd_spi_transfer(pSD, buffer, NULL, length);
-    myASSERT(ret);
-
-#if SD_CRC_ENABLED
-    if (crc_on) {
-        // Compute CRC
-        crc = crc16((void *)buffer, length);
-    }
-#endif
+    // indicate start of block, then write the data
+    bool ret = sd_spi_transfer_start(pSD, &token, NULL, 1) &&
+               sd_spi_transfer_start(pSD, buffer, NULL, length);
 
-    // write the checksum CRC16
-    sd_spi_write(pSD, crc >> 8);
-    sd_spi_write(pSD, crc);
+    uint16_t crc = sd_block_crc(buffer, length);
+    crc_bytes[0] = crc >> 8;
+    crc_bytes[1] = crc;
 
-    // check the response token
-    response = sd_spi_write(pSD, SPI_FILL_CHAR);
+    // write the checksum CRC16 and check the response token
+    ret = ret && sd_spi_transfer_start(pSD, crc_bytes, NULL, 2) &&
+          sd_spi_transfer_start(pSD, NULL, &response, 1);
+    ret = sd_spi_transfer_wait(pSD) && ret;
+    myASSERT(ret);
+    if (!ret) return 0;
 
     // Wait for last block to be written
     if (false == sd_wait_ready(pSD, SD_COMMAND_TIMEOUT)) {
@@ -1176,6 +1252,83 @@ bool sd_init_driver() {
     mutex_exit(&sd_init_driver_mutex);
     return true;
 }
+#if SD_SPEED_PROBE && SD_CRC_ENABLED
+// Each rate is checked by reading SD_PROBE_SECTORS sectors at a few places on
+// the card, SD_PROBE_ROUNDS times. Besides the CRC16 of every block, the data
+// has to be the same as at the configured rate.
+#define SD_PROBE_SECTORS 4
+#define SD_PROBE_PLACES 3
+#define SD_PROBE_ROUNDS 4
+
+// Returns the read throughput in bytes per second, or 0 on any error. With
+// sums[i] == -1, records the checksum of place i instead of checking it.
+static uint32_t sd_probe_reads(sd_card_t *pSD, int32_t sums[SD_PROBE_PLACES]) {
+    static uint8_t buf[SD_PROBE_SECTORS * BLOCK_SIZE_HC];
+    const uint64_t places[SD_PROBE_PLACES] = {
+        0, pSD->sectors / 2, pSD->sectors - SD_PROBE_SECTORS};
+
+    absolute_time_t start = get_absolute_time();
+    for (size_t round = 0; round < SD_PROBE_ROUNDS; ++round) {
+        for (size_t i = 0; i < SD_PROBE_PLACES; ++i) {
+            if (in_sd_read_blocks(pSD, buf, places[i], SD_PROBE_SECTORS))
+                return 0;
+            uint16_t sum = crc16_slice4(buf, sizeof buf);
+            if (sums[i] < 0)
+                sums[i] = sum;
+            else if (sums[i] != sum)
+                return 0;
+        }
+    }
+    int64_t elapsed_us = absolute_time_diff_us(start, get_absolute_time());
+    uint64_t bytes = (uint64_t)SD_PROBE_ROUNDS * SD_PROBE_PLACES * sizeof buf;
+    return elapsed_us > 0 ? bytes * 1000000 / elapsed_us : UINT32_MAX;
+}
+
+// Try the SCK rates the SPI can make above the configured one, slowest first,
+// and keep the fastest at which the probe reads work. The SPI runs at
+// clk_peri / (2 * n) with the largest prescaler that PL022 allows being 2.
+static void sd_probe_speed(sd_card_t *pSD) {
+    sd_speed_t *speed = &pSD->speed;
+    int32_t sums[SD_PROBE_PLACES] = {-1, -1, -1};
+
+    pSD->read_next = UINT64_MAX;  // No stream across the probe reads
+    uint best = sd_spi_set_frequency(pSD, pSD->spi->baud_rate);
+    uint32_t best_Bps = sd_probe_reads(pSD, sums);
+    speed->samples[speed->count++] = (sd_speed_sample_t){best, best_Bps};
+    if (!best_Bps) {
+        DBG_PRINTF("%s: reads fail at %u Hz\r\n", __FUNCTION__, best);
+    } else {
+        uint clk = clock_get_hz(clk_peri);
+        for (uint n = clk / 2 / best; n >= 1; --n) {
+            uint rate = clk / (2 * n);
+            if (rate <= best) continue;
+            if (rate > SD_SPEED_MAX_BAUD_RATE ||
+                speed->count == SD_SPEED_PROFILE_LEN)
+                break;
+            rate = sd_spi_set_frequency(pSD, rate);
+            uint32_t Bps = sd_probe_reads(pSD, sums);
+            speed->samples[speed->count++] = (sd_speed_sample_t){rate, Bps};
+            if (!Bps) {
+                DBG_PRINTF("%s: reads fail at %u Hz\r\n", __FUNCTION__, rate);
+                break;
+            }
+            best = rate;
+            best_Bps = Bps;
+        }
+    }
+    if (pSD->read_stream) sd_read_stream_stop(pSD);
+    speed->baud_rate = best;
+    speed->read_Bps = best_Bps;
+    sd_spi_go_high_frequency(pSD);
+    // Leave the card ready at the chosen rate after a failed step
+    sd_wait_ready(pSD, SD_COMMAND_TIMEOUT);
+}
+#endif
+
+const sd_speed_t *sd_get_speed(sd_card_t *pSD) {
+    return (pSD->m_Status & STA_NOINIT) ? NULL : &pSD->speed;
+}
+
 static int sd_init(sd_card_t *pSD) {
     TRACE_PRINTF("> %s\r\n", __FUNCTION__);
 
@@ -1199,6 +1352,8 @@ static int sd_init(sd_card_t *pSD) {
     }
     // Initialize the member variables
     pSD->card_type = SDCARD_NONE;
+    pSD->read_stream = false;
+    memset(&pSD->speed, 0, sizeof pSD->speed);
 
     sd_spi_acquire(pSD);
 
@@ -1230,6 +1385,10 @@ static int sd_init(sd_card_t *pSD) {
     // The card is now initialized
     pSD->m_Status &= ~STA_NOINIT;
 
+#if SD_SPEED_PROBE && SD_CRC_ENABLED
+    if (crc_on) sd_probe_speed(pSD);
+#endif
+
     sd_spi_release(pSD);
     sd_unlock(pSD);
 
@@ -1247,6 +1406,7 @@ static bool sd_test_com(sd_card_t *pSD) {
 
     if (!(pSD->m_Status & STA_NOINIT)) {
         // SD card is currently initialized
+        if (pSD->read_stream) sd_read_stream_stop(pSD);
 
         // Timeout of 0 means only check once
         if (sd_wait_ready(pSD, 0)) {
@@ -1275,6 +1435,7 @@ static bool sd_test_com(sd_card_t *pSD) {
 
         // Initialize the member variables
         pSD->card_type = SDCARD_NONE;
+        pSD->read_stream = false;
 
         sd_spi_go_low_frequency(pSD);
         sd_spi_send_initializing_sequence(pSD);
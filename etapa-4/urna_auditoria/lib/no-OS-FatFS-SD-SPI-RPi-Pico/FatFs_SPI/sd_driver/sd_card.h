@@ -32,6 +32,23 @@ extern "C" {
 
 typedef struct sd_card_t sd_card_t;
 
+// Most SCK rates the speed probe can try
+#define SD_SPEED_PROFILE_LEN 8
+
+// Read throughput measured by the speed probe at one SCK rate
+typedef struct {
+    uint baud_rate;     // Actual SCK frequency, Hz
+    uint32_t read_Bps;  // Bytes per second; 0 if the reads failed
+} sd_speed_sample_t;
+
+// Result of the speed probe run on each initialization of the card
+typedef struct {
+    uint baud_rate;     // SCK frequency used for data transfer, Hz
+    uint32_t read_Bps;  // Read throughput at baud_rate (0 if not measured)
+    size_t count;       // Rates tried, from the slowest
+    sd_speed_sample_t samples[SD_SPEED_PROFILE_LEN];
+} sd_speed_t;
+
 // "Class" representing SD Cards
 struct sd_card_t {
     const char *pcName;
@@ -52,6 +69,9 @@ struct sd_card_t {
     uint64_t sectors;                                // Assigned dynamically
     int card_type;                                   // Assigned dynamically
     mutex_t mutex;
+    uint64_t read_next;  // Sector after the last one read
+    bool read_stream;    // A CMD18 is left open at read_next
+    sd_speed_t speed;    // Assigned by the speed probe
     FATFS fatfs;
     bool mounted;
 
@@ -91,7 +111,18 @@ bool sd_card_detect(sd_card_t *pSD);
 uint64_t sd_sectors(sd_card_t *pSD);
 
 bool sd_init_driver();
+// Coalescing of consecutive sector writes in disk_write (glue.c); on by
+// default. Disabling flushes whatever is held.
+void sd_set_write_behind(bool enable);
+// Sequential read-ahead: a CMD18 stream is kept open across reads that
+// continue where the last one ended (sd_card.c), and short sequential reads
+// are served from a prefetch buffer (glue.c). On by default.
+void sd_set_read_ahead(bool enable);
+bool sd_get_read_ahead(void);
 bool sd_card_detect(sd_card_t *sd_card_p);
+// Diagnostics: the SCK rate negotiated when the card was initialized, and the
+// read throughput measured at each rate tried. NULL if not initialized.
+const sd_speed_t *sd_get_speed(sd_card_t *sd_card_p);
 
 #ifdef __cplusplus
 }
@@ -30,10 +30,16 @@ specific language governing permissions and limitations under the License.
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wunused-variable"
 
+// The rate found by the speed probe, if any, else the configured one
 void sd_spi_go_high_frequency(sd_card_t *pSD) {
-    uint actual = spi_set_baudrate(pSD->spi->hw_inst, pSD->spi->baud_rate);
+    uint baud_rate = pSD->speed.baud_rate ? pSD->speed.baud_rate
+                                          : pSD->spi->baud_rate;
+    uint actual = spi_set_baudrate(pSD->spi->hw_inst, baud_rate);
     TRACE_PRINTF("%s: Actual frequency: %lu\n", __FUNCTION__, (long)actual);
 }
+uint sd_spi_set_frequency(sd_card_t *pSD, uint baud_rate) {
+    return spi_set_baudrate(pSD->spi->hw_inst, baud_rate);
+}
 void sd_spi_go_low_frequency(sd_card_t *pSD) {
     uint actual = spi_set_baudrate(pSD->spi->hw_inst, 400 * 1000); // Actual frequency: 398089
     TRACE_PRINTF("%s: Actual frequency: %lu\n", __FUNCTION__, (long)actual);
@@ -91,6 +97,20 @@ bool sd_spi_transfer(sd_card_t *pSD, const uint8_t *tx, uint8_t *rx,
     return spi_transfer(pSD->spi, tx, rx, length);
 }
 
+bool sd_spi_transfer_start(sd_card_t *pSD, const uint8_t *tx, uint8_t *rx,
+                           size_t length) {
+    return spi_transfer_start(pSD->spi, tx, rx, length, NULL, NULL);
+}
+
+bool sd_spi_transfer_start_crc16(sd_card_t *pSD, uint8_t *rx, size_t length,
+                                 int32_t *crc16) {
+    return spi_transfer_start_crc16(pSD->spi, rx, length, crc16);
+}
+
+bool sd_spi_transfer_wait(sd_card_t *pSD) {
+    return spi_transfer_wait(pSD->spi);
+}
+
 uint8_t sd_spi_write(sd_card_t *pSD, const uint8_t value) {
     // TRACE_PRINTF("%s\n", __FUNCTION__);
     uint8_t received = SPI_FILL_CHAR;
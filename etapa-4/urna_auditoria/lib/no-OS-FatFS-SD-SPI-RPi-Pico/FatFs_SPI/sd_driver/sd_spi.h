@@ -21,12 +21,22 @@ specific language governing permissions and limitations under the License.
 /* Transfer tx to SPI while receiving SPI to rx. 
 tx or rx can be NULL if not important. */
 bool sd_spi_transfer(sd_card_t *pSD, const uint8_t *tx, uint8_t *rx, size_t length);
+/* Asynchronous variant: queue the transfer and return (see spi_transfer_start).
+Buffers must stay valid until sd_spi_transfer_wait returns. */
+bool sd_spi_transfer_start(sd_card_t *pSD, const uint8_t *tx, uint8_t *rx, size_t length);
+/* Asynchronous receive that also yields the CRC16 of the received bytes, or -1
+(see spi_transfer_start_crc16). */
+bool sd_spi_transfer_start_crc16(sd_card_t *pSD, uint8_t *rx, size_t length,
+                                 int32_t *crc16);
+bool sd_spi_transfer_wait(sd_card_t *pSD);
 uint8_t sd_spi_write(sd_card_t *pSD, const uint8_t value);
 void sd_spi_deselect_pulse(sd_card_t *pSD);
 void sd_spi_acquire(sd_card_t *pSD);
 void sd_spi_release(sd_card_t *pSD);
 void sd_spi_go_low_frequency(sd_card_t *this);
 void sd_spi_go_high_frequency(sd_card_t *this);
+// Returns the actual frequency
+uint sd_spi_set_frequency(sd_card_t *this, uint baud_rate);
 
 /* 
 After power up, the host starts the clock and sends the initializing sequence on the CMD line. 
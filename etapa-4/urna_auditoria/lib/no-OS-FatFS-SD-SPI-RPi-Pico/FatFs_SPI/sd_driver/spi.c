@@ -27,42 +27,11 @@ specific language governing permissions and limitations under the License.
 static bool irqChannel1 = false;
 static bool irqShared = true;
 
-static void in_spi_irq_handler(const uint DMA_IRQ_num, io_rw_32 *dma_hw_ints_p) {
-    for (size_t i = 0; i < spi_get_num(); ++i) {
-        spi_t *spi_p = spi_get_by_num(i);
-        if (DMA_IRQ_num == spi_p->DMA_IRQ_num)  {
-            // Is the SPI's channel requesting interrupt?
-            if (*dma_hw_ints_p & (1 << spi_p->rx_dma)) {
-                *dma_hw_ints_p = 1 << spi_p->rx_dma;  // Clear it.
-                assert(!dma_channel_is_busy(spi_p->rx_dma));
-                assert(!sem_available(&spi_p->sem));
-                bool ok = sem_release(&spi_p->sem);
-                assert(ok);
-            }
-        }
-    }
-}
-static void __not_in_flash_func(spi_irq_handler_0)() {
-    in_spi_irq_handler(DMA_IRQ_0, &dma_hw->ints0);
-}
-static void __not_in_flash_func(spi_irq_handler_1)() {
-    in_spi_irq_handler(DMA_IRQ_1, &dma_hw->ints1);
-}
-
-void set_spi_dma_irq_channel(bool useChannel1, bool shared) {
-    irqChannel1 = useChannel1;
-    irqShared = shared;
-}
-
-// SPI Transfer: Read & Write (simultaneously) on SPI bus
-//   If the data that will be received is not important, pass NULL as rx.
-//   If the data that will be transmitted is not important,
-//     pass NULL as tx and then the SPI_FILL_CHAR is sent out as each data
-//     element.
-bool spi_transfer(spi_t *spi_p, const uint8_t *tx, uint8_t *rx, size_t length) {
-    // assert(512 == length || 1 == length);
-    assert(tx || rx);
-    // assert(!(tx && rx));
+// Program both DMA channels for a transfer and start them
+static void __not_in_flash_func(spi_xfer_launch)(spi_t *spi_p,
+                                                 const spi_xfer_t *xfer) {
+    const uint8_t *tx = xfer->tx;
+    uint8_t *rx = xfer->rx;
 
     // tx write increment is already false
     if (tx) {
@@ -82,55 +51,168 @@ bool spi_transfer(spi_t *spi_p, const uint8_t *tx, uint8_t *rx, size_t length) {
         channel_config_set_write_increment(&spi_p->rx_dma_cfg, false);
     }
 
+    // The sniffer restarts from 0 for the transfer it watches; the others
+    // leave its result alone
+    bool sniff = spi_p->sniffer && xfer->crc16;
+    if (sniff) {
+        dma_sniffer_enable(spi_p->rx_dma, DMA_SNIFF_CTRL_CALC_VALUE_CRC16, false);
+        dma_sniffer_set_data_accumulator(0);
+    }
+    channel_config_set_sniff_enable(&spi_p->rx_dma_cfg, sniff);
+
     dma_channel_configure(spi_p->tx_dma, &spi_p->tx_dma_cfg,
                           &spi_get_hw(spi_p->hw_inst)->dr,  // write address
                           tx,                              // read address
-                          length,  // element count (each element is of
-                                   // size transfer_data_size)
+                          xfer->length,  // element count (each element is of
+                                         // size transfer_data_size)
                           false);  // start
     dma_channel_configure(spi_p->rx_dma, &spi_p->rx_dma_cfg,
                           rx,                              // write address
                           &spi_get_hw(spi_p->hw_inst)->dr,  // read address
-                          length,  // element count (each element is of
-                                   // size transfer_data_size)
+                          xfer->length,  // element count (each element is of
+                                         // size transfer_data_size)
                           false);  // start
 
-    switch (spi_p->DMA_IRQ_num) {
-        case DMA_IRQ_0:
-            assert(!dma_channel_get_irq0_status(spi_p->rx_dma));
-            break;
-        case DMA_IRQ_1:
-            assert(!dma_channel_get_irq1_status(spi_p->rx_dma));
-            break;
-        default:
-            assert(false);
-    }
-    sem_reset(&spi_p->sem, 0);
-
     // start them exactly simultaneously to avoid races (in extreme cases
     // the FIFO could overflow)
     dma_start_channel_mask((1u << spi_p->tx_dma) | (1u << spi_p->rx_dma));
+}
 
+static void in_spi_irq_handler(const uint DMA_IRQ_num, io_rw_32 *dma_hw_ints_p) {
+    for (size_t i = 0; i < spi_get_num(); ++i) {
+        spi_t *spi_p = spi_get_by_num(i);
+        if (DMA_IRQ_num == spi_p->DMA_IRQ_num)  {
+            // Is the SPI's channel requesting interrupt?
+            if (*dma_hw_ints_p & (1 << spi_p->rx_dma)) {
+                *dma_hw_ints_p = 1 << spi_p->rx_dma;  // Clear it.
+                assert(!dma_channel_is_busy(spi_p->rx_dma));
+
+                // Retire the finished transfer and put the next one on the
+                // wire before running the callback
+                critical_section_enter_blocking(&spi_p->xfer_crit);
+                if (!spi_p->xfer_count) {
+                    // Spurious: the queue was aborted
+                    critical_section_exit(&spi_p->xfer_crit);
+                    continue;
+                }
+                spi_xfer_t done = spi_p->xfer[spi_p->xfer_first];
+                // Before the next transfer can restart the sniffer
+                if (done.crc16 && spi_p->sniffer)
+                    *done.crc16 = dma_sniffer_get_data_accumulator() & 0xFFFF;
+                spi_p->xfer_first = (spi_p->xfer_first + 1) % SPI_XFER_QUEUE_LEN;
+                if (--spi_p->xfer_count)
+                    spi_xfer_launch(spi_p, &spi_p->xfer[spi_p->xfer_first]);
+                critical_section_exit(&spi_p->xfer_crit);
+
+                if (done.callback) done.callback(spi_p, done.ctx);
+                // May already be available from an earlier completion that
+                // nobody waited for; spi_transfer_wait rechecks xfer_count
+                sem_release(&spi_p->sem);
+            }
+        }
+    }
+}
+static void __not_in_flash_func(spi_irq_handler_0)() {
+    in_spi_irq_handler(DMA_IRQ_0, &dma_hw->ints0);
+}
+static void __not_in_flash_func(spi_irq_handler_1)() {
+    in_spi_irq_handler(DMA_IRQ_1, &dma_hw->ints1);
+}
+
+void set_spi_dma_irq_channel(bool useChannel1, bool shared) {
+    irqChannel1 = useChannel1;
+    irqShared = shared;
+}
+
+// Drop the queue and stop the DMA after a timeout
+static void spi_xfer_abort(spi_t *spi_p) {
+    critical_section_enter_blocking(&spi_p->xfer_crit);
+    spi_p->xfer_count = 0;
+    dma_channel_abort(spi_p->tx_dma);
+    dma_channel_abort(spi_p->rx_dma);
+    // An abort can still raise the completion interrupt (RP2040-E13)
+    if (DMA_IRQ_0 == spi_p->DMA_IRQ_num)
+        dma_channel_acknowledge_irq0(spi_p->rx_dma);
+    else
+        dma_channel_acknowledge_irq1(spi_p->rx_dma);
+    critical_section_exit(&spi_p->xfer_crit);
+}
+
+static bool spi_xfer_queue(spi_t *spi_p, const uint8_t *tx, uint8_t *rx,
+                           size_t length, spi_callback_t callback, void *ctx,
+                           int32_t *crc16) {
+    assert(tx || rx);
+    assert(length);
+
+    // Queue full: wait for the transfer on the wire to complete
+    while (SPI_XFER_QUEUE_LEN == spi_p->xfer_count) {
+        if (!sem_acquire_timeout_ms(&spi_p->sem, 1000)) {
+            DBG_PRINTF("Notification wait timed out in %s\n", __FUNCTION__);
+            spi_xfer_abort(spi_p);
+            return false;
+        }
+    }
+    critical_section_enter_blocking(&spi_p->xfer_crit);
+    spi_xfer_t *xfer = &spi_p->xfer[(spi_p->xfer_first + spi_p->xfer_count) %
+                                    SPI_XFER_QUEUE_LEN];
+    xfer->tx = tx;
+    xfer->rx = rx;
+    xfer->length = length;
+    xfer->callback = callback;
+    xfer->ctx = ctx;
+    xfer->crc16 = crc16;
+    if (crc16) *crc16 = -1;
+    if (0 == spi_p->xfer_count++) {
+        // Idle: nothing will start it from the interrupt
+        sem_reset(&spi_p->sem, 0);
+        spi_xfer_launch(spi_p, xfer);
+    }
+    critical_section_exit(&spi_p->xfer_crit);
+    return true;
+}
+
+bool spi_transfer_start(spi_t *spi_p, const uint8_t *tx, uint8_t *rx,
+                        size_t length, spi_callback_t callback, void *ctx) {
+    return spi_xfer_queue(spi_p, tx, rx, length, callback, ctx, NULL);
+}
+
+bool spi_transfer_start_crc16(spi_t *spi_p, uint8_t *rx, size_t length,
+                              int32_t *crc16) {
+    assert(rx);
+    return spi_xfer_queue(spi_p, NULL, rx, length, NULL, NULL, crc16);
+}
+
+bool spi_transfer_wait(spi_t *spi_p) {
     /* Wait until master completes transfer or time out has occured. */
     uint32_t timeOut = 1000; /* Timeout 1 sec */
-    bool rc = sem_acquire_timeout_ms(
-        &spi_p->sem, timeOut);  // Wait for notification from ISR
-    if (!rc) {
-        // If the timeout is reached the function will return false
-        DBG_PRINTF("Notification wait timed out in %s\n", __FUNCTION__);
-        return false;
+    while (spi_p->xfer_count) {
+        if (!sem_acquire_timeout_ms(&spi_p->sem, timeOut)) {
+            // If the timeout is reached the function will return false
+            DBG_PRINTF("Notification wait timed out in %s\n", __FUNCTION__);
+            spi_xfer_abort(spi_p);
+            return false;
+        }
     }
     // Shouldn't be necessary:
     dma_channel_wait_for_finish_blocking(spi_p->tx_dma);
     dma_channel_wait_for_finish_blocking(spi_p->rx_dma);
 
-    assert(!sem_available(&spi_p->sem));
     assert(!dma_channel_is_busy(spi_p->tx_dma));
     assert(!dma_channel_is_busy(spi_p->rx_dma));
 
     return true;
 }
 
+// SPI Transfer: Read & Write (simultaneously) on SPI bus
+//   If the data that will be received is not important, pass NULL as rx.
+//   If the data that will be transmitted is not important,
+//     pass NULL as tx and then the SPI_FILL_CHAR is sent out as each data
+//     element.
+bool spi_transfer(spi_t *spi_p, const uint8_t *tx, uint8_t *rx, size_t length) {
+    return spi_transfer_start(spi_p, tx, rx, length, NULL, NULL) &&
+           spi_transfer_wait(spi_p);
+}
+
 void spi_lock(spi_t *spi_p) {
     assert(mutex_is_initialized(&spi_p->mutex));
     mutex_enter_blocking(&spi_p->mutex);
@@ -155,6 +237,7 @@ bool my_spi_init(spi_t *spi_p) {
             spi_p->baud_rate = 10 * 1000 * 1000;
         // For the IRQ notification:
         sem_init(&spi_p->sem, 0, 1);
+        critical_section_init(&spi_p->xfer_crit);
 
         /* Configure component */
         // Enable SPI at 100 kHz and connect to GPIOs
@@ -210,6 +293,14 @@ bool my_spi_init(spi_t *spi_p) {
                                                        : DREQ_SPI0_RX);
         channel_config_set_read_increment(&spi_p->rx_dma_cfg, false);
 
+#if SPI_DMA_SNIFFER
+        static bool sniffer_claimed;  // Under my_spi_init_mutex
+        if (!sniffer_claimed) {
+            sniffer_claimed = true;
+            spi_p->sniffer = true;
+        }
+#endif
+
         /* Theory: we only need an interrupt on rx complete,
         since if rx is complete, tx must also be complete. */
 
@@ -21,14 +21,40 @@ specific language governing permissions and limitations under the License.
 #include "hardware/gpio.h"
 #include "hardware/irq.h"
 #include "hardware/spi.h"
+#include "pico/critical_section.h"
 #include "pico/mutex.h"
 #include "pico/sem.h"
 #include "pico/types.h"
 
 #define SPI_FILL_CHAR (0xFF)
 
-// "Class" representing SPIs
+// Transfers that can be handed to the DMA at once: the one on the wire and
+// the one that starts when it completes
+#define SPI_XFER_QUEUE_LEN 2
+
+// Compute the CRC16 of received blocks with the DMA sniffer. There is a single
+// sniffer in the chip; the first SPI initialized takes it.
+#ifndef SPI_DMA_SNIFFER
+#define SPI_DMA_SNIFFER 1
+#endif
+
+typedef struct spi_t spi_t;
+
+// Completion callback of an asynchronous transfer. Runs in the DMA interrupt,
+// after the next queued transfer (if any) has been started.
+typedef void (*spi_callback_t)(spi_t *pSPI, void *ctx);
+
 typedef struct {
+    const uint8_t *tx;
+    uint8_t *rx;
+    size_t length;
+    spi_callback_t callback;
+    void *ctx;
+    int32_t *crc16;  // Sniffed CRC16 of rx, or -1 (may be NULL)
+} spi_xfer_t;
+
+// "Class" representing SPIs
+struct spi_t {
     // SPI HW
     spi_inst_t *hw_inst;
     uint miso_gpio;  // SPI MISO GPIO number (not pin number)
@@ -53,13 +79,34 @@ typedef struct {
     bool initialized;  
     semaphore_t sem;
     mutex_t mutex;    
-} spi_t;
+    // Asynchronous transfer queue, shared with the DMA interrupt
+    spi_xfer_t xfer[SPI_XFER_QUEUE_LEN];
+    volatile uint8_t xfer_first;
+    volatile uint8_t xfer_count;
+    critical_section_t xfer_crit;
+    bool sniffer;  // Owns the DMA sniffer
+};
 
 #ifdef __cplusplus
 extern "C" {
 #endif
   
 bool __not_in_flash_func(spi_transfer)(spi_t *pSPI, const uint8_t *tx, uint8_t *rx, size_t length);  
+// Asynchronous transfer: queues it and returns once it is on the wire or
+// queued behind the one that is. tx, rx and length follow spi_transfer; the
+// buffers must stay valid until the transfer completes. Blocks while the queue
+// is full. callback may be NULL.
+bool spi_transfer_start(spi_t *pSPI, const uint8_t *tx, uint8_t *rx,
+                        size_t length, spi_callback_t callback, void *ctx);
+// Asynchronous receive of length bytes (SPI_FILL_CHAR is sent) that also
+// yields the CRC16 (CCITT, as used by SD cards) of the received bytes. When the
+// transfer completes, *crc16 holds it, or -1 if the DMA sniffer isn't
+// available to this SPI and the caller has to compute it.
+bool spi_transfer_start_crc16(spi_t *pSPI, uint8_t *rx, size_t length,
+                              int32_t *crc16);
+// Wait for every queued transfer to complete. On timeout, the transfers are
+// aborted and false is returned.
+bool spi_transfer_wait(spi_t *pSPI);
 void spi_lock(spi_t *pSPI);
 void spi_unlock(spi_t *pSPI);
 bool my_spi_init(spi_t *pSPI);
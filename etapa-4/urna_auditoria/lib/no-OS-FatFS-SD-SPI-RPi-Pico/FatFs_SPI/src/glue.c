@@ -20,6 +20,7 @@ specific language governing permissions and limitations under the License.
 /* storage control modules to the FatFs module with a defined API.       */
 /*-----------------------------------------------------------------------*/
 #include <stdio.h>
+#include <string.h>
 //
 #include "ff.h" /* Obtains integer types */
 //
@@ -32,6 +33,72 @@ specific language governing permissions and limitations under the License.
 #define TRACE_PRINTF(fmt, args...)
 //#define TRACE_PRINTF printf  // task_printf
 
+/*-----------------------------------------------------------------------*/
+/* Write-behind                                                          */
+/*-----------------------------------------------------------------------*/
+/* FatFs writes most sectors one at a time (FAT, directory and partial   */
+/* cluster updates), and each one costs a CMD24 plus a full program      */
+/* cycle. Writes to consecutive sectors are held here and go out as one  */
+/* CMD25 burst when the run is broken, the buffer fills, a read touches  */
+/* the held sectors, or FatFs asks for CTRL_SYNC (f_sync, f_close).      */
+/* Errors of a deferred write are reported by the call that flushed it.  */
+
+#ifndef SD_WRITE_BEHIND_SECTORS
+#define SD_WRITE_BEHIND_SECTORS 8
+#endif
+
+typedef struct {
+    LBA_t start;    // First sector held
+    UINT count;     // Sectors held (0: empty)
+    BYTE buf[SD_WRITE_BEHIND_SECTORS * FF_MAX_SS];
+} write_behind_t;
+
+static write_behind_t write_behind[FF_VOLUMES];
+static bool write_behind_enabled = true;
+
+/*-----------------------------------------------------------------------*/
+/* Read-ahead                                                            */
+/*-----------------------------------------------------------------------*/
+/* A short read that continues where the previous one ended fetches     */
+/* SD_READ_AHEAD_SECTORS sectors; the following sequential reads are     */
+/* then served from memory. Together with the CMD18 stream the driver    */
+/* keeps open, replaying a file sector by sector costs one command.      */
+
+#ifndef SD_READ_AHEAD_SECTORS
+#define SD_READ_AHEAD_SECTORS 4
+#endif
+
+typedef struct {
+    LBA_t start;    // First sector held
+    UINT count;     // Sectors held (0: empty)
+    LBA_t next;     // Sector after the last one read
+    BYTE buf[SD_READ_AHEAD_SECTORS * FF_MAX_SS];
+} read_ahead_t;
+
+static read_ahead_t read_ahead[FF_VOLUMES];
+
+static int sdrc2dresult(int sd_rc);
+
+static bool overlaps(LBA_t a, UINT a_count, LBA_t b, UINT b_count) {
+    return a < b + b_count && b < a + a_count;
+}
+
+static DRESULT wb_flush(BYTE pdrv, sd_card_t *p_sd) {
+    write_behind_t *wb = &write_behind[pdrv];
+    if (!wb->count) return RES_OK;
+    int rc = p_sd->write_blocks(p_sd, wb->buf, wb->start, wb->count);
+    wb->count = 0;  // Dropped on error too: the caller gets the error
+    return sdrc2dresult(rc);
+}
+
+void sd_set_write_behind(bool enable) {
+    if (!enable) {
+        for (size_t i = 0; i < sd_get_num() && i < FF_VOLUMES; ++i)
+            wb_flush(i, sd_get_by_num(i));
+    }
+    write_behind_enabled = enable;
+}
+
 /*-----------------------------------------------------------------------*/
 /* Get Drive Status                                                      */
 /*-----------------------------------------------------------------------*/
@@ -59,6 +126,12 @@ DSTATUS disk_initialize(
 
     sd_card_t *p_sd = sd_get_by_num(pdrv);
     if (!p_sd) return RES_PARERR;
+    // Sectors held for a card that has since been removed must not reach
+    // whatever card is in the socket now
+    if (p_sd->m_Status & STA_NOINIT) {
+        write_behind[pdrv].count = 0;
+        read_ahead[pdrv].count = 0;
+    }
     // See http://elm-chan.org/fsw/ff/doc/dstat.html
     return p_sd->init(p_sd);  
 }
@@ -98,7 +171,43 @@ DRESULT disk_read(BYTE pdrv,  /* Physical drive nmuber to identify the drive */
     TRACE_PRINTF(">>> %s\n", __FUNCTION__);
     sd_card_t *p_sd = sd_get_by_num(pdrv);
     if (!p_sd) return RES_PARERR;
-    int rc = p_sd->read_blocks(p_sd, buff, sector, count);
+    write_behind_t *wb = &write_behind[pdrv];
+    read_ahead_t *ra = &read_ahead[pdrv];
+    if (wb->count && sector >= wb->start &&
+        sector + count <= wb->start + wb->count) {
+        // Entirely held for writing: serve it from the buffer
+        memcpy(buff, &wb->buf[(sector - wb->start) * FF_MAX_SS],
+               count * FF_MAX_SS);
+        return RES_OK;
+    }
+    if (ra->count && sector >= ra->start &&
+        sector + count <= ra->start + ra->count) {
+        memcpy(buff, &ra->buf[(sector - ra->start) * FF_MAX_SS],
+               count * FF_MAX_SS);
+        ra->next = sector + count;
+        return RES_OK;
+    }
+    // What to fetch: a whole read-ahead buffer for a short sequential read
+    BYTE *dst = buff;
+    UINT fetch = count;
+    if (sd_get_read_ahead() && sector == ra->next &&
+        count < SD_READ_AHEAD_SECTORS &&
+        sector + SD_READ_AHEAD_SECTORS <= p_sd->sectors) {
+        dst = ra->buf;
+        fetch = SD_READ_AHEAD_SECTORS;
+        ra->count = 0;
+    }
+    if (wb->count && overlaps(sector, fetch, wb->start, wb->count)) {
+        DRESULT res = wb_flush(pdrv, p_sd);
+        if (RES_OK != res) return res;
+    }
+    int rc = p_sd->read_blocks(p_sd, dst, sector, fetch);
+    if (SD_BLOCK_DEVICE_ERROR_NONE == rc && dst != buff) {
+        ra->start = sector;
+        ra->count = fetch;
+        memcpy(buff, ra->buf, count * FF_MAX_SS);
+    }
+    ra->next = sector + count;
     return sdrc2dresult(rc);
 }
 
@@ -116,8 +225,32 @@ DRESULT disk_write(BYTE pdrv, /* Physical drive nmuber to identify the drive */
     TRACE_PRINTF(">>> %s\n", __FUNCTION__);
     sd_card_t *p_sd = sd_get_by_num(pdrv);
     if (!p_sd) return RES_PARERR;
-    int rc = p_sd->write_blocks(p_sd, buff, sector, count);
-    return sdrc2dresult(rc);
+    read_ahead_t *ra = &read_ahead[pdrv];
+    if (ra->count && overlaps(sector, count, ra->start, ra->count))
+        ra->count = 0;
+    write_behind_t *wb = &write_behind[pdrv];
+    // Extends or rewrites the held run without leaving a gap in it
+    if (wb->count && sector >= wb->start &&
+        sector <= wb->start + wb->count &&
+        sector + count <= wb->start + SD_WRITE_BEHIND_SECTORS) {
+        memcpy(&wb->buf[(sector - wb->start) * FF_MAX_SS], buff,
+               count * FF_MAX_SS);
+        if (sector + count > wb->start + wb->count)
+            wb->count = sector + count - wb->start;
+        if (wb->count < SD_WRITE_BEHIND_SECTORS) return RES_OK;
+        return wb_flush(pdrv, p_sd);
+    }
+    DRESULT res = wb_flush(pdrv, p_sd);
+    if (RES_OK != res) return res;
+    if (!write_behind_enabled || count >= SD_WRITE_BEHIND_SECTORS) {
+        // Large writes are already a single burst: no copy
+        int rc = p_sd->write_blocks(p_sd, buff, sector, count);
+        return sdrc2dresult(rc);
+    }
+    memcpy(wb->buf, buff, count * FF_MAX_SS);
+    wb->start = sector;
+    wb->count = count;
+    return RES_OK;
 }
 
 #endif
@@ -161,7 +294,7 @@ DRESULT disk_ioctl(BYTE pdrv, /* Physical drive nmuber (0..) */
             return RES_OK;
         }
         case CTRL_SYNC:
-            return RES_OK;
+            return wb_flush(pdrv, p_sd);
         default:
             return RES_PARERR;
     }
@@ -25,6 +25,10 @@ extern "C" {
     void simple();
     void big_file_test(const char *const pathname, size_t size,
                             uint32_t seed);
+    void big_file_benchmark(const char *const pathname, size_t size,
+                            uint32_t seed);
+    void sequential_read_benchmark(const char *const pathname);
+    void crc_test(sd_card_t *pSD, uint32_t seed);
     void vCreateAndVerifyExampleFiles(const char *pcMountPath);
     void vStdioWithCWDTest(const char *pcMountPath);
     bool process_logger();
@@ -194,6 +198,29 @@ static void run_getfree() {
     printf("%10lu KiB total drive space.\n%10lu KiB available.\n", tot_sect / 2,
            fre_sect / 2);
 }
+static void run_speed() {
+    const char *arg1 = strtok(NULL, " ");
+    if (!arg1) arg1 = sd_get_by_num(0)->pcName;
+    sd_card_t *pSD = sd_get_by_name(arg1);
+    if (!pSD) {
+        printf("Unknown logical drive number: \"%s\"\n", arg1);
+        return;
+    }
+    const sd_speed_t *speed = sd_get_speed(pSD);
+    if (!speed) {
+        printf("Drive \"%s\" not initialized\n", arg1);
+        return;
+    }
+    for (size_t i = 0; i < speed->count; ++i) {
+        const sd_speed_sample_t *sample = &speed->samples[i];
+        printf("%9u Hz: ", sample->baud_rate);
+        if (sample->read_Bps)
+            printf("%7.1f KiB/s\n", sample->read_Bps / 1024.0);
+        else
+            printf("failed\n");
+    }
+    printf("Using %u Hz\n", speed->baud_rate);
+}
 static void run_cd() {
     char *arg1 = strtok(NULL, " ");
     if (!arg1) {
@@ -303,6 +330,35 @@ static void run_big_file_test() {
     uint32_t seed = atoi(pcSeed);
     big_file_test(pcPathName, size, seed);
 }
+static void run_big_file_benchmark() {
+    const char *pcPathName = strtok(NULL, " ");
+    const char *pcSize = strtok(NULL, " ");
+    const char *pcSeed = strtok(NULL, " ");
+    if (!pcPathName || !pcSize || !pcSeed) {
+        printf("Missing argument\n");
+        return;
+    }
+    big_file_benchmark(pcPathName, strtoul(pcSize, 0, 0), atoi(pcSeed));
+}
+static void run_read_benchmark() {
+    const char *pcPathName = strtok(NULL, " ");
+    if (!pcPathName) {
+        printf("Missing argument\n");
+        return;
+    }
+    sequential_read_benchmark(pcPathName);
+}
+static void run_crc_test() {
+    const char *arg1 = strtok(NULL, " ");
+    if (!arg1) arg1 = sd_get_by_num(0)->pcName;
+    sd_card_t *pSD = sd_get_by_name(arg1);
+    if (!pSD) {
+        printf("Unknown logical drive number: \"%s\"\n", arg1);
+        return;
+    }
+    const char *pcSeed = strtok(NULL, " ");
+    crc_test(pSD, pcSeed ? atoi(pcSeed) : 1);
+}
 static void del_node(const char *path) {
     FILINFO fno;
     char buff[256];
@@ -382,6 +438,10 @@ static cmd_def_t cmds[] = {
     {"getfree", run_getfree,
      "getfree [<drive#:>]:\n"
      "  Print the free space on drive"},
+    {"speed", run_speed,
+     "speed [<drive#:>]:\n"
+     "  Show the SPI clock rates tried for the card and the one in use\n"
+     "\te.g.: speed 0:"},
     {"cd", run_cd,
      "cd <path>:\n"
      "  Changes the current directory of the logical drive.\n"
@@ -406,6 +466,18 @@ static cmd_def_t cmds[] = {
      " <size in bytes> must be multiple of 512.\n"
      "\te.g.: big_file_test bf 1048576 1\n"
      "\tor: big_file_test big3G-3 0xC0000000 3"},
+    {"big_file_bench", run_big_file_benchmark,
+     "big_file_bench <pathname> <size in bytes> <seed>:\n"
+     " Compare write throughput with and without write-behind\n"
+     "\te.g.: big_file_bench bf 1048576 1"},
+    {"read_bench", run_read_benchmark,
+     "read_bench <pathname>:\n"
+     " Compare sequential read throughput with and without read-ahead\n"
+     "\te.g.: read_bench bf"},
+    {"crc_test", run_crc_test,
+     "crc_test [drive#:] [seed]:\n"
+     " Check the CRC16 implementations and read random sectors\n"
+     "\te.g.: crc_test 0: 1"},
     {"cdef", run_cdef,
      "cdef:\n  Create Disk and Example Files\n"
      "  Expects card to be already formatted and mounted"},
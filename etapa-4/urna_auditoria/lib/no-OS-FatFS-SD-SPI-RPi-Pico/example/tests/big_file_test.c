@@ -24,6 +24,7 @@ specific language governing permissions and limitations under the License.
 //
 //#include "ff_headers.h"
 #include "ff_stdio.h"
+#include "sd_card.h"
 
 #define FF_MAX_SS 512
 #define BUFFSZ 8 * 1024
@@ -63,14 +64,16 @@ static DWORD pn(/* Pseudo random number generator */
     return lfsr;
 }
 
-// Create a file of size "size" bytes filled with random data seeded with "seed"
-static bool create_big_file(const char *const pathname, size_t size,
-                            unsigned seed) {
+// Create a file of size "size" bytes filled with random data seeded with "seed",
+// written "chunk" bytes at a time. Returns the elapsed time in seconds, or a
+// negative value on failure.
+static float write_big_file(const char *const pathname, size_t size,
+                            unsigned seed, size_t chunk) {
     int32_t lItems;
     FF_FILE *pxFile;
 
     //    DWORD buff[FF_MAX_SS];  /* Working buffer (4 sector in size) */
-    size_t bufsz = size < BUFFSZ ? size : BUFFSZ;
+    size_t bufsz = size < chunk ? size : chunk;
     assert(0 == size % bufsz);
     DWORD *buff = malloc(bufsz);
     assert(buff);
@@ -100,7 +103,8 @@ static bool create_big_file(const char *const pathname, size_t size,
     //    pxFile = ff_truncate(pathname, size);
     if (!pxFile) {
         printf("ff_fopen(%s): %s (%d)\n", pathname, strerror(errno), errno);
-        return false;
+        free(buff);
+        return -1;
     }
     assert(pxFile);
 
@@ -118,7 +122,13 @@ static bool create_big_file(const char *const pathname, size_t size,
     ff_fclose(pxFile);
 
     int64_t elapsed_us = absolute_time_diff_us(xStart, get_absolute_time());
-    float elapsed = elapsed_us / 1E6;
+    return elapsed_us / 1E6;
+}
+
+static bool create_big_file(const char *const pathname, size_t size,
+                            unsigned seed) {
+    float elapsed = write_big_file(pathname, size, seed, BUFFSZ);
+    if (elapsed < 0) return false;
     printf("Elapsed seconds %.3g\n", elapsed);
     printf("Transfer rate %.3g KiB/s\n", (double)size / elapsed / 1024);
     return true;
@@ -261,4 +271,71 @@ void big_file_test(const char *const pathname, size_t size, uint32_t seed) {
         check_big_file(pathname, size, seed);
 }
 
+// Write throughput with and without write-behind coalescing in disk_write.
+// Writes of one sector at a time are the worst case for the card (one CMD24
+// per sector); 8 KiB writes show the large-transfer path.
+void big_file_benchmark(const char *const pathname, size_t size,
+                        uint32_t seed) {
+    static const size_t chunks[] = {FF_MAX_SS, BUFFSZ};
+    for (size_t i = 0; i < count_of(chunks); ++i) {
+        float mbps[2];
+        for (int wb = 0; wb < 2; ++wb) {
+            sd_set_write_behind(wb);
+            float elapsed = write_big_file(pathname, size, seed, chunks[i]);
+            if (elapsed < 0) {
+                sd_set_write_behind(true);
+                return;
+            }
+            mbps[wb] = size / elapsed / 1E6;
+        }
+        printf("%u-byte writes: %.3f MB/s without write-behind, "
+               "%.3f MB/s with it (%.2fx)\n",
+               (unsigned)chunks[i], mbps[0], mbps[1], mbps[1] / mbps[0]);
+    }
+    sd_set_write_behind(true);
+    check_big_file(pathname, size, seed);
+}
+
+// Sequential read throughput with and without read-ahead (open CMD18 stream
+// plus prefetch buffer), reading an existing file "chunk" bytes at a time.
+static float read_whole_file(const char *const pathname, size_t chunk,
+                             size_t *size) {
+    FF_FILE *pxFile = ff_fopen(pathname, "r");
+    if (!pxFile) {
+        printf("ff_fopen(%s): %s (%d)\n", pathname, strerror(errno), errno);
+        return -1;
+    }
+    void *buff = malloc(chunk);
+    assert(buff);
+    *size = 0;
+    absolute_time_t xStart = get_absolute_time();
+    size_t n;
+    while ((n = ff_fread(buff, 1, chunk, pxFile)) > 0) *size += n;
+    int64_t elapsed_us = absolute_time_diff_us(xStart, get_absolute_time());
+    free(buff);
+    ff_fclose(pxFile);
+    return elapsed_us / 1E6;
+}
+
+void sequential_read_benchmark(const char *const pathname) {
+    static const size_t chunks[] = {FF_MAX_SS, BUFFSZ};
+    for (size_t i = 0; i < count_of(chunks); ++i) {
+        float mbps[2];
+        for (int ra = 0; ra < 2; ++ra) {
+            sd_set_read_ahead(ra);
+            size_t size;
+            float elapsed = read_whole_file(pathname, chunks[i], &size);
+            if (elapsed < 0) {
+                sd_set_read_ahead(true);
+                return;
+            }
+            mbps[ra] = size / elapsed / 1E6;
+        }
+        printf("%u-byte reads: %.3f MB/s without read-ahead, "
+               "%.3f MB/s with it (%.2fx)\n",
+               (unsigned)chunks[i], mbps[0], mbps[1], mbps[1] / mbps[0]);
+    }
+    sd_set_read_ahead(true);
+}
+
 /* [] END OF FILE */
@@ -0,0 +1,80 @@
+/* crc_test.c
+Copyright 2021 Carl John Kugler III
+
+Licensed under the Apache License, Version 2.0 (the License); you may not use 
+this file except in compliance with the License. You may obtain a copy of the 
+License at
+
+   http://www.apache.org/licenses/LICENSE-2.0 
+Unless required by applicable law or agreed to in writing, software distributed 
+under the License is distributed on an AS IS BASIS, WITHOUT WARRANTIES OR 
+CONDITIONS OF ANY KIND, either express or implied. See the License for the 
+specific language governing permissions and limitations under the License.
+*/
+// Checks the slice-by-4 CRC16 against the byte-at-a-time crc16() and reads
+// random sectors, whose CRC16 the driver checks with the DMA sniffer.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+//
+#include "pico/stdlib.h"
+//
+#include "crc.h"
+#include "ff.h"
+#include "diskio.h" /* Declarations of disk functions */
+#include "sd_card.h"
+
+#define CRC_TEST_ROUNDS 1000
+#define CRC_TEST_MAX_LEN 600
+#define CRC_TEST_SECTORS 64
+#define CRC_TEST_MAX_BLOCKS 8 // Multi-block reads of 1 to 8 sectors
+
+void crc_test(sd_card_t *pSD, uint32_t seed) {
+    static uint8_t buf[CRC_TEST_MAX_BLOCKS * 512];
+    srand(seed);
+
+    size_t mismatches = 0;
+    for (size_t i = 0; i < CRC_TEST_ROUNDS; ++i) {
+        size_t len = rand() % (CRC_TEST_MAX_LEN + 1);
+        for (size_t j = 0; j < len; ++j) buf[j] = rand();
+        if (crc16((const char *)buf, len) != crc16_slice4(buf, len)) {
+            printf("CRC16 mismatch: length %zu, round %zu\n", len, i);
+            ++mismatches;
+        }
+    }
+    printf("crc16_slice4: %zu mismatches in %d random buffers\n", mismatches,
+           CRC_TEST_ROUNDS);
+
+    absolute_time_t xStart = get_absolute_time();
+    unsigned short sum = 0;
+    for (size_t i = 0; i < 100; ++i) sum ^= crc16((const char *)buf, 512);
+    int64_t bytewise_us = absolute_time_diff_us(xStart, get_absolute_time());
+    xStart = get_absolute_time();
+    for (size_t i = 0; i < 100; ++i) sum ^= crc16_slice4(buf, 512);
+    int64_t slice4_us = absolute_time_diff_us(xStart, get_absolute_time());
+    printf("512-byte CRC16: %.1f us byte at a time, %.1f us slice-by-4 (%04x)\n",
+           bytewise_us / 100.0, slice4_us / 100.0, sum);
+
+    // A wrong sniffed CRC16 shows up as SD_BLOCK_DEVICE_ERROR_CRC
+    if (pSD->init(pSD) & STA_NOINIT) {
+        printf("Card not initialized\n");
+        return;
+    }
+    uint64_t sectors = pSD->sectors;
+    size_t errors = 0;
+    for (size_t i = 0; i < CRC_TEST_SECTORS; ++i) {
+        uint64_t sector = (((uint64_t)rand() << 31) | rand()) % sectors;
+        uint32_t count = 1 + rand() % CRC_TEST_MAX_BLOCKS;
+        if (sector + count > sectors) count = 1;
+        int rc = pSD->read_blocks(pSD, buf, sector, count);
+        if (SD_BLOCK_DEVICE_ERROR_NONE != rc) {
+            printf("read_blocks(%llu, %lu): %d\n", (unsigned long long)sector,
+                   (unsigned long)count, rc);
+            ++errors;
+        }
+    }
+    printf("%d random reads, %zu errors\n", CRC_TEST_SECTORS, errors);
+}
+
+/* [] END OF FILE */
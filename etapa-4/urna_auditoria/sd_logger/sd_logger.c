@@ -0,0 +1,367 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "sd_logger.h"
+
+// Fonte dos zeros gravados na extensão pré-alocada
+static const uint8_t zeros[SD_LOGGER_SECTOR_SIZE];
+
+// Grava 'len' zeros na posição corrente do arquivo
+static FRESULT write_zeros(FIL *fil, FSIZE_t len) {
+    while (len > 0) {
+        UINT chunk = len < sizeof(zeros) ? (UINT)len : sizeof(zeros);
+        UINT written = 0;
+        FRESULT fr = f_write(fil, zeros, chunk, &written);
+        if (fr != FR_OK) return fr;
+        if (written != chunk) return FR_DENIED; // Volume cheio
+        len -= chunk;
+    }
+    return FR_OK;
+}
+
+// Tabela de fragmentos do arquivo (fast seek). Se ele estiver fragmentado
+// demais para a tabela, segue sem ela, percorrendo a FAT como antes.
+static void sd_logger_link_map(sd_logger_t *logger) {
+    logger->clmt[0] = SD_LOGGER_CLMT_LEN;
+    logger->fil.cltbl = logger->clmt;
+    if (f_lseek(&logger->fil, CREATE_LINKMAP) != FR_OK) logger->fil.cltbl = NULL;
+}
+
+// Reserva a extensão de um arquivo novo. O f_expand só procura um bloco
+// contíguo livre e o indica como ponto de partida das próximas alocações;
+// os clusters são alocados à medida que a extensão é zerada, em partes, pelo
+// sd_logger_poll. Assim a abertura não bloqueia gravando prealloc_size bytes.
+static FRESULT sd_logger_preallocate(sd_logger_t *logger) {
+    FRESULT fr = f_expand(&logger->fil, logger->config.prealloc_size, 0);
+    if (fr == FR_DENIED) {
+        printf("AVISO: Sem espaco contiguo para pre-alocar o log\n");
+        return FR_OK; // Os clusters vêm de onde houver espaço livre
+    }
+    return fr;
+}
+
+// Zera o próximo trecho da extensão, a partir do fim do arquivo, e volta ao
+// fim dos dados. O tamanho do arquivo marca até onde a extensão já foi zerada.
+// Ao terminar, sincroniza e monta a tabela de fragmentos.
+static FRESULT sd_logger_zero_step(sd_logger_t *logger) {
+    FIL *fil = &logger->fil;
+    FSIZE_t end = f_tell(fil);
+    FSIZE_t len = SD_LOGGER_ZERO_SECTORS * SD_LOGGER_SECTOR_SIZE - f_size(fil) % SD_LOGGER_SECTOR_SIZE;
+    if (len > logger->extent - f_size(fil)) len = logger->extent - f_size(fil);
+
+    FRESULT fr = f_lseek(fil, f_size(fil));
+    if (fr == FR_OK) fr = write_zeros(fil, len);
+    if (fr == FR_DENIED) {
+        // Volume cheio: a extensão fica no que já foi zerado
+        printf("AVISO: Volume cheio, extensao do log reduzida a %lu kB\n", (unsigned long)(f_size(fil) / 1024));
+        logger->extent = f_size(fil);
+        fr = FR_OK;
+    }
+    if (fr == FR_OK) fr = f_lseek(fil, end);
+    if (fr != FR_OK || f_size(fil) < logger->extent) return fr;
+
+    fr = f_sync(fil);
+    if (fr == FR_OK) {
+        sd_logger_link_map(logger);
+        printf("Log: extensao de %lu kB zerada em %lu ms\n", (unsigned long)(logger->extent / 1024),
+               (unsigned long)(absolute_time_diff_us(logger->zero_start, get_absolute_time()) / 1000));
+    }
+    return fr;
+}
+
+static FRESULT record_is_zero(FIL *fil, size_t record_size, uint32_t index, bool *zero) {
+    uint8_t buf[64];
+    FRESULT fr = f_lseek(fil, (FSIZE_t)index * record_size);
+    *zero = true;
+    for (size_t done = 0; fr == FR_OK && *zero && done < record_size; done += sizeof(buf)) {
+        UINT n = record_size - done < sizeof(buf) ? (UINT)(record_size - done) : sizeof(buf);
+        UINT read = 0;
+        fr = f_read(fil, buf, n, &read);
+        if (fr == FR_OK && read != n) fr = FR_INT_ERR;
+        for (UINT i = 0; fr == FR_OK && i < n; i++) {
+            if (buf[i]) {
+                *zero = false;
+                break;
+            }
+        }
+    }
+    return fr;
+}
+
+// Fim dos dados: a extensão é zerada à frente dos dados e preenchida em
+// ordem, então há uma busca binária pelo primeiro registro todo zerado.
+// Sem nenhum (extensão esgotada, ou arquivo de antes da pré-alocação), o
+// fim dos dados é o do arquivo.
+static FRESULT sd_logger_find_end(sd_logger_t *logger) {
+    size_t record_size = logger->config.record_size;
+    uint32_t lo = 0;                                                 // [0, lo) em uso
+    uint32_t hi = (uint32_t)(f_size(&logger->fil) / record_size);    // [hi, fim) livres
+    uint32_t records = hi;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        bool zero;
+        FRESULT fr = record_is_zero(&logger->fil, record_size, mid, &zero);
+        if (fr != FR_OK) return fr;
+        if (zero) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    if (lo == records) return f_lseek(&logger->fil, f_size(&logger->fil));
+    return f_lseek(&logger->fil, (FSIZE_t)lo * record_size);
+}
+
+// Posiciona o arquivo no fim dos dados, onde continuam as gravações
+static FRESULT sd_logger_seek_end(sd_logger_t *logger) {
+    const sd_logger_config_t *config = &logger->config;
+    FIL *fil = &logger->fil;
+
+    logger->extent = 0;
+    fil->cltbl = NULL;
+    if (config->prealloc_size == 0 || config->record_size == 0) {
+        return f_lseek(fil, f_size(fil));
+    }
+    // Arquivo novo: no boot com um cartão sem log, ou ao reabrir depois de
+    // trocar o cartão (então no meio da eleição, na mensagem seguinte)
+    if (f_size(fil) == 0) {
+        FRESULT fr = sd_logger_preallocate(logger);
+        if (fr != FR_OK) return fr;
+    }
+    logger->extent = config->prealloc_size;
+    FRESULT fr = sd_logger_find_end(logger);
+    if (fr != FR_OK) return fr;
+    if (f_size(fil) >= logger->extent) {
+        sd_logger_link_map(logger);
+    } else {
+        // Zerada em partes pelo sd_logger_poll; até lá, sem fast seek
+        logger->zero_start = get_absolute_time();
+        printf("Log: zerando %lu kB da extensao em segundo plano\n",
+               (unsigned long)((logger->extent - f_size(fil)) / 1024));
+    }
+    return FR_OK;
+}
+
+// Reabre o volume e o arquivo após uma falha (ex.: cartão reinserido)
+static bool sd_logger_reopen(sd_logger_t *logger) {
+    FRESULT fr;
+
+    if (!logger->mounted) {
+        fr = f_mount(&logger->fs, logger->config.drive, 1);
+        if (fr != FR_OK) {
+            printf("ERRO: Nao foi possivel montar o filesystem (%d)\n", fr);
+            logger->stats.errors++;
+            return false;
+        }
+        logger->mounted = true;
+    }
+
+    // O fim dos dados é procurado uma única vez, na abertura; FA_READ
+    // permite reler o fim do arquivo (sd_logger_read)
+    fr = f_open(&logger->fil, logger->config.path, FA_READ | FA_WRITE | FA_OPEN_ALWAYS);
+    if (fr == FR_OK) {
+        fr = sd_logger_seek_end(logger);
+        if (fr != FR_OK) f_close(&logger->fil);
+    }
+    if (fr != FR_OK) {
+        printf("ERRO: Nao foi possivel abrir o arquivo '%s' (%d)\n", logger->config.path, fr);
+        logger->stats.errors++;
+        f_unmount(logger->config.drive);
+        logger->mounted = false;
+        return false;
+    }
+    logger->open = true;
+    return true;
+}
+
+// Marca o arquivo como perdido; a próxima operação tenta reabri-lo
+static void sd_logger_fail(sd_logger_t *logger, const char *op, FRESULT fr) {
+    printf("ERRO: %s falhou no arquivo de log (%d)\n", op, fr);
+    logger->stats.errors++;
+    f_close(&logger->fil);
+    f_unmount(logger->config.drive);
+    logger->open = false;
+    logger->mounted = false;
+}
+
+// Grava 'len' bytes do início do buffer de preparo e descarta-os do buffer
+static bool sd_logger_write_stage(sd_logger_t *logger, size_t len) {
+    if (len == 0) return true;
+    if (!logger->open && !sd_logger_reopen(logger)) return false;
+
+    // O fast seek não deixa o arquivo crescer: além da extensão pré-alocada
+    // os clusters voltam a ser alocados pela FAT
+    if (logger->fil.cltbl && f_tell(&logger->fil) + len > f_size(&logger->fil)) {
+        logger->fil.cltbl = NULL;
+    }
+    UINT written = 0;
+    FRESULT fr = f_write(&logger->fil, logger->stage, len, &written);
+    if (fr != FR_OK || written != len) {
+        sd_logger_fail(logger, "f_write", fr);
+        return false;
+    }
+    logger->stage_len -= len;
+    if (logger->stage_len > 0) {
+        memmove(logger->stage, logger->stage + len, logger->stage_len);
+    }
+    return true;
+}
+
+// Grava somente o que completa setores inteiros do arquivo. Se o fim do
+// arquivo não está alinhado, o primeiro trecho completa o setor corrente;
+// o resto sai em setores de 512 bytes, que o FatFs envia direto ao disco.
+static bool sd_logger_flush_sectors(sd_logger_t *logger) {
+    if (!logger->open && !sd_logger_reopen(logger)) return false;
+
+    size_t head = (SD_LOGGER_SECTOR_SIZE - (size_t)(f_tell(&logger->fil) % SD_LOGGER_SECTOR_SIZE)) %
+                  SD_LOGGER_SECTOR_SIZE;
+    if (logger->stage_len < head + (head ? 0 : SD_LOGGER_SECTOR_SIZE)) {
+        return true; // Nenhum setor completo ainda
+    }
+    size_t len = head + ((logger->stage_len - head) / SD_LOGGER_SECTOR_SIZE) * SD_LOGGER_SECTOR_SIZE;
+    if (!sd_logger_write_stage(logger, len)) return false;
+    logger->stats.sector_flushes++;
+    return true;
+}
+
+bool sd_logger_open(sd_logger_t *logger, const sd_logger_config_t *config) {
+    memset(logger, 0, sizeof(*logger));
+    logger->config = *config;
+    return sd_logger_reopen(logger);
+}
+
+bool sd_logger_append(sd_logger_t *logger, const void *data, size_t len) {
+    const uint8_t *src = data;
+
+    while (len > 0) {
+        size_t room = SD_LOGGER_STAGE_SIZE - logger->stage_len;
+        if (room == 0) {
+            // Buffer cheio e o cartão não aceitou os setores: o registro é perdido
+            return false;
+        }
+        size_t chunk = len < room ? len : room;
+        memcpy(logger->stage + logger->stage_len, src, chunk);
+        logger->stage_len += chunk;
+        src += chunk;
+        len -= chunk;
+
+        if (logger->stage_len >= SD_LOGGER_SECTOR_SIZE) {
+            sd_logger_flush_sectors(logger);
+        }
+    }
+
+    if (logger->pending_records++ == 0) {
+        logger->first_pending = get_absolute_time();
+    }
+    logger->stats.records++;
+    logger->stats.bytes += (uint32_t)(src - (const uint8_t *)data);
+
+    if (logger->config.flush_every_records &&
+        logger->pending_records >= logger->config.flush_every_records) {
+        return sd_logger_sync(logger);
+    }
+    return true;
+}
+
+bool sd_logger_poll(sd_logger_t *logger) {
+    // Com o cartão indisponível, a nova tentativa fica para o próximo registro
+    if (!logger->open) return false;
+    if (logger->pending_records > 0 && logger->config.flush_every_ms > 0) {
+        int64_t age_us = absolute_time_diff_us(logger->first_pending, get_absolute_time());
+        if (age_us >= (int64_t)logger->config.flush_every_ms * 1000 && !sd_logger_sync(logger)) return false;
+    }
+    if (sd_logger_zero_left(logger) == 0) return true;
+    FRESULT fr = sd_logger_zero_step(logger);
+    if (fr != FR_OK) {
+        sd_logger_fail(logger, "f_write", fr);
+        return false;
+    }
+    return true;
+}
+
+bool sd_logger_sync(sd_logger_t *logger) {
+    if (!logger->open && !sd_logger_reopen(logger)) return false;
+    if (!sd_logger_write_stage(logger, logger->stage_len)) return false;
+    if (logger->pending_records == 0) return true;
+
+    FRESULT fr = f_sync(&logger->fil);
+    if (fr != FR_OK) {
+        sd_logger_fail(logger, "f_sync", fr);
+        return false;
+    }
+    logger->pending_records = 0;
+    logger->stats.syncs++;
+    return true;
+}
+
+// As gravações mantêm a posição do arquivo no fim dos dados, que dentro da
+// extensão pré-alocada é menor que o tamanho do arquivo
+FSIZE_t sd_logger_size(const sd_logger_t *logger) {
+    if (!logger->open) return 0;
+    return f_tell(&logger->fil) + logger->stage_len;
+}
+
+FSIZE_t sd_logger_zero_left(const sd_logger_t *logger) {
+    if (!logger->open || f_size(&logger->fil) >= logger->extent) return 0;
+    return logger->extent - f_size(&logger->fil);
+}
+
+FSIZE_t sd_logger_prealloc_left(const sd_logger_t *logger) {
+    FSIZE_t used = sd_logger_size(logger);
+    if (!logger->open || used >= logger->extent) return 0;
+    return logger->extent - used;
+}
+
+bool sd_logger_read(sd_logger_t *logger, FSIZE_t offset, void *dst, size_t len) {
+    // O que ainda está no buffer de preparo precisa ir para o arquivo antes
+    if (!sd_logger_write_stage(logger, logger->stage_len)) return false;
+    if (!logger->open) return false;
+
+    FSIZE_t end = f_tell(&logger->fil);
+    UINT read = 0;
+    FRESULT fr = f_lseek(&logger->fil, offset);
+    if (fr == FR_OK) fr = f_read(&logger->fil, dst, len, &read);
+    // Volta ao fim: as próximas gravações continuam sendo adições
+    FRESULT fr_end = f_lseek(&logger->fil, end);
+    if (fr != FR_OK || fr_end != FR_OK) {
+        sd_logger_fail(logger, "f_read", fr != FR_OK ? fr : fr_end);
+        return false;
+    }
+    return read == len;
+}
+
+bool sd_logger_truncate(sd_logger_t *logger, FSIZE_t size) {
+    if (!sd_logger_write_stage(logger, logger->stage_len)) return false;
+    if (!logger->open) return false;
+
+    FRESULT fr;
+    FSIZE_t end = f_tell(&logger->fil);
+    if (logger->extent && size <= end && end < f_size(&logger->fil) && f_size(&logger->fil) <= logger->extent) {
+        // Dentro da parte já zerada da extensão, o trecho cortado volta a ser
+        // zeros; no fim do arquivo ele é cortado, e a zeragem retoma dali
+        fr = f_lseek(&logger->fil, size);
+        if (fr == FR_OK) fr = write_zeros(&logger->fil, end - size);
+        if (fr == FR_OK) fr = f_lseek(&logger->fil, size);
+    } else {
+        fr = f_lseek(&logger->fil, size);
+        if (fr == FR_OK) fr = f_truncate(&logger->fil);
+    }
+    if (fr == FR_OK) fr = f_sync(&logger->fil);
+    if (fr != FR_OK) {
+        sd_logger_fail(logger, "f_truncate", fr);
+        return false;
+    }
+    return true;
+}
+
+void sd_logger_close(sd_logger_t *logger) {
+    if (logger->open) sd_logger_sync(logger);
+    if (logger->open) {
+        f_close(&logger->fil);
+        logger->open = false;
+    }
+    if (logger->mounted) {
+        f_unmount(logger->config.drive);
+        logger->mounted = false;
+    }
+}
@@ -0,0 +1,163 @@
+/**
+ * @file sd_logger.h
+ *
+ * Motor de log persistente para o cartão SD.
+ *
+ * O volume é montado uma única vez e o arquivo de log fica aberto durante
+ * toda a eleição. Os registros são acumulados em um buffer de preparo na RAM
+ * e gravados no cartão em setores inteiros (512 bytes), de modo que cada
+ * setor de log custa uma única escrita no SD.
+ *
+ * A política de durabilidade é configurável: o buffer pode ser descarregado
+ * (com f_sync) a cada N registros, a cada T milissegundos ou apenas quando
+ * sd_logger_sync() for chamada explicitamente.
+ *
+ * Com prealloc_size, um arquivo novo recebe uma extensão contígua (f_expand)
+ * que é zerada à frente dos dados e, depois, usada com a tabela de fragmentos
+ * do FatFs (fast seek): gravar e reler não percorrem a cadeia de clusters,
+ * então o custo de um registro não cresce com o log. O tamanho do arquivo
+ * passa a ser o da extensão; o fim dos dados é o primeiro registro todo
+ * zerado, achado por busca binária ao reabrir. Quando a extensão acaba, o
+ * arquivo volta a crescer normalmente.
+ *
+ * A abertura não zera a extensão: cada sd_logger_poll zera no máximo
+ * SD_LOGGER_ZERO_SECTORS setores, depois do gatilho por tempo, e os registros
+ * continuam sendo gravados enquanto isso. O tamanho do arquivo marca até onde
+ * a extensão já foi zerada, então um reinício no meio retoma dali. O tempo
+ * total sai no console.
+ */
+
+#ifndef SD_LOGGER_H
+#define SD_LOGGER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pico/time.h"
+#include "ff.h"
+
+// Tamanho do setor do cartão SD (FF_MAX_SS)
+#define SD_LOGGER_SECTOR_SIZE 512
+
+// Entradas da tabela de fragmentos (fast seek): 2 por fragmento + 2
+#define SD_LOGGER_CLMT_LEN 16
+
+// Quantidade de setores mantidos no buffer de preparo
+#ifndef SD_LOGGER_STAGE_SECTORS
+#define SD_LOGGER_STAGE_SECTORS 4
+#endif
+
+#define SD_LOGGER_STAGE_SIZE (SD_LOGGER_STAGE_SECTORS * SD_LOGGER_SECTOR_SIZE)
+
+// Setores da extensão zerados a cada sd_logger_poll
+#ifndef SD_LOGGER_ZERO_SECTORS
+#define SD_LOGGER_ZERO_SECTORS 8
+#endif
+
+/**
+ * @brief Configuração do logger e da política de durabilidade.
+ *
+ * Um valor 0 em flush_every_records ou flush_every_ms desativa o respectivo
+ * gatilho. Com ambos em 0 os dados parciais só vão para o cartão quando
+ * sd_logger_sync() é chamada (ou quando um setor inteiro fica pronto).
+ */
+typedef struct {
+    const char *drive;            // Unidade FatFs, ex.: "0:"
+    const char *path;             // Arquivo de log, ex.: "0:auditoria.txt"
+    uint32_t flush_every_records; // Sincroniza a cada N registros
+    uint32_t flush_every_ms;      // Sincroniza a cada T ms com dados pendentes
+    FSIZE_t prealloc_size;        // Extensão de um arquivo novo (0 desativa)
+    size_t record_size;           // Registros de tamanho fixo, nunca todos zero
+} sd_logger_config_t;
+
+/**
+ * @brief Contadores de diagnóstico do logger.
+ */
+typedef struct {
+    uint32_t records;        // Registros aceitos
+    uint32_t bytes;          // Bytes aceitos
+    uint32_t sector_flushes; // Descargas de setores inteiros
+    uint32_t syncs;          // Descargas parciais + f_sync
+    uint32_t errors;         // Falhas do FatFs
+} sd_logger_stats_t;
+
+typedef struct {
+    sd_logger_config_t config;
+    FATFS fs;
+    FIL fil;
+    bool mounted;
+    bool open;
+    FSIZE_t extent;             // Extensão pré-alocada (0 se não há)
+    DWORD clmt[SD_LOGGER_CLMT_LEN]; // Tabela de fragmentos do arquivo
+    absolute_time_t zero_start; // Início da zeragem da extensão
+
+    // Buffer de preparo: sempre descarregado em setores inteiros
+    uint8_t stage[SD_LOGGER_STAGE_SIZE] __attribute__((aligned(4)));
+    size_t stage_len;
+
+    uint32_t pending_records;   // Registros ainda não sincronizados
+    absolute_time_t first_pending; // Instante do registro pendente mais antigo
+
+    sd_logger_stats_t stats;
+} sd_logger_t;
+
+/**
+ * @brief Monta o volume e abre (ou cria) o arquivo de log para adição.
+ * @return true se o logger está pronto para receber registros.
+ */
+bool sd_logger_open(sd_logger_t *logger, const sd_logger_config_t *config);
+
+/**
+ * @brief Adiciona um registro ao buffer de preparo.
+ *
+ * Setores completos são gravados imediatamente; o restante aguarda a
+ * política de durabilidade.
+ */
+bool sd_logger_append(sd_logger_t *logger, const void *data, size_t len);
+
+/**
+ * @brief Verifica o gatilho por tempo e zera mais um trecho da extensão
+ * pré-alocada. Deve ser chamada no loop principal.
+ */
+bool sd_logger_poll(sd_logger_t *logger);
+
+/**
+ * @brief Grava todo o conteúdo pendente e sincroniza o arquivo (f_sync).
+ */
+bool sd_logger_sync(sd_logger_t *logger);
+
+/**
+ * @brief Tamanho do log, incluindo o que ainda está no buffer de preparo.
+ */
+FSIZE_t sd_logger_size(const sd_logger_t *logger);
+
+/**
+ * @brief Espaço pré-alocado ainda livre (0 sem pré-alocação ou se esgotado).
+ */
+FSIZE_t sd_logger_prealloc_left(const sd_logger_t *logger);
+
+/**
+ * @brief Parte da extensão pré-alocada que ainda falta zerar (0 quando
+ * pronta). Enquanto não é 0, o loop principal não deve dormir entre as
+ * chamadas de sd_logger_poll.
+ */
+FSIZE_t sd_logger_zero_left(const sd_logger_t *logger);
+
+/**
+ * @brief Relê um trecho do log (ex.: o último registro, após reiniciar).
+ * Grava antes o buffer de preparo, então não deve ser usada a cada registro.
+ */
+bool sd_logger_read(sd_logger_t *logger, FSIZE_t offset, void *dst, size_t len);
+
+/**
+ * @brief Corta o log no tamanho indicado (ex.: registro incompleto no fim).
+ */
+bool sd_logger_truncate(sd_logger_t *logger, FSIZE_t size);
+
+/**
+ * @brief Sincroniza, fecha o arquivo e desmonta o volume.
+ */
+void sd_logger_close(sd_logger_t *logger);
+
+#endif // SD_LOGGER_H
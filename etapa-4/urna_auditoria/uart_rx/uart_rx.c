@@ -0,0 +1,167 @@
+#include <string.h>
+
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+
+#include "uart_rx.h"
+
+#define RING_MASK (UART_RX_RING_SIZE - 1)
+#define QUEUE_MASK (UART_RX_QUEUE_LEN - 1)
+
+_Static_assert(UART_RX_RING_BITS <= 15, "O modo ring do DMA aceita no maximo 32 KiB");
+_Static_assert((UART_RX_QUEUE_LEN & QUEUE_MASK) == 0, "UART_RX_QUEUE_LEN deve ser potencia de 2");
+
+// Descritor de uma mensagem completa: posição absoluta no fluxo e tamanho
+typedef struct {
+    uint32_t start;
+    uint32_t len;
+} rx_msg_t;
+
+// O endereço precisa estar alinhado ao tamanho para o wrap do DMA
+static uint8_t ring[UART_RX_RING_SIZE] __attribute__((aligned(UART_RX_RING_SIZE)));
+static int dma_chan = -1;
+static volatile uint32_t laps; // Voltas completas do DMA no buffer circular
+
+static rx_msg_t queue[UART_RX_QUEUE_LEN];
+static volatile uint32_t q_head; // Escrito apenas pelo produtor (timer)
+static volatile uint32_t q_tail; // Escrito apenas pelo consumidor (loop)
+
+// Estado do produtor, usado apenas dentro da interrupção do timer
+static uint8_t rx_delim;
+static uint32_t scan_pos;   // Próximo byte ainda não varrido
+static uint32_t line_start; // Início da mensagem em montagem
+static repeating_timer_t scan_timer;
+
+static uart_rx_stats_t stats;
+
+// Posição absoluta (bytes recebidos desde o início) do DMA no fluxo
+static uint32_t dma_position(void) {
+    uint32_t l, remaining;
+    do {
+        l = laps;
+        remaining = dma_channel_hw_addr(dma_chan)->transfer_count;
+    } while (l != laps);
+    return l * UART_RX_RING_SIZE + (UART_RX_RING_SIZE - remaining);
+}
+
+// Ao fim de cada volta o canal é religado; o endereço de escrita continua
+// dando a volta no buffer, então nenhum byte muda de lugar
+static void uart_rx_dma_irq(void) {
+    if (dma_channel_get_irq1_status(dma_chan)) {
+        dma_channel_acknowledge_irq1(dma_chan);
+        laps++;
+        dma_channel_set_trans_count(dma_chan, UART_RX_RING_SIZE, true);
+    }
+}
+
+static void publish(uint32_t start, uint32_t len) {
+    if (len == 0) return; // Mensagens vazias são ignoradas
+    uint32_t used = q_head - q_tail;
+    if (used == UART_RX_QUEUE_LEN) {
+        stats.queue_full++;
+        return;
+    }
+    queue[q_head & QUEUE_MASK] = (rx_msg_t){start, len};
+    __dmb(); // O descritor precisa estar visível antes do novo head
+    q_head++;
+    stats.messages++;
+    if (used + 1 > stats.max_queued) stats.max_queued = used + 1;
+}
+
+// Varre somente os bytes que chegaram desde a última chamada
+static bool scan_ring(repeating_timer_t *t) {
+    uint32_t end = dma_position();
+
+    // A mensagem em montagem foi sobrescrita: descarta e recomeça no fim
+    if (end - line_start > UART_RX_RING_SIZE) {
+        stats.overruns++;
+        scan_pos = line_start = end;
+        return true;
+    }
+
+    while (scan_pos != end) {
+        uint32_t idx = scan_pos & RING_MASK;
+        uint32_t chunk = end - scan_pos;
+        if (chunk > UART_RX_RING_SIZE - idx) chunk = UART_RX_RING_SIZE - idx;
+
+        const uint8_t *hit = memchr(&ring[idx], rx_delim, chunk);
+        if (hit) {
+            uint32_t pos = scan_pos + (uint32_t)(hit - &ring[idx]);
+            scan_pos = pos + 1;
+        } else {
+            scan_pos += chunk;
+        }
+        // Linhas maiores que o limite são quebradas, como no buffer antigo
+        while (scan_pos - line_start > UART_RX_MSG_MAX + (hit ? 1u : 0u)) {
+            publish(line_start, UART_RX_MSG_MAX);
+            line_start += UART_RX_MSG_MAX;
+        }
+        if (hit) {
+            publish(line_start, scan_pos - 1 - line_start);
+            line_start = scan_pos;
+        }
+    }
+    return true;
+}
+
+bool uart_rx_init(uart_inst_t *uart, uint8_t delimiter) {
+    rx_delim = delimiter;
+    laps = 0;
+    scan_pos = line_start = 0;
+    q_head = q_tail = 0;
+    memset(&stats, 0, sizeof(stats));
+
+    dma_chan = dma_claim_unused_channel(false);
+    if (dma_chan < 0) return false;
+
+    dma_channel_config c = dma_channel_get_default_config(dma_chan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_ring(&c, true, UART_RX_RING_BITS); // Wrap no endereço de escrita
+    channel_config_set_dreq(&c, uart_get_dreq(uart, false));
+
+    // DMA_IRQ_1: o driver do SD usa a DMA_IRQ_0 por padrão
+    dma_channel_set_irq1_enabled(dma_chan, true);
+    irq_add_shared_handler(DMA_IRQ_1, uart_rx_dma_irq, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(DMA_IRQ_1, true);
+
+    dma_channel_configure(dma_chan, &c,
+                          ring,                        // write address
+                          &uart_get_hw(uart)->dr,      // read address
+                          UART_RX_RING_SIZE,           // uma volta por disparo
+                          true);                       // start
+
+    return add_repeating_timer_us(-UART_RX_SCAN_PERIOD_US, scan_ring, NULL, &scan_timer);
+}
+
+size_t uart_rx_pop(uint8_t *dst, size_t cap) {
+    while (q_tail != q_head) {
+        __dmb(); // Lê o descritor somente depois de observar o head
+        rx_msg_t msg = queue[q_tail & QUEUE_MASK];
+
+        size_t len = msg.len < cap ? msg.len : cap;
+        uint32_t idx = msg.start & RING_MASK;
+        size_t first = UART_RX_RING_SIZE - idx;
+        if (first > len) first = len;
+        memcpy(dst, &ring[idx], first);
+        memcpy(dst + first, ring, len - first);
+
+        // Se o DMA passou do início da mensagem durante a cópia, ela é inválida
+        bool intact = dma_position() - msg.start <= UART_RX_RING_SIZE;
+        __dmb();
+        q_tail++;
+        if (intact) return len;
+        stats.overruns++;
+    }
+    return 0;
+}
+
+uint32_t uart_rx_queued(void) {
+    return q_head - q_tail;
+}
+
+uart_rx_stats_t uart_rx_get_stats(void) {
+    return stats;
+}
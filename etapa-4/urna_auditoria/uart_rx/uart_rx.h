@@ -0,0 +1,81 @@
+/**
+ * @file uart_rx.h
+ *
+ * Recepção da UART por DMA em buffer circular, com fila de mensagens.
+ *
+ * Um canal de DMA copia continuamente os bytes da FIFO da UART para um buffer
+ * circular (modo "ring" do DMA do RP2040), sem interrupção por byte. Um timer
+ * periódico varre apenas os bytes novos, uma única vez, à procura do
+ * delimitador de mensagem e publica um descritor (início, tamanho) em uma
+ * fila lock-free de produtor único / consumidor único.
+ *
+ * O loop principal consome a fila no seu próprio ritmo: enquanto grava no SD,
+ * as mensagens seguintes continuam acumulando no buffer circular, sem que
+ * nenhuma seja sobrescrita (até o limite de UART_RX_RING_SIZE bytes).
+ */
+
+#ifndef UART_RX_H
+#define UART_RX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hardware/uart.h"
+#include "pico/time.h"
+
+// Buffer circular do DMA: potência de 2 e no máximo 32 KiB (limite do modo ring)
+#ifndef UART_RX_RING_BITS
+#define UART_RX_RING_BITS 14
+#endif
+#define UART_RX_RING_SIZE (1u << UART_RX_RING_BITS)
+
+// Quantidade de mensagens completas que podem aguardar o consumidor
+#ifndef UART_RX_QUEUE_LEN
+#define UART_RX_QUEUE_LEN 256
+#endif
+
+// Tamanho máximo de uma mensagem; linhas maiores são quebradas
+#define UART_RX_MSG_MAX 255
+
+// Período da varredura do buffer circular
+#define UART_RX_SCAN_PERIOD_US 1000
+
+/**
+ * @brief Contadores de diagnóstico da recepção.
+ */
+typedef struct {
+    uint32_t messages;  // Mensagens publicadas na fila
+    uint32_t queue_full; // Mensagens descartadas por fila cheia
+    uint32_t overruns;  // Mensagens sobrescritas pelo DMA antes do consumo
+    uint32_t max_queued; // Maior ocupação observada da fila
+} uart_rx_stats_t;
+
+/**
+ * @brief Inicializa o DMA circular e o timer de varredura.
+ *
+ * A UART já deve estar configurada (uart_init e funções dos pinos).
+ * @param delimiter Byte que encerra cada mensagem (ex.: '\n').
+ */
+bool uart_rx_init(uart_inst_t *uart, uint8_t delimiter);
+
+/**
+ * @brief Retira a mensagem mais antiga da fila.
+ *
+ * O delimitador não é copiado. Se o DMA já tiver sobrescrito a mensagem ela
+ * é descartada, contada em overruns, e a próxima é tentada.
+ * @return Tamanho copiado para dst (0 se a fila está vazia).
+ */
+size_t uart_rx_pop(uint8_t *dst, size_t cap);
+
+/**
+ * @brief Quantidade de mensagens aguardando na fila.
+ */
+uint32_t uart_rx_queued(void);
+
+/**
+ * @brief Cópia dos contadores de diagnóstico.
+ */
+uart_rx_stats_t uart_rx_get_stats(void);
+
+#endif // UART_RX_H
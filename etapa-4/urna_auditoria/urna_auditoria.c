@@ -1,97 +1,108 @@
 #include <stdio.h>
 #include <string.h>
 #include "pico/stdlib.h"
+#include "pico/rand.h"
 #include "hardware/uart.h"
-#include "hardware/irq.h"
 
 // Includes da biblioteca do SD Card
 #include "sd_card.h"
+#include "hw_config.h"
 #include "ff.h"
+#include "sd_logger.h"
+#include "uart_rx.h"
+#include "urna_link.h"
+#include "audit_log.h"
 
 // CONFIGURAÇÕES DE HARDWARE
 // UART para comunicação com a Urna (MCU 1)
 #define UART_ID uart0
 #define UART_TX_PIN 0
 #define UART_RX_PIN 1
-#define BAUD_RATE 115200
 
 // LED de status (LED integrado na placa Pico)
 #define LED_PIN 25
 
+// POLÍTICA DE DURABILIDADE DO LOG
+// Sincroniza o arquivo a cada N registros ou quando o registro mais antigo
+// pendente passar de T ms na RAM (0 desativa o gatilho)
+#define LOG_PATH "auditoria.bin"
+#define LOG_FLUSH_EVERY_RECORDS 16
+#define LOG_FLUSH_EVERY_MS 1000
+// Extensão contígua reservada quando o log é criado: 32768 registros de 64
+// bytes. Depois dela o arquivo cresce normalmente. O arquivo é criado ao
+// abrir o log no boot (ou ao reabrir com um cartão novo), e os 2 MiB são
+// zerados aos poucos pelo sd_logger_poll do loop, sem atrasar a urna; o
+// tempo total sai no console.
+#define LOG_PREALLOC_SIZE (2u * 1024 * 1024)
+
 // VARIÁVEIS GLOBAIS
-char uart_buffer[256];
-volatile int buffer_pos = 0; // 'volatile' pois é modificado na interrupção
-volatile bool new_message_received = false; // Flag para sinalizar que uma nova mensagem chegou
+sd_logger_t logger; // Volume montado e arquivo aberto durante toda a execução
+audit_log_t audit;  // Registros encadeados por hash e apuração do auditor
+urna_link_t link;   // Enlace com a urna: quadros COBS com CRC, ACK e retransmissão
+absolute_time_t led_off_time;
 
 // FUNÇÕES
 
 /**
- * @brief Callback da Interrupção - executado quando a UART recebe dados.
- * Lê os caracteres, monta a mensagem no buffer e sinaliza
- * o loop principal quando uma mensagem completa é recebida.
+ * @brief Monta uma linha de texto (para o console) a partir de um evento.
+ * Mantém apenas os caracteres imprimíveis e termina a linha com '\n'.
+ * @return Tamanho da linha (0 se não sobrou nenhum caractere).
  */
-void on_uart_rx() {
-    while (uart_is_readable(UART_ID)) {
-        char ch = uart_getc(UART_ID);
-
-        // Se recebemos uma nova linha ou o buffer está cheio, a mensagem está completa
-        if (ch == '\n' || buffer_pos >= (sizeof(uart_buffer) - 1)) {
-            if (buffer_pos > 0) { // Garante que não processemos mensagens vazias
-                uart_buffer[buffer_pos] = '\n'; // Garante o caractere de nova linha
-                uart_buffer[buffer_pos + 1] = '\0'; // Adiciona o terminador nulo
-                new_message_received = true; // Sinaliza para o loop principal
-            }
-            buffer_pos = 0; // Reseta para a próxima mensagem
-        } else if (ch >= ' ' && ch <= '~') { // Aceita apenas caracteres imprimíveis
-            uart_buffer[buffer_pos++] = ch;
+size_t format_log_line(char *line, const uint8_t *msg, size_t len) {
+    size_t pos = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (msg[i] >= ' ' && msg[i] <= '~') { // Aceita apenas caracteres imprimíveis
+            line[pos++] = (char)msg[i];
         }
     }
+    if (pos == 0) return 0;
+    line[pos++] = '\n';
+    line[pos] = '\0';
+    return pos;
 }
 
 /**
- * @brief Grava uma string de dados no arquivo de log "auditoria.txt" no cartão SD.
- * * @param data A string de dados a ser gravada.
+ * @brief Registra um evento da urna no log "auditoria.bin" do cartão SD.
+ * A gravação física acontece em setores inteiros, conforme a política
+ * de durabilidade configurada em LOG_FLUSH_EVERY_RECORDS / LOG_FLUSH_EVERY_MS.
+ * * @param event O texto do evento (ex.: "VOTO;0;12").
  */
-void log_to_sd_card(const char* data) {
-    printf("Gravando no SD Card: %s", data);
-    
-    FRESULT fr;
-    FATFS fs;
-    FIL fil;
-
-    // Monta o drive do SD Card
-    fr = f_mount(&fs, "0:", 1);
-    if (fr != FR_OK) {
-        printf("ERRO: Nao foi possivel montar o filesystem (%d)\n", fr);
-        return;
+void log_to_sd_card(const uint8_t *event, size_t len) {
+    char line[URNA_LINK_MAX_PAYLOAD + 2];
+    if (format_log_line(line, event, len) > 0) {
+        printf("Gravando no SD Card: %s", line);
     }
 
-    // Abre o arquivo para ADICIONAR ao final (append)
-    fr = f_open(&fil, "auditoria.txt", FA_WRITE | FA_OPEN_APPEND | FA_CREATE_ALWAYS);
-    if (fr != FR_OK) {
-        printf("ERRO: Nao foi possivel abrir o arquivo 'auditoria.txt' (%d)\n", fr);
-        f_unmount("0:");
+    uint32_t flushes = logger.stats.sector_flushes + logger.stats.syncs;
+    if (!audit_log_event(&audit, event, len)) {
+        printf("ERRO: Nao foi possivel escrever no arquivo.\n");
         return;
     }
-
-    // Escreve os dados no arquivo
-    if (f_printf(&fil, "%s", data) < 0) {
-        printf("ERRO: Nao foi possivel escrever no arquivo.\n");
-    } else {
-        printf("Gravado com sucesso!\n");
-        gpio_put(LED_PIN, 1); // Pisca o LED para indicar sucesso
-        sleep_ms(100);
-        gpio_put(LED_PIN, 0);
+    // Acende o LED quando algo chegou de fato ao cartão; o loop apaga depois
+    if (logger.stats.sector_flushes + logger.stats.syncs != flushes) {
+        gpio_put(LED_PIN, 1);
+        led_off_time = make_timeout_time_ms(100);
     }
+}
 
-    // Fecha o arquivo (essencial para salvar os dados!)
-    fr = f_close(&fil);
-    if (fr != FR_OK) {
-        printf("ERRO: Nao foi possivel fechar o arquivo (%d)\n", fr);
-    }
-    
-    // Desmonta o drive
-    f_unmount("0:");
+// Funções de acesso à UART usadas pelo enlace
+static void link_write(void *ctx, const uint8_t *data, size_t len) {
+    uart_write_blocking(UART_ID, data, len);
+}
+
+static void link_set_baud(void *ctx, uint32_t baud) {
+    uart_tx_wait_blocking(UART_ID); // O BAUD_ACK sai inteiro na taxa antiga
+    uart_set_baudrate(UART_ID, baud);
+    printf("Enlace com a urna a %u baud\n", (unsigned)baud);
+}
+
+static uint32_t link_now_ms(void *ctx) {
+    return to_ms_since_boot(get_absolute_time());
+}
+
+// Cada quadro de dados confirmado pelo enlace vira um registro do log
+static void link_deliver(void *ctx, const uint8_t *payload, size_t len) {
+    if (len > 0) log_to_sd_card(payload, len);
 }
 
 int main() {
@@ -101,13 +112,15 @@ int main() {
     gpio_init(LED_PIN);
     gpio_set_dir(LED_PIN, GPIO_OUT);
     
-    // Inicializa a UART e suas interrupções
-    uart_init(UART_ID, BAUD_RATE);
+    // Inicializa a UART; a recepção é feita por DMA em um buffer circular e
+    // cada mensagem da fila é um quadro do enlace, delimitado por 0x00
+    uart_init(UART_ID, URNA_LINK_BASE_BAUD);
     gpio_set_function(UART_TX_PIN, GPIO_FUNC_UART);
     gpio_set_function(UART_RX_PIN, GPIO_FUNC_UART);
-    irq_set_exclusive_handler(UART0_IRQ, on_uart_rx);
-    irq_set_enabled(UART0_IRQ, true);
-    uart_set_irq_enables(UART_ID, true, false); // Habilita interrupção apenas para RX
+    if (!uart_rx_init(UART_ID, 0x00)) {
+        printf("ERRO FATAL: Nao foi possivel iniciar a recepcao da UART por DMA.\n");
+        while (true) tight_loop_contents();
+    }
     
     printf("Firmware do Logger (MCU 2) iniciado.\n");
     printf("Inicializando SD Card...\n");
@@ -120,17 +133,61 @@ int main() {
             gpio_put(LED_PIN, 0); sleep_ms(100);
         }
     }
-    printf("Driver do SD Card OK. Aguardando dados da urna...\n");
+    printf("Driver do SD Card OK.\n");
+
+    const sd_logger_config_t log_config = {
+        .drive = "0:",
+        .path = LOG_PATH,
+        .flush_every_records = LOG_FLUSH_EVERY_RECORDS,
+        .flush_every_ms = LOG_FLUSH_EVERY_MS,
+        .prealloc_size = LOG_PREALLOC_SIZE,
+        .record_size = AUDIT_RECORD_SIZE,
+    };
+    // A cadeia de hashes continua a partir do fim do arquivo existente;
+    // sem cartão, audit_log_open fica pendente e é refeita no próximo evento
+    bool log_ok = sd_logger_open(&logger, &log_config);
+    if (!audit_log_open(&audit, &logger) || !log_ok) {
+        // O logger tenta reabrir o arquivo a cada nova mensagem
+        printf("AVISO: Log indisponivel, nova tentativa na proxima mensagem.\n");
+    }
+    if (logger.extent) {
+        printf("Log: espaco pre-alocado para mais %lu registros\n",
+               (unsigned long)(sd_logger_prealloc_left(&logger) / AUDIT_RECORD_SIZE));
+    }
+    // Velocidade do SPI negociada pelo driver ao inicializar o cartão
+    const sd_speed_t *speed = sd_get_speed(sd_get_by_num(0));
+    if (speed) {
+        printf("SD Card a %.1f MHz, leitura a %lu kB/s\n", speed->baud_rate / 1e6,
+               (unsigned long)(speed->read_Bps / 1000));
+    }
+
+    // A urna propõe a velocidade; o auditor apenas aceita e acompanha
+    const urna_link_io_t link_io = {
+        .write = link_write,
+        .set_baud = link_set_baud,
+        .now_ms = link_now_ms,
+        .deliver = link_deliver,
+    };
+    urna_link_init(&link, &link_io, get_rand_32());
+    printf("Aguardando dados da urna...\n");
     
+    uint8_t msg[UART_RX_MSG_MAX];
     while(true) {
-        // O loop principal apenas verifica se a interrupção sinalizou uma nova mensagem
-        if (new_message_received) {
-            log_to_sd_card(uart_buffer);
-            new_message_received = false; // Reseta a flag para aguardar a próxima
+        // Esvazia a fila de quadros completos; enquanto o SD grava, o DMA
+        // continua recebendo os próximos no buffer circular
+        size_t len;
+        while ((len = uart_rx_pop(msg, sizeof(msg))) > 0) {
+            urna_link_rx_frame(&link, msg, len);
         }
-        // O microcontrolador "dorme" aqui até a próxima interrupção (UART ou outra)
-        // para economizar energia.
-        __wfi(); // Wait For Interrupt
+        // ACKs pendentes, retransmissões e a volta à taxa base se a urna sumir
+        urna_link_poll(&link);
+        // Descarrega o log se a linha pendente mais antiga passou do prazo,
+        // e zera mais um trecho da extensão pré-alocada
+        sd_logger_poll(&logger);
+        if (time_reached(led_off_time)) gpio_put(LED_PIN, 0);
+        // O microcontrolador "dorme" aqui até a próxima interrupção (timer da UART ou outra)
+        // para economizar energia. Enquanto a extensão não está toda zerada, segue direto.
+        if (sd_logger_zero_left(&logger) == 0) __wfi(); // Wait For Interrupt
     }
     
     return 0;
@@ -0,0 +1,129 @@
+#include <stdarg.h>
+#include <stdio.h>
+
+#include "pico/stdlib.h"
+#include "pico/rand.h"
+#include "pico/cyw43_arch.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "hardware/uart.h"
+
+#include "auditoria_link.h"
+#include "urna_link.h"
+
+// UART para comunicação com o auditor (MCU 2)
+#define UART_ID uart0
+#define UART_IRQ UART0_IRQ
+#define UART_TX_PIN 0
+#define UART_RX_PIN 1
+
+// Taxas tentadas na negociação, da maior para a menor
+static const uint32_t link_rates[] = {3000000, 2000000, 1000000};
+
+// Bytes recebidos na interrupção (só ACKs e controle, por isso é pequeno)
+#define RX_RING_SIZE 256
+#define RX_RING_MASK (RX_RING_SIZE - 1)
+
+static uint8_t rx_ring[RX_RING_SIZE];
+static volatile uint32_t rx_head; // Escrito apenas pela interrupção
+static volatile uint32_t rx_tail; // Escrito apenas pelo loop principal
+
+typedef struct {
+    uint8_t len;
+    char text[AUDITORIA_LINK_EVENT_MAX];
+} event_t;
+
+// Eventos vêm do loop principal (teclas, votos) e dos handlers HTTP, que
+// rodam na interrupção do lwIP: quem enfileira trava o lwIP
+static event_t events[AUDITORIA_LINK_QUEUE_LEN];
+static volatile uint32_t ev_head; // Escrito com o lwIP travado
+static volatile uint32_t ev_tail; // Escrito apenas pelo loop principal
+
+static urna_link_t link;
+
+static void on_uart_rx(void) {
+    while (uart_is_readable(UART_ID)) {
+        uint8_t b = uart_getc(UART_ID);
+        if (rx_head - rx_tail < RX_RING_SIZE) {
+            rx_ring[rx_head & RX_RING_MASK] = b;
+            rx_head++;
+        }
+    }
+}
+
+static void link_write(void *ctx, const uint8_t *data, size_t len) {
+    uart_write_blocking(UART_ID, data, len);
+}
+
+static void link_set_baud(void *ctx, uint32_t baud) {
+    uart_tx_wait_blocking(UART_ID); // O último quadro sai inteiro na taxa antiga
+    uart_set_baudrate(UART_ID, baud);
+    printf("Enlace com o auditor a %u baud\n", (unsigned)baud);
+}
+
+static uint32_t link_now_ms(void *ctx) {
+    return to_ms_since_boot(get_absolute_time());
+}
+
+void auditoria_link_init(void) {
+    uart_init(UART_ID, URNA_LINK_BASE_BAUD);
+    gpio_set_function(UART_TX_PIN, GPIO_FUNC_UART);
+    gpio_set_function(UART_RX_PIN, GPIO_FUNC_UART);
+    uart_set_fifo_enabled(UART_ID, true);
+
+    irq_set_exclusive_handler(UART_IRQ, on_uart_rx);
+    irq_set_enabled(UART_IRQ, true);
+    uart_set_irq_enables(UART_ID, true, false);
+
+    const urna_link_io_t io = {
+        .write = link_write,
+        .set_baud = link_set_baud,
+        .now_ms = link_now_ms,
+        .deliver = NULL, // O auditor não envia dados para a urna
+    };
+    urna_link_init(&link, &io, get_rand_32());
+    urna_link_negotiate_baud(&link, link_rates, sizeof(link_rates) / sizeof(link_rates[0]));
+}
+
+bool auditoria_link_event(const char *fmt, ...) {
+    cyw43_arch_lwip_begin();
+    if (ev_head - ev_tail == AUDITORIA_LINK_QUEUE_LEN) {
+        cyw43_arch_lwip_end();
+        printf("AVISO: Fila de eventos do auditor cheia\n");
+        return false;
+    }
+    event_t *ev = &events[ev_head % AUDITORIA_LINK_QUEUE_LEN];
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(ev->text, sizeof(ev->text), fmt, args);
+    va_end(args);
+    if (n >= 0) {
+        ev->len = (uint8_t)(n < (int)sizeof(ev->text) ? n : (int)sizeof(ev->text) - 1);
+        __dmb(); // O evento precisa estar completo antes do novo head
+        ev_head++;
+    }
+    cyw43_arch_lwip_end();
+    return n >= 0;
+}
+
+void auditoria_link_poll(void) {
+    // Bytes recebidos desde a última chamada, em no máximo dois trechos
+    uint32_t head = rx_head;
+    while (rx_tail != head) {
+        uint32_t idx = rx_tail & RX_RING_MASK;
+        uint32_t chunk = head - rx_tail;
+        if (chunk > RX_RING_SIZE - idx) chunk = RX_RING_SIZE - idx;
+        urna_link_rx_bytes(&link, &rx_ring[idx], chunk);
+        rx_tail += chunk;
+    }
+
+    // Passa para o enlace tantos eventos quanto a janela aceitar
+    while (ev_tail != ev_head && urna_link_tx_free(&link) > 0) {
+        __dmb(); // Lê o evento somente depois de observar o head
+        event_t *ev = &events[ev_tail % AUDITORIA_LINK_QUEUE_LEN];
+        urna_link_send(&link, ev->text, ev->len);
+        ev_tail++;
+    }
+
+    urna_link_poll(&link);
+}
@@ -0,0 +1,41 @@
+/**
+ * @file auditoria_link.h
+ *
+ * Envio dos eventos da urna para o auditor (MCU 2) pela UART.
+ *
+ * Usa o protocolo de enlace compartilhado (urna_link): cada evento vira um
+ * quadro DATA com CRC, confirmado pelo auditor e retransmitido se necessário.
+ * Os eventos ficam em uma fila local enquanto a janela do enlace está cheia,
+ * para que a lógica da urna nunca espere pela UART.
+ */
+
+#ifndef AUDITORIA_LINK_H
+#define AUDITORIA_LINK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Eventos que podem aguardar na fila local até o enlace liberar espaço
+#define AUDITORIA_LINK_QUEUE_LEN 16
+#define AUDITORIA_LINK_EVENT_MAX 64
+
+/**
+ * @brief Configura a UART, o enlace e inicia a negociação de velocidade.
+ */
+void auditoria_link_init(void);
+
+/**
+ * @brief Enfileira um evento de texto (formato printf) para o auditor.
+ * Pode ser chamada no loop principal e nos callbacks do lwIP (trava o lwIP
+ * sozinha).
+ * @return false se a fila local está cheia (o evento é perdido).
+ */
+bool auditoria_link_event(const char *fmt, ...);
+
+/**
+ * @brief Processa bytes recebidos, temporizadores e a fila de eventos.
+ * Deve ser chamada no loop principal.
+ */
+void auditoria_link_poll(void);
+
+#endif // AUDITORIA_LINK_H
@@ -0,0 +1,111 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "ballot.h"
+
+void ballot_clear(ballot_t *b) {
+    b->num_offices = 0;
+    b->num_candidates = 0;
+    memset(b->tally, 0, sizeof(b->tally));
+    candidate_index_clear(&b->index);
+    b->generation++;
+}
+
+bool ballot_add_office(ballot_t *b, const char *name) {
+    if (b->num_offices == BALLOT_OFFICES_MAX) return false;
+    ballot_office_t *office = &b->offices[b->num_offices];
+    // Sem restos de cargas anteriores depois do '\0': a cédula é gravada byte a byte
+    memset(office, 0, sizeof(*office));
+    snprintf(office->name, sizeof(office->name), "%s", name);
+    office->first = b->num_candidates;
+    // Os cargos anteriores ocupam os seus candidatos e dois contadores cada
+    office->tally = (uint16_t)(b->num_candidates + 2 * b->num_offices);
+    b->num_offices++;
+    return true;
+}
+
+bool ballot_add_candidate(ballot_t *b, const char *number, const char *name) {
+    if (b->num_offices == 0 || b->num_candidates == BALLOT_CANDIDATES_MAX) return false;
+    ballot_office_t *office = &b->offices[b->num_offices - 1];
+    // O primeiro candidato fixa os dígitos do cargo. Um número mais curto
+    // nunca seria digitado inteiro, e um mais longo esconderia os demais
+    uint8_t digits = (uint8_t)strlen(number);
+    if (office->digits && digits != office->digits) return false;
+    uint32_t key = candidate_index_key(b->num_offices - 1, number);
+    if (!candidate_index_add(&b->index, key, b->num_candidates)) return false;
+
+    // O candidato fica completo antes de contar: o laço principal lê a tabela
+    ballot_candidate_t *c = &b->candidates[b->num_candidates];
+    memset(c, 0, sizeof(*c));
+    snprintf(c->number, sizeof(c->number), "%s", number);
+    snprintf(c->name, sizeof(c->name), "%s", name);
+    b->num_candidates++;
+    office->count++;
+    office->digits = digits;
+    return true;
+}
+
+void ballot_reset_tally(ballot_t *b) {
+    memset(b->tally, 0, sizeof(b->tally));
+}
+
+void ballot_session_begin(const ballot_t *b, ballot_session_t *s) {
+    memset(s, 0, sizeof(*s));
+    s->generation = b->generation;
+    s->candidate = -1;
+}
+
+bool ballot_session_digit(const ballot_t *b, ballot_session_t *s, char digit) {
+    if (digit < '0' || digit > '9' || s->office >= b->num_offices) return false;
+    uint8_t digits = ballot_office_digits(&b->offices[s->office]);
+    if (s->typed >= digits) return false;
+    s->number[s->typed++] = digit;
+    s->number[s->typed] = '\0';
+    if (s->typed == digits) {
+        s->candidate = candidate_index_find(&b->index, candidate_index_key(s->office, s->number));
+    }
+    return true;
+}
+
+bool ballot_session_complete(const ballot_t *b, const ballot_session_t *s) {
+    return s->office < b->num_offices && s->typed == ballot_office_digits(&b->offices[s->office]);
+}
+
+void ballot_session_correct(ballot_session_t *s) {
+    s->typed = 0;
+    s->candidate = -1;
+    memset(s->number, 0, sizeof(s->number));
+}
+
+// Guarda a escolha do cargo em votação e passa para o próximo
+static void choose(ballot_session_t *s, uint16_t slot) {
+    s->slots[s->office] = slot;
+    memcpy(s->numbers[s->office], s->number, sizeof(s->number));
+    s->office++;
+    ballot_session_correct(s);
+}
+
+bool ballot_session_blank(const ballot_t *b, ballot_session_t *s) {
+    if (s->office >= b->num_offices || s->typed != 0) return false;
+    choose(s, ballot_blank_slot(&b->offices[s->office]));
+    return true;
+}
+
+bool ballot_session_confirm(const ballot_t *b, ballot_session_t *s) {
+    if (!ballot_session_complete(b, s)) return false;
+    const ballot_office_t *office = &b->offices[s->office];
+    // O índice só devolve candidatos do próprio cargo
+    choose(s, s->candidate >= 0 ? (uint16_t)(office->tally + (s->candidate - office->first))
+                                : ballot_null_slot(office));
+    return true;
+}
+
+bool ballot_session_done(const ballot_t *b, const ballot_session_t *s) {
+    return s->office >= b->num_offices;
+}
+
+bool ballot_commit(ballot_t *b, const ballot_session_t *s) {
+    if (s->generation != b->generation || s->office != b->num_offices) return false;
+    for (int i = 0; i < b->num_offices; i++) b->tally[s->slots[i]]++;
+    return true;
+}
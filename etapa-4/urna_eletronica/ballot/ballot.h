@@ -0,0 +1,160 @@
+/**
+ * @file ballot.h
+ *
+ * Cédula com vários cargos (vereador, prefeito, ...) e a apuração deles.
+ *
+ * Cada cargo tem a sua quantidade de dígitos (a do número do primeiro
+ * candidato, que vale para todos os outros), os seus candidatos e os seus
+ * votos brancos e nulos. Os candidatos ficam em uma tabela só, na ordem dos
+ * cargos, e os contadores também: os de um cargo são contíguos (um por
+ * candidato, depois o branco e o nulo), e os cargos vêm um depois do outro.
+ * Quem publica a apuração percorre tally[] uma vez, do começo ao fim.
+ *
+ * O eleitor vota cargo a cargo em uma sessão (ballot_session_t), que só
+ * guarda as escolhas; os contadores mudam todos juntos em ballot_commit,
+ * quando o último cargo é confirmado. Uma sessão interrompida não deixa
+ * voto pela metade.
+ *
+ * O módulo não depende do SDK do Pico nem do lwIP.
+ */
+
+#ifndef BALLOT_H
+#define BALLOT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "candidate_index/candidate_index.h"
+
+#define BALLOT_OFFICES_MAX 8
+#define BALLOT_CANDIDATES_MAX 512    // Somando todos os cargos
+#define BALLOT_NAME_MAX 16           // Nomes de cargo e candidato, com o '\0'
+#define BALLOT_DIGITS_DEFAULT 2      // Dígitos de um cargo sem candidatos
+// Um contador por candidato, mais o branco e o nulo de cada cargo
+#define BALLOT_TALLY_MAX (BALLOT_CANDIDATES_MAX + 2 * BALLOT_OFFICES_MAX)
+
+typedef struct {
+    char name[BALLOT_NAME_MAX];
+    uint8_t digits;             // Dígitos de todo número do cargo (0 sem candidatos)
+    uint16_t first;             // Primeiro candidato do cargo em candidates[]
+    uint16_t count;
+    uint16_t tally;             // Primeiro contador do cargo em tally[]
+} ballot_office_t;
+
+typedef struct {
+    char number[CANDIDATE_INDEX_DIGITS + 1];
+    char name[BALLOT_NAME_MAX];
+} ballot_candidate_t;
+
+typedef struct {
+    ballot_office_t offices[BALLOT_OFFICES_MAX];
+    uint8_t num_offices;
+    ballot_candidate_t candidates[BALLOT_CANDIDATES_MAX];
+    uint16_t num_candidates;
+    uint32_t tally[BALLOT_TALLY_MAX];
+    uint32_t generation;        // Muda a cada carga: sessões de antes não gravam
+    candidate_index_t index;    // Número de cada cargo -> posição em candidates[]
+} ballot_t;
+
+/**
+ * @brief Sessão de um eleitor: o cargo em votação e as escolhas já feitas.
+ */
+typedef struct {
+    uint32_t generation;
+    uint8_t office;             // Cargo em votação; num_offices quando acabou
+    uint8_t typed;              // Dígitos digitados no cargo em votação
+    char number[CANDIDATE_INDEX_DIGITS + 1];
+    int candidate;              // Candidato do número completo, -1 para nulo
+    uint16_t slots[BALLOT_OFFICES_MAX];  // Contador escolhido em cada cargo
+    char numbers[BALLOT_OFFICES_MAX][CANDIDATE_INDEX_DIGITS + 1]; // Vazio no branco
+} ballot_session_t;
+
+/**
+ * @brief Contadores usados em tally[], do primeiro cargo ao último.
+ */
+static inline uint16_t ballot_tally_len(const ballot_t *b) {
+    return (uint16_t)(b->num_candidates + 2 * b->num_offices);
+}
+
+static inline uint16_t ballot_blank_slot(const ballot_office_t *office) {
+    return (uint16_t)(office->tally + office->count);
+}
+
+static inline uint16_t ballot_null_slot(const ballot_office_t *office) {
+    return (uint16_t)(office->tally + office->count + 1);
+}
+
+static inline uint8_t ballot_office_digits(const ballot_office_t *office) {
+    return office->digits ? office->digits : BALLOT_DIGITS_DEFAULT;
+}
+
+/**
+ * @brief Esvazia a cédula (sem cargos) e invalida as sessões em andamento.
+ */
+void ballot_clear(ballot_t *b);
+
+/**
+ * @brief Acrescenta um cargo; os candidatos acrescentados depois são dele.
+ * @return false se já há BALLOT_OFFICES_MAX cargos.
+ */
+bool ballot_add_office(ballot_t *b, const char *name);
+
+/**
+ * @brief Acrescenta um candidato ao último cargo.
+ * @return false sem cargo, com a tabela cheia, com número inválido ou
+ * repetido no cargo, ou com dígitos diferentes dos do primeiro candidato.
+ */
+bool ballot_add_candidate(ballot_t *b, const char *number, const char *name);
+
+/**
+ * @brief Zera todos os contadores.
+ */
+void ballot_reset_tally(ballot_t *b);
+
+/**
+ * @brief Começa a sessão de um eleitor no primeiro cargo.
+ */
+void ballot_session_begin(const ballot_t *b, ballot_session_t *s);
+
+/**
+ * @brief Digita um dígito no cargo em votação; com o número completo, o
+ * candidato é procurado no índice.
+ * @return false se não é dígito ou o número já está completo.
+ */
+bool ballot_session_digit(const ballot_t *b, ballot_session_t *s, char digit);
+
+/**
+ * @brief O número do cargo em votação tem todos os dígitos.
+ */
+bool ballot_session_complete(const ballot_t *b, const ballot_session_t *s);
+
+/**
+ * @brief Apaga o que foi digitado no cargo em votação.
+ */
+void ballot_session_correct(ballot_session_t *s);
+
+/**
+ * @brief Vota em branco no cargo em votação e passa para o próximo.
+ * @return false se algum dígito já foi digitado.
+ */
+bool ballot_session_blank(const ballot_t *b, ballot_session_t *s);
+
+/**
+ * @brief Confirma o número completo (candidato ou nulo) e passa para o
+ * próximo cargo.
+ * @return false se o número não está completo.
+ */
+bool ballot_session_confirm(const ballot_t *b, ballot_session_t *s);
+
+/**
+ * @brief Todos os cargos foram votados.
+ */
+bool ballot_session_done(const ballot_t *b, const ballot_session_t *s);
+
+/**
+ * @brief Conta as escolhas da sessão, todas de uma vez.
+ * @return false se a sessão não acabou ou a cédula mudou no meio dela.
+ */
+bool ballot_commit(ballot_t *b, const ballot_session_t *s);
+
+#endif // BALLOT_H
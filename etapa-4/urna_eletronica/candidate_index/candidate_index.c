@@ -0,0 +1,57 @@
+#include <string.h>
+
+#include "candidate_index.h"
+
+#define SLOT_MASK (CANDIDATE_INDEX_SLOTS - 1)
+// Valor em 17 bits (até 10^5), grupo nos 10 seguintes, dígitos acima
+#define GROUP_SHIFT 17
+#define DIGITS_SHIFT 27
+
+uint32_t candidate_index_key(uint16_t group, const char *number) {
+    if (group >= CANDIDATE_INDEX_GROUPS) return 0;
+    uint32_t value = 0;
+    uint32_t digits = 0;
+    for (; number[digits]; digits++) {
+        char c = number[digits];
+        if (c < '0' || c > '9' || digits == CANDIDATE_INDEX_DIGITS) return 0;
+        value = value * 10 + (uint32_t)(c - '0');
+    }
+    if (digits == 0) return 0;
+    return (digits << DIGITS_SHIFT) | ((uint32_t)group << GROUP_SHIFT) | value;
+}
+
+// Hash multiplicativo; a dobra traz os bits altos (e os dígitos) para a máscara
+static uint32_t slot_of(uint32_t key) {
+    uint32_t h = key * 2654435761u;
+    return (h ^ (h >> 16)) & SLOT_MASK;
+}
+
+void candidate_index_clear(candidate_index_t *index) {
+    memset(index->keys, 0, sizeof(index->keys));
+    index->count = 0;
+}
+
+bool candidate_index_add(candidate_index_t *index, uint32_t key, uint16_t position) {
+    // Metade livre: as sequências de sondagem ficam curtas
+    if (key == 0 || index->count >= CANDIDATE_INDEX_SLOTS / 2) return false;
+    uint32_t slot = slot_of(key);
+    while (index->keys[slot]) {
+        if (index->keys[slot] == key) return false;
+        slot = (slot + 1) & SLOT_MASK;
+    }
+    // Posição antes da chave: uma busca no meio da carga nunca vê a chave sem ela
+    index->positions[slot] = position;
+    index->keys[slot] = key;
+    index->count++;
+    return true;
+}
+
+int candidate_index_find(const candidate_index_t *index, uint32_t key) {
+    if (key == 0) return -1;
+    uint32_t slot = slot_of(key);
+    while (index->keys[slot]) {
+        if (index->keys[slot] == key) return index->positions[slot];
+        slot = (slot + 1) & SLOT_MASK;
+    }
+    return -1;
+}
@@ -0,0 +1,55 @@
+/**
+ * @file candidate_index.h
+ *
+ * Índice dos candidatos pelo número, com busca em tempo constante.
+ *
+ * O número digitado (de 1 a CANDIDATE_INDEX_DIGITS dígitos) vira uma chave
+ * inteira que guarda o valor, a quantidade de dígitos (para que "05" e "5"
+ * sejam candidatos diferentes) e o grupo do número, para que cargos
+ * diferentes possam ter candidatos com o mesmo número. As chaves ficam em uma tabela hash de
+ * endereçamento aberto, com pelo menos o dobro de posições que candidatos:
+ * a busca olha, em média, uma ou duas posições e nunca compara strings.
+ * O índice é montado uma vez, na carga dos candidatos.
+ *
+ * O módulo não depende do SDK do Pico nem do lwIP.
+ */
+
+#ifndef CANDIDATE_INDEX_H
+#define CANDIDATE_INDEX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define CANDIDATE_INDEX_DIGITS 5      // Vereador/deputado: até 5 dígitos
+#define CANDIDATE_INDEX_SLOTS 1024    // Potência de 2, no mínimo 2x os candidatos
+#define CANDIDATE_INDEX_GROUPS 1024   // Grupos (cargos) distintos nas chaves
+
+typedef struct {
+    uint32_t keys[CANDIDATE_INDEX_SLOTS];     // 0 marca posição livre
+    uint16_t positions[CANDIDATE_INDEX_SLOTS];
+    uint16_t count;
+} candidate_index_t;
+
+/**
+ * @brief Chave de um número só com dígitos dentro de um grupo, ou 0 se o
+ * número ou o grupo é inválido.
+ */
+uint32_t candidate_index_key(uint16_t group, const char *number);
+
+/**
+ * @brief Esvazia o índice.
+ */
+void candidate_index_clear(candidate_index_t *index);
+
+/**
+ * @brief Associa a chave à posição do candidato na tabela.
+ * @return false se a chave já existe ou o índice está na lotação máxima.
+ */
+bool candidate_index_add(candidate_index_t *index, uint32_t key, uint16_t position);
+
+/**
+ * @brief Posição do candidato com a chave, ou -1 se não existe.
+ */
+int candidate_index_find(const candidate_index_t *index, uint32_t key);
+
+#endif // CANDIDATE_INDEX_H
@@ -0,0 +1,323 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "pico/cyw43_arch.h"
+#include "lwip/pbuf.h"
+#include "lwip/sys.h"
+#include "lwip/tcp.h"
+
+#include "host_link.h"
+
+// Computador da mesa, com o servidor Flask
+#define HOST_IP "192.168.4.16"
+#define HOST_PORT 8080
+
+#define CONNECT_TIMEOUT_MS 5000     // SYN sem resposta (computador fora da rede)
+#define RESPONSE_TIMEOUT_MS 10000   // Requisição enviada sem resposta
+#define BACKOFF_MIN_MS 250
+#define BACKOFF_MAX_MS 8000
+
+enum { LINK_IDLE, LINK_CONNECTING, LINK_CONNECTED };
+
+// Leitura das respostas, só o necessário para saber onde cada uma termina
+enum { RESP_STATUS, RESP_HEADERS, RESP_BODY, RESP_UNTIL_CLOSE };
+
+typedef struct {
+    uint8_t len;
+    char text[HOST_LINK_EVENT_MAX];
+} event_t;
+
+static event_t events[HOST_LINK_QUEUE_LEN];
+static uint32_t ev_head;        // Próximo evento a enfileirar
+static uint32_t ev_tail;        // Evento mais antigo sem resposta
+static uint32_t in_flight;      // Eventos a partir de ev_tail já escritos na conexão
+
+static struct tcp_pcb *link_pcb;
+static uint8_t link_state = LINK_IDLE;
+static uint32_t link_since;     // sys_now() do connect ou da última resposta
+static uint32_t retry_at;       // sys_now() da próxima tentativa de conexão
+static uint32_t backoff_ms = BACKOFF_MIN_MS;
+// O computador mantém a conexão depois de responder; sem isso não adianta
+// mandar mais de uma requisição por conexão
+static bool host_keep_alive = true;
+// O computador avisou que fecha a conexão depois da última resposta
+static bool link_spent;
+
+static struct {
+    uint8_t state;
+    char line[48];              // Linha corrente (cortada; basta para os campos lidos)
+    uint8_t line_len;
+    int status;
+    bool keep_alive;
+    bool has_length;
+    uint32_t remaining;         // Bytes do corpo ainda por vir
+} resp;
+
+static uint32_t delivered, dropped, reconnects;
+
+static void resp_reset(void) {
+    memset(&resp, 0, sizeof(resp));
+    resp.state = RESP_STATUS;
+}
+
+// Resposta completa: o evento mais antigo foi entregue
+static void on_response(void) {
+    if (resp.status < 200 || resp.status >= 300) {
+        printf("Computador da mesa respondeu %d a um evento\n", resp.status);
+    }
+    host_keep_alive = resp.keep_alive;
+    if (!resp.keep_alive) link_spent = true;
+    if (in_flight > 0) {
+        ev_tail++;
+        in_flight--;
+        delivered++;
+    }
+    backoff_ms = BACKOFF_MIN_MS;
+    link_since = sys_now();
+    resp_reset();
+}
+
+static void resp_line(void) {
+    char *line = resp.line;
+    if (resp.state == RESP_STATUS) {
+        // "HTTP/1.x NNN ...": HTTP/1.1 mantém a conexão por padrão
+        if (strncmp(line, "HTTP/1.", 7) != 0 || strlen(line) < 12) {
+            resp.status = -1;
+        } else {
+            resp.keep_alive = line[7] == '1';
+            resp.status = atoi(line + 9);
+        }
+        resp.state = RESP_HEADERS;
+        return;
+    }
+
+    if (resp.line_len == 0) {
+        // Fim dos cabeçalhos; 1xx não é a resposta final
+        if (resp.status >= 100 && resp.status < 200) {
+            resp_reset();
+        } else if (!resp.has_length) {
+            resp.state = RESP_UNTIL_CLOSE;
+        } else if (resp.remaining == 0) {
+            on_response();
+        } else {
+            resp.state = RESP_BODY;
+        }
+        return;
+    }
+
+    if (strncasecmp(line, "Content-Length:", 15) == 0) {
+        resp.has_length = true;
+        resp.remaining = (uint32_t)strtoul(line + 15, NULL, 10);
+    } else if (strncasecmp(line, "Connection:", 11) == 0) {
+        const char *value = line + 11;
+        while (*value == ' ') value++;
+        if (strncasecmp(value, "close", 5) == 0) resp.keep_alive = false;
+        if (strncasecmp(value, "keep-alive", 10) == 0) resp.keep_alive = true;
+    }
+}
+
+static void resp_feed(const char *data, size_t len) {
+    size_t i = 0;
+    while (i < len) {
+        if (resp.state == RESP_BODY) {
+            size_t n = len - i < resp.remaining ? len - i : resp.remaining;
+            i += n;
+            resp.remaining -= (uint32_t)n;
+            if (resp.remaining == 0) on_response();
+            continue;
+        }
+        if (resp.state == RESP_UNTIL_CLOSE) return; // O corpo termina no FIN
+
+        char c = data[i++];
+        if (c == '\r') continue;
+        if (c == '\n') {
+            resp.line[resp.line_len] = '\0';
+            resp_line();
+            resp.line_len = 0;
+        } else if (resp.line_len < sizeof(resp.line) - 1) {
+            resp.line[resp.line_len++] = c;
+        }
+    }
+}
+
+// Solta a conexão; os eventos sem resposta voltam a ser pendentes
+static err_t link_drop(bool abort) {
+    err_t result = ERR_OK;
+    if (link_pcb) {
+        tcp_arg(link_pcb, NULL);
+        tcp_sent(link_pcb, NULL);
+        tcp_recv(link_pcb, NULL);
+        tcp_err(link_pcb, NULL);
+        if (abort || tcp_close(link_pcb) != ERR_OK) {
+            tcp_abort(link_pcb);
+            result = ERR_ABRT;
+        }
+        link_pcb = NULL;
+    }
+    link_state = LINK_IDLE;
+    in_flight = 0;
+    resp_reset();
+    retry_at = sys_now();
+    return result;
+}
+
+// Depois de uma falha, a próxima conexão espera o dobro da anterior
+static void link_backoff(void) {
+    retry_at = sys_now() + backoff_ms;
+    backoff_ms = backoff_ms * 2 > BACKOFF_MAX_MS ? BACKOFF_MAX_MS : backoff_ms * 2;
+}
+
+// Escreve os eventos pendentes que couberem no pipeline e no buffer do TCP
+static void link_flush(void) {
+    if (link_state != LINK_CONNECTED || link_spent) return;
+    uint32_t limit = host_keep_alive ? HOST_LINK_PIPELINE : 1;
+    bool wrote = false;
+
+    while (in_flight < limit && ev_tail + in_flight != ev_head) {
+        const event_t *ev = &events[(ev_tail + in_flight) % HOST_LINK_QUEUE_LEN];
+        char request[HOST_LINK_EVENT_MAX + 128];
+        int n = snprintf(request, sizeof(request),
+                         "POST /comando HTTP/1.1\r\n"
+                         "Host: " HOST_IP ":%d\r\n"
+                         "Content-Type: application/json\r\n"
+                         "Content-Length: %u\r\n\r\n"
+                         "%.*s",
+                         HOST_PORT, (unsigned)ev->len, ev->len, ev->text);
+        if (n > (int)tcp_sndbuf(link_pcb) || tcp_sndqueuelen(link_pcb) >= TCP_SND_QUEUELEN) break;
+        if (tcp_write(link_pcb, request, (u16_t)n, TCP_WRITE_FLAG_COPY | TCP_WRITE_FLAG_MORE) != ERR_OK) break;
+        if (in_flight == 0) link_since = sys_now();
+        in_flight++;
+        wrote = true;
+    }
+    if (wrote) tcp_output(link_pcb);
+}
+
+static err_t link_sent(void *arg, struct tcp_pcb *pcb, u16_t len) {
+    link_flush();
+    return ERR_OK;
+}
+
+static err_t link_recv(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err) {
+    if (!p) {
+        // Sem Content-Length, a resposta termina no fechamento
+        if (resp.state == RESP_UNTIL_CLOSE) on_response();
+        // Fechar com requisições sem resposta conta como falha
+        bool unanswered = in_flight > 0;
+        err_t result = link_drop(false);
+        if (unanswered) link_backoff();
+        return result;
+    }
+    for (struct pbuf *q = p; q; q = q->next) resp_feed(q->payload, q->len);
+    tcp_recved(pcb, p->tot_len);
+    pbuf_free(p);
+    link_flush();
+    return ERR_OK;
+}
+
+static void link_err(void *arg, err_t err) {
+    printf("Conexao com o computador da mesa caiu: %d\n", err);
+    link_pcb = NULL; // O lwIP já liberou o PCB
+    link_drop(true);
+    link_backoff();
+}
+
+static err_t link_connected(void *arg, struct tcp_pcb *pcb, err_t err) {
+    link_state = LINK_CONNECTED;
+    link_since = sys_now();
+    link_flush();
+    return ERR_OK;
+}
+
+static void link_connect(void) {
+    ip_addr_t addr;
+    ipaddr_aton(HOST_IP, &addr);
+
+    link_pcb = tcp_new();
+    if (!link_pcb) {
+        link_drop(true);
+        link_backoff();
+        return;
+    }
+    tcp_sent(link_pcb, link_sent);
+    tcp_recv(link_pcb, link_recv);
+    tcp_err(link_pcb, link_err);
+    // Um evento por tecla: sem esperar o ACK do anterior para mandar o próximo
+    tcp_nagle_disable(link_pcb);
+
+    link_state = LINK_CONNECTING;
+    link_spent = false;
+    link_since = sys_now();
+    reconnects++;
+    if (tcp_connect(link_pcb, &addr, HOST_PORT, link_connected) != ERR_OK) {
+        link_drop(true);
+        link_backoff();
+    }
+}
+
+bool host_link_event(const char *fmt, ...) {
+    cyw43_arch_lwip_begin();
+    if (ev_head - ev_tail == HOST_LINK_QUEUE_LEN) {
+        dropped++;
+        cyw43_arch_lwip_end();
+        printf("AVISO: Fila de eventos do computador da mesa cheia\n");
+        return false;
+    }
+    event_t *ev = &events[ev_head % HOST_LINK_QUEUE_LEN];
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(ev->text, sizeof(ev->text), fmt, args);
+    va_end(args);
+    if (n < 0) {
+        cyw43_arch_lwip_end();
+        return false;
+    }
+    ev->len = (uint8_t)(n < (int)sizeof(ev->text) ? n : (int)sizeof(ev->text) - 1);
+    ev_head++;
+
+    // Com a conexão aberta o evento sai agora, sem esperar o loop
+    link_flush();
+    cyw43_arch_lwip_end();
+    return true;
+}
+
+void host_link_poll(void) {
+    cyw43_arch_lwip_begin();
+    uint32_t now = sys_now();
+    switch (link_state) {
+    case LINK_IDLE:
+        // A conexão só é aberta quando há o que enviar
+        if (ev_head != ev_tail && (int32_t)(now - retry_at) >= 0) link_connect();
+        break;
+    case LINK_CONNECTING:
+        if (now - link_since >= CONNECT_TIMEOUT_MS) {
+            printf("Computador da mesa nao respondeu a conexao\n");
+            link_drop(true);
+            link_backoff();
+        }
+        break;
+    case LINK_CONNECTED:
+        if (in_flight > 0 && now - link_since >= RESPONSE_TIMEOUT_MS) {
+            printf("Computador da mesa sem resposta, reconectando\n");
+            link_drop(true);
+            link_backoff();
+        } else if (link_spent && in_flight == 0) {
+            link_drop(false); // Não espera o FIN para abrir a próxima
+        } else {
+            link_flush();
+        }
+        break;
+    }
+    cyw43_arch_lwip_end();
+}
+
+void host_link_stats(host_link_stats_t *stats) {
+    stats->pending = (uint16_t)(ev_head - ev_tail);
+    stats->in_flight = (uint16_t)in_flight;
+    stats->connected = link_state == LINK_CONNECTED;
+    stats->delivered = delivered;
+    stats->dropped = dropped;
+    stats->reconnects = reconnects;
+}
@@ -0,0 +1,58 @@
+/**
+ * @file host_link.h
+ *
+ * Envio das teclas e votos para o computador da mesa (servidor Flask).
+ *
+ * Os eventos entram em uma fila local e saem por uma única conexão TCP
+ * persistente, como requisições POST /comando em pipeline: tudo o que se
+ * acumulou enquanto a conexão estava ocupada vai junto, no mesmo segmento.
+ * Um evento só sai da fila quando a resposta dele chega; se a conexão cair
+ * antes disso, ele é reenviado na próxima, na mesma ordem. As reconexões
+ * esperam um intervalo que dobra a cada falha, para não prender a rede da
+ * urna com um computador fora do ar.
+ *
+ * Enfileirar nunca bloqueia: a lógica da urna não espera pela rede, e com a
+ * fila cheia o evento novo é descartado (e contado).
+ */
+
+#ifndef HOST_LINK_H
+#define HOST_LINK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Eventos aguardando resposta do computador, e o maior corpo JSON de um evento
+#define HOST_LINK_QUEUE_LEN 32
+#define HOST_LINK_EVENT_MAX 64
+// Requisições em pipeline na mesma conexão
+#define HOST_LINK_PIPELINE 8
+
+typedef struct {
+    uint16_t pending;           // Eventos na fila, inclusive os em envio
+    uint16_t in_flight;         // Enviados na conexão atual, sem resposta
+    bool connected;
+    uint32_t delivered;         // Eventos respondidos pelo computador
+    uint32_t dropped;           // Descartados com a fila cheia
+    uint32_t reconnects;        // Conexões tentadas desde o boot
+} host_link_stats_t;
+
+/**
+ * @brief Enfileira um evento; o corpo JSON é montado no formato printf.
+ * Deve ser chamada fora dos callbacks do lwIP (trava o lwIP sozinha).
+ * @return false se a fila está cheia (o evento é perdido).
+ */
+bool host_link_event(const char *fmt, ...);
+
+/**
+ * @brief Conecta, reconecta e confere os prazos da conexão.
+ * Deve ser chamada no loop principal.
+ */
+void host_link_poll(void);
+
+/**
+ * @brief Profundidade da fila e contadores da conexão (com o lwIP travado,
+ * como nos handlers do servidor HTTP).
+ */
+void host_link_stats(host_link_stats_t *stats);
+
+#endif // HOST_LINK_H
@@ -0,0 +1,279 @@
+#include <string.h>
+
+#include "http_parser.h"
+
+enum {
+    S_METHOD,
+    S_PATH,
+    S_QUERY,
+    S_VERSION,
+    S_LINE_LF,      // '\r' da linha de requisição já lido
+    S_HEADER_START, // Início de uma linha de cabeçalho (ou da linha vazia)
+    S_HEADER_NAME,
+    S_VALUE_WS,     // Espaços entre ':' e o valor
+    S_VALUE,
+    S_HEADER_LF,    // '\r' de um cabeçalho já lido
+    S_HEAD_END_LF,  // '\r' da linha vazia já lido
+    S_BODY,
+    S_DONE,
+    S_ERROR,
+};
+
+static const struct {
+    const char *name;
+    http_method_t method;
+} methods[] = {
+    {"GET", HTTP_METHOD_GET},
+    {"POST", HTTP_METHOD_POST},
+    {"HEAD", HTTP_METHOD_HEAD},
+    {"OPTIONS", HTTP_METHOD_OPTIONS},
+};
+
+void http_parser_init(http_parser_t *p) {
+    memset(p, 0, sizeof(*p));
+    p->state = S_METHOD;
+}
+
+bool http_parser_started(const http_parser_t *p) {
+    return p->head_bytes > 0;
+}
+
+bool http_parser_done(const http_parser_t *p) {
+    return p->state == S_DONE;
+}
+
+bool http_parser_failed(const http_parser_t *p) {
+    return p->state == S_ERROR;
+}
+
+static void fail(http_parser_t *p, int status) {
+    p->state = S_ERROR;
+    p->error = status;
+}
+
+static void complete(http_parser_t *p, const http_parser_callbacks_t *cb, void *ctx) {
+    p->state = S_DONE;
+    if (cb->on_complete) cb->on_complete(ctx);
+}
+
+static bool is_token_char(uint8_t c) {
+    return c > ' ' && c < 0x7f && !strchr("()<>@,;:\\\"/[]?={}", c);
+}
+
+static void end_method(http_parser_t *p) {
+    p->method = HTTP_METHOD_OTHER;
+    for (size_t i = 0; i < sizeof(methods) / sizeof(methods[0]); i++) {
+        if (strlen(methods[i].name) == p->pos && memcmp(methods[i].name, p->token, p->pos) == 0) {
+            p->method = methods[i].method;
+        }
+    }
+}
+
+static bool end_version(http_parser_t *p) {
+    if (p->pos != 8 || memcmp(p->token, "HTTP/", 5) != 0) {
+        fail(p, 400);
+        return false;
+    }
+    if (p->token[5] != '1' || p->token[6] != '.' || p->token[7] < '0' || p->token[7] > '9') {
+        fail(p, 505);
+        return false;
+    }
+    p->version_minor = (uint8_t)(p->token[7] - '0');
+    return true;
+}
+
+// Cabeçalho completo em name/value: trata os que afetam o parser
+static bool end_header(http_parser_t *p, const http_parser_callbacks_t *cb, void *ctx) {
+    while (p->value_len > 0 && (p->value[p->value_len - 1] == ' ' || p->value[p->value_len - 1] == '\t')) {
+        p->value_len--;
+    }
+    p->name[p->name_len] = '\0';
+    p->value[p->value_len] = '\0';
+
+    if (strcmp(p->name, "content-length") == 0) {
+        uint32_t n = 0;
+        if (p->value_len == 0 || p->value_len > 9) {
+            fail(p, p->value_len ? 413 : 400);
+            return false;
+        }
+        for (uint8_t i = 0; i < p->value_len; i++) {
+            if (p->value[i] < '0' || p->value[i] > '9') {
+                fail(p, 400);
+                return false;
+            }
+            n = n * 10 + (uint32_t)(p->value[i] - '0');
+        }
+        p->content_length = n;
+    } else if (strcmp(p->name, "transfer-encoding") == 0) {
+        // Corpos em chunked não são aceitos: os clientes mandam Content-Length
+        fail(p, 501);
+        return false;
+    }
+
+    if (cb->on_header) {
+        int status = cb->on_header(ctx, p->name, p->value);
+        if (status) {
+            fail(p, status);
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool end_head(http_parser_t *p, const http_parser_callbacks_t *cb, void *ctx) {
+    if (cb->on_headers_done) {
+        int status = cb->on_headers_done(ctx);
+        if (status) {
+            fail(p, status);
+            return false;
+        }
+    }
+    p->body_left = p->content_length;
+    if (p->body_left == 0) {
+        complete(p, cb, ctx);
+    } else {
+        p->state = S_BODY;
+    }
+    return true;
+}
+
+size_t http_parser_feed(http_parser_t *p, const uint8_t *data, size_t len,
+                        const http_parser_callbacks_t *cb, void *ctx) {
+    size_t i = 0;
+    while (i < len) {
+        if (p->state == S_DONE || p->state == S_ERROR) break;
+
+        if (p->state == S_BODY) {
+            // O corpo não é copiado: o trecho aponta para 'data'
+            size_t n = len - i < p->body_left ? len - i : p->body_left;
+            if (cb->on_body) {
+                int status = cb->on_body(ctx, data + i, n);
+                if (status) {
+                    fail(p, status);
+                    return i + n;
+                }
+            }
+            i += n;
+            p->body_left -= (uint32_t)n;
+            if (p->body_left == 0) complete(p, cb, ctx);
+            continue;
+        }
+
+        uint8_t c = data[i++];
+        if (++p->head_bytes > HTTP_HEAD_MAX) {
+            fail(p, 431);
+            break;
+        }
+
+        switch (p->state) {
+        case S_METHOD:
+            if (c == ' ' && p->pos > 0) {
+                end_method(p);
+                p->pos = 0;
+                p->state = S_PATH;
+            } else if ((c == '\r' || c == '\n') && p->pos == 0) {
+                p->head_bytes--; // Linhas vazias entre requisições
+            } else if (is_token_char(c) && p->pos < sizeof(p->token)) {
+                p->token[p->pos++] = (char)c;
+            } else {
+                fail(p, p->pos < sizeof(p->token) ? 400 : 501);
+            }
+            break;
+
+        case S_PATH:
+            if (p->pos == 0 && c != '/') {
+                fail(p, 400);
+            } else if (c == ' ' || c == '?') {
+                p->path[p->pos] = '\0';
+                p->state = c == ' ' ? S_VERSION : S_QUERY;
+                p->pos = 0;
+            } else if (c <= ' ' || c >= 0x7f) {
+                fail(p, 400);
+            } else if (p->pos + 1 >= HTTP_PATH_MAX) {
+                fail(p, 414);
+            } else {
+                p->path[p->pos++] = (char)c;
+            }
+            break;
+
+        case S_QUERY:
+            // A query string não é usada por nenhuma rota
+            if (c == ' ') {
+                p->state = S_VERSION;
+            } else if (c < ' ' || c >= 0x7f) {
+                fail(p, 400);
+            }
+            break;
+
+        case S_VERSION:
+            if (c == '\r' || c == '\n') {
+                if (!end_version(p)) break;
+                p->pos = 0;
+                p->state = c == '\r' ? S_LINE_LF : S_HEADER_START;
+            } else if (p->pos < sizeof(p->token)) {
+                p->token[p->pos++] = (char)c;
+            } else {
+                fail(p, 400);
+            }
+            break;
+
+        case S_LINE_LF:
+        case S_HEADER_LF:
+            if (c != '\n') {
+                fail(p, 400);
+            } else {
+                p->state = S_HEADER_START;
+            }
+            break;
+
+        case S_HEAD_END_LF:
+            if (c != '\n') {
+                fail(p, 400);
+            } else {
+                end_head(p, cb, ctx);
+            }
+            break;
+
+        case S_HEADER_START:
+            if (c == '\r') {
+                p->state = S_HEAD_END_LF;
+                break;
+            }
+            if (c == '\n') {
+                end_head(p, cb, ctx);
+                break;
+            }
+            p->name_len = 0;
+            p->value_len = 0;
+            p->state = S_HEADER_NAME;
+            // fall through
+        case S_HEADER_NAME:
+            if (c == ':' && p->name_len > 0) {
+                p->state = S_VALUE_WS;
+            } else if (is_token_char(c)) {
+                if (p->name_len + 1 < HTTP_HEADER_NAME_MAX) {
+                    p->name[p->name_len++] = (char)(c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c);
+                }
+            } else {
+                fail(p, 400);
+            }
+            break;
+
+        case S_VALUE_WS:
+            if (c == ' ' || c == '\t') break;
+            p->state = S_VALUE;
+            // fall through
+        case S_VALUE:
+            if (c == '\r' || c == '\n') {
+                if (!end_header(p, cb, ctx)) break;
+                p->state = c == '\r' ? S_HEADER_LF : S_HEADER_START;
+            } else if (c < ' ' && c != '\t') {
+                fail(p, 400);
+            } else if (p->value_len + 1 < HTTP_HEADER_VALUE_MAX) {
+                p->value[p->value_len++] = (char)c;
+            }
+            break;
+        }
+    }
+    return i;
+}
@@ -0,0 +1,103 @@
+/**
+ * @file http_parser.h
+ *
+ * Parser incremental de requisições HTTP/1.x.
+ *
+ * O parser é uma máquina de estados alimentada com pedaços arbitrários do
+ * fluxo TCP (normalmente o payload de cada pbuf, sem cópia): uma requisição
+ * pode chegar dividida em qualquer ponto, inclusive no meio de um nome de
+ * cabeçalho ou do "\r\n\r\n". Da linha de requisição e dos cabeçalhos só
+ * ficam guardados os campos pequenos de que o servidor precisa (método,
+ * caminho, nome e valor do cabeçalho corrente); o corpo é entregue em
+ * trechos que apontam para o próprio buffer recebido.
+ *
+ * O módulo não depende do SDK do Pico nem do lwIP.
+ */
+
+#ifndef HTTP_PARSER_H
+#define HTTP_PARSER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define HTTP_PATH_MAX 48          // Caminho sem a query string, com o '\0'
+#define HTTP_HEADER_NAME_MAX 32   // Nomes maiores são truncados
+#define HTTP_HEADER_VALUE_MAX 96  // Valores maiores são truncados
+#define HTTP_HEAD_MAX 4096        // Linha de requisição + cabeçalhos
+
+typedef enum {
+    HTTP_METHOD_OTHER = 0,
+    HTTP_METHOD_GET,
+    HTTP_METHOD_POST,
+    HTTP_METHOD_HEAD,
+    HTTP_METHOD_OPTIONS,
+} http_method_t;
+
+/**
+ * @brief Funções chamadas pelo parser. Todas podem ser NULL.
+ *
+ * As que devolvem int retornam 0 para continuar ou um código de status HTTP
+ * (ex.: 413) para abortar a requisição com esse erro.
+ */
+typedef struct {
+    // Nome já em minúsculas; ambos terminados em '\0'
+    int (*on_header)(void *ctx, const char *name, const char *value);
+    // Fim dos cabeçalhos: método, caminho e Content-Length já conhecidos
+    int (*on_headers_done)(void *ctx);
+    // Trecho do corpo, apontando para o buffer passado a http_parser_feed
+    int (*on_body)(void *ctx, const uint8_t *data, size_t len);
+    // Requisição completa
+    void (*on_complete)(void *ctx);
+} http_parser_callbacks_t;
+
+typedef struct {
+    uint8_t state;
+    http_method_t method;
+    uint8_t version_minor;     // HTTP/1.<minor>
+    char path[HTTP_PATH_MAX];
+    uint32_t content_length;
+    uint32_t body_left;
+    int error;                 // Status HTTP do erro, 0 se nenhum
+
+    // Estado interno da linha corrente
+    uint16_t pos;
+    uint16_t head_bytes;
+    char token[8];             // Método e versão
+    char name[HTTP_HEADER_NAME_MAX];
+    char value[HTTP_HEADER_VALUE_MAX];
+    uint8_t name_len;
+    uint8_t value_len;
+} http_parser_t;
+
+/**
+ * @brief Prepara o parser para uma nova requisição.
+ */
+void http_parser_init(http_parser_t *p);
+
+/**
+ * @brief Consome bytes do fluxo.
+ *
+ * Para logo depois do fim de uma requisição (ou de um erro), para que os
+ * bytes seguintes possam pertencer à próxima requisição.
+ * @return Quantidade de bytes consumidos de 'data'.
+ */
+size_t http_parser_feed(http_parser_t *p, const uint8_t *data, size_t len,
+                        const http_parser_callbacks_t *cb, void *ctx);
+
+/**
+ * @brief Algum byte da requisição corrente já foi consumido.
+ */
+bool http_parser_started(const http_parser_t *p);
+
+/**
+ * @brief Requisição completa (on_complete já chamada).
+ */
+bool http_parser_done(const http_parser_t *p);
+
+/**
+ * @brief Requisição inválida; o status do erro está em p->error.
+ */
+bool http_parser_failed(const http_parser_t *p);
+
+#endif // HTTP_PARSER_H
@@ -0,0 +1,990 @@
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+#include "lwip/pbuf.h"
+#include "lwip/sys.h"
+#include "lwip/tcp.h"
+
+#include "http_server.h"
+#include "websocket.h"
+#include "slab/slab.h"
+
+// Intervalo do tcp_poll, em unidades de 500 ms
+#define POLL_INTERVAL 2
+
+// Moldura de um chunk: "XXXX\r\n" antes dos dados e "\r\n" depois
+#define CHUNK_HEAD 6
+#define CHUNK_OVERHEAD 8
+
+typedef struct http_conn {
+    struct tcp_pcb *pcb;
+    http_parser_t parser;
+    struct pbuf *rx;            // Bytes recebidos e ainda não interpretados
+    uint32_t last_active;       // sys_now() da última atividade
+    bool keep_alive;            // Conexão continua depois da resposta
+    int8_t connection_hdr;      // Cabeçalho Connection: 1 keep-alive, -1 close
+    bool peer_closed;           // FIN recebido do cliente
+    const http_route_t *route;  // NULL se nenhuma rota atende a requisição
+    int route_status;           // 404 ou 405 quando route é NULL
+    bool body_streaming;        // Corpo indo em trechos para route->body_stream
+    bool responded;             // Resposta da requisição corrente enviada
+    bool events;                // Assinatura de eventos
+    uint32_t ev_sent;           // Posição no fluxo de eventos já entregue ao lwIP
+    uint32_t ev_acked;          // Posição no fluxo de eventos já confirmada
+    bool ws;                    // Conexão WebSocket
+    bool ws_upgrade;            // Upgrade: websocket
+    bool ws_version;            // Sec-WebSocket-Version: 13
+    bool ws_pinged;             // PING enviado desde a última atividade
+    char ws_key[32];            // Sec-WebSocket-Key
+    char if_none_match[48];     // If-None-Match (truncado não casa com nada)
+    char accept[HTTP_HEADER_VALUE_MAX];
+    ws_parser_t ws_parser;
+    uint16_t ws_close;          // Fechamento pendente (código), 0 se nenhum
+    bool ws_broken;             // Quadro pela metade no fluxo: só resta fechar
+    uint8_t ws_frame_op;        // Opcode do quadro corrente
+    uint32_t ws_frame_len;
+    uint8_t ws_message_op;      // Opcode da mensagem em montagem, 0 se nenhuma
+    uint8_t ws_ctrl[WS_CONTROL_MAX];
+    int sent_len;
+    char headers[256];
+    int header_len;
+    char result[HTTP_RESPONSE_MAX];
+    const char *body;           // 'result' ou os dados de 'shared'
+    http_shared_body_t *shared;
+    http_body_fn stream;        // Corpo gerado em partes ('result' é o rascunho)
+    void *stream_ctx;
+    bool chunked;               // Tamanho desconhecido em HTTP/1.1
+    uint16_t stream_pending;    // Trecho gerado em 'result' que o lwIP ainda não aceitou
+    bool stream_failed;
+    bool body_done;             // Corpo inteiro entregue ao lwIP
+    uint32_t body_pos;          // Bytes do corpo já entregues ao lwIP
+    uint32_t out_len;           // Bytes da resposta (com cabeçalhos) entregues
+    int result_len;             // -1 se só o gerador sabe onde o corpo acaba
+} http_conn_t;
+
+static struct tcp_pcb *server_pcb;
+static const http_route_t *routes;
+static size_t route_count;
+static http_conn_t *conns[HTTP_MAX_CONNECTIONS];
+SLAB_DEFINE(conn_pool, http_conn_t, HTTP_MAX_CONNECTIONS);
+static uint32_t busy_count;     // Conexões recusadas com 503
+
+// Corpo da requisição em andamento; uma conexão por vez
+static char body_buf[HTTP_BODY_MAX + 1];
+static size_t body_len;
+static http_conn_t *body_owner;
+
+// Fluxo de eventos compartilhado pelas assinaturas; as posições crescem
+// sempre e o anel guarda os últimos HTTP_EVENTS_RING_SIZE bytes
+static char ev_ring[HTTP_EVENTS_RING_SIZE];
+static uint32_t ev_head;
+static uint32_t ev_id;
+static uint32_t ev_last_write;  // sys_now() da última escrita no anel
+static uint32_t ev_joined;
+static uint32_t ws_joined;
+
+static const char *reason_phrase(int status) {
+    switch (status) {
+    case 200: return "OK";
+    case 304: return "Not Modified";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 413: return "Payload Too Large";
+    case 414: return "URI Too Long";
+    case 431: return "Request Header Fields Too Large";
+    case 501: return "Not Implemented";
+    case 503: return "Service Unavailable";
+    case 505: return "HTTP Version Not Supported";
+    default: return "Error";
+    }
+}
+
+static void release_body(http_conn_t *conn) {
+    if (body_owner == conn) {
+        // Corpo em trechos que não chegou ao fim
+        if (conn->body_streaming) conn->route->body_stream(body_len, NULL, 0);
+        conn->body_streaming = false;
+        body_owner = NULL;
+        body_len = 0;
+    }
+}
+
+static void release_shared(http_conn_t *conn) {
+    if (conn->shared) {
+        conn->shared->refs--;
+        conn->shared = NULL;
+    }
+}
+
+static bool conn_write(http_conn_t *conn, const void *data, size_t len, u8_t flags) {
+    if (tcp_write(conn->pcb, data, (u16_t)len, flags) != ERR_OK) return false;
+    conn->out_len += len;
+    return true;
+}
+
+// Avisa o gerador de que a resposta terminou (ou foi abandonada)
+static void release_stream(http_conn_t *conn) {
+    if (conn->stream) conn->stream(conn->stream_ctx, conn->body_pos, NULL, 0);
+    conn->stream = NULL;
+    conn->stream_pending = 0;
+}
+
+// Gerador com defeito: a resposta não tem como terminar direito
+static bool stream_fail(http_conn_t *conn) {
+    release_stream(conn);
+    conn->stream_failed = true;
+    return false;
+}
+
+// Um trecho do corpo em um chunk montado no rascunho; o último chunk é o
+// vazio, quando o gerador devolve 0. Um chunk que o lwIP recusou fica no
+// rascunho até ser aceito: o gerador não é chamado de novo para ele
+static bool pump_chunk(http_conn_t *conn, size_t room, bool *wrote) {
+    uint8_t *frame = (uint8_t *)conn->result;
+    if (!conn->stream_pending) {
+        size_t max = (room < sizeof(conn->result) ? room : sizeof(conn->result)) - CHUNK_OVERHEAD;
+        size_t n = conn->stream(conn->stream_ctx, conn->body_pos, frame + CHUNK_HEAD, max);
+        if (n == HTTP_STREAM_ERROR || n > max) return stream_fail(conn);
+
+        static const char hex[] = "0123456789abcdef";
+        for (int i = 0; i < 4; i++) frame[i] = hex[(n >> (12 - 4 * i)) & 0xf];
+        frame[4] = '\r';
+        frame[5] = '\n';
+        frame[CHUNK_HEAD + n] = '\r'; // Com n == 0, "0000\r\n\r\n" encerra o corpo
+        frame[CHUNK_HEAD + n + 1] = '\n';
+        conn->stream_pending = (uint16_t)(n + CHUNK_OVERHEAD);
+    } else if (room < conn->stream_pending) {
+        return true;
+    }
+    size_t n = conn->stream_pending - CHUNK_OVERHEAD;
+    // O rascunho é reaproveitado no próximo trecho: o lwIP copia
+    *wrote = conn_write(conn, frame, conn->stream_pending, TCP_WRITE_FLAG_COPY | (n ? TCP_WRITE_FLAG_MORE : 0));
+    if (*wrote) {
+        conn->stream_pending = 0;
+        conn->body_pos += n;
+        conn->body_done = n == 0;
+    }
+    return true;
+}
+
+/**
+ * Entrega ao lwIP o quanto couber do corpo, sem passar de tcp_sndbuf; o
+ * resto segue a cada tcp_sent. Corpos prontos vão sem cópia, e os gerados
+ * passam pelo rascunho 'result'.
+ * @return false se o gerador falhou (a conexão precisa ser abortada).
+ */
+static bool conn_pump(http_conn_t *conn) {
+    while (conn->responded && !conn->body_done) {
+        size_t room = tcp_sndbuf(conn->pcb);
+        bool wrote = false;
+        if (conn->chunked) {
+            if (room <= CHUNK_OVERHEAD) break;
+            if (!pump_chunk(conn, room, &wrote)) return false;
+        } else {
+            size_t n = conn->result_len < 0 ? room : (uint32_t)conn->result_len - conn->body_pos;
+            if (n > room) n = room;
+            if (conn->stream && n > sizeof(conn->result)) n = sizeof(conn->result);
+            if (n == 0) break;
+
+            const void *data = conn->body + conn->body_pos;
+            u8_t flags = 0;
+            if (conn->stream && conn->stream_pending) {
+                // Recusado antes pelo lwIP: vai de novo, sem gerar outra vez
+                if (n < conn->stream_pending) break;
+                n = conn->stream_pending;
+                data = conn->result;
+                flags = TCP_WRITE_FLAG_COPY;
+            } else if (conn->stream) {
+                size_t got = conn->stream(conn->stream_ctx, conn->body_pos, (uint8_t *)conn->result, n);
+                if (got == HTTP_STREAM_ERROR || got > n) return stream_fail(conn);
+                if (got == 0 && conn->result_len < 0) {
+                    // HTTP/1.0 sem tamanho: o corpo termina no fechamento
+                    conn->body_done = true;
+                    break;
+                }
+                if (got != n && conn->result_len >= 0) return stream_fail(conn);
+                n = got;
+                conn->stream_pending = (uint16_t)got;
+                data = conn->result;
+                flags = TCP_WRITE_FLAG_COPY;
+            }
+            if (conn->result_len < 0 || conn->body_pos + n < (uint32_t)conn->result_len) flags |= TCP_WRITE_FLAG_MORE;
+            wrote = conn_write(conn, data, n, flags);
+            if (wrote) {
+                conn->stream_pending = 0;
+                conn->body_pos += n;
+                conn->body_done = conn->result_len >= 0 && conn->body_pos == (uint32_t)conn->result_len;
+            }
+        }
+        // Fila do lwIP cheia: continua no próximo tcp_sent
+        if (!wrote) break;
+    }
+    tcp_output(conn->pcb);
+    return true;
+}
+
+// A resposta ainda está (parcialmente) nas filas do lwIP
+static bool conn_sending(const http_conn_t *conn) {
+    // Os quadros WebSocket são copiados pelo lwIP; só o 101 não é
+    if (conn->ws) return conn->sent_len < conn->header_len;
+    if (conn->events) return conn->sent_len < conn->header_len || conn->ev_acked != conn->ev_sent;
+    return conn->responded && (!conn->body_done || (uint32_t)conn->sent_len < conn->out_len);
+}
+
+static err_t conn_close(http_conn_t *conn, struct tcp_pcb *pcb, err_t close_err) {
+    if (pcb) {
+        tcp_arg(pcb, NULL);
+        tcp_poll(pcb, NULL, 0);
+        tcp_sent(pcb, NULL);
+        tcp_recv(pcb, NULL);
+        tcp_err(pcb, NULL);
+        // Dados ainda não confirmados apontam para os buffers da conexão,
+        // que são liberados logo abaixo: nesse caso a conexão é abortada
+        if (conn_sending(conn) || tcp_close(pcb) != ERR_OK) {
+            tcp_abort(pcb);
+            close_err = ERR_ABRT;
+        }
+    }
+    for (int i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+        if (conns[i] == conn) conns[i] = NULL;
+    }
+    if (conn->rx) pbuf_free(conn->rx);
+    release_body(conn);
+    release_shared(conn);
+    release_stream(conn);
+    slab_free(&conn_pool, conn);
+    return close_err;
+}
+
+static void respond(http_conn_t *conn, int status, const char *content_type, const char *etag) {
+    conn->responded = true;
+    conn->sent_len = 0;
+    conn->out_len = 0;
+    conn->body_pos = 0;
+    release_body(conn);
+
+    conn->header_len = snprintf(conn->headers, sizeof(conn->headers), "HTTP/1.1 %d %s\r\n", status, reason_phrase(status));
+    if (status == 304) {
+        // Sem corpo nem cabeçalhos de conteúdo: o cliente usa o que já tem
+        conn->result_len = 0;
+        release_stream(conn);
+        release_shared(conn);
+    } else if (conn->result_len >= 0) {
+        conn->header_len += snprintf(conn->headers + conn->header_len, sizeof(conn->headers) - conn->header_len,
+            "Content-Length: %d\r\n"
+            "Content-Type: %s\r\n", conn->result_len, content_type);
+    } else {
+        // Tamanho desconhecido: chunked no HTTP/1.1; no 1.0 o fim é o fechamento
+        conn->chunked = conn->parser.version_minor >= 1;
+        if (!conn->chunked) conn->keep_alive = false;
+        conn->header_len += snprintf(conn->headers + conn->header_len, sizeof(conn->headers) - conn->header_len,
+            "%sContent-Type: %s\r\n", conn->chunked ? "Transfer-Encoding: chunked\r\n" : "", content_type);
+    }
+    conn->header_len += snprintf(conn->headers + conn->header_len, sizeof(conn->headers) - conn->header_len,
+        "Access-Control-Allow-Origin: *\r\n");
+    if (etag) {
+        conn->header_len += snprintf(conn->headers + conn->header_len, sizeof(conn->headers) - conn->header_len,
+            "ETag: %s\r\n"
+            "Cache-Control: no-cache\r\n", etag);
+    }
+    if (conn->keep_alive) {
+        conn->header_len += snprintf(conn->headers + conn->header_len, sizeof(conn->headers) - conn->header_len,
+            "Connection: keep-alive\r\n"
+            "Keep-Alive: timeout=%d\r\n\r\n", HTTP_IDLE_TIMEOUT_MS / 1000);
+    } else {
+        conn->header_len += snprintf(conn->headers + conn->header_len, sizeof(conn->headers) - conn->header_len,
+            "Connection: close\r\n\r\n");
+    }
+
+    if (conn->parser.method == HTTP_METHOD_HEAD) {
+        conn->result_len = 0;
+        release_stream(conn);
+        conn->chunked = false;
+        release_shared(conn);
+    }
+    conn->body_done = conn->result_len == 0;
+
+    // Os buffers pertencem à conexão (ou estão presos em refs) e só são
+    // reutilizados depois do último ACK
+    conn_write(conn, conn->headers, conn->header_len, conn->body_done ? 0 : TCP_WRITE_FLAG_MORE);
+    conn_pump(conn);
+}
+
+static void respond_error(http_conn_t *conn, int status) {
+    printf("HTTP: erro %d em %s\n", status, conn->parser.path[0] ? conn->parser.path : "(sem caminho)");
+    // Depois de um erro de sintaxe não dá para saber onde começa a próxima
+    // requisição; 404 e 405 chegam com a requisição inteira consumida
+    if (http_parser_failed(&conn->parser)) conn->keep_alive = false;
+    conn->body = conn->result;
+    conn->result_len = snprintf(conn->result, sizeof(conn->result), "%s", reason_phrase(status));
+    respond(conn, status, "text/plain", NULL);
+}
+
+// Entrega ao lwIP o que a assinatura ainda não recebeu do anel
+static void events_pump(http_conn_t *conn) {
+    while (conn->ev_sent != ev_head) {
+        uint32_t offset = conn->ev_sent & (HTTP_EVENTS_RING_SIZE - 1);
+        uint32_t n = ev_head - conn->ev_sent;
+        if (n > HTTP_EVENTS_RING_SIZE - offset) n = HTTP_EVENTS_RING_SIZE - offset;
+        if (n > tcp_sndbuf(conn->pcb)) n = tcp_sndbuf(conn->pcb);
+        // Sem espaço agora: continua no próximo tcp_sent
+        if (n == 0 || tcp_write(conn->pcb, ev_ring + offset, (u16_t)n, 0) != ERR_OK) break;
+        conn->ev_sent += n;
+    }
+    tcp_output(conn->pcb);
+}
+
+// O anel não pode sobrescrever bytes que o lwIP ainda pode retransmitir
+static bool events_lagging(const http_conn_t *conn, size_t len) {
+    return ev_head + len - conn->ev_acked > HTTP_EVENTS_RING_SIZE;
+}
+
+static void events_write(const char *text, size_t len) {
+    for (int i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+        http_conn_t *conn = conns[i];
+        if (conn && conn->events && events_lagging(conn, len)) {
+            printf("HTTP: assinante de eventos atrasado, desconectado\n");
+            conn_close(conn, conn->pcb, ERR_OK);
+        }
+    }
+    for (size_t i = 0; i < len; i++) {
+        ev_ring[(ev_head + i) & (HTTP_EVENTS_RING_SIZE - 1)] = text[i];
+    }
+    ev_head += len;
+    ev_last_write = sys_now();
+    for (int i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+        if (conns[i] && conns[i]->events) events_pump(conns[i]);
+    }
+}
+
+// Transforma a conexão em assinatura; os eventos começam na posição atual
+static void respond_events(http_conn_t *conn) {
+    conn->responded = true;
+    conn->events = true;
+    conn->keep_alive = false;
+    conn->sent_len = 0;
+    conn->result_len = 0;
+    conn->body_done = true;
+    conn->ev_sent = conn->ev_acked = ev_head;
+    ev_joined++;
+
+    conn->header_len = snprintf(conn->headers, sizeof(conn->headers),
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Type: text/event-stream\r\n"
+        "Cache-Control: no-cache\r\n"
+        "Access-Control-Allow-Origin: *\r\n"
+        "Connection: close\r\n\r\n"
+        "retry: 2000\n\n");
+    tcp_write(conn->pcb, conn->headers, conn->header_len, 0);
+    tcp_output(conn->pcb);
+}
+
+// Espaço para um quadro de 'len' bytes: em bytes e na fila de pbufs do
+// lwIP (TCP_SND_QUEUELEN), que enche antes com muitos quadros pequenos.
+// Com cópia, cada segmento ocupa um pbuf: o cabeçalho, os segmentos do
+// conteúdo e um a mais se o cabeçalho dividir o primeiro.
+static bool ws_fits(struct tcp_pcb *pcb, size_t len) {
+    size_t pbufs = 2 + len / tcp_mss(pcb);
+    return tcp_sndbuf(pcb) >= WS_HEADER_MAX + len && tcp_sndqueuelen(pcb) + pbufs <= TCP_SND_QUEUELEN;
+}
+
+static bool ws_write(http_conn_t *conn, uint8_t opcode, const void *data, size_t len) {
+    if (len > UINT16_MAX || conn->ws_broken) return false;
+    uint8_t hdr[WS_HEADER_MAX];
+    size_t hdr_len = ws_frame_header(hdr, opcode, (uint16_t)len);
+    // O quadro vai inteiro ou não vai, para não deixar um quadro pela metade
+    if (!ws_fits(conn->pcb, len)) return false;
+    // Quadros pequenos e de vida curta: o lwIP copia
+    if (tcp_write(conn->pcb, hdr, (u16_t)hdr_len, TCP_WRITE_FLAG_COPY | (len ? TCP_WRITE_FLAG_MORE : 0)) != ERR_OK) {
+        return false;
+    }
+    if (len && tcp_write(conn->pcb, data, (u16_t)len, TCP_WRITE_FLAG_COPY) != ERR_OK) {
+        // Sem memória para o conteúdo com o cabeçalho já na fila: o cliente
+        // leria o próximo quadro como conteúdo deste, então a conexão fecha
+        printf("HTTP: quadro WebSocket pela metade, conexao fechada\n");
+        conn->ws_broken = true;
+        return false;
+    }
+    tcp_output(conn->pcb);
+    return true;
+}
+
+static void respond_upgrade(http_conn_t *conn) {
+    char accept[WS_ACCEPT_LEN + 1];
+    ws_accept_key(conn->ws_key, accept);
+
+    conn->responded = true;
+    conn->ws = true;
+    conn->keep_alive = false;
+    conn->sent_len = 0;
+    conn->result_len = 0;
+    conn->body_done = true;
+    ws_parser_init(&conn->ws_parser, HTTP_BODY_MAX);
+    ws_joined++;
+
+    conn->header_len = snprintf(conn->headers, sizeof(conn->headers),
+        "HTTP/1.1 101 Switching Protocols\r\n"
+        "Upgrade: websocket\r\n"
+        "Connection: Upgrade\r\n"
+        "Sec-WebSocket-Accept: %s\r\n\r\n", accept);
+    tcp_write(conn->pcb, conn->headers, conn->header_len, 0);
+    tcp_output(conn->pcb);
+}
+
+// Fim da mensagem em montagem (ou mensagem abortada)
+static void ws_end_message(http_conn_t *conn) {
+    conn->ws_message_op = 0;
+    release_body(conn);
+}
+
+static uint8_t *ws_on_frame(void *ctx, uint8_t opcode, bool fin, uint32_t len) {
+    http_conn_t *conn = ctx;
+    if (conn->ws_close || conn->ws_broken) return NULL; // Fechando: o resto do pbuf é descartado
+    conn->ws_frame_op = opcode;
+    conn->ws_frame_len = len;
+    if (opcode & 0x8) return conn->ws_ctrl;
+
+    // Mensagens remontadas no buffer de corpos, uma conexão por vez
+    if (opcode == WS_OP_CONTINUATION ? !conn->ws_message_op : conn->ws_message_op != 0) {
+        conn->ws_close = WS_CLOSE_PROTOCOL;
+        return NULL;
+    }
+    if (opcode != WS_OP_CONTINUATION) {
+        if (body_owner && body_owner != conn) {
+            conn->ws_close = WS_CLOSE_TRY_LATER;
+            return NULL;
+        }
+        body_owner = conn;
+        body_len = 0;
+        conn->ws_message_op = opcode;
+    }
+    if (body_len + len > HTTP_BODY_MAX) {
+        conn->ws_close = WS_CLOSE_TOO_BIG;
+        return NULL;
+    }
+    return (uint8_t *)body_buf + body_len;
+}
+
+static void ws_on_frame_done(void *ctx) {
+    http_conn_t *conn = ctx;
+    if (conn->ws_close || conn->ws_broken) return;
+
+    switch (conn->ws_frame_op) {
+    case WS_OP_PING:
+        ws_write(conn, WS_OP_PONG, conn->ws_ctrl, conn->ws_frame_len);
+        return;
+    case WS_OP_PONG:
+        return;
+    case WS_OP_CLOSE:
+        conn->ws_close = WS_CLOSE_NORMAL;
+        return;
+    case WS_OP_TEXT:
+    case WS_OP_BINARY:
+    case WS_OP_CONTINUATION:
+        body_len += conn->ws_frame_len;
+        if (!conn->ws_parser.fin) return;
+        conn->route->ws_message(conn, (const uint8_t *)body_buf, body_len);
+        ws_end_message(conn);
+        return;
+    default:
+        conn->ws_close = WS_CLOSE_PROTOCOL; // Opcode reservado
+        return;
+    }
+}
+
+static const ws_callbacks_t ws_callbacks = {
+    .on_frame = ws_on_frame,
+    .on_frame_done = ws_on_frame_done,
+};
+
+// Procura 'token' na lista separada por vírgulas de um cabeçalho
+static bool header_has_token(const char *value, const char *token) {
+    size_t len = strlen(token);
+    while (*value) {
+        while (*value == ' ' || *value == ',') value++;
+        if (strncasecmp(value, token, len) == 0 && (value[len] == '\0' || value[len] == ',' || value[len] == ' ')) {
+            return true;
+        }
+        while (*value && *value != ',') value++;
+    }
+    return false;
+}
+
+// If-None-Match: lista de ETags (comparação fraca, W/ ignorado) ou "*"
+static bool etag_matches(const char *list, const char *etag) {
+    size_t len = strlen(etag);
+    while (*list) {
+        while (*list == ' ' || *list == ',') list++;
+        if (*list == '*') return true;
+        if (strncmp(list, "W/", 2) == 0) list += 2;
+        if (strncmp(list, etag, len) == 0 && (list[len] == '\0' || list[len] == ',' || list[len] == ' ')) {
+            return true;
+        }
+        while (*list && *list != ',') list++;
+    }
+    return false;
+}
+
+static int on_header(void *ctx, const char *name, const char *value) {
+    http_conn_t *conn = ctx;
+    if (strcmp(name, "connection") == 0) {
+        if (header_has_token(value, "close")) {
+            conn->connection_hdr = -1;
+        } else if (header_has_token(value, "keep-alive")) {
+            conn->connection_hdr = 1;
+        }
+    } else if (strcmp(name, "if-none-match") == 0) {
+        if (strlen(value) < sizeof(conn->if_none_match)) strcpy(conn->if_none_match, value);
+    } else if (strcmp(name, "accept") == 0) {
+        strcpy(conn->accept, value);
+    } else if (strcmp(name, "upgrade") == 0) {
+        conn->ws_upgrade = header_has_token(value, "websocket");
+    } else if (strcmp(name, "sec-websocket-key") == 0) {
+        snprintf(conn->ws_key, sizeof(conn->ws_key), "%s", value);
+    } else if (strcmp(name, "sec-websocket-version") == 0) {
+        conn->ws_version = strcmp(value, "13") == 0;
+    }
+    return 0;
+}
+
+static int on_headers_done(void *ctx) {
+    http_conn_t *conn = ctx;
+    const http_parser_t *p = &conn->parser;
+
+    // HTTP/1.1 mantém a conexão por padrão; HTTP/1.0 só se o cliente pedir
+    conn->keep_alive = conn->connection_hdr == 0 ? p->version_minor >= 1 : conn->connection_hdr > 0;
+
+    conn->route = NULL;
+    conn->route_status = 404;
+    for (size_t i = 0; i < route_count; i++) {
+        if (strcmp(routes[i].path, p->path) != 0) continue;
+        if (routes[i].method == p->method ||
+            (routes[i].method == HTTP_METHOD_GET && p->method == HTTP_METHOD_HEAD)) {
+            conn->route = &routes[i];
+            break;
+        }
+        conn->route_status = 405;
+    }
+
+    if (conn->route && conn->route->has_body && p->content_length > 0) {
+        bool streaming = conn->route->body_stream != NULL;
+        if (p->content_length > HTTP_BODY_MAX && !streaming) return 413;
+        if (body_owner && body_owner != conn) return 503; // Outro corpo em andamento
+        body_owner = conn;
+        body_len = 0;
+        conn->body_streaming = streaming;
+    }
+    return 0;
+}
+
+static int on_body(void *ctx, const uint8_t *data, size_t len) {
+    http_conn_t *conn = ctx;
+    // Corpos de rotas que não os usam são descartados sem cópia
+    if (body_owner == conn) {
+        if (!conn->body_streaming) {
+            memcpy(body_buf + body_len, data, len);
+        } else if (!conn->route->body_stream(body_len, data, len)) {
+            return 400;
+        }
+        body_len += len;
+    }
+    return 0;
+}
+
+static void on_complete(void *ctx) {
+    http_conn_t *conn = ctx;
+    if (!conn->route) {
+        respond_error(conn, conn->route_status);
+        return;
+    }
+    if (conn->route->events) {
+        respond_events(conn);
+        return;
+    }
+    if (conn->route->ws_message) {
+        if (conn->parser.method != HTTP_METHOD_GET || !conn->ws_upgrade || !conn->ws_version || !conn->ws_key[0]) {
+            conn->keep_alive = false;
+            respond_error(conn, 400);
+        } else {
+            respond_upgrade(conn);
+        }
+        return;
+    }
+
+    http_request_t req = {
+        .method = conn->parser.method,
+        .path = conn->parser.path,
+        .body = NULL,
+        .body_len = 0,
+        .accept = conn->accept,
+    };
+    if (body_owner == conn && conn->body_streaming) {
+        conn->body_streaming = false; // Completo: release_body não avisa o abandono
+        req.body_len = body_len;
+    } else if (body_owner == conn) {
+        body_buf[body_len] = '\0';
+        req.body = body_buf;
+        req.body_len = body_len;
+    }
+    http_response_t res = {
+        .status = 200,
+        .content_type = "text/plain",
+        .body = conn->result,
+        .body_len = 0,
+        .shared = NULL,
+        .stream = NULL,
+        .stream_ctx = NULL,
+        .etag = NULL,
+    };
+    conn->route->handler(&req, &res);
+    if (res.etag && res.status == 200 && etag_matches(conn->if_none_match, res.etag)) {
+        res.status = 304;
+        res.shared = NULL;
+        if (res.stream) res.stream(res.stream_ctx, 0, NULL, 0);
+        res.stream = NULL;
+    }
+    if (res.stream) {
+        conn->stream = res.stream;
+        conn->stream_ctx = res.stream_ctx;
+        conn->result_len = res.body_len == HTTP_LENGTH_UNKNOWN ? -1 : (int)res.body_len;
+    } else if (res.shared) {
+        conn->shared = res.shared;
+        conn->shared->refs++;
+        conn->body = res.shared->data;
+        conn->result_len = (int)res.shared->len;
+    } else {
+        conn->result_len = (int)res.body_len;
+    }
+    respond(conn, res.status, res.content_type, res.etag);
+}
+
+static const http_parser_callbacks_t parser_callbacks = {
+    .on_header = on_header,
+    .on_headers_done = on_headers_done,
+    .on_body = on_body,
+    .on_complete = on_complete,
+};
+
+// Prepara a conexão para a próxima requisição
+static void conn_reset(http_conn_t *conn) {
+    http_parser_init(&conn->parser);
+    conn->connection_hdr = 0;
+    conn->route = NULL;
+    conn->ws_upgrade = false;
+    conn->ws_version = false;
+    conn->ws_key[0] = '\0';
+    conn->if_none_match[0] = '\0';
+    conn->accept[0] = '\0';
+    release_stream(conn);
+    conn->chunked = false;
+    conn->body_done = false;
+    conn->body_pos = 0;
+    conn->out_len = 0;
+    conn->responded = false;
+    conn->sent_len = 0;
+    conn->header_len = 0;
+    conn->body = conn->result;
+    conn->result_len = 0;
+    release_shared(conn);
+}
+
+// Manda o CLOSE (o do cliente é respondido com o mesmo código) e fecha
+static err_t ws_close(http_conn_t *conn, uint16_t code) {
+    uint8_t payload[2] = {(uint8_t)(code >> 8), (uint8_t)code};
+    ws_write(conn, WS_OP_CLOSE, payload, sizeof(payload));
+    return conn_close(conn, conn->pcb, ERR_OK);
+}
+
+// Interpreta os bytes pendentes: até responder a uma requisição HTTP, ou
+// tudo o que houver depois do upgrade para WebSocket
+static err_t conn_process(http_conn_t *conn) {
+    while (conn->rx && (conn->ws || !conn->responded)) {
+        struct pbuf *q = conn->rx;
+        size_t used;
+        if (conn->ws) {
+            used = ws_parser_feed(&conn->ws_parser, q->payload, q->len, &ws_callbacks, conn);
+        } else {
+            used = http_parser_feed(&conn->parser, q->payload, q->len, &parser_callbacks, conn);
+        }
+        if (used > 0) {
+            // Só o que foi consumido sai do pbuf e reabre a janela
+            conn->rx = pbuf_free_header(q, (u16_t)used);
+            tcp_recved(conn->pcb, (u16_t)used);
+        }
+        if (conn->ws) {
+            if (conn->ws_broken) return conn_close(conn, conn->pcb, ERR_OK);
+            if (conn->ws_parser.close_code) conn->ws_close = conn->ws_parser.close_code;
+            if (conn->ws_close) return ws_close(conn, conn->ws_close);
+        } else if (http_parser_failed(&conn->parser) && !conn->responded) {
+            respond_error(conn, conn->parser.error);
+        }
+    }
+    // Corpo pela metade: com Content-Length já enviado, só resta abortar
+    if (conn->stream_failed) return conn_close(conn, conn->pcb, ERR_OK);
+    return ERR_OK;
+}
+
+static err_t http_server_recv(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err) {
+    http_conn_t *conn = (http_conn_t *)arg;
+    if (!p) {
+        // O cliente não manda mais nada: termina a resposta em andamento
+        conn->peer_closed = true;
+        if (conn->events || conn->ws || !conn_sending(conn)) return conn_close(conn, pcb, ERR_OK);
+        return ERR_OK;
+    }
+    if (conn->events) {
+        // Assinaturas só enviam; o que chegar é descartado
+        tcp_recved(pcb, p->tot_len);
+        pbuf_free(p);
+        return ERR_OK;
+    }
+
+    conn->last_active = sys_now();
+    conn->ws_pinged = false;
+    if (conn->rx) {
+        pbuf_cat(conn->rx, p);
+    } else {
+        conn->rx = p;
+    }
+    return conn_process(conn);
+}
+
+static err_t http_server_sent(void *arg, struct tcp_pcb *pcb, u16_t len) {
+    http_conn_t *conn = (http_conn_t *)arg;
+    conn->last_active = sys_now();
+    if (conn->events) {
+        // Primeiro os cabeçalhos, depois o fluxo do anel
+        u16_t head = conn->header_len - conn->sent_len < len ? (u16_t)(conn->header_len - conn->sent_len) : len;
+        conn->sent_len += head;
+        conn->ev_acked += len - head;
+        events_pump(conn);
+        return ERR_OK;
+    }
+    conn->sent_len += len;
+    if (!conn_pump(conn)) return conn_close(conn, pcb, ERR_OK);
+    if (conn->ws || conn_sending(conn)) return ERR_OK;
+
+    // Resposta confirmada: segue para a próxima requisição em pipeline
+    release_shared(conn);
+    if (!conn->keep_alive || (conn->peer_closed && !conn->rx)) {
+        return conn_close(conn, pcb, ERR_OK);
+    }
+    conn_reset(conn);
+    return conn_process(conn);
+}
+
+static void http_server_err(void *arg, err_t err) {
+    // O lwIP já liberou o PCB; resta liberar o estado da conexão
+    http_conn_t *conn = (http_conn_t *)arg;
+    if (conn) conn_close(conn, NULL, err);
+}
+
+static err_t http_server_poll(void *arg, struct tcp_pcb *pcb) {
+    http_conn_t *conn = (http_conn_t *)arg;
+    if (sys_now() - conn->last_active >= HTTP_IDLE_TIMEOUT_MS) {
+        return conn_close(conn, pcb, ERR_OK);
+    }
+    if (conn->events && sys_now() - ev_last_write >= HTTP_EVENTS_HEARTBEAT_MS) {
+        static const char heartbeat[] = ":\n\n";
+        // events_write desconectaria esta assinatura por dentro do callback
+        if (events_lagging(conn, sizeof(heartbeat) - 1)) return conn_close(conn, pcb, ERR_OK);
+        events_write(heartbeat, sizeof(heartbeat) - 1);
+    }
+    if (conn->ws && !conn->ws_pinged && sys_now() - conn->last_active >= HTTP_EVENTS_HEARTBEAT_MS) {
+        conn->ws_pinged = ws_write(conn, WS_OP_PING, NULL, 0);
+        if (conn->ws_broken) return conn_close(conn, pcb, ERR_OK);
+    }
+    return ERR_OK;
+}
+
+// Conexão aberta sem nenhuma requisição em andamento
+static bool conn_idle(const http_conn_t *conn) {
+    return !conn->rx && !conn->responded && !http_parser_started(&conn->parser);
+}
+
+// Vaga para uma nova conexão; fecha a ociosa mais antiga se preciso
+static int conn_slot(void) {
+    int oldest = -1;
+    for (int i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+        if (!conns[i]) return i;
+        if (conn_idle(conns[i]) &&
+            (oldest < 0 || (int32_t)(conns[i]->last_active - conns[oldest]->last_active) < 0)) {
+            oldest = i;
+        }
+    }
+    if (oldest >= 0) conn_close(conns[oldest], conns[oldest]->pcb, ERR_OK);
+    return oldest;
+}
+
+// Todas as vagas ocupadas: 503 na hora, sem estado, em vez de deixar o
+// cliente esperando o SYN ser retransmitido
+static err_t respond_busy(struct tcp_pcb *pcb) {
+    static const char busy[] =
+        "HTTP/1.1 503 Service Unavailable\r\n"
+        "Content-Length: 0\r\n"
+        "Retry-After: 1\r\n"
+        "Access-Control-Allow-Origin: *\r\n"
+        "Connection: close\r\n\r\n";
+    busy_count++;
+    // O texto é constante e vai sem cópia; depois do tcp_close o lwIP termina
+    // o envio sozinho e descarta o que o cliente mandar
+    if (tcp_write(pcb, busy, sizeof(busy) - 1, 0) != ERR_OK || tcp_close(pcb) != ERR_OK) {
+        tcp_abort(pcb);
+        return ERR_ABRT;
+    }
+    return ERR_OK;
+}
+
+static err_t http_server_accept(void *arg, struct tcp_pcb *client_pcb, err_t err) {
+    if (err != ERR_OK || client_pcb == NULL) return ERR_VAL;
+
+    int slot = conn_slot();
+    http_conn_t *conn = slot < 0 ? NULL : slab_alloc(&conn_pool);
+    if (!conn) return respond_busy(client_pcb);
+    conns[slot] = conn;
+    conn->pcb = client_pcb;
+    conn->last_active = sys_now();
+    conn_reset(conn);
+
+    tcp_arg(client_pcb, conn);
+    tcp_sent(client_pcb, http_server_sent);
+    tcp_recv(client_pcb, http_server_recv);
+    tcp_poll(client_pcb, http_server_poll, POLL_INTERVAL);
+    tcp_err(client_pcb, http_server_err);
+    return ERR_OK;
+}
+
+bool http_server_open(const http_route_t *route_table, size_t count) {
+    routes = route_table;
+    route_count = count;
+
+    struct tcp_pcb *pcb = tcp_new_ip_type(IPADDR_TYPE_ANY);
+    if (!pcb) return false;
+    if (tcp_bind(pcb, IP_ANY_TYPE, HTTP_SERVER_PORT) != ERR_OK) {
+        tcp_close(pcb);
+        return false;
+    }
+    server_pcb = tcp_listen_with_backlog(pcb, 5);
+    if (!server_pcb) {
+        tcp_close(pcb);
+        return false;
+    }
+    tcp_accept(server_pcb, http_server_accept);
+    return true;
+}
+
+void http_server_close(void) {
+    if (server_pcb) {
+        tcp_arg(server_pcb, NULL);
+        tcp_close(server_pcb);
+        server_pcb = NULL;
+    }
+}
+
+bool http_events_publish(const char *event, const char *data) {
+    static char text[HTTP_EVENTS_MAX];
+    int len = snprintf(text, sizeof(text), "id: %lu\nevent: %s\ndata: %s\n\n",
+                       (unsigned long)(ev_id + 1), event, data);
+    if (len < 0 || len >= (int)sizeof(text)) return false;
+    ev_id++;
+    events_write(text, (size_t)len);
+    return true;
+}
+
+size_t http_events_subscribers(void) {
+    size_t n = 0;
+    for (int i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+        if (conns[i] && conns[i]->events) n++;
+    }
+    return n;
+}
+
+bool http_events_ready(size_t len) {
+    for (int i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+        if (conns[i] && conns[i]->events && events_lagging(conns[i], len)) return false;
+    }
+    return true;
+}
+
+uint32_t http_events_joined(void) {
+    return ev_joined;
+}
+
+bool http_ws_send(http_ws_t *ws, const void *data, size_t len) {
+    if (ws_write(ws, WS_OP_BINARY, data, len)) return true;
+    // Fecha no fim do conn_process, que está chamando ws_message
+    if (!ws->ws_close) ws->ws_close = WS_CLOSE_TRY_LATER;
+    return false;
+}
+
+size_t http_ws_broadcast(const void *data, size_t len) {
+    size_t n = 0;
+    for (int i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+        http_conn_t *conn = conns[i];
+        if (!conn || !conn->ws) continue;
+        if (ws_write(conn, WS_OP_BINARY, data, len)) {
+            n++;
+        } else {
+            // Mensagem perdida: o cliente reconecta e recebe o estado inteiro
+            printf("HTTP: cliente WebSocket sem espaco para a mensagem, desconectado\n");
+            ws_close(conn, WS_CLOSE_TRY_LATER);
+        }
+    }
+    return n;
+}
+
+bool http_ws_ready(size_t len) {
+    for (int i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+        if (conns[i] && conns[i]->ws && !ws_fits(conns[i]->pcb, len)) return false;
+    }
+    return true;
+}
+
+size_t http_ws_clients(void) {
+    size_t n = 0;
+    for (int i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+        if (conns[i] && conns[i]->ws) n++;
+    }
+    return n;
+}
+
+uint32_t http_ws_joined(void) {
+    return ws_joined;
+}
+
+void http_server_stats(http_server_stats_t *stats) {
+    stats->connections = conn_pool.in_use;
+    stats->high_water = conn_pool.high_water;
+    stats->busy = busy_count;
+}
+
+bool http_accepts(const http_request_t *req, const char *media_type) {
+    size_t len = strlen(media_type);
+    const char *p = req->accept;
+    while (*p) {
+        while (*p == ' ' || *p == ',') p++;
+        bool match = strncasecmp(p, media_type, len) == 0 && (p[len] == '\0' || strchr(",; ", p[len]));
+        while (*p && *p != ',') {
+            // q=0 (ou 0.000) recusa o tipo
+            if (*p == ';') {
+                const char *q = p + 1;
+                while (*q == ' ') q++;
+                if (match && (q[0] == 'q' || q[0] == 'Q') && q[1] == '=') {
+                    q += 2;
+                    while (*q == '0' || *q == '.') q++;
+                    if (*q == '\0' || *q == ',' || *q == ';' || *q == ' ') match = false;
+                }
+            }
+            p++;
+        }
+        if (match) return true;
+    }
+    return false;
+}
+
+void http_response_text(http_response_t *res, const char *text) {
+    res->body_len = (size_t)snprintf(res->body, HTTP_RESPONSE_MAX, "%s", text);
+    if (res->body_len >= HTTP_RESPONSE_MAX) res->body_len = HTTP_RESPONSE_MAX - 1;
+}
@@ -0,0 +1,237 @@
+/**
+ * @file http_server.h
+ *
+ * Servidor HTTP da urna sobre a API raw TCP do lwIP.
+ *
+ * As requisições são interpretadas pelo http_parser diretamente nos pbufs
+ * recebidos, em quantos segmentos TCP chegarem, e despachadas por uma tabela
+ * de rotas (método + caminho). O corpo, quando a rota aceita um, é acumulado
+ * em um único buffer estático de HTTP_BODY_MAX bytes: nenhuma memória é
+ * alocada por requisição. Rotas com 'body_stream' recebem o corpo em
+ * trechos, direto dos pbufs e à medida que os segmentos chegam, e por isso
+ * não têm limite de tamanho.
+ *
+ * A resposta é montada no buffer da própria conexão, ou então aponta para
+ * um http_shared_body_t mantido pela aplicação: o mesmo documento é enviado
+ * sem cópia para todas as conexões, que o seguram (refs) até o último ACK.
+ * Uma resposta 200 com 'etag' que casa com o If-None-Match da requisição é
+ * trocada por 304 Not Modified, sem corpo.
+ *
+ * Nenhum corpo é entregue ao lwIP além do que cabe em tcp_sndbuf: o resto
+ * segue a cada ACK. Corpos que não cabem em buffer nenhum vêm de um gerador
+ * ('stream'), chamado só para o trecho que cabe no momento. Com tamanho
+ * desconhecido (HTTP_LENGTH_UNKNOWN), a resposta sai em chunked, ou, para
+ * clientes HTTP/1.0, termina no fechamento da conexão.
+ *
+ * As conexões são persistentes (keep-alive do HTTP/1.1) e aceitam
+ * requisições em pipeline: elas são respondidas em ordem, e a próxima só é
+ * interpretada depois que a resposta anterior foi confirmada pelo cliente,
+ * porque o lwIP envia direto dos buffers da conexão. Até lá os bytes ficam
+ * nos pbufs, e a janela do TCP só reabre para o que já foi consumido.
+ * Conexões ociosas fecham depois de HTTP_IDLE_TIMEOUT_MS. O estado das
+ * conexões vem de um pool estático de HTTP_MAX_CONNECTIONS blocos; com todos
+ * em uso, uma nova conexão fecha a ociosa mais antiga, ou recebe um 503
+ * imediato se todas estiverem ocupadas.
+ *
+ * Rotas marcadas com 'events' viram assinaturas de Server-Sent Events: a
+ * conexão fica aberta e recebe os eventos publicados com
+ * http_events_publish. Cada evento é serializado uma única vez em um anel
+ * compartilhado, e todas as assinaturas enviam direto dele (sem cópia) a
+ * partir da própria posição. Um assinante que deixa de confirmar dados a
+ * ponto de o anel precisar sobrescrevê-los é desconectado (o EventSource
+ * reconecta sozinho). Sem eventos, um comentário vazio sai a cada
+ * HTTP_EVENTS_HEARTBEAT_MS para manter as conexões vivas.
+ *
+ * Rotas com 'ws_message' aceitam o upgrade para WebSocket (RFC 6455): cada
+ * mensagem recebida (binária ou texto, já sem máscara e remontada dos
+ * fragmentos no buffer de corpos) vai para ws_message, que pode responder
+ * com http_ws_send. O servidor responde a PING, fecha em resposta a CLOSE e
+ * manda PING depois de HTTP_EVENTS_HEARTBEAT_MS sem atividade.
+ */
+
+#ifndef HTTP_SERVER_H
+#define HTTP_SERVER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "http_parser.h"
+
+#define HTTP_SERVER_PORT 80
+#define HTTP_BODY_MAX 8192          // Maior corpo acumulado (e mensagem WebSocket)
+#define HTTP_RESPONSE_MAX 2048      // Maior corpo de resposta
+#define HTTP_MAX_CONNECTIONS 4      // Conexões simultâneas
+#define HTTP_IDLE_TIMEOUT_MS 10000  // Conexão sem requisição é fechada
+
+#define HTTP_EVENTS_RING_SIZE 4096  // Anel de eventos (potência de 2)
+#define HTTP_EVENTS_MAX 1024        // Maior evento serializado
+#define HTTP_EVENTS_HEARTBEAT_MS 5000
+
+typedef struct {
+    http_method_t method;
+    const char *path;
+    const char *body;           // Terminado em '\0'; NULL se não houver corpo ou se veio por body_stream
+    size_t body_len;            // Com body_stream, o total entregue em trechos
+    const char *accept;         // Cabeçalho Accept ("" se ausente)
+} http_request_t;
+
+// Corpo de resposta mantido pela aplicação e compartilhado pelas conexões
+typedef struct {
+    const char *data;
+    size_t len;
+    uint16_t refs;              // Respostas em envio; 'data' só muda com 0
+} http_shared_body_t;
+
+#define HTTP_LENGTH_UNKNOWN SIZE_MAX   // body_len de um corpo gerado sem tamanho
+#define HTTP_STREAM_ERROR SIZE_MAX     // Retorno do gerador: aborta a conexão
+
+/**
+ * @brief Gera o corpo da resposta a partir de 'offset', até 'max' bytes.
+ *
+ * Com body_len conhecido, cada chamada precisa preencher os 'max' bytes
+ * pedidos (o servidor nunca pede além do fim). Com HTTP_LENGTH_UNKNOWN,
+ * qualquer quantidade serve e 0 encerra o corpo.
+ *
+ * Cada trecho é pedido uma vez, na ordem: o que o lwIP não aceitou fica com
+ * o servidor, então o gerador pode guardar a posição em 'ctx'. Quando a
+ * resposta termina (ou é abandonada, ou vira 304), a função é chamada uma
+ * última vez com 'buf' NULL, para liberar 'ctx'.
+ * @return Bytes gerados, ou HTTP_STREAM_ERROR.
+ */
+typedef size_t (*http_body_fn)(void *ctx, size_t offset, uint8_t *buf, size_t max);
+
+typedef struct {
+    int status;                 // 200 se o handler não alterar
+    const char *content_type;   // "text/plain" se o handler não alterar
+    char *body;                 // Buffer de HTTP_RESPONSE_MAX bytes
+    size_t body_len;
+    http_shared_body_t *shared; // Se definido, enviado no lugar de 'body'
+    http_body_fn stream;        // Se definido, gera o corpo (body_len ou HTTP_LENGTH_UNKNOWN)
+    void *stream_ctx;
+    const char *etag;           // Com aspas; se casar com If-None-Match vira 304
+} http_response_t;
+
+typedef void (*http_handler_t)(const http_request_t *req, http_response_t *res);
+
+/**
+ * @brief Trecho do corpo de uma rota com body_stream, na ordem do fluxo.
+ *
+ * 'offset' 0 começa um corpo novo. Se a requisição termina antes do fim do
+ * corpo (conexão perdida ou erro), a função é chamada uma última vez com
+ * 'data' NULL. O handler da rota só é chamado com o corpo completo.
+ * @return false para recusar o corpo (a requisição recebe 400).
+ */
+typedef bool (*http_body_handler_t)(size_t offset, const uint8_t *data, size_t len);
+
+// Conexão WebSocket, válida durante a chamada de ws_message
+typedef struct http_conn http_ws_t;
+typedef void (*http_ws_handler_t)(http_ws_t *ws, const uint8_t *msg, size_t len);
+
+typedef struct {
+    http_method_t method;
+    const char *path;
+    http_handler_t handler;
+    bool has_body;              // A rota recebe corpo (até HTTP_BODY_MAX)
+    bool events;                // Assinatura de eventos (handler não é usado)
+    http_ws_handler_t ws_message; // Rota WebSocket (handler não é usado)
+    http_body_handler_t body_stream; // Corpo em trechos, sem passar pelo buffer
+} http_route_t;
+
+typedef struct {
+    uint8_t connections;        // Conexões abertas agora
+    uint8_t high_water;         // Pico de conexões simultâneas
+    uint32_t busy;              // Conexões recusadas com 503
+} http_server_stats_t;
+
+/**
+ * @brief Abre o servidor na porta HTTP_SERVER_PORT com a tabela de rotas.
+ * A tabela precisa continuar válida enquanto o servidor estiver aberto.
+ */
+bool http_server_open(const http_route_t *routes, size_t count);
+
+/**
+ * @brief Fecha o socket de escuta.
+ */
+void http_server_close(void);
+
+/**
+ * @brief Contadores do pool de conexões.
+ */
+void http_server_stats(http_server_stats_t *stats);
+
+/**
+ * @brief Publica um evento para todas as assinaturas.
+ *
+ * Deve ser chamada com o lwIP travado (cyw43_arch_lwip_begin) quando fora
+ * dos callbacks do servidor.
+ * @param event Nome do evento (campo "event:").
+ * @param data Dados do evento, em uma única linha.
+ * @return false se o evento não cabe em HTTP_EVENTS_MAX.
+ */
+bool http_events_publish(const char *event, const char *data);
+
+/**
+ * @brief Quantidade de assinaturas abertas.
+ */
+size_t http_events_subscribers(void);
+
+/**
+ * @brief Todas as assinaturas aceitam mais um evento de até 'len' bytes
+ * sem que o anel sobrescreva o que alguma delas ainda não confirmou (o que
+ * a desconectaria).
+ */
+bool http_events_ready(size_t len);
+
+/**
+ * @brief Contador de novas assinaturas: quando muda, quem publica deve
+ * mandar o estado completo, que os novos assinantes ainda não têm.
+ */
+uint32_t http_events_joined(void);
+
+/**
+ * @brief Envia uma mensagem binária por uma conexão WebSocket.
+ * Sem espaço no buffer de envio do TCP a mensagem não sai e a conexão é
+ * fechada (CLOSE 1013) ao fim de ws_message: o cliente reconecta e pede o
+ * estado de novo, em vez de esperar uma resposta que não vem.
+ * @return false se a mensagem não foi enviada.
+ */
+bool http_ws_send(http_ws_t *ws, const void *data, size_t len);
+
+/**
+ * @brief Envia uma mensagem binária para todas as conexões WebSocket.
+ * Mesmas condições de trava de http_events_publish.
+ * Conexões sem espaço para a mensagem são fechadas, como os assinantes
+ * atrasados de eventos; ao reconectar recebem o estado inteiro.
+ * @return Quantidade de conexões que receberam a mensagem.
+ */
+size_t http_ws_broadcast(const void *data, size_t len);
+
+/**
+ * @brief Todas as conexões WebSocket têm espaço no buffer de envio do TCP
+ * para uma mensagem de até 'len' bytes.
+ */
+bool http_ws_ready(size_t len);
+
+/**
+ * @brief Quantidade de conexões WebSocket abertas.
+ */
+size_t http_ws_clients(void);
+
+/**
+ * @brief Contador de novas conexões WebSocket (ver http_events_joined).
+ */
+uint32_t http_ws_joined(void);
+
+/**
+ * @brief Confere se o Accept da requisição lista 'media_type' (sem curingas)
+ * com qualidade maior que zero.
+ */
+bool http_accepts(const http_request_t *req, const char *media_type);
+
+/**
+ * @brief Copia um texto fixo para o corpo da resposta.
+ */
+void http_response_text(http_response_t *res, const char *text);
+
+#endif // HTTP_SERVER_H
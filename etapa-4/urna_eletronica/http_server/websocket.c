@@ -0,0 +1,209 @@
+#include <string.h>
+
+#include "websocket.h"
+
+enum {
+    S_HEADER0,
+    S_HEADER1,
+    S_EXT_LEN,
+    S_MASK,
+    S_PAYLOAD,
+    S_ERROR,
+};
+
+static const char ws_guid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+void ws_parser_init(ws_parser_t *p, uint32_t max_len) {
+    memset(p, 0, sizeof(*p));
+    p->state = S_HEADER0;
+    p->max_len = max_len;
+}
+
+static void fail(ws_parser_t *p, uint16_t code) {
+    p->state = S_ERROR;
+    p->close_code = code;
+}
+
+// Tamanho conhecido: confere os limites e pede o destino do payload
+static void begin_payload(ws_parser_t *p, const ws_callbacks_t *cb, void *ctx) {
+    bool control = p->opcode & 0x8;
+    if (control && (!p->fin || p->len > WS_CONTROL_MAX)) {
+        fail(p, WS_CLOSE_PROTOCOL);
+        return;
+    }
+    if (p->len > p->max_len) {
+        fail(p, WS_CLOSE_TOO_BIG);
+        return;
+    }
+    p->dst = cb->on_frame ? cb->on_frame(ctx, p->opcode, p->fin, p->len) : NULL;
+    p->done = 0;
+    p->pos = 0;
+    p->state = S_MASK;
+}
+
+static void end_frame(ws_parser_t *p, const ws_callbacks_t *cb, void *ctx) {
+    p->state = S_HEADER0;
+    if (cb->on_frame_done) cb->on_frame_done(ctx);
+}
+
+size_t ws_parser_feed(ws_parser_t *p, const uint8_t *data, size_t len, const ws_callbacks_t *cb, void *ctx) {
+    size_t i = 0;
+    while (i < len && p->state != S_ERROR) {
+        if (p->state == S_PAYLOAD) {
+            size_t n = len - i < p->len - p->done ? len - i : p->len - p->done;
+            if (p->dst) {
+                for (size_t k = 0; k < n; k++) {
+                    p->dst[p->done + k] = data[i + k] ^ p->mask[(p->done + k) & 3];
+                }
+            }
+            i += n;
+            p->done += (uint32_t)n;
+            if (p->done == p->len) end_frame(p, cb, ctx);
+            continue;
+        }
+
+        uint8_t c = data[i++];
+        switch (p->state) {
+        case S_HEADER0:
+            // Sem extensões negociadas, os bits RSV precisam ser zero
+            if (c & 0x70) {
+                fail(p, WS_CLOSE_PROTOCOL);
+                break;
+            }
+            p->fin = c & 0x80;
+            p->opcode = c & 0x0f;
+            p->state = S_HEADER1;
+            break;
+
+        case S_HEADER1:
+            // Quadros do cliente sempre têm máscara
+            if (!(c & 0x80)) {
+                fail(p, WS_CLOSE_PROTOCOL);
+                break;
+            }
+            p->len = c & 0x7f;
+            p->pos = 0;
+            if (p->len >= 126) {
+                p->ext_len = p->len == 126 ? 2 : 8;
+                p->len = 0;
+                p->state = S_EXT_LEN;
+            } else {
+                begin_payload(p, cb, ctx);
+            }
+            break;
+
+        case S_EXT_LEN:
+            if (p->ext_len == 8 && p->pos < 4 && c != 0) {
+                fail(p, WS_CLOSE_TOO_BIG); // Mais de 4 GiB
+                break;
+            }
+            if (p->ext_len == 2 || p->pos >= 4) p->len = (p->len << 8) | c;
+            if (++p->pos == p->ext_len) begin_payload(p, cb, ctx);
+            break;
+
+        case S_MASK:
+            p->mask[p->pos++] = c;
+            if (p->pos == 4) {
+                if (p->len == 0) {
+                    end_frame(p, cb, ctx);
+                } else {
+                    p->state = S_PAYLOAD;
+                }
+            }
+            break;
+        }
+    }
+    return i;
+}
+
+size_t ws_frame_header(uint8_t hdr[WS_HEADER_MAX], uint8_t opcode, uint16_t len) {
+    hdr[0] = 0x80 | opcode;
+    if (len < 126) {
+        hdr[1] = (uint8_t)len;
+        return 2;
+    }
+    hdr[1] = 126;
+    hdr[2] = (uint8_t)(len >> 8);
+    hdr[3] = (uint8_t)len;
+    return 4;
+}
+
+#define ROTL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+// SHA-1 de uma mensagem curta (só o handshake usa)
+static void sha1(const uint8_t *msg, size_t len, uint8_t digest[20]) {
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    uint8_t block[64];
+    size_t total = (len + 9 + 63) / 64 * 64;
+
+    for (size_t off = 0; off < total; off += 64) {
+        for (size_t i = 0; i < 64; i++) {
+            size_t k = off + i;
+            if (k < len) {
+                block[i] = msg[k];
+            } else if (k == len) {
+                block[i] = 0x80;
+            } else if (k >= total - 8) {
+                block[i] = (uint8_t)(((uint64_t)len * 8) >> (8 * (total - 1 - k)));
+            } else {
+                block[i] = 0;
+            }
+        }
+
+        uint32_t w[80];
+        for (int i = 0; i < 16; i++) {
+            w[i] = ((uint32_t)block[4 * i] << 24) | ((uint32_t)block[4 * i + 1] << 16) |
+                   ((uint32_t)block[4 * i + 2] << 8) | block[4 * i + 3];
+        }
+        for (int i = 16; i < 80; i++) w[i] = ROTL(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; i++) {
+            uint32_t f, k;
+            if (i < 20) {
+                f = (b & c) | (~b & d);
+                k = 0x5A827999;
+            } else if (i < 40) {
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1;
+            } else if (i < 60) {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8F1BBCDC;
+            } else {
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6;
+            }
+            uint32_t t = ROTL(a, 5) + f + e + k + w[i];
+            e = d; d = c; c = ROTL(b, 30); b = a; a = t;
+        }
+        h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+    }
+
+    for (int i = 0; i < 5; i++) {
+        digest[4 * i] = (uint8_t)(h[i] >> 24);
+        digest[4 * i + 1] = (uint8_t)(h[i] >> 16);
+        digest[4 * i + 2] = (uint8_t)(h[i] >> 8);
+        digest[4 * i + 3] = (uint8_t)h[i];
+    }
+}
+
+void ws_accept_key(const char *key, char accept[WS_ACCEPT_LEN + 1]) {
+    static const char b64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    uint8_t msg[64 + sizeof(ws_guid)];
+    size_t key_len = strnlen(key, 64);
+    memcpy(msg, key, key_len);
+    memcpy(msg + key_len, ws_guid, sizeof(ws_guid) - 1);
+
+    uint8_t digest[21] = {0}; // 20 bytes + 1 de padding para o último grupo
+    sha1(msg, key_len + sizeof(ws_guid) - 1, digest);
+
+    char *out = accept;
+    for (int i = 0; i < 21; i += 3) {
+        uint32_t v = ((uint32_t)digest[i] << 16) | ((uint32_t)digest[i + 1] << 8) | digest[i + 2];
+        *out++ = b64[(v >> 18) & 63];
+        *out++ = b64[(v >> 12) & 63];
+        *out++ = i + 1 < 20 ? b64[(v >> 6) & 63] : '=';
+        *out++ = i + 2 < 20 ? b64[v & 63] : '=';
+    }
+    *out = '\0';
+}
@@ -0,0 +1,85 @@
+/**
+ * @file websocket.h
+ *
+ * Quadros WebSocket (RFC 6455) do lado do servidor.
+ *
+ * O parser é incremental como o http_parser: recebe pedaços arbitrários do
+ * fluxo, tira a máscara do payload (os quadros do cliente são sempre
+ * mascarados) e o grava onde a função on_frame indicar. Os quadros enviados
+ * pelo servidor não têm máscara; só o cabeçalho é montado aqui.
+ *
+ * O módulo não depende do SDK do Pico nem do lwIP.
+ */
+
+#ifndef WEBSOCKET_H
+#define WEBSOCKET_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define WS_OP_CONTINUATION 0x0
+#define WS_OP_TEXT 0x1
+#define WS_OP_BINARY 0x2
+#define WS_OP_CLOSE 0x8
+#define WS_OP_PING 0x9
+#define WS_OP_PONG 0xA
+
+#define WS_CLOSE_NORMAL 1000
+#define WS_CLOSE_PROTOCOL 1002
+#define WS_CLOSE_TOO_BIG 1009
+#define WS_CLOSE_TRY_LATER 1013
+
+#define WS_CONTROL_MAX 125     // Payload máximo dos quadros de controle
+#define WS_HEADER_MAX 4        // Cabeçalho de quadro do servidor (até 64 KiB)
+#define WS_ACCEPT_LEN 28       // Sec-WebSocket-Accept em base64
+
+typedef struct {
+    /**
+     * @brief Início de um quadro. 'len' já foi conferido contra max_len.
+     * @return Onde gravar o payload desmascarado (NULL descarta).
+     */
+    uint8_t *(*on_frame)(void *ctx, uint8_t opcode, bool fin, uint32_t len);
+    // Payload do quadro completo
+    void (*on_frame_done)(void *ctx);
+} ws_callbacks_t;
+
+typedef struct {
+    uint8_t state;
+    uint8_t opcode;
+    bool fin;
+    uint8_t pos;               // Bytes lidos do campo corrente
+    uint8_t ext_len;           // Bytes do tamanho estendido (2 ou 8)
+    uint8_t mask[4];
+    uint32_t len;
+    uint32_t done;             // Bytes do payload já recebidos
+    uint8_t *dst;
+    uint32_t max_len;          // Maior payload aceito
+    uint16_t close_code;       // Erro de protocolo, 0 se nenhum
+} ws_parser_t;
+
+/**
+ * @brief Prepara o parser; quadros com mais de 'max_len' bytes são recusados.
+ */
+void ws_parser_init(ws_parser_t *p, uint32_t max_len);
+
+/**
+ * @brief Consome bytes do fluxo. Depois de um erro (close_code != 0) não
+ * consome mais nada.
+ * @return Quantidade de bytes consumidos.
+ */
+size_t ws_parser_feed(ws_parser_t *p, const uint8_t *data, size_t len, const ws_callbacks_t *cb, void *ctx);
+
+/**
+ * @brief Monta o cabeçalho de um quadro final e sem máscara.
+ * @return Tamanho do cabeçalho (2 ou 4 bytes).
+ */
+size_t ws_frame_header(uint8_t hdr[WS_HEADER_MAX], uint8_t opcode, uint16_t len);
+
+/**
+ * @brief Calcula o Sec-WebSocket-Accept a partir do Sec-WebSocket-Key.
+ * @param accept Recebe WS_ACCEPT_LEN caracteres e o '\0'.
+ */
+void ws_accept_key(const char *key, char accept[WS_ACCEPT_LEN + 1]);
+
+#endif // WEBSOCKET_H
@@ -0,0 +1,328 @@
+#include <string.h>
+
+#include "json_stream.h"
+
+enum {
+    S_VALUE,            // Depois de ':' ou ',' em array, ou no começo
+    S_ARRAY_FIRST,      // Depois de '[': valor ou ']'
+    S_OBJECT_FIRST,     // Depois de '{': chave ou '}'
+    S_KEY,              // Depois de ',' em objeto
+    S_COLON,
+    S_NEXT,             // Depois de um valor: ',' ou fim do objeto/array
+    S_STRING,
+    S_ESCAPE,
+    S_UNICODE,
+    S_NUMBER,
+    S_LITERAL,          // true, false ou null
+    S_DONE,
+    S_ERROR,
+};
+
+void json_stream_init(json_stream_t *p) {
+    memset(p, 0, sizeof(*p));
+    p->state = S_VALUE;
+}
+
+static bool is_space(uint8_t c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static void text_reset(json_stream_t *p) {
+    p->len = 0;
+    p->truncated = false;
+}
+
+// Acrescenta bytes ao texto corrente; um caractere UTF-8 entra inteiro ou não entra
+static void put(json_stream_t *p, const char *bytes, uint8_t n) {
+    if (p->truncated) return;
+    if (p->len + n >= JSON_STREAM_STRING_MAX) {
+        p->truncated = true; // Daqui em diante nada mais entra
+        return;
+    }
+    memcpy(p->text + p->len, bytes, n);
+    p->len += n;
+}
+
+static void put_byte(json_stream_t *p, uint8_t c) {
+    // O byte inicial de um caractere UTF-8 só entra se couber o caractere todo;
+    // os de continuação vêm logo depois e param junto com ele
+    uint8_t n = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : c >= 0xC0 ? 2 : 1;
+    if (!p->truncated && p->len + n >= JSON_STREAM_STRING_MAX) p->truncated = true;
+    char b = (char)c;
+    put(p, &b, 1);
+}
+
+static void put_code(json_stream_t *p, uint32_t cp) {
+    char b[4];
+    if (cp < 0x80) {
+        b[0] = (char)cp;
+        put(p, b, 1);
+    } else if (cp < 0x800) {
+        b[0] = (char)(0xC0 | (cp >> 6));
+        b[1] = (char)(0x80 | (cp & 0x3F));
+        put(p, b, 2);
+    } else if (cp < 0x10000) {
+        b[0] = (char)(0xE0 | (cp >> 12));
+        b[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        b[2] = (char)(0x80 | (cp & 0x3F));
+        put(p, b, 3);
+    } else {
+        b[0] = (char)(0xF0 | (cp >> 18));
+        b[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+        b[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        b[3] = (char)(0x80 | (cp & 0x3F));
+        put(p, b, 4);
+    }
+}
+
+// Metade de um par UTF-16 sem a outra metade
+static void flush_surrogate(json_stream_t *p) {
+    if (p->surrogate) {
+        put(p, "?", 1);
+        p->surrogate = 0;
+    }
+}
+
+static const char *text(json_stream_t *p) {
+    p->text[p->len] = '\0';
+    return p->text;
+}
+
+static bool top_is_object(const json_stream_t *p) {
+    return p->depth > 0 && (p->objects & (1u << (p->depth - 1)));
+}
+
+static void value_done(json_stream_t *p) {
+    p->state = p->depth == 0 ? S_DONE : S_NEXT;
+}
+
+static void begin_container(json_stream_t *p, bool object, const json_stream_callbacks_t *cb, void *ctx) {
+    if (p->depth == JSON_STREAM_DEPTH_MAX) {
+        p->state = S_ERROR;
+        return;
+    }
+    p->depth++;
+    if (object) {
+        p->objects |= 1u << (p->depth - 1);
+    } else {
+        p->objects &= ~(1u << (p->depth - 1));
+    }
+    if (cb->on_begin) cb->on_begin(ctx, object, p->depth);
+    p->state = object ? S_OBJECT_FIRST : S_ARRAY_FIRST;
+}
+
+static void end_container(json_stream_t *p, bool object, const json_stream_callbacks_t *cb, void *ctx) {
+    if (p->depth == 0 || top_is_object(p) != object) {
+        p->state = S_ERROR;
+        return;
+    }
+    if (cb->on_end) cb->on_end(ctx, object, p->depth);
+    p->depth--;
+    value_done(p);
+}
+
+// Primeiro byte de um valor; false se não começa valor nenhum
+static bool begin_value(json_stream_t *p, uint8_t c, const json_stream_callbacks_t *cb, void *ctx) {
+    text_reset(p);
+    if (c == '{' || c == '[') {
+        begin_container(p, c == '{', cb, ctx);
+    } else if (c == '"') {
+        p->key = false;
+        p->state = S_STRING;
+    } else if (c == '-' || (c >= '0' && c <= '9')) {
+        put_byte(p, c);
+        p->state = S_NUMBER;
+    } else if (c == 't' || c == 'f' || c == 'n') {
+        put_byte(p, c);
+        p->state = S_LITERAL;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static void end_number(json_stream_t *p, const json_stream_callbacks_t *cb, void *ctx) {
+    if (cb->on_value) cb->on_value(ctx, JSON_NUMBER, text(p), p->depth);
+    value_done(p);
+}
+
+static void end_literal(json_stream_t *p, const json_stream_callbacks_t *cb, void *ctx) {
+    const char *t = text(p);
+    json_type_t type;
+    if (strcmp(t, "true") == 0) {
+        type = JSON_TRUE;
+    } else if (strcmp(t, "false") == 0) {
+        type = JSON_FALSE;
+    } else if (strcmp(t, "null") == 0) {
+        type = JSON_NULL;
+    } else {
+        p->state = S_ERROR;
+        return;
+    }
+    if (cb->on_value) cb->on_value(ctx, type, "", p->depth);
+    value_done(p);
+}
+
+static void end_string(json_stream_t *p, const json_stream_callbacks_t *cb, void *ctx) {
+    flush_surrogate(p);
+    if (p->key) {
+        if (cb->on_key) cb->on_key(ctx, text(p), p->depth);
+        p->state = S_COLON;
+    } else {
+        if (cb->on_value) cb->on_value(ctx, JSON_STRING, text(p), p->depth);
+        value_done(p);
+    }
+}
+
+static void end_unicode(json_stream_t *p) {
+    uint16_t code = p->code;
+    if (code >= 0xD800 && code < 0xDC00) {
+        flush_surrogate(p);
+        p->surrogate = code;
+    } else if (code >= 0xDC00 && code < 0xE000) {
+        if (p->surrogate) {
+            put_code(p, 0x10000 + (((uint32_t)p->surrogate - 0xD800) << 10) + (code - 0xDC00));
+            p->surrogate = 0;
+        } else {
+            put(p, "?", 1);
+        }
+    } else {
+        flush_surrogate(p);
+        put_code(p, code);
+    }
+    p->state = S_STRING;
+}
+
+static int hex_value(uint8_t c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+bool json_stream_feed(json_stream_t *p, const uint8_t *data, size_t len,
+                      const json_stream_callbacks_t *cb, void *ctx) {
+    size_t i = 0;
+    while (i < len && p->state != S_ERROR) {
+        uint8_t c = data[i];
+
+        switch (p->state) {
+        case S_STRING:
+            if (c == '"') {
+                end_string(p, cb, ctx);
+            } else if (c == '\\') {
+                p->state = S_ESCAPE;
+            } else if (c < 0x20) {
+                p->state = S_ERROR; // Caractere de controle sem escape
+            } else {
+                flush_surrogate(p);
+                put_byte(p, c);
+            }
+            break;
+
+        case S_ESCAPE: {
+            static const char from[] = "\"\\/bfnrt";
+            static const char to[] = "\"\\/\b\f\n\r\t";
+            const char *e = c ? strchr(from, c) : NULL;
+            if (c == 'u') {
+                p->hex = 0;
+                p->code = 0;
+                p->state = S_UNICODE;
+            } else if (e) {
+                flush_surrogate(p);
+                put(p, &to[e - from], 1);
+                p->state = S_STRING;
+            } else {
+                p->state = S_ERROR;
+            }
+            break;
+        }
+
+        case S_UNICODE: {
+            int v = hex_value(c);
+            if (v < 0) {
+                p->state = S_ERROR;
+                break;
+            }
+            p->code = (uint16_t)((p->code << 4) | v);
+            if (++p->hex == 4) end_unicode(p);
+            break;
+        }
+
+        case S_NUMBER:
+            if ((c >= '0' && c <= '9') || c == '.' || c == 'e' || c == 'E' || c == '+' || c == '-') {
+                put_byte(p, c);
+                break;
+            }
+            end_number(p, cb, ctx);
+            continue; // O byte que terminou o número é do próximo estado
+
+        case S_LITERAL:
+            if (c >= 'a' && c <= 'z') {
+                put_byte(p, c);
+                break;
+            }
+            end_literal(p, cb, ctx);
+            continue;
+
+        default:
+            if (is_space(c)) break;
+
+            switch (p->state) {
+            case S_ARRAY_FIRST:
+                if (c == ']') {
+                    end_container(p, false, cb, ctx);
+                    break;
+                }
+                // fall through
+            case S_VALUE:
+                if (!begin_value(p, c, cb, ctx)) p->state = S_ERROR;
+                break;
+
+            case S_OBJECT_FIRST:
+                if (c == '}') {
+                    end_container(p, true, cb, ctx);
+                    break;
+                }
+                // fall through
+            case S_KEY:
+                if (c == '"') {
+                    text_reset(p);
+                    p->key = true;
+                    p->state = S_STRING;
+                } else {
+                    p->state = S_ERROR;
+                }
+                break;
+
+            case S_COLON:
+                p->state = c == ':' ? S_VALUE : S_ERROR;
+                break;
+
+            case S_NEXT:
+                if (c == ',') {
+                    p->state = top_is_object(p) ? S_KEY : S_VALUE;
+                } else if (c == '}' || c == ']') {
+                    end_container(p, c == '}', cb, ctx);
+                } else {
+                    p->state = S_ERROR;
+                }
+                break;
+
+            case S_DONE:
+                p->state = S_ERROR; // Só espaços depois do documento
+                break;
+            }
+            break;
+        }
+        i++;
+    }
+    return p->state != S_ERROR;
+}
+
+bool json_stream_finish(json_stream_t *p, const json_stream_callbacks_t *cb, void *ctx) {
+    // Um número ou literal solto só termina no fim do documento
+    if (p->depth == 0 && p->state == S_NUMBER) end_number(p, cb, ctx);
+    if (p->depth == 0 && p->state == S_LITERAL) end_literal(p, cb, ctx);
+    return p->state == S_DONE;
+}
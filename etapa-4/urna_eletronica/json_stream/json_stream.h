@@ -0,0 +1,83 @@
+/**
+ * @file json_stream.h
+ *
+ * Parser JSON incremental, no estilo SAX.
+ *
+ * Como o http_parser, é alimentado com pedaços arbitrários do fluxo (um
+ * documento pode chegar dividido em qualquer ponto, inclusive no meio de
+ * uma string ou de um escape \uXXXX) e não monta árvore nenhuma: cada
+ * chave, valor e início ou fim de objeto/array vira uma chamada de
+ * callback, na ordem do documento. A memória usada é só a do próprio
+ * json_stream_t, qualquer que seja o tamanho do documento: strings maiores
+ * que JSON_STREAM_STRING_MAX são truncadas, e o aninhamento vai até
+ * JSON_STREAM_DEPTH_MAX níveis.
+ *
+ * O módulo não depende do SDK do Pico nem do lwIP.
+ */
+
+#ifndef JSON_STREAM_H
+#define JSON_STREAM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define JSON_STREAM_STRING_MAX 64   // Maior string/número entregue, com o '\0'
+#define JSON_STREAM_DEPTH_MAX 32
+
+typedef enum {
+    JSON_STRING,
+    JSON_NUMBER,                // Texto do número, sem conversão
+    JSON_TRUE,
+    JSON_FALSE,
+    JSON_NULL,
+} json_type_t;
+
+/**
+ * @brief Funções chamadas pelo parser. Todas podem ser NULL.
+ *
+ * 'depth' é o nível do objeto ou array onde está a chave ou o valor (1 para
+ * o documento de fora); on_begin e on_end recebem o nível do próprio
+ * objeto ou array.
+ */
+typedef struct {
+    void (*on_begin)(void *ctx, bool object, uint8_t depth);
+    void (*on_end)(void *ctx, bool object, uint8_t depth);
+    // Chave já sem aspas e com os escapes resolvidos, terminada em '\0'
+    void (*on_key)(void *ctx, const char *key, uint8_t depth);
+    // Valor escalar; 'text' terminado em '\0' (vazio para true/false/null)
+    void (*on_value)(void *ctx, json_type_t type, const char *text, uint8_t depth);
+} json_stream_callbacks_t;
+
+typedef struct {
+    uint8_t state;
+    uint8_t depth;
+    uint32_t objects;           // Bit n: o nível n+1 é um objeto
+    bool key;                   // A string corrente é uma chave
+    char text[JSON_STREAM_STRING_MAX];
+    uint8_t len;
+    bool truncated;             // O texto corrente não coube inteiro
+    uint8_t hex;                // Dígitos lidos do \uXXXX
+    uint16_t code;              // Valor do \uXXXX em leitura
+    uint16_t surrogate;         // Primeira metade de um par \uD8xx\uDCxx
+} json_stream_t;
+
+/**
+ * @brief Prepara o parser para um novo documento.
+ */
+void json_stream_init(json_stream_t *p);
+
+/**
+ * @brief Consome bytes do documento. Depois de um erro não consome mais nada.
+ * @return false se o documento é inválido.
+ */
+bool json_stream_feed(json_stream_t *p, const uint8_t *data, size_t len,
+                      const json_stream_callbacks_t *cb, void *ctx);
+
+/**
+ * @brief Fim do documento (entrega um número que ainda estava em leitura).
+ * @return true se um documento completo e válido foi lido.
+ */
+bool json_stream_finish(json_stream_t *p, const json_stream_callbacks_t *cb, void *ctx);
+
+#endif // JSON_STREAM_H
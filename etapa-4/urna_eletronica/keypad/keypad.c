@@ -0,0 +1,113 @@
+#include "hardware/clocks.h"
+#include "hardware/irq.h"
+#include "hardware/pio.h"
+#include "hardware/sync.h"
+#include "pico/time.h"
+
+#include "keypad.h"
+#include "keypad.pio.h"
+
+#define QUEUE_MASK (KEYPAD_QUEUE_LEN - 1)
+// Ciclo de 5 us: 40 us para cada linha assentar, ~10 ms de repique
+#define PIO_CLOCK_HZ 200000
+
+_Static_assert((KEYPAD_QUEUE_LEN & QUEUE_MASK) == 0, "KEYPAD_QUEUE_LEN deve ser potencia de 2");
+
+static const uint row_pins[4] = KEYPAD_ROW_PINS;
+static const char KEY_MAP[4][4] = {
+    {'1', '2', '3', 'A'}, {'4', '5', '6', 'B'},
+    {'7', '8', '9', 'C'}, {'*', '0', '#', 'D'}
+};
+
+static PIO pio;
+static uint sm;
+static uint32_t last_keys;      // Último estado entregue pela PIO
+
+static keypad_event_t queue[KEYPAD_QUEUE_LEN];
+static volatile uint32_t q_head; // Escrito apenas pela interrupção
+static volatile uint32_t q_tail; // Escrito apenas pelo laço principal
+static keypad_stats_t stats;
+
+static void publish(char key, bool pressed, uint32_t now) {
+    if (q_head - q_tail == KEYPAD_QUEUE_LEN) {
+        stats.dropped++;
+        return;
+    }
+    queue[q_head & QUEUE_MASK] = (keypad_event_t){key, pressed, now};
+    __dmb(); // O evento precisa estar visível antes do novo head
+    q_head++;
+    stats.events++;
+}
+
+// Cada palavra da FIFO é o estado das 16 teclas (linha 0 nos bits altos);
+// as diferenças para o anterior viram eventos
+static void keypad_irq(void) {
+    while (!pio_sm_is_rx_fifo_empty(pio, sm)) {
+        uint32_t keys = pio_sm_get(pio, sm) & 0xFFFFu;
+        uint32_t changed = keys ^ last_keys;
+        uint32_t now = time_us_32();
+        last_keys = keys;
+        for (; changed; changed &= changed - 1) {
+            uint bit = (uint)__builtin_ctz(changed);
+            publish(KEY_MAP[3 - bit / 4][bit % 4], (keys >> bit) & 1u, now);
+        }
+    }
+}
+
+bool keypad_init(void) {
+    uint offset;
+    // Linhas e colunas ocupam os GPIO 4 a 20
+    if (!pio_claim_free_sm_and_add_program_for_gpio_range(&keypad_program, &pio, &sm, &offset,
+                                                          row_pins[0], KEYPAD_COL_BASE + 4 - row_pins[0], true)) {
+        return false;
+    }
+
+    uint32_t row_mask = 0;
+    for (int i = 0; i < 4; i++) {
+        pio_gpio_init(pio, row_pins[i]);
+        row_mask |= 1u << row_pins[i];
+        uint col = KEYPAD_COL_BASE + i;
+        gpio_init(col); gpio_set_dir(col, GPIO_IN); gpio_pull_down(col);
+    }
+    pio_sm_set_pins_with_mask(pio, sm, 0, row_mask);
+    pio_sm_set_pindirs_with_mask(pio, sm, row_mask, row_mask);
+
+    pio_sm_config c = keypad_program_get_default_config(offset);
+    sm_config_set_set_pins(&c, row_pins[0], 5);     // Linhas 0 e 1 (valores 1 e 16)
+    sm_config_set_sideset_pins(&c, row_pins[2]);
+    sm_config_set_out_pins(&c, row_pins[3], 1);
+    sm_config_set_in_pins(&c, KEYPAD_COL_BASE);
+    sm_config_set_in_shift(&c, false, false, 32);
+    sm_config_set_out_shift(&c, true, false, 32);   // A espera conta 32 bits do OSR
+    sm_config_set_clkdiv(&c, (float)clock_get_hz(clk_sys) / PIO_CLOCK_HZ);
+    pio_sm_init(pio, sm, offset, &c);
+
+    // Nenhuma tecla confirmada e OSR cheio: a primeira leitura é uma leitura comum
+    pio_sm_exec(pio, sm, pio_encode_set(pio_x, 0));
+    pio_sm_exec(pio, sm, pio_encode_mov(pio_osr, pio_null));
+
+    last_keys = 0;
+    q_head = q_tail = 0;
+    uint irq = pio_get_irq_num(pio, 0);
+    pio_set_irqn_source_enabled(pio, 0, pio_get_rx_fifo_not_empty_interrupt_source(sm), true);
+    irq_add_shared_handler(irq, keypad_irq, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(irq, true);
+
+    pio_sm_set_enabled(pio, sm, true);
+    return true;
+}
+
+bool keypad_next(keypad_event_t *event) {
+    if (q_tail == q_head) return false;
+    __dmb(); // Lê o evento somente depois de observar o head
+    *event = queue[q_tail & QUEUE_MASK];
+    __dmb();
+    q_tail++;
+    uint32_t latency = time_us_32() - event->time_us;
+    if (latency > stats.max_latency_us) stats.max_latency_us = latency;
+    return true;
+}
+
+void keypad_stats(keypad_stats_t *stats_out) {
+    *stats_out = stats;
+}
@@ -0,0 +1,56 @@
+/**
+ * @file keypad.h
+ *
+ * Teclado matricial 4x4 varrido por uma máquina de estados da PIO.
+ *
+ * A PIO varre a matriz sem parar (uma varredura a cada ~200 us), espera o
+ * repique de cada mudança (~10 ms) e só então entrega o estado novo das 16
+ * teclas na FIFO RX. A interrupção da FIFO compara com o estado anterior e
+ * enfileira um evento por tecla apertada ou solta, com o instante da
+ * confirmação. A CPU não lê os pinos nem espera a tecla ser solta: o laço
+ * principal só consome a fila.
+ *
+ * Os pinos das linhas estão fixos no programa da PIO (keypad.pio).
+ */
+
+#ifndef KEYPAD_H
+#define KEYPAD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Linhas: GPIO 4, 8, 9 e 16; colunas: GPIO 17 a 20
+#define KEYPAD_ROW_PINS {4, 8, 9, 16}
+#define KEYPAD_COL_BASE 17
+// Eventos esperando o laço principal
+#define KEYPAD_QUEUE_LEN 32
+
+typedef struct {
+    char key;
+    bool pressed;               // false quando a tecla é solta
+    uint32_t time_us;           // time_us_32() da confirmação pela PIO
+} keypad_event_t;
+
+typedef struct {
+    uint32_t events;            // Eventos enfileirados desde o boot
+    uint32_t dropped;           // Descartados com a fila cheia
+    uint32_t max_latency_us;    // Maior espera entre a confirmação e o consumo
+} keypad_stats_t;
+
+/**
+ * @brief Configura os pinos, carrega o programa em uma PIO livre e liga a
+ * interrupção da FIFO. Deve ser chamada antes de cyw43_arch_init, que
+ * também usa uma PIO.
+ * @return false sem máquina de estados ou memória de programa livre.
+ */
+bool keypad_init(void);
+
+/**
+ * @brief Retira o evento mais antigo da fila.
+ * @return false com a fila vazia.
+ */
+bool keypad_next(keypad_event_t *event);
+
+void keypad_stats(keypad_stats_t *stats);
+
+#endif // KEYPAD_H
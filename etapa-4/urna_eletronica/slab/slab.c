@@ -0,0 +1,25 @@
+#include <string.h>
+
+#include "slab.h"
+
+void *slab_alloc(slab_t *slab) {
+    for (uint8_t i = 0; i < slab->count; i++) {
+        if (slab->used & (1u << i)) continue;
+        slab->used |= 1u << i;
+        if (++slab->in_use > slab->high_water) slab->high_water = slab->in_use;
+        uint8_t *block = slab->blocks + i * slab->block_size;
+        memset(block, 0, slab->block_size);
+        return block;
+    }
+    slab->failures++;
+    return NULL;
+}
+
+void slab_free(slab_t *slab, void *block) {
+    if (!block) return;
+    size_t i = (size_t)((uint8_t *)block - slab->blocks) / slab->block_size;
+    if (i < slab->count && (slab->used & (1u << i))) {
+        slab->used &= ~(1u << i);
+        slab->in_use--;
+    }
+}
@@ -0,0 +1,49 @@
+/**
+ * @file slab.h
+ *
+ * Pools de blocos de tamanho fixo em memória estática.
+ *
+ * Guardam o estado das conexões TCP no lugar de calloc/free: os blocos são
+ * reservados em tempo de compilação, então muitas conexões curtas não
+ * fragmentam o heap nem fazem o accept falhar por falta de memória. A
+ * alocação é uma busca em um bitmap (até 32 blocos por pool), e cada pool
+ * conta o pico de uso e as alocações recusadas.
+ *
+ * Não há trava própria: os pools só são usados com o lwIP travado (nos
+ * callbacks do lwIP ou entre cyw43_arch_lwip_begin/end), o que já serializa
+ * o acesso entre o laço principal e a interrupção da rede.
+ */
+
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    uint8_t *blocks;
+    size_t block_size;
+    uint8_t count;
+    uint8_t in_use;
+    uint8_t high_water;         // Maior in_use desde o boot
+    uint32_t used;              // Bitmap dos blocos alocados
+    uint32_t failures;          // Alocações recusadas com o pool cheio
+} slab_t;
+
+// Define um pool estático 'name' com 'n' blocos do tipo 'type' (n <= 32)
+#define SLAB_DEFINE(name, type, n)                                          \
+    static type name##_blocks[n];                                           \
+    static slab_t name = {(uint8_t *)name##_blocks, sizeof(type), (n), 0, 0, 0, 0}
+
+/**
+ * @brief Reserva um bloco zerado.
+ * @return NULL se todos os blocos estão em uso.
+ */
+void *slab_alloc(slab_t *slab);
+
+/**
+ * @brief Devolve um bloco obtido com slab_alloc (NULL é ignorado).
+ */
+void slab_free(slab_t *slab, void *block);
+
+#endif // SLAB_H
@@ -0,0 +1,302 @@
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "status.h"
+
+// Maior unidade: um cargo ou candidato com o nome inteiro escapado (\u00XX)
+// e contadores de 10 dígitos
+#define STATUS_UNIT_MAX 192
+
+typedef struct {
+    uint8_t *buf;
+    size_t skip;                // Bytes do documento antes da janela
+    size_t max;                 // Tamanho da janela
+    size_t pos;                 // Tamanho do documento até aqui
+} status_sink_t;
+
+typedef struct {
+    const ballot_t *ballot;
+    int state;
+    status_format_t format;
+} status_doc_t;
+
+// Posição no documento, em unidades codificadas de uma vez. A seção 0 é o
+// nível de cima (com o primeiro cargo), as seções 1 a num_offices são os
+// cargos, e a seguinte só fecha o documento
+typedef struct {
+    uint8_t section;
+    int16_t item;               // -1 abertura, 0 a count - 1 candidatos, count fechamento
+} status_unit_t;
+
+static void sink_put(status_sink_t *s, const void *data, size_t n) {
+    // Só a parte de [pos, pos + n) que cai em [skip, skip + max) é copiada
+    size_t from = s->pos > s->skip ? s->pos : s->skip;
+    size_t to = s->pos + n < s->skip + s->max ? s->pos + n : s->skip + s->max;
+    if (from < to) memcpy(s->buf + (from - s->skip), (const uint8_t *)data + (from - s->pos), to - from);
+    s->pos += n;
+}
+
+static void sink_printf(status_sink_t *s, const char *fmt, ...) {
+    char text[96];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(text, sizeof(text), fmt, ap);
+    va_end(ap);
+    if (n > 0) sink_put(s, text, (size_t)n < sizeof(text) ? (size_t)n : sizeof(text) - 1);
+}
+
+// String JSON entre aspas. Os nomes vêm da configuração já sem os escapes,
+// então aspas, barras e caracteres de controle são escapados de novo aqui
+static void sink_json_string(status_sink_t *s, const char *text, size_t max) {
+    sink_put(s, "\"", 1);
+    size_t start = 0, i = 0;
+    for (; i < max && text[i]; i++) {
+        uint8_t c = (uint8_t)text[i];
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+        sink_put(s, text + start, i - start);
+        if (c == '"' || c == '\\') {
+            char esc[2] = {'\\', (char)c};
+            sink_put(s, esc, sizeof(esc));
+        } else {
+            sink_printf(s, "\\u%04x", c);
+        }
+        start = i + 1;
+    }
+    sink_put(s, text + start, i - start);
+    sink_put(s, "\"", 1);
+}
+
+// O cargo de uma seção; o nível de cima repete o primeiro (NULL sem cargos)
+static const ballot_office_t *section_office(const ballot_t *b, uint8_t section) {
+    if (section == 0) return b->num_offices ? &b->offices[0] : NULL;
+    return section <= b->num_offices ? &b->offices[section - 1] : NULL;
+}
+
+// O nível de cima tem o formato de um cargo só, com "state" e "offices"
+static void status_json_unit(status_sink_t *s, const status_doc_t *d, status_unit_t u) {
+    const ballot_t *b = d->ballot;
+    const ballot_office_t *office = section_office(b, u.section);
+    if (u.section > b->num_offices) {
+        sink_printf(s, "]}");
+    } else if (u.item < 0) {
+        if (u.section == 0) {
+            sink_printf(s, "{\"state\":%d,", d->state);
+        } else {
+            sink_printf(s, "%s{\"name\":", u.section > 1 ? "," : "");
+            sink_json_string(s, office->name, sizeof(office->name));
+            sink_printf(s, ",\"digits\":%d,", ballot_office_digits(office));
+        }
+        sink_printf(s, "\"candidates\":[");
+    } else if (office && u.item < office->count) {
+        const ballot_candidate_t *c = &b->candidates[office->first + u.item];
+        sink_printf(s, "%s{\"name\":", u.item ? "," : "");
+        sink_json_string(s, c->name, sizeof(c->name));
+        sink_printf(s, ",\"number\":\"%s\",\"votes\":%lu}", c->number, (unsigned long)b->tally[office->tally + u.item]);
+    } else {
+        sink_printf(s, "],\"blank_votes\":%lu,\"null_votes\":%lu",
+                    (unsigned long)(office ? b->tally[ballot_blank_slot(office)] : 0),
+                    (unsigned long)(office ? b->tally[ballot_null_slot(office)] : 0));
+        sink_printf(s, u.section == 0 ? ",\"offices\":[" : "}");
+    }
+}
+
+// Cabeçalho CBOR (RFC 8949): tipo maior e valor/tamanho
+static void cbor_head(status_sink_t *s, uint8_t major, uint32_t value) {
+    uint8_t head[5];
+    size_t n;
+    if (value < 24) {
+        head[0] = (uint8_t)(major << 5 | value);
+        n = 1;
+    } else if (value <= 0xff) {
+        head[0] = (uint8_t)(major << 5 | 24);
+        head[1] = (uint8_t)value;
+        n = 2;
+    } else if (value <= 0xffff) {
+        head[0] = (uint8_t)(major << 5 | 25);
+        head[1] = (uint8_t)(value >> 8);
+        head[2] = (uint8_t)value;
+        n = 3;
+    } else {
+        head[0] = (uint8_t)(major << 5 | 26);
+        for (int i = 0; i < 4; i++) head[1 + i] = (uint8_t)(value >> (24 - 8 * i));
+        n = 5;
+    }
+    sink_put(s, head, n);
+}
+
+static void cbor_text(status_sink_t *s, const char *text, size_t max) {
+    size_t n = strnlen(text, max);
+    cbor_head(s, 3, (uint32_t)n);
+    sink_put(s, text, n);
+}
+
+#define CBOR_KEY(s, key) cbor_text(s, key, sizeof(key) - 1)
+
+// Mapas e listas de tamanho definido: o fim do documento não tem bytes
+static void status_cbor_unit(status_sink_t *s, const status_doc_t *d, status_unit_t u) {
+    const ballot_t *b = d->ballot;
+    const ballot_office_t *office = section_office(b, u.section);
+    if (u.section > b->num_offices) return;
+    if (u.item < 0) {
+        cbor_head(s, 5, 5);
+        if (u.section == 0) {
+            CBOR_KEY(s, "state");
+            cbor_head(s, 0, (uint32_t)d->state);
+        } else {
+            CBOR_KEY(s, "name");
+            cbor_text(s, office->name, sizeof(office->name));
+            CBOR_KEY(s, "digits");
+            cbor_head(s, 0, ballot_office_digits(office));
+        }
+        CBOR_KEY(s, "candidates");
+        cbor_head(s, 4, office ? office->count : 0);
+    } else if (office && u.item < office->count) {
+        const ballot_candidate_t *c = &b->candidates[office->first + u.item];
+        cbor_head(s, 5, 3);
+        CBOR_KEY(s, "name");
+        cbor_text(s, c->name, sizeof(c->name));
+        CBOR_KEY(s, "number");
+        cbor_text(s, c->number, sizeof(c->number));
+        CBOR_KEY(s, "votes");
+        cbor_head(s, 0, b->tally[office->tally + u.item]);
+    } else {
+        CBOR_KEY(s, "blank_votes");
+        cbor_head(s, 0, office ? b->tally[ballot_blank_slot(office)] : 0);
+        CBOR_KEY(s, "null_votes");
+        cbor_head(s, 0, office ? b->tally[ballot_null_slot(office)] : 0);
+        if (u.section == 0) {
+            CBOR_KEY(s, "offices");
+            cbor_head(s, 4, b->num_offices);
+        }
+    }
+}
+
+static void status_unit(status_sink_t *s, const status_doc_t *d, status_unit_t u) {
+    if (d->format == STATUS_CBOR) {
+        status_cbor_unit(s, d, u);
+    } else {
+        status_json_unit(s, d, u);
+    }
+}
+
+// Avança para a próxima unidade; false depois do fim do documento
+static bool unit_next(const ballot_t *b, status_unit_t *u) {
+    if (u->section > b->num_offices) return false;
+    const ballot_office_t *office = section_office(b, u->section);
+    if (u->item < (office ? office->count : 0)) {
+        u->item++;
+    } else {
+        u->section++;
+        u->item = -1;
+    }
+    return true;
+}
+
+size_t status_encode(const ballot_t *ballot, int state, status_format_t format, uint8_t *buf, size_t skip,
+                     size_t max) {
+    status_doc_t doc = {ballot, state, format};
+    status_sink_t s = {.buf = buf, .skip = skip, .max = max, .pos = 0};
+    status_unit_t u = {0, -1};
+    do {
+        status_unit(&s, &doc, u);
+    } while (unit_next(ballot, &u));
+    return s.pos;
+}
+
+// Dois documentos por formato: um pode ser refeito enquanto o outro ainda
+// está em envio. Só cédulas pequenas cabem (em JSON, umas duas dezenas de
+// candidatos): um cache para o maior documento, com nomes escapados, passaria
+// de 70 KB por cópia. Os maiores vão pelo status_stream, que é linear
+static struct {
+    char data[HTTP_RESPONSE_MAX];
+    uint32_t version;           // 0 enquanto vazio
+    http_shared_body_t body;    // body.data NULL se o documento não coube
+} status_cache[STATUS_FORMATS][2];
+static int status_current[STATUS_FORMATS];
+static bool status_oversize[STATUS_FORMATS]; // O último documento não coube
+
+http_shared_body_t *status_body(const ballot_t *ballot, int state, status_format_t format, uint32_t version) {
+    int slot = status_current[format];
+    if (status_cache[format][slot].version != version) {
+        slot ^= 1;
+        if (status_cache[format][slot].body.refs != 0) slot ^= 1;
+        if (status_cache[format][slot].body.refs != 0) return NULL;
+
+        size_t len = status_encode(ballot, state, format, (uint8_t *)status_cache[format][slot].data, 0,
+                                   HTTP_RESPONSE_MAX);
+        status_cache[format][slot].version = version;
+        status_cache[format][slot].body.data = len <= HTTP_RESPONSE_MAX ? status_cache[format][slot].data : NULL;
+        status_cache[format][slot].body.len = len;
+        status_current[format] = slot;
+        if ((len > HTTP_RESPONSE_MAX) != status_oversize[format]) {
+            status_oversize[format] = len > HTTP_RESPONSE_MAX;
+            printf("Status: documento %s de %u bytes %s\n", format == STATUS_CBOR ? "CBOR" : "JSON", (unsigned)len,
+                   status_oversize[format] ? "gerado em partes a cada pedido" : "de volta ao cache");
+        }
+    }
+    return status_cache[format][slot].body.data ? &status_cache[format][slot].body : NULL;
+}
+
+// Cursor de um envio em partes
+typedef struct {
+    bool used;
+    status_doc_t doc;           // Estado lido na abertura
+    uint32_t generation;        // Cédula do começo do envio
+    status_unit_t next;         // Próxima unidade a codificar
+    bool done;                  // Última unidade já codificada
+    size_t offset;              // Bytes já entregues
+    uint8_t unit[STATUS_UNIT_MAX]; // Última unidade codificada
+    size_t unit_len;
+    size_t unit_pos;            // Quanto dela já foi entregue
+} status_stream_t;
+
+static status_stream_t streams[STATUS_STREAMS];
+
+void *status_stream_open(const ballot_t *ballot, int state, status_format_t format) {
+    for (int i = 0; i < STATUS_STREAMS; i++) {
+        status_stream_t *st = &streams[i];
+        if (st->used) continue;
+        *st = (status_stream_t){
+            .used = true,
+            .doc = {ballot, state, format},
+            .generation = ballot->generation,
+            .next = {0, -1},
+        };
+        return st;
+    }
+    return NULL;
+}
+
+size_t status_stream(void *ctx, size_t offset, uint8_t *buf, size_t max) {
+    status_stream_t *st = ctx;
+    if (!buf) {
+        st->used = false; // Fim da resposta
+        return 0;
+    }
+    // Cada trecho é pedido uma vez, na ordem. Votos e estado podem mudar no
+    // meio; uma cédula nova muda a estrutura, e o cliente refaz o pedido
+    if (offset != st->offset || st->doc.ballot->generation != st->generation) return HTTP_STREAM_ERROR;
+
+    size_t n = 0;
+    while (n < max) {
+        if (st->unit_pos < st->unit_len) {
+            // O resto da unidade que não coube no trecho anterior
+            size_t k = st->unit_len - st->unit_pos < max - n ? st->unit_len - st->unit_pos : max - n;
+            memcpy(buf + n, st->unit + st->unit_pos, k);
+            st->unit_pos += k;
+            n += k;
+            continue;
+        }
+        if (st->done) break;
+        status_sink_t s = {.buf = st->unit, .skip = 0, .max = sizeof(st->unit), .pos = 0};
+        status_unit(&s, &st->doc, st->next);
+        if (s.pos > sizeof(st->unit)) return HTTP_STREAM_ERROR;
+        st->unit_len = s.pos;
+        st->unit_pos = 0;
+        st->done = !unit_next(st->doc.ballot, &st->next);
+    }
+    st->offset += n;
+    return n;
+}
@@ -0,0 +1,71 @@
+/**
+ * @file status.h
+ *
+ * Documento de status para o app (GET /status): o estado da eleição e a
+ * apuração de cada cargo, em JSON (padrão) ou CBOR (Accept:
+ * application/cbor), com as mesmas chaves.
+ *
+ * O documento é uma sequência de unidades pequenas (a abertura de um cargo,
+ * um candidato, o fechamento), codificadas uma a uma. Só documentos que
+ * cabem em HTTP_RESPONSE_MAX ficam em cache, um por versão do status: na
+ * prática, cédulas de até umas duas dezenas de candidatos em JSON (o
+ * tools/status_check mostra o limite). Os maiores são gerados em partes a
+ * cada pedido, direto no buffer de envio do TCP, com um cursor que retoma da
+ * unidade onde o trecho anterior parou; a troca de caminho sai no log.
+ *
+ * No envio em partes o estado da eleição é o do começo da resposta, e cada
+ * contador é lido quando o seu candidato é codificado: um voto no meio do
+ * envio aparece ou não, como em um pedido feito um instante depois, e o
+ * documento continua válido. Só uma carga nova da cédula interrompe o envio.
+ *
+ * As funções devem ser chamadas com o lwIP travado (nos callbacks ou entre
+ * cyw43_arch_lwip_begin/end), como as que mexem na apuração. O módulo não
+ * depende do SDK do Pico nem do lwIP.
+ */
+
+#ifndef STATUS_H
+#define STATUS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ballot/ballot.h"
+#include "http_server/http_server.h"
+
+typedef enum { STATUS_JSON, STATUS_CBOR, STATUS_FORMATS } status_format_t;
+
+// Envios em partes simultâneos: um por conexão
+#define STATUS_STREAMS HTTP_MAX_CONNECTIONS
+
+/**
+ * @brief Codifica o trecho [skip, skip + max) do documento em 'buf'.
+ * @return Tamanho do documento inteiro.
+ */
+size_t status_encode(const ballot_t *ballot, int state, status_format_t format, uint8_t *buf, size_t skip,
+                     size_t max);
+
+/**
+ * @brief Documento da versão 'version' (lida do contador de versões antes
+ * da chamada: uma mudança no meio fica para a próxima versão), refeito só
+ * quando ela muda.
+ * Um documento que não cabe também fica registrado para a versão, e os
+ * pedidos seguintes dela não o codificam de novo só para medir.
+ * @return NULL se o documento não cabe no cache, ou se os dois documentos
+ * estão desatualizados e ainda presos em envios (o chamador gera em partes).
+ */
+http_shared_body_t *status_body(const ballot_t *ballot, int state, status_format_t format, uint32_t version);
+
+/**
+ * @brief Começa um envio em partes, para status_stream. O contexto é
+ * liberado quando o servidor avisa o fim da resposta.
+ * @return Contexto, ou NULL se todos os STATUS_STREAMS estão em uso.
+ */
+void *status_stream_open(const ballot_t *ballot, int state, status_format_t format);
+
+/**
+ * @brief Gerador do corpo (http_body_fn) com o contexto de
+ * status_stream_open, para respostas com HTTP_LENGTH_UNKNOWN.
+ */
+size_t status_stream(void *ctx, size_t offset, uint8_t *buf, size_t max);
+
+#endif
@@ -1,7 +1,9 @@
 #include <string.h>
 #include <stdlib.h>
+#include <stdarg.h>
 #include "pico/cyw43_arch.h"
 #include "pico/stdlib.h"
+#include "pico/rand.h"
 
 #include "lwip/pbuf.h"
 #include "lwip/tcp.h"
@@ -13,20 +15,21 @@
 #include "hardware/i2c.h"
 #include "ssd1306/ssd1306.h"
 #include "hardware/pwm.h"
-
-#include "jsmn.h"
+#include "auditoria_link/auditoria_link.h"
+#include "http_server/http_server.h"
+#include "host_link/host_link.h"
+#include "json_stream/json_stream.h"
+#include "ballot/ballot.h"
+#include "status/status.h"
+#include "vote_journal/vote_journal.h"
+#include "keypad/keypad.h"
 
 // CONFIGURAÇÕES DE REDE
 #define AP_SSID "URNA_ELEICAO_2025"
 #define AP_PASSWORD "12345678!"
 
 // MAPEAMENTO DE HARDWARE
-const uint ROW_PINS[] = {4, 8, 9, 16};
-const uint COL_PINS[] = {17, 18, 19, 20};
-const char KEY_MAP[4][4] = {
-    {'1', '2', '3', 'A'}, {'4', '5', '6', 'B'},
-    {'7', '8', '9', 'C'}, {'*', '0', '#', 'D'}
-};
+// Teclado 4x4: pinos e teclas em keypad/keypad.h
 #define I2C_PORT i2c1
 #define I2C_SDA_PIN 14
 #define I2C_SCL_PIN 15
@@ -39,45 +42,27 @@ typedef enum {
     SHOWING_CANDIDATE, VOTE_CONFIRMED, ELECTION_ENDED
 } UrnaState;
 
-typedef struct { char number[3]; char name[16]; int votes; } Candidate;
-Candidate *candidates = NULL;
-int NUM_CANDIDATES = 0;
-int votes_blank = 0;
-int votes_null = 0;
-
-typedef struct TCP_CLIENT_STATE_T_ {
-    struct tcp_pcb *pcb;
-    ip_addr_t remote_addr;
-    char http_request[256];
-    int sent_len;
-} TCP_CLIENT_STATE_T;
+// Cargos, candidatos e apuração: a carga do /configure preenche em ordem,
+// sem alocar nada
+static ballot_t ballot;
 
 volatile UrnaState current_state = WAITING_FOR_START;
-char current_vote_buffer[3] = "";
-int input_pos = 0;
+// Incrementada a cada voto e mudança de estado; o status em cache e os
+// eventos só são refeitos quando ela muda
+volatile uint32_t status_version = 1;
+// Escolhas do eleitor que está votando, gravadas só no último cargo
+static ballot_session_t session;
+// Fase da eleição nos checkpoints do diário: a urna volta a ela ao reiniciar
+enum { PHASE_WAITING, PHASE_STARTED, PHASE_ENDED };
 
 typedef struct TCP_SERVER_T_ {
-    struct tcp_pcb *server_pcb;
     bool complete;
     ip_addr_t gw;
 } TCP_SERVER_T;
 
-typedef struct TCP_CONNECT_STATE_T_ {
-    struct tcp_pcb *pcb;
-    int sent_len;
-    char headers[128];
-    char result[2048];
-    int header_len;
-    int result_len;
-    ip_addr_t *gw;
-} TCP_CONNECT_STATE_T;
-
 // FUNÇÕES DE HARDWARE 
 void setup_hardware() {
-    for (int i = 0; i < 4; i++) {
-        gpio_init(ROW_PINS[i]); gpio_set_dir(ROW_PINS[i], GPIO_OUT);
-        gpio_init(COL_PINS[i]); gpio_set_dir(COL_PINS[i], GPIO_IN); gpio_pull_down(COL_PINS[i]);
-    }
+    if (!keypad_init()) printf("Sem PIO livre para o teclado\n");
     gpio_set_function(BUZZER_PIN, GPIO_FUNC_PWM);
     i2c_init(I2C_PORT, 400 * 1000);
     gpio_set_function(I2C_SDA_PIN, GPIO_FUNC_I2C);
@@ -99,19 +84,13 @@ void play_sound(uint freq, uint duration_ms) {
 }
 void play_confirmation_sound() { play_sound(1200, 150); sleep_ms(50); play_sound(1500, 300); }
 
-char scan_keypad() {
-    for (int r = 0; r < 4; r++) {
-        gpio_put(ROW_PINS[r], 1); sleep_us(50);
-        for (int c = 0; c < 4; c++) {
-            if (gpio_get(COL_PINS[c])) {
-                gpio_put(ROW_PINS[r], 0); return KEY_MAP[r][c];
-            }
-        }
-        gpio_put(ROW_PINS[r], 0);
-    }
-    return '\0';
+void reset_vote_state() { ballot_session_begin(&ballot, &session); }
+// Votos contados antes da troca de estado entram na mesma versão
+void set_state(UrnaState state) { current_state = state; status_version++; }
+uint8_t election_phase() {
+    if (current_state == WAITING_FOR_START) return PHASE_WAITING;
+    return current_state == ELECTION_ENDED ? PHASE_ENDED : PHASE_STARTED;
 }
-void reset_vote_state() { input_pos = 0; memset(current_vote_buffer, 0, sizeof(current_vote_buffer)); }
 
 void update_oled_display() {
     ssd1306_clear(&disp); char line[32];
@@ -119,351 +98,720 @@ void update_oled_display() {
         case WAITING_FOR_START: ssd1306_draw_string(&disp, 0, 24, 1, "Aguardando inicio..."); break;
         case WAITING_FOR_ENABLE: ssd1306_draw_string(&disp, 5, 24, 1, "Aguardando Mesario..."); break;
         case READY_TO_VOTE: ssd1306_draw_string(&disp, 10, 24, 2, "URNA PRONTA"); break;
-        case VOTING: ssd1306_draw_string(&disp, 0, 10, 1, "Numero:"); ssd1306_draw_string(&disp, 40, 24, 3, current_vote_buffer); break;
+        case VOTING: {
+            if (session.office >= ballot.num_offices) break; // Cédula recarregada no meio do voto
+            const ballot_office_t *office = &ballot.offices[session.office];
+            ssd1306_draw_string(&disp, 0, 0, 1, office->name);
+            ssd1306_draw_string(&disp, 0, 10, 1, "Numero:");
+            ssd1306_draw_string(&disp, (128 - ballot_office_digits(office) * 18) / 2, 24, 3, session.number);
+            break;
+        }
         case SHOWING_CANDIDATE: {
-            bool found = false;
-            for (int i = 0; i < NUM_CANDIDATES; i++) {
-                if (strcmp(current_vote_buffer, candidates[i].number) == 0) {
-                    ssd1306_draw_string(&disp, 0, 16, 2, candidates[i].name); found = true; break;
-                }
+            if (session.office < ballot.num_offices) ssd1306_draw_string(&disp, 0, 0, 1, ballot.offices[session.office].name);
+            // Candidato já resolvido pelo índice quando o último dígito entrou
+            if (session.candidate >= 0 && session.candidate < ballot.num_candidates) {
+                ssd1306_draw_string(&disp, 0, 16, 2, ballot.candidates[session.candidate].name);
+            } else {
+                ssd1306_draw_string(&disp, 10, 16, 2, "VOTO NULO");
             }
-            if (!found) ssd1306_draw_string(&disp, 10, 16, 2, "VOTO NULO");
             ssd1306_draw_string(&disp, 0, 48, 1, "A=Conf B=Corr D=Branco");
             break;
         }
         case VOTE_CONFIRMED: ssd1306_draw_string(&disp, 45, 24, 3, "FIM"); break;
-        case ELECTION_ENDED:
+        case ELECTION_ENDED: {
             ssd1306_draw_string(&disp, 10, 0, 1, "-- RESULTADO --");
-            for (int i = 0; i < NUM_CANDIDATES; i++) {
-                sprintf(line, "%s: %d", candidates[i].name, candidates[i].votes);
-                ssd1306_draw_string(&disp, 0, 16 + (i * 10), 1, line);
+            int y = 16;
+            for (int o = 0; o < ballot.num_offices; o++) {
+                const ballot_office_t *office = &ballot.offices[o];
+                if (office->name[0]) { ssd1306_draw_string(&disp, 0, y, 1, office->name); y += 10; }
+                for (int i = 0; i < office->count; i++) {
+                    sprintf(line, "%s: %lu", ballot.candidates[office->first + i].name, (unsigned long)ballot.tally[office->tally + i]);
+                    ssd1306_draw_string(&disp, 0, y, 1, line); y += 10;
+                }
+                sprintf(line, "Brancos: %lu", (unsigned long)ballot.tally[ballot_blank_slot(office)]);
+                ssd1306_draw_string(&disp, 0, y, 1, line); y += 10;
+                sprintf(line, "Nulos: %lu", (unsigned long)ballot.tally[ballot_null_slot(office)]);
+                ssd1306_draw_string(&disp, 0, y, 1, line); y += 10;
             }
-            sprintf(line, "Brancos: %d", votes_blank);
-            ssd1306_draw_string(&disp, 0, 16 + (NUM_CANDIDATES * 10), 1, line);
-            sprintf(line, "Nulos: %d", votes_null);
-            ssd1306_draw_string(&disp, 0, 16 + ((NUM_CANDIDATES+1) * 10), 1, line);
             break;
+        }
     }
     ssd1306_show(&disp);
 }
 
-static void tcp_client_close(TCP_CLIENT_STATE_T *state) {
-    if (state->pcb) {
-        tcp_arg(state->pcb, NULL);
-        tcp_poll(state->pcb, NULL, 0);
-        tcp_sent(state->pcb, NULL);
-        tcp_recv(state->pcb, NULL);
-        tcp_err(state->pcb, NULL);
-        tcp_close(state->pcb);
-        state->pcb = NULL; // Evita double free
+// LÓGICA DA URNA
+
+// Auditoria e computador da mesa recebem um voto por cargo, já gravado
+static void record_vote(void) {
+    for (int o = 0; o < ballot.num_offices; o++) {
+        const ballot_office_t *office = &ballot.offices[o];
+        const char *type;
+        if (session.slots[o] == ballot_blank_slot(office)) {
+            auditoria_link_event("BRANCO;%d", o);
+            type = "branco";
+        } else {
+            bool null = session.slots[o] == ballot_null_slot(office);
+            auditoria_link_event("%s;%d;%s", null ? "NULO" : "VOTO", o, session.numbers[o]);
+            type = null ? "nulo" : "nominal";
+        }
+        host_link_event("{\"command\":\"voto\",\"tipo\":\"%s\",\"cargo\":%d}", type, o);
     }
-    free(state);
 }
 
-// Callback chamado quando os dados foram enviados com sucesso
-static err_t tcp_client_sent(void *arg, struct tcp_pcb *pcb, u16_t len) {
-    TCP_CLIENT_STATE_T *state = (TCP_CLIENT_STATE_T*)arg;
-    state->sent_len += len;
+// Depois de cada cargo: o próximo, ou todos gravados de uma vez no último
+static void next_office(void) {
+    if (!ballot_session_done(&ballot, &session)) {
+        set_state(VOTING);
+        return;
+    }
+    // Com o lwIP travado, o /status e os eventos veem todos os cargos ou nenhum
+    cyw43_arch_lwip_begin();
+    bool ok = ballot_commit(&ballot, &session);
+    set_state(VOTE_CONFIRMED);
+    // Na flash antes da tela de confirmação: só grava páginas, o setor já está apagado
+    if (ok) vote_journal_vote(&ballot, &session);
+    vote_journal_flush(&ballot, election_phase());
+    cyw43_arch_lwip_end();
+    if (ok) record_vote(); else printf("Cedula recarregada durante o voto, voto descartado\n");
+    update_oled_display(); play_confirmation_sound(); sleep_ms(2000);
+    reset_vote_state(); set_state(WAITING_FOR_ENABLE);
+}
+
+// Fora da votação de um eleitor: grava o que ficou pendente e apaga o
+// próximo setor do diário, que para tudo por dezenas de milissegundos
+void journal_poll() {
+    if (current_state == READY_TO_VOTE || current_state == VOTING || current_state == SHOWING_CANDIDATE) return;
+    cyw43_arch_lwip_begin();
+    vote_journal_flush(&ballot, election_phase());
+    vote_journal_prepare();
+    cyw43_arch_lwip_end();
+}
 
-    // Se todo o request foi enviado, podemos fechar a conexão
-    if (state->sent_len >= strlen(state->http_request)) {
-        printf("Requisição para o servidor Flask enviada, fechando conexão.\n");
-        tcp_client_close(state);
+void urna_loop() {
+    update_oled_display();
+    keypad_event_t event;
+    // A fila é sempre esvaziada: teclas fora da votação não valem depois
+    while (keypad_next(&event)) {
+        if (!event.pressed) continue;
+        if (current_state != READY_TO_VOTE && current_state != VOTING && current_state != SHOWING_CANDIDATE) continue;
+        char key = event.key;
+        host_link_event("{\"command\":\"tecla\",\"tecla\":\"%c\"}", key);
+        auditoria_link_event("TECLA;%c", key);
+        if (current_state == READY_TO_VOTE && (key >= '0' && key <= '9')) set_state(VOTING);
+        if (current_state == VOTING && ballot_session_digit(&ballot, &session, key)) {
+            play_sound(800, 100);
+            if (ballot_session_complete(&ballot, &session)) set_state(SHOWING_CANDIDATE);
+        }
+        switch(key) {
+            case 'A': if (current_state == SHOWING_CANDIDATE && ballot_session_confirm(&ballot, &session)) {
+                next_office();
+            } break;
+            // Corrige só o cargo em votação
+            case 'B': ballot_session_correct(&session); set_state(session.office == 0 ? READY_TO_VOTE : VOTING); break;
+            case 'D': if ((current_state == READY_TO_VOTE || current_state == VOTING) && ballot_session_blank(&ballot, &session)) {
+                next_office();
+            } break;
+        }
     }
-    return ERR_OK;
 }
 
-// Callback chamado quando a conexão é estabelecida com sucesso
-static err_t tcp_client_connected(void *arg, struct tcp_pcb *pcb, err_t err) {
-    if (err != ERR_OK) {
-        printf("Erro ao conectar ao cliente: %d\n", err);
-        tcp_client_close(arg);
-        return err;
+static void appendf(char *buf, size_t size, size_t *len, const char *fmt, ...) {
+    if (*len >= size) return;
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(buf + *len, size - *len, fmt, ap);
+    va_end(ap);
+    *len = n < 0 ? size : *len + (size_t)n;
+}
+
+// STATUS PARA O APP (GET /status): documento em status/status.c
+// Prefixo do ETag: as versões recomeçam a cada boot
+static uint32_t status_boot_id;
+
+// EVENTOS PARA O APP (GET /events e WebSocket /ws)
+// "status" traz o estado completo e "update" só o que mudou, com as chaves do
+// /status; um estado grande demais para um evento termina nos "update"
+// seguintes. Mudanças dentro da janela saem juntas em um único evento
+#define EVENTS_COALESCE_MS 200
+// Quanto uma parte espera por espaço em um cliente lento antes de sair assim
+// mesmo (o assinante SSE atrasado é desconectado e volta com o estado todo)
+#define EVENTS_STALL_MS 2000
+
+// Protocolo binário do /ws. Cada mensagem do app é [comando, id, payload] e
+// recebe [comando | WS_REPLY, id, resultado]. O estado chega em mensagens
+// [WS_PUSH_FULL ou WS_PUSH_DELTA, campos...]: WS_FIELD_STATE + u8,
+// WS_FIELD_VOTE + u8 tamanho + número + u32 votos, WS_FIELD_BLANK + u32 e
+// WS_FIELD_NULL + u32, inteiros em little-endian. Os votos são do primeiro
+// cargo até um WS_FIELD_OFFICE + u8 índice, que vale para os seguintes. Um
+// estado que não cabe em uma mensagem chega em partes: o WS_PUSH_FULL com o
+// começo e WS_PUSH_DELTA com o resto, cada uma retomando o cargo.
+#define WS_CMD_START 0x01
+#define WS_CMD_ENABLE 0x02
+#define WS_CMD_END 0x03
+#define WS_CMD_STATUS 0x04      // Responde e manda o estado completo
+#define WS_CMD_CONFIGURE 0x05   // Payload: o mesmo JSON do POST /configure
+#define WS_REPLY 0x80
+#define WS_RESULT_OK 0
+#define WS_RESULT_REJECTED 1
+#define WS_RESULT_UNKNOWN 2
+#define WS_PUSH_FULL 0x40
+#define WS_PUSH_DELTA 0x41
+#define WS_FIELD_STATE 0x01
+#define WS_FIELD_VOTE 0x02
+#define WS_FIELD_BLANK 0x03
+#define WS_FIELD_NULL 0x04
+#define WS_FIELD_OFFICE 0x05
+#define WS_PUSH_MAX 1024
+
+// Último estado publicado
+static struct {
+    uint32_t joined;
+    uint32_t ws_joined;
+    uint32_t version;
+    uint32_t time_ms;
+    UrnaState state;
+    uint32_t generation;        // Cédula publicada
+    uint16_t tally_len;
+    uint32_t tally[BALLOT_TALLY_MAX];
+    bool full;                  // Estado completo saindo em partes
+    uint16_t full_next;         // Próximo contador do estado completo
+    bool more;                  // A última parte não levou todas as diferenças
+    bool stalled;               // A próxima parte espera espaço desde stalled_ms
+    uint32_t stalled_ms;
+} published;
+
+// WS_CMD_STATUS chega pelo callback do lwIP; o laço principal manda o estado
+static volatile bool status_requested;
+
+// Uma parte em montagem: o JSON do SSE e a mensagem do /ws recebem os mesmos
+// campos, na mesma ordem
+typedef struct {
+    size_t len;                 // JSON, sem os fechamentos
+    size_t msg_len;
+    int fields;                 // Campos no nível de cima do JSON
+    int offices;                // Cargos abertos em "offices"
+    int office;                 // Cargo em curso no JSON (0 é o nível de cima)
+    int office_fields;
+    int votes;                  // Entradas no objeto "votes" aberto
+    int msg_office;             // Cargo em curso na mensagem binária
+} events_piece_t;
+
+// "}" de "votes", do cargo, de "offices" e do documento
+#define EVENTS_CLOSE_MAX 4
+
+static char events_data[HTTP_EVENTS_MAX - 64];
+static uint8_t events_msg[WS_PUSH_MAX];
+
+// Como appendf, para as mensagens binárias: *len vira 'size' se não couber
+static void appendb(uint8_t *buf, size_t size, size_t *len, const void *data, size_t n) {
+    if (*len >= size) return;
+    if (n > size - *len) {
+        *len = size;
+        return;
     }
-    TCP_CLIENT_STATE_T *state = (TCP_CLIENT_STATE_T*)arg;
-    printf("Conectado ao servidor Flask, enviando dados...\n");
+    memcpy(buf + *len, data, n);
+    *len += n;
+}
 
-    // Agora que estamos conectados, definimos o callback de envio e enviamos os dados
-    tcp_sent(pcb, tcp_client_sent);
-    tcp_write(pcb, state->http_request, strlen(state->http_request), TCP_WRITE_FLAG_COPY);
-    tcp_output(pcb);
+static void append_u32(uint8_t *buf, size_t size, size_t *len, uint32_t value) {
+    uint8_t v[4];
+    for (int i = 0; i < 4; i++) v[i] = (uint8_t)(value >> (8 * i));
+    appendb(buf, size, len, v, sizeof(v));
+}
 
-    return ERR_OK;
+static void piece_begin(events_piece_t *p, bool full) {
+    memset(p, 0, sizeof(*p));
+    appendf(events_data, sizeof(events_data), &p->len, "{");
+    uint8_t type = full ? WS_PUSH_FULL : WS_PUSH_DELTA;
+    appendb(events_msg, sizeof(events_msg), &p->msg_len, &type, 1);
 }
 
-// Callback de erro
-static void tcp_client_err(void *arg, err_t err) {
-    printf("Erro na conexão do cliente TCP: %d\n", err);
-    tcp_client_close(arg);
+static void piece_close_votes(events_piece_t *p) {
+    if (p->votes) appendf(events_data, sizeof(events_data), &p->len, "}");
+    p->votes = 0;
 }
 
-void send_key_to_server(const char* key) {
-    // Aloca estado dinamicamente, pois a operação é assíncrona
-    TCP_CLIENT_STATE_T *state = calloc(1, sizeof(TCP_CLIENT_STATE_T));
-    if (!state) {
-        printf("Falha ao alocar estado do cliente TCP\n");
-        return;
+static void piece_state(events_piece_t *p) {
+    appendf(events_data, sizeof(events_data), &p->len, "%s\"state\":%d", p->fields++ ? "," : "", current_state);
+    uint8_t field[2] = {WS_FIELD_STATE, (uint8_t)current_state};
+    appendb(events_msg, sizeof(events_msg), &p->msg_len, field, sizeof(field));
+}
+
+// Contador 'i' do cargo 'o' (candidato, branco ou nulo), com as chaves do
+// /status: o primeiro cargo no nível de cima, os demais em "offices" pelo
+// índice
+static void piece_write(events_piece_t *p, int o, int i) {
+    const ballot_office_t *office = &ballot.offices[o];
+    unsigned long votes = (unsigned long)ballot.tally[office->tally + i];
+    size_t size = sizeof(events_data);
+
+    if (o != p->office) {
+        piece_close_votes(p);
+        if (p->office) appendf(events_data, size, &p->len, "}");
+        appendf(events_data, size, &p->len, "%s\"%d\":{",
+                p->offices++ ? "," : p->fields++ ? ",\"offices\":{" : "\"offices\":{", o);
+        p->office = o;
+        p->office_fields = 0;
+    }
+    int *fields = p->office ? &p->office_fields : &p->fields;
+    if (i < office->count) {
+        appendf(events_data, size, &p->len, "%s\"%s\":%lu",
+                p->votes++ ? "," : (*fields)++ ? ",\"votes\":{" : "\"votes\":{",
+                ballot.candidates[office->first + i].number, votes);
+    } else {
+        piece_close_votes(p);
+        appendf(events_data, size, &p->len, "%s\"%s\":%lu", (*fields)++ ? "," : "",
+                i == office->count ? "blank_votes" : "null_votes", votes);
     }
 
-    const char* server_ip = "192.168.4.16"; // IP do computador com Flask
-    const uint16_t server_port = 8080;
-    ipaddr_aton(server_ip, &state->remote_addr);
-
-    char json_payload[64];
-    snprintf(json_payload, sizeof(json_payload),
-             "{\"command\":\"tecla\",\"tecla\":\"%s\"}", key);
-
-    // Monta a requisição completa e armazena no estado
-    snprintf(state->http_request, sizeof(state->http_request),
-             "POST /comando HTTP/1.1\r\n"
-             "Host: %s:%d\r\n"
-             "Content-Type: application/json\r\n"
-             "Content-Length: %d\r\n"
-             "Connection: close\r\n\r\n"
-             "%s",
-             server_ip, server_port, strlen(json_payload), json_payload);
-
-    struct tcp_pcb *pcb = tcp_new();
-    if (!pcb) {
-        printf("Falha ao criar PCB do cliente\n");
-        free(state);
-        return;
+    if (o != p->msg_office) {
+        uint8_t field[2] = {WS_FIELD_OFFICE, (uint8_t)o};
+        appendb(events_msg, sizeof(events_msg), &p->msg_len, field, sizeof(field));
+        p->msg_office = o;
     }
+    if (i < office->count) {
+        const ballot_candidate_t *c = &ballot.candidates[office->first + i];
+        uint8_t field[2] = {WS_FIELD_VOTE, (uint8_t)strnlen(c->number, sizeof(c->number))};
+        appendb(events_msg, sizeof(events_msg), &p->msg_len, field, sizeof(field));
+        appendb(events_msg, sizeof(events_msg), &p->msg_len, c->number, field[1]);
+    } else {
+        uint8_t field = i == office->count ? WS_FIELD_BLANK : WS_FIELD_NULL;
+        appendb(events_msg, sizeof(events_msg), &p->msg_len, &field, 1);
+    }
+    append_u32(events_msg, sizeof(events_msg), &p->msg_len, ballot.tally[office->tally + i]);
+}
 
-    state->pcb = pcb;
-    tcp_arg(pcb, state); // Passa nosso estado para os callbacks
-    tcp_err(pcb, tcp_client_err);
+// Acrescenta o contador se ele couber nos dois formatos; senão a parte fica
+// como estava e o contador vai na próxima
+static bool piece_add(events_piece_t *p, int o, int i) {
+    events_piece_t saved = *p;
+    piece_write(p, o, i);
+    if (p->len + EVENTS_CLOSE_MAX < sizeof(events_data) && p->msg_len < sizeof(events_msg)) return true;
+    *p = saved;
+    return false;
+}
+
+static void piece_publish(events_piece_t *p, bool full) {
+    size_t size = sizeof(events_data);
+    piece_close_votes(p);
+    if (p->office) appendf(events_data, size, &p->len, "}");
+    if (p->offices) appendf(events_data, size, &p->len, "}");
+    appendf(events_data, size, &p->len, "}");
+
+    cyw43_arch_lwip_begin();
+    if (http_events_subscribers()) http_events_publish(full ? "status" : "update", events_data);
+    http_ws_broadcast(events_msg, p->msg_len);
+    cyw43_arch_lwip_end();
+}
 
-    // Inicia a conexão. O callback tcp_client_connected será chamado quando conectar.
-    err_t err = tcp_connect(pcb, &state->remote_addr, server_port, tcp_client_connected);
-    if (err != ERR_OK) {
-        printf("Erro ao iniciar conexão com cliente: %d\n", err);
-        tcp_client_close(state);
+// Espaço para uma parte inteira em todos os clientes, ou espera demais
+static bool events_ready(uint32_t now) {
+    cyw43_arch_lwip_begin();
+    bool ready = http_events_ready(HTTP_EVENTS_MAX) && http_ws_ready(WS_PUSH_MAX);
+    cyw43_arch_lwip_end();
+    if (ready) {
+        published.stalled = false;
+        return true;
     }
+    if (!published.stalled) {
+        published.stalled = true;
+        published.stalled_ms = now;
+    }
+    if (now - published.stalled_ms < EVENTS_STALL_MS) return false;
+    published.stalled = false;
+    return true;
 }
 
-// LÓGICA DA URNA
-void urna_loop() {
-    update_oled_display();
-    if (current_state != READY_TO_VOTE && current_state != VOTING && current_state != SHOWING_CANDIDATE) return;
-    char key = scan_keypad();
-    if (key != '\0') {
-        char key_str[2] = {key, '\0'};
-        send_key_to_server(key_str);
-        if (current_state == READY_TO_VOTE && (key >= '0' && key <= '9')) current_state = VOTING;
-        if (current_state == VOTING) {
-            if (key >= '0' && key <= '9' && input_pos < 2) {
-                current_vote_buffer[input_pos++] = key; current_vote_buffer[input_pos] = '\0';
-                play_sound(800, 100);
-                if (input_pos == 2) current_state = SHOWING_CANDIDATE;
+/**
+ * @brief Publica o que mudou no estado e na apuração desde o último evento,
+ * como evento SSE e como mensagem binária para os clientes do /ws.
+ * Sem ninguém conectado não faz nada; a cada novo cliente o estado inteiro
+ * é publicado ("status" / WS_PUSH_FULL), e depois só as diferenças.
+ *
+ * Cada chamada publica no máximo uma parte, que cabe em HTTP_EVENTS_MAX e
+ * em WS_PUSH_MAX. O que não coube sai nas chamadas seguintes, sem esperar
+ * a janela de EVENTS_COALESCE_MS, assim que todos os clientes têm espaço.
+ * Um contador só conta como publicado depois de entrar em uma parte.
+ */
+void publish_events(void) {
+    if (http_events_subscribers() == 0 && http_ws_clients() == 0) return;
+    uint32_t version = status_version;
+    uint16_t tally_len = ballot_tally_len(&ballot);
+    bool restart = status_requested || published.joined != http_events_joined() ||
+                   published.ws_joined != http_ws_joined() ||
+                   published.generation != ballot.generation || published.tally_len != tally_len;
+    bool pending = published.full || published.more;
+    if (!restart && !pending && published.version == version) return;
+    uint32_t now = to_ms_since_boot(get_absolute_time());
+    if (!pending && now - published.time_ms < EVENTS_COALESCE_MS) return;
+    if (!events_ready(now)) return;
+
+    bool first = false;
+    if (restart) {
+        status_requested = false;
+        published.joined = http_events_joined();
+        published.ws_joined = http_ws_joined();
+        published.generation = ballot.generation;
+        published.tally_len = tally_len;
+        published.full = first = true;
+        published.full_next = 0;
+    }
+    bool full = published.full;
+
+    events_piece_t p;
+    piece_begin(&p, first);
+    if (first || current_state != published.state) piece_state(&p);
+    // Sem estado completo em curso, só os contadores que mudaram; nos dois
+    // casos, do primeiro que ainda falta em diante
+    uint16_t from = full ? published.full_next : 0;
+    uint16_t next = tally_len;
+    for (int o = 0; o < ballot.num_offices && next == tally_len; o++) {
+        const ballot_office_t *office = &ballot.offices[o];
+        for (int i = 0; i < office->count + 2; i++) {
+            uint16_t slot = (uint16_t)(office->tally + i);
+            if (slot < from || (!full && ballot.tally[slot] == published.tally[slot])) continue;
+            if (!piece_add(&p, o, i)) {
+                next = slot;
+                break;
             }
+            published.tally[slot] = ballot.tally[slot];
         }
-        switch(key) {
-            case 'A': if (current_state == SHOWING_CANDIDATE) {
-                bool found = false;
-                for (int i = 0; i < NUM_CANDIDATES; i++) {
-                    if (strcmp(current_vote_buffer, candidates[i].number) == 0) { candidates[i].votes++; found = true; break; }
-                }
-                if (!found) votes_null++;
-                current_state = VOTE_CONFIRMED; update_oled_display(); play_confirmation_sound(); sleep_ms(2000);
-                reset_vote_state(); current_state = WAITING_FOR_ENABLE;
-            } break;
-            case 'B': reset_vote_state(); current_state = READY_TO_VOTE; break;
-            case 'D': if (current_state == READY_TO_VOTE) {
-                votes_blank++; current_state = VOTE_CONFIRMED;
-                update_oled_display(); play_confirmation_sound(); sleep_ms(2000);
-                reset_vote_state(); current_state = WAITING_FOR_ENABLE;
-            } break;
-        }
-        while(scan_keypad() != '\0') { sleep_ms(20); }
     }
+
+    published.more = next < tally_len;
+    if (full) {
+        published.full = published.more;
+        published.full_next = next;
+    } else if (!published.more) {
+        // Todas as diferenças desta versão estão na parte
+        published.version = version;
+    }
+    if (p.fields == 0) return;
+    piece_publish(&p, first);
+    published.time_ms = now;
+    published.state = current_state;
 }
 
-void create_status_json(char* buffer, size_t len) {
-    char candidates_json[1024] = "";
-    char temp[128];
-    
-    for (int i = 0; i < NUM_CANDIDATES; i++) {
-        sprintf(temp, "{\"name\":\"%s\",\"number\":\"%s\",\"votes\":%d}%s",
-                candidates[i].name, candidates[i].number, candidates[i].votes,
-                i < NUM_CANDIDATES - 1 ? "," : "");
-        strcat(candidates_json, temp);
+// COMANDOS DO MESÁRIO (HTTP e WebSocket)
+
+// Carga da cédula a partir do JSON, em trechos à medida que chegam. O formato
+// com cargos é {"offices":[{"name":..,"candidates":[{"name":..,"number":..},...]},...]};
+// um array só de candidatos, [{"name":..,"number":..},...], é uma cédula de um
+// cargo sem nome. Cada candidato entra na tabela quando o objeto dele fecha;
+// chaves desconhecidas (e o que houver dentro delas) são ignoradas.
+enum { FIELD_OTHER, FIELD_NAME, FIELD_NUMBER, FIELD_OFFICES, FIELD_CANDIDATES };
+
+// Níveis no formato com cargos: o array "offices", cada cargo, o array
+// "candidates" e cada candidato
+#define LEVEL_OFFICES 2
+#define LEVEL_OFFICE 3
+#define LEVEL_CANDIDATES 4
+
+static struct {
+    json_stream_t json;
+    bool started;               // Algum byte do documento já chegou
+    bool failed;                // JSON inválido ou fora do formato
+    bool offices;               // Formato com cargos (o documento é um objeto)
+    uint8_t candidate_level;    // Nível dos objetos de candidato
+    uint8_t field;              // Campo cujo valor vem a seguir
+    bool in_offices;            // Dentro do array "offices"
+    bool in_candidates;         // Dentro de um array de candidatos
+    bool office_open;           // O cargo em leitura já está na cédula
+    char office_name[BALLOT_NAME_MAX];
+    ballot_candidate_t current; // Candidato do objeto em leitura
+    int skipped;                // Sem número, repetidos, com dígitos diferentes dos do cargo ou além de BALLOT_CANDIDATES_MAX
+} config_load;
+
+static void config_open_office(void) {
+    // Cargos além de BALLOT_OFFICES_MAX deixariam a cédula incompleta
+    if (!ballot_add_office(&ballot, config_load.office_name)) config_load.failed = true;
+    config_load.office_open = true;
+}
+
+static void config_on_begin(void *ctx, bool object, uint8_t depth) {
+    if (depth == 1) {
+        config_load.offices = object;
+        config_load.candidate_level = object ? LEVEL_CANDIDATES + 1 : 2;
+        config_load.in_candidates = !object;
+        if (!object) config_open_office(); // Cargo único, sem nome
+    } else if (config_load.offices && depth == LEVEL_OFFICES && !object && config_load.field == FIELD_OFFICES) {
+        config_load.in_offices = true;
+    } else if (config_load.in_offices && depth == LEVEL_OFFICE && object) {
+        config_load.office_name[0] = '\0';
+        config_load.office_open = false;
+    } else if (config_load.in_offices && depth == LEVEL_CANDIDATES && !object && config_load.field == FIELD_CANDIDATES) {
+        if (!config_load.office_open) config_open_office();
+        config_load.in_candidates = true;
+    } else if (config_load.in_candidates && depth == config_load.candidate_level && object) {
+        memset(&config_load.current, 0, sizeof(config_load.current));
     }
-    
-    int json_len = snprintf(buffer, len,
-        "{\"state\":%d,\"candidates\":[%s],\"blank_votes\":%d,\"null_votes\":%d}",
-        current_state, candidates_json, votes_blank, votes_null
-    );
-    
-    printf("JSON Status criado (len=%d): %s\n", json_len, buffer); // Debug
 }
 
-static int jsoneq(const char *json, jsmntok_t *tok, const char *s) {
-    if (tok->type == JSMN_STRING && (int)strlen(s) == tok->end - tok->start &&
-        strncmp(json + tok->start, s, tok->end - tok->start) == 0) {
-        return 0;
+static void config_on_key(void *ctx, const char *key, uint8_t depth) {
+    config_load.field = FIELD_OTHER;
+    if (config_load.offices && depth == 1 && strcmp(key, "offices") == 0) config_load.field = FIELD_OFFICES;
+    if (config_load.in_offices && depth == LEVEL_OFFICE) {
+        if (strcmp(key, "name") == 0) config_load.field = FIELD_NAME;
+        if (strcmp(key, "candidates") == 0) config_load.field = FIELD_CANDIDATES;
     }
-    return -1;
-}
-
-err_t tcp_close_client_connection(TCP_CONNECT_STATE_T *con_state, struct tcp_pcb *client_pcb, err_t close_err) { if (client_pcb) { assert(con_state && con_state->pcb == client_pcb); tcp_arg(client_pcb, NULL); tcp_poll(client_pcb, NULL, 0); tcp_sent(client_pcb, NULL); tcp_recv(client_pcb, NULL); tcp_err(client_pcb, NULL); err_t err = tcp_close(client_pcb); if (err != ERR_OK) { tcp_abort(client_pcb); close_err = ERR_ABRT; } if (con_state) { free(con_state); } } return close_err; }
-
-// Callback que processa as requisições
-err_t tcp_server_recv(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err) {
-    TCP_CONNECT_STATE_T *con_state = (TCP_CONNECT_STATE_T*)arg;
-    if (!p) { return tcp_close_client_connection(con_state, pcb, ERR_OK); }
-   
-    if (p->tot_len > 0) {
-        char* request_payload = malloc(p->tot_len + 1);
-        pbuf_copy_partial(p, request_payload, p->tot_len, 0);
-        request_payload[p->tot_len] = '\0';
-
-        printf("Requisicao recebida: %s\n", request_payload); // Debug
-
-        // API JSON para status
-        if (strncmp("GET /status", request_payload, 11) == 0) {
-            printf("Enviando status JSON\n");
-            create_status_json(con_state->result, sizeof(con_state->result));
-            con_state->header_len = snprintf(con_state->headers, sizeof(con_state->headers), 
-                "HTTP/1.1 200 OK\r\n"
-                "Content-Length: %d\r\n"
-                "Content-Type: application/json\r\n"
-                "Access-Control-Allow-Origin: *\r\n"
-                "Connection: close\r\n\r\n", 
-                strlen(con_state->result));
-            con_state->result_len = strlen(con_state->result);
-        }
-        // Configuração de candidatos
-        else if (strncmp("POST /configure", request_payload, 15) == 0) {
-            printf("Recebido comando de configuracao!\n");
-            if (candidates) { free(candidates); candidates = NULL; NUM_CANDIDATES = 0; }
-           
-            char *json_body = strstr(request_payload, "\r\n\r\n");
-            if (json_body) {
-                json_body += 4;
-                jsmn_parser parser; jsmntok_t tokens[128];
-                jsmn_init(&parser);
-                int r = jsmn_parse(&parser, json_body, strlen(json_body), tokens, 128);
-
-                if (r > 0 && tokens[0].type == JSMN_ARRAY) {
-                    NUM_CANDIDATES = tokens[0].size;
-                    candidates = malloc(NUM_CANDIDATES * sizeof(Candidate));
-                   
-                    int token_idx = 1;
-                    for (int i = 0; i < NUM_CANDIDATES; i++) {
-                        token_idx++; // Pula o token do objeto
-                        for (int j = 0; j < 2; j++) { // name e number
-                            jsmntok_t *key = &tokens[token_idx];
-                            jsmntok_t *val = &tokens[token_idx+1];
-                            if (jsoneq(json_body, key, "name") == 0) {
-                                snprintf(candidates[i].name, sizeof(candidates[i].name), "%.*s", 
-                                    val->end - val->start, json_body + val->start);
-                            } else if (jsoneq(json_body, key, "number") == 0) {
-                                snprintf(candidates[i].number, sizeof(candidates[i].number), "%.*s", 
-                                    val->end - val->start, json_body + val->start);
-                            }
-                            token_idx += 2;
-                        }
-                        candidates[i].votes = 0;
-                        printf("Candidato cadastrado: %s - %s\n", candidates[i].name, candidates[i].number);
-                    }
-                }
-            }
-            
-            con_state->header_len = snprintf(con_state->headers, sizeof(con_state->headers), 
-                "HTTP/1.1 200 OK\r\n"
-                "Content-Length: 2\r\n"
-                "Content-Type: application/json\r\n"
-                "Access-Control-Allow-Origin: *\r\n"
-                "Connection: close\r\n\r\n");
-            strcpy(con_state->result, "OK");
-            con_state->result_len = 2;
-        }
-        // Comandos simples
-        else if (strncmp("GET /start", request_payload, 10) == 0) {
-            printf("Comando START recebido\n");
-            for (int i = 0; i < NUM_CANDIDATES; i++) candidates[i].votes = 0;
-            votes_blank = 0; 
-            votes_null = 0;
-            reset_vote_state(); 
-            current_state = WAITING_FOR_ENABLE;
-            
-            con_state->header_len = snprintf(con_state->headers, sizeof(con_state->headers), 
-                "HTTP/1.1 200 OK\r\n"
-                "Content-Length: 2\r\n"
-                "Content-Type: text/plain\r\n"
-                "Access-Control-Allow-Origin: *\r\n"
-                "Connection: close\r\n\r\n");
-            strcpy(con_state->result, "OK");
-            con_state->result_len = 2;
-        } 
-        else if (strncmp("GET /enable", request_payload, 11) == 0) {
-            printf("Comando ENABLE recebido\n");
-            if (current_state == WAITING_FOR_ENABLE || current_state == VOTE_CONFIRMED) {
-                reset_vote_state(); 
-                current_state = READY_TO_VOTE;
-            }
-            
-            con_state->header_len = snprintf(con_state->headers, sizeof(con_state->headers), 
-                "HTTP/1.1 200 OK\r\n"
-                "Content-Length: 2\r\n"
-                "Content-Type: text/plain\r\n"
-                "Access-Control-Allow-Origin: *\r\n"
-                "Connection: close\r\n\r\n");
-            strcpy(con_state->result, "OK");
-            con_state->result_len = 2;
-        } 
-        else if (strncmp("GET /end", request_payload, 8) == 0) {
-            printf("Comando END recebido\n");
-            current_state = ELECTION_ENDED;
-            
-            con_state->header_len = snprintf(con_state->headers, sizeof(con_state->headers), 
-                "HTTP/1.1 200 OK\r\n"
-                "Content-Length: 2\r\n"
-                "Content-Type: text/plain\r\n"
-                "Access-Control-Allow-Origin: *\r\n"
-                "Connection: close\r\n\r\n");
-            strcpy(con_state->result, "OK");
-            con_state->result_len = 2;
-        }
-        // Requisições não reconhecidas
-        else {
-            printf("Requisicao nao reconhecida\n");
-            con_state->header_len = snprintf(con_state->headers, sizeof(con_state->headers), 
-                "HTTP/1.1 404 Not Found\r\n"
-                "Content-Length: 9\r\n"
-                "Content-Type: text/plain\r\n"
-                "Connection: close\r\n\r\n");
-            strcpy(con_state->result, "Not Found");
-            con_state->result_len = 9;
+    if (config_load.in_candidates && depth == config_load.candidate_level) {
+        if (strcmp(key, "name") == 0) config_load.field = FIELD_NAME;
+        if (strcmp(key, "number") == 0) config_load.field = FIELD_NUMBER;
+    }
+}
+
+static void config_on_value(void *ctx, json_type_t type, const char *text, uint8_t depth) {
+    if (depth == 0) config_load.failed = true;
+    if (type != JSON_STRING && type != JSON_NUMBER) return;
+    if (config_load.in_offices && depth == LEVEL_OFFICE && config_load.field == FIELD_NAME) {
+        snprintf(config_load.office_name, sizeof(config_load.office_name), "%s", text);
+        // O nome pode vir depois dos candidatos, com o cargo já na cédula
+        if (config_load.office_open && ballot.num_offices) {
+            ballot_office_t *office = &ballot.offices[ballot.num_offices - 1];
+            snprintf(office->name, sizeof(office->name), "%s", text);
         }
-       
-        // Envia resposta
-        tcp_write(pcb, con_state->headers, con_state->header_len, 0);
-        if(con_state->result_len > 0) {
-            tcp_write(pcb, con_state->result, con_state->result_len, 0);
+    }
+    if (!config_load.in_candidates || depth != config_load.candidate_level) return;
+    ballot_candidate_t *c = &config_load.current;
+    if (config_load.field == FIELD_NAME) snprintf(c->name, sizeof(c->name), "%s", text);
+    if (config_load.field == FIELD_NUMBER) {
+        // Número longo demais não é cortado: fica vazio e o candidato é ignorado
+        if (strlen(text) < sizeof(c->number)) strcpy(c->number, text); else c->number[0] = '\0';
+    }
+}
+
+static void config_on_end(void *ctx, bool object, uint8_t depth) {
+    if (config_load.in_candidates && depth == config_load.candidate_level && object) {
+        // Números inválidos, repetidos ou de outro tamanho no cargo ficam de fora
+        if (!ballot_add_candidate(&ballot, config_load.current.number, config_load.current.name)) config_load.skipped++;
+    } else if (config_load.in_offices && depth == LEVEL_CANDIDATES && !object) {
+        config_load.in_candidates = false;
+    } else if (config_load.in_offices && depth == LEVEL_OFFICE && object) {
+        if (!config_load.office_open) config_open_office(); // Cargo sem candidatos
+        config_load.office_open = false;
+    } else if (config_load.in_offices && depth == LEVEL_OFFICES && !object) {
+        config_load.in_offices = false;
+    }
+}
+
+static const json_stream_callbacks_t config_callbacks = {
+    .on_begin = config_on_begin,
+    .on_end = config_on_end,
+    .on_key = config_on_key,
+    .on_value = config_on_value,
+};
+
+static void config_begin(void) {
+    printf("Recebido comando de configuracao!\n");
+    memset(&config_load, 0, sizeof(config_load));
+    json_stream_init(&config_load.json);
+    ballot_clear(&ballot);
+    status_version++;
+}
+
+static bool config_feed(const uint8_t *data, size_t len) {
+    config_load.started = true;
+    if (!json_stream_feed(&config_load.json, data, len, &config_callbacks, NULL)) config_load.failed = true;
+    return !config_load.failed;
+}
+
+// Urna sem candidatos: ainda se vota em branco ou nulo, em um cargo
+static void config_default(void) {
+    ballot_clear(&ballot);
+    ballot_add_office(&ballot, "");
+}
+
+// false se o JSON era inválido: a urna fica sem candidatos
+static bool config_end(void) {
+    bool ok = !config_load.started || (!config_load.failed && json_stream_finish(&config_load.json, &config_callbacks, NULL));
+    if (!ok) printf("JSON de candidatos invalido\n");
+    if (!ok || ballot.num_offices == 0) config_default();
+    printf("Candidatos cadastrados: %d em %d cargos (%d ignorados)\n",
+           ballot.num_candidates, ballot.num_offices, config_load.skipped);
+    status_version++;
+    vote_journal_ballot_changed();
+    auditoria_link_event("CONFIG;%d", ballot.num_candidates);
+    return ok;
+}
+
+// Documento inteiro de uma vez (mensagem WebSocket)
+static bool cmd_configure(const char *json_body, size_t len) {
+    config_begin();
+    config_feed((const uint8_t *)json_body, len);
+    return config_end();
+}
+
+static void cmd_start(void) {
+    printf("Comando START recebido\n");
+    ballot_reset_tally(&ballot);
+    reset_vote_state();
+    set_state(WAITING_FOR_ENABLE);
+    vote_journal_checkpoint();
+    auditoria_link_event("INICIO");
+}
+
+// false se a urna não está esperando liberação
+static bool cmd_enable(void) {
+    printf("Comando ENABLE recebido\n");
+    if (current_state != WAITING_FOR_ENABLE && current_state != VOTE_CONFIRMED) return false;
+    reset_vote_state();
+    set_state(READY_TO_VOTE);
+    auditoria_link_event("LIBERADA");
+    return true;
+}
+
+static void cmd_end(void) {
+    printf("Comando END recebido\n");
+    set_state(ELECTION_ENDED);
+    vote_journal_checkpoint();
+    auditoria_link_event("ENCERRADA");
+}
+
+// ROTAS DO SERVIDOR WEB
+
+// API JSON para status
+static void handle_status(const http_request_t *req, http_response_t *res) {
+    static char etag[24];
+    status_format_t format = http_accepts(req, "application/cbor") ? STATUS_CBOR : STATUS_JSON;
+    uint32_t version = status_version;
+    res->content_type = format == STATUS_CBOR ? "application/cbor" : "application/json";
+    res->shared = status_body(&ballot, current_state, format, version);
+    if (!res->shared) {
+        // Sem limite de tamanho: gerado em partes direto no buffer de envio
+        // do TCP, sem Content-Length (o documento cresce com os votos)
+        res->stream_ctx = status_stream_open(&ballot, current_state, format);
+        if (!res->stream_ctx) {
+            res->status = 503;
+            http_response_text(res, "Ocupado");
+            return;
         }
-        tcp_recved(pcb, p->tot_len);
-        free(request_payload);
+        res->stream = status_stream;
+        res->body_len = HTTP_LENGTH_UNKNOWN;
+    }
+    // Polls sem mudança desde o último recebem 304 sem corpo
+    snprintf(etag, sizeof(etag), "\"%08lx-%lu%s\"", (unsigned long)status_boot_id, (unsigned long)version,
+             format == STATUS_CBOR ? "c" : "");
+    res->etag = etag;
+}
+
+// Contadores das conexões e da fila para o computador da mesa, para diagnóstico
+static void handle_stats(const http_request_t *req, http_response_t *res) {
+    http_server_stats_t stats;
+    host_link_stats_t host;
+    vote_journal_stats_t journal;
+    keypad_stats_t keypad;
+    http_server_stats(&stats);
+    host_link_stats(&host);
+    vote_journal_stats(&journal);
+    keypad_stats(&keypad);
+    res->body_len = (size_t)snprintf(res->body, HTTP_RESPONSE_MAX,
+        "{\"http_connections\":%u,\"http_high_water\":%u,\"http_busy\":%lu,"
+        "\"host_pending\":%u,\"host_in_flight\":%u,\"host_connected\":%s,"
+        "\"host_delivered\":%lu,\"host_dropped\":%lu,\"host_reconnects\":%lu,"
+        "\"journal_sector_seq\":%lu,\"journal_sector_used\":%u,\"journal_pending\":%u,"
+        "\"journal_checkpoints\":%lu,\"journal_erases\":%lu,\"journal_errors\":%lu,"
+        "\"journal_recovered\":%lu,\"journal_recovery_us\":%lu,\"journal_disabled\":%s,"
+        "\"keypad_events\":%lu,\"keypad_dropped\":%lu,\"keypad_latency_max_us\":%lu}",
+        stats.connections, stats.high_water, (unsigned long)stats.busy,
+        host.pending, host.in_flight, host.connected ? "true" : "false",
+        (unsigned long)host.delivered, (unsigned long)host.dropped, (unsigned long)host.reconnects,
+        (unsigned long)journal.sector_seq, journal.sector_used, journal.pending,
+        (unsigned long)journal.checkpoints, (unsigned long)journal.erases, (unsigned long)journal.errors,
+        (unsigned long)journal.recovered, (unsigned long)journal.recovery_us, journal.disabled ? "true" : "false",
+        (unsigned long)keypad.events, (unsigned long)keypad.dropped, (unsigned long)keypad.max_latency_us);
+    res->content_type = "application/json";
+}
+
+// Configuração de candidatos: o corpo chega em trechos, sem limite de tamanho
+static bool configure_body(size_t offset, const uint8_t *data, size_t len) {
+    if (offset == 0) config_begin();
+    if (!data) {
+        config_load.failed = true; // Corpo incompleto
+        config_end();
+        return false;
+    }
+    return config_feed(data, len);
+}
+
+static void handle_configure(const http_request_t *req, http_response_t *res) {
+    if (req->body_len == 0) config_begin(); // Corpo vazio: urna sem candidatos
+    if (!config_end()) {
+        res->status = 400;
+        http_response_text(res, "JSON invalido");
+        return;
     }
-    pbuf_free(p);
-    return ERR_OK;
+    http_response_text(res, "OK");
+    res->content_type = "application/json";
+}
+
+// Comandos simples
+static void handle_start(const http_request_t *req, http_response_t *res) {
+    cmd_start();
+    http_response_text(res, "OK");
+}
+
+static void handle_enable(const http_request_t *req, http_response_t *res) {
+    cmd_enable();
+    http_response_text(res, "OK");
 }
 
-// FUNÇÕES DO SERVIDOR WEB (do exemplo oficial, adaptadas)
+static void handle_end(const http_request_t *req, http_response_t *res) {
+    cmd_end();
+    http_response_text(res, "OK");
+}
+
+// Comandos pelo WebSocket, na mesma conexão para a eleição inteira
+static void handle_ws_message(http_ws_t *ws, const uint8_t *msg, size_t len) {
+    if (len < 2) return;
+    uint8_t reply[3] = {msg[0] | WS_REPLY, msg[1], WS_RESULT_OK};
+    switch (msg[0]) {
+    case WS_CMD_START: cmd_start(); break;
+    case WS_CMD_ENABLE: if (!cmd_enable()) reply[2] = WS_RESULT_REJECTED; break;
+    case WS_CMD_END: cmd_end(); break;
+    case WS_CMD_CONFIGURE: if (!cmd_configure((const char *)msg + 2, len - 2)) reply[2] = WS_RESULT_REJECTED; break;
+    case WS_CMD_STATUS: break;
+    default: reply[2] = WS_RESULT_UNKNOWN; break;
+    }
+    // Sem espaço para a resposta o servidor fecha a conexão, e o cliente
+    // reconecta e pede o estado (o comando já foi executado)
+    if (!http_ws_send(ws, reply, sizeof(reply))) printf("WS: resposta ao comando %u perdida\n", msg[0]);
 
-void tcp_server_close(TCP_SERVER_T *state) { if (state->server_pcb) { tcp_arg(state->server_pcb, NULL); tcp_close(state->server_pcb); state->server_pcb = NULL; } }
-err_t tcp_server_sent(void *arg, struct tcp_pcb *pcb, u16_t len) { TCP_CONNECT_STATE_T *con_state = (TCP_CONNECT_STATE_T*)arg; con_state->sent_len += len; if (con_state->sent_len >= con_state->header_len + con_state->result_len) { return tcp_close_client_connection(con_state, pcb, ERR_OK); } return ERR_OK; }
-void tcp_server_err(void *arg, err_t err) { TCP_CONNECT_STATE_T *con_state = (TCP_CONNECT_STATE_T*)arg; if (err != ERR_ABRT) { tcp_close_client_connection(con_state, con_state->pcb, err); } }
-err_t tcp_server_poll(void *arg, struct tcp_pcb *pcb) { TCP_CONNECT_STATE_T *con_state = (TCP_CONNECT_STATE_T*)arg; return tcp_close_client_connection(con_state, pcb, ERR_OK); }
-err_t tcp_server_accept(void *arg, struct tcp_pcb *client_pcb, err_t err) { TCP_SERVER_T *state = (TCP_SERVER_T*)arg; if (err != ERR_OK || client_pcb == NULL) { return ERR_VAL; } TCP_CONNECT_STATE_T *con_state = calloc(1, sizeof(TCP_CONNECT_STATE_T)); if (!con_state) { return ERR_MEM; } con_state->pcb = client_pcb; con_state->gw = &state->gw; tcp_arg(client_pcb, con_state); tcp_sent(client_pcb, tcp_server_sent); tcp_recv(client_pcb, tcp_server_recv); tcp_poll(client_pcb, tcp_server_poll, 5 * 2); tcp_err(client_pcb, tcp_server_err); return ERR_OK; }
-bool tcp_server_open(void *arg) { TCP_SERVER_T *state = (TCP_SERVER_T*)arg; struct tcp_pcb *pcb = tcp_new_ip_type(IPADDR_TYPE_ANY); if (!pcb) return false; err_t err = tcp_bind(pcb, IP_ANY_TYPE, 80); if (err) { tcp_close(pcb); return false; } state->server_pcb = tcp_listen_with_backlog(pcb, 5); if (!state->server_pcb) { if (pcb) tcp_close(pcb); return false; } tcp_arg(state->server_pcb, state); tcp_accept(state->server_pcb, tcp_server_accept); return true; }
+    // O estado completo sai pelo laço principal, em partes se preciso, para
+    // todos os clientes
+    if (msg[0] == WS_CMD_STATUS) status_requested = true;
+}
+
+// Demais caminhos respondem 404 (ou 405 para o método errado)
+static const http_route_t routes[] = {
+    {HTTP_METHOD_GET, "/status", handle_status, false},
+    {HTTP_METHOD_GET, "/stats", handle_stats, false},
+    {HTTP_METHOD_POST, "/configure", handle_configure, true, false, NULL, configure_body},
+    {HTTP_METHOD_GET, "/start", handle_start, false},
+    {HTTP_METHOD_GET, "/enable", handle_enable, false},
+    {HTTP_METHOD_GET, "/end", handle_end, false},
+    {HTTP_METHOD_GET, "/events", NULL, false, true},
+    {HTTP_METHOD_GET, "/ws", NULL, false, false, handle_ws_message},
+};
 
 // FUNÇÃO MAIN
 int main() {
     stdio_init_all();
     setup_hardware();
     sleep_ms(2500);
+    auditoria_link_init();
+    status_boot_id = get_rand_32();
+    config_default();
+    // Cédula, apuração e fase gravadas antes de uma queda de energia
+    uint8_t phase = PHASE_WAITING;
+    if (vote_journal_recover(&ballot, &phase)) {
+        vote_journal_stats_t journal;
+        vote_journal_stats(&journal);
+        printf("Apuracao recuperada: %lu votos do diario em %lu us\n",
+               (unsigned long)journal.recovered, (unsigned long)journal.recovery_us);
+        if (phase == PHASE_STARTED) current_state = WAITING_FOR_ENABLE;
+        if (phase == PHASE_ENDED) current_state = ELECTION_ENDED;
+    }
+    reset_vote_state();
 
     TCP_SERVER_T *state = calloc(1, sizeof(TCP_SERVER_T));
     if (!state) { return 1; }
@@ -485,7 +833,7 @@ int main() {
     // dns_server_t dns_server;
     // dns_server_init(&dns_server, &state->gw);
 
-    if (!tcp_server_open(state)) { return 1; }
+    if (!http_server_open(routes, sizeof(routes) / sizeof(routes[0]))) { return 1; }
 
     printf("Ponto de Acesso '%s' criado.\n", AP_SSID);
     printf("Conecte e acesse http://%s\n", ip4addr_ntoa(&state->gw));
@@ -493,11 +841,15 @@ int main() {
     state->complete = false;
     while(!state->complete) {
         cyw43_arch_poll();
+        auditoria_link_poll();
+        host_link_poll();
+        journal_poll();
         urna_loop();
+        publish_events();
         sleep_ms(50);
     }
 
-    tcp_server_close(state);
+    http_server_close();
     // dns_server_deinit(&dns_server);
     dhcp_server_deinit(&dhcp_server);
     cyw43_arch_deinit();
@@ -0,0 +1,392 @@
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "pico/flash.h"
+#include "hardware/flash.h"
+
+#include "vote_journal.h"
+#include "urna_link.h"
+
+// Região no fim da flash, longe do programa: a cédula e depois o anel
+#define REGION_OFFSET (PICO_FLASH_SIZE_BYTES - (VOTE_JOURNAL_BALLOT_SECTORS + VOTE_JOURNAL_SECTORS) * FLASH_SECTOR_SIZE)
+#define BALLOT_OFFSET REGION_OFFSET
+#define RING_OFFSET (REGION_OFFSET + VOTE_JOURNAL_BALLOT_SECTORS * FLASH_SECTOR_SIZE)
+
+// Fim do programa na flash, do linker script do SDK. A região não é reservada
+// nele: vote_journal_recover confere que o programa termina antes dela
+extern char __flash_binary_end;
+
+#define BALLOT_MAGIC 0x4C444543u        // "CEDL"
+#define CHECKPOINT_MAGIC 0x4B504843u    // "CHPK"
+#define RECORD_VOTE 0x56
+#define RECORD_SIZE 32u
+
+// Cédula gravada: cabeçalho, os cargos e os candidatos de todos eles
+typedef struct {
+    uint32_t magic;
+    uint32_t crc;               // CRC-32 de tudo o que vem depois deste campo
+    uint16_t num_offices;
+    uint16_t num_candidates;
+} saved_ballot_t;
+
+// Só o que não se refaz na carga: dígitos e posições saem dos candidatos
+typedef struct {
+    char name[BALLOT_NAME_MAX];
+    uint16_t count;
+} saved_office_t;
+
+// Começo de cada setor do anel, seguido de tally_len contadores
+typedef struct {
+    uint32_t magic;
+    uint32_t crc;               // CRC-32 do que vem depois deste campo, contadores inclusive
+    uint32_t seq;               // O maior é o setor atual
+    uint32_t ballot_crc;        // Cédula a que os contadores se referem
+    uint16_t tally_len;
+    uint8_t phase;
+    uint8_t reserved;
+} checkpoint_t;
+
+// Um eleitor: o contador escolhido em cada cargo
+typedef struct {
+    uint8_t type;               // RECORD_VOTE; 0xFF em posição ainda livre
+    uint8_t count;              // Cargos em slots[]
+    uint16_t reserved;
+    uint16_t slots[BALLOT_OFFICES_MAX];
+    uint8_t padding[RECORD_SIZE - 8 - 2 * BALLOT_OFFICES_MAX];
+    uint32_t crc;               // CRC-32 dos bytes anteriores
+} record_t;
+
+_Static_assert(sizeof(record_t) == RECORD_SIZE, "Registro do diario deve ter 32 bytes");
+_Static_assert(FLASH_PAGE_SIZE % RECORD_SIZE == 0, "Registros nao podem cruzar paginas");
+_Static_assert(sizeof(saved_ballot_t) + BALLOT_OFFICES_MAX * sizeof(saved_office_t) +
+               BALLOT_CANDIDATES_MAX * sizeof(ballot_candidate_t) <= VOTE_JOURNAL_BALLOT_SECTORS * FLASH_SECTOR_SIZE,
+               "Cedula nao cabe nos setores reservados");
+
+// Os registros começam depois dos contadores, alinhados
+static uint16_t records_start(uint16_t tally_len) {
+    uint32_t end = sizeof(checkpoint_t) + 4u * tally_len;
+    return (uint16_t)((end + RECORD_SIZE - 1) & ~(uint32_t)(RECORD_SIZE - 1));
+}
+
+_Static_assert(sizeof(checkpoint_t) + 4 * BALLOT_TALLY_MAX + 2 * RECORD_SIZE <= FLASH_SECTOR_SIZE,
+               "Checkpoint nao deixa espaco para registros");
+
+static struct {
+    uint8_t current;            // Setor atual do anel
+    uint32_t seq;               // seq do checkpoint do setor atual (0: anel vazio)
+    uint16_t write;             // Próxima posição livre no setor atual
+    bool next_erased;           // O setor seguinte está pronto para um checkpoint
+    bool checkpoint_needed;
+    bool ballot_dirty;
+    bool disabled;              // O programa invade a região: nada é gravado
+    uint32_t ballot_crc;        // Cédula em uso, para os checkpoints
+    record_t queue[VOTE_JOURNAL_QUEUE_LEN];
+    uint8_t queued;
+    vote_journal_stats_t stats;
+} journal;
+
+// Gravação sequencial em área apagada, uma página de cada vez
+static struct {
+    uint32_t offset;            // Página em montagem
+    uint16_t fill;
+    uint8_t page[FLASH_PAGE_SIZE];
+} writer;
+
+typedef struct {
+    uint32_t offset;
+    const uint8_t *data;
+    size_t len;
+} flash_op_t;
+
+static void do_erase(void *param) {
+    const flash_op_t *op = param;
+    flash_range_erase(op->offset, op->len);
+}
+
+static void do_program(void *param) {
+    const flash_op_t *op = param;
+    flash_range_program(op->offset, op->data, op->len);
+}
+
+// Nada roda da flash enquanto ela é apagada ou gravada: as interrupções
+// ficam desligadas durante a operação
+static bool flash_op(void (*func)(void *), uint32_t offset, const uint8_t *data, size_t len) {
+    flash_op_t op = {.offset = offset, .data = data, .len = len};
+    if (flash_safe_execute(func, &op, UINT32_MAX) == PICO_OK) return true;
+    journal.stats.errors++;
+    return false;
+}
+
+static const uint8_t *flash_at(uint32_t offset) {
+    return (const uint8_t *)(XIP_BASE + offset);
+}
+
+static uint32_t sector_offset(uint8_t sector) {
+    return RING_OFFSET + (uint32_t)sector * FLASH_SECTOR_SIZE;
+}
+
+static bool is_erased(const uint8_t *p, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (p[i] != 0xFF) return false;
+    }
+    return true;
+}
+
+// Em uma página já gravada pela metade, os bytes 0xFF não alteram o que já está lá
+static void writer_begin(uint32_t offset) {
+    writer.offset = offset & ~(uint32_t)(FLASH_PAGE_SIZE - 1);
+    writer.fill = (uint16_t)(offset - writer.offset);
+    memset(writer.page, 0xFF, sizeof(writer.page));
+}
+
+static void writer_flush(void) {
+    flash_op(do_program, writer.offset, writer.page, FLASH_PAGE_SIZE);
+    writer.offset += FLASH_PAGE_SIZE;
+    writer.fill = 0;
+    memset(writer.page, 0xFF, sizeof(writer.page));
+}
+
+static void writer_put(const void *data, size_t len) {
+    const uint8_t *p = data;
+    while (len) {
+        size_t n = FLASH_PAGE_SIZE - writer.fill < len ? FLASH_PAGE_SIZE - writer.fill : len;
+        memcpy(writer.page + writer.fill, p, n);
+        writer.fill += n;
+        p += n;
+        len -= n;
+        if (writer.fill == FLASH_PAGE_SIZE) writer_flush();
+    }
+}
+
+static void writer_end(void) {
+    if (writer.fill) writer_flush();
+}
+
+// Os mesmos bytes que save_ballot grava depois do campo crc
+static uint32_t ballot_crc(const ballot_t *b) {
+    uint16_t counts[2] = {b->num_offices, b->num_candidates};
+    uint32_t crc = urna_link_crc32((const uint8_t *)counts, sizeof(counts));
+    for (int i = 0; i < b->num_offices; i++) {
+        saved_office_t office;
+        memcpy(office.name, b->offices[i].name, sizeof(office.name));
+        office.count = b->offices[i].count;
+        crc = urna_link_crc32_update(crc, (const uint8_t *)&office, sizeof(office));
+    }
+    return urna_link_crc32_update(crc, (const uint8_t *)b->candidates, b->num_candidates * sizeof(ballot_candidate_t));
+}
+
+static void save_ballot(const ballot_t *b) {
+    saved_ballot_t header = {
+        .magic = BALLOT_MAGIC,
+        .crc = ballot_crc(b),
+        .num_offices = b->num_offices,
+        .num_candidates = b->num_candidates,
+    };
+    size_t size = sizeof(header) + b->num_offices * sizeof(saved_office_t) + b->num_candidates * sizeof(ballot_candidate_t);
+    size_t sectors = (size + FLASH_SECTOR_SIZE - 1) / FLASH_SECTOR_SIZE;
+    // Os checkpoints passam a ser desta cédula mesmo se a gravação falhar: a
+    // cédula antiga na flash não casa com eles e nada é recuperado por engano
+    journal.ballot_crc = header.crc;
+    if (!flash_op(do_erase, BALLOT_OFFSET, NULL, sectors * FLASH_SECTOR_SIZE)) return;
+    journal.stats.erases += sectors;
+
+    writer_begin(BALLOT_OFFSET);
+    writer_put(&header, sizeof(header));
+    for (int i = 0; i < b->num_offices; i++) {
+        saved_office_t office;
+        memcpy(office.name, b->offices[i].name, sizeof(office.name));
+        office.count = b->offices[i].count;
+        writer_put(&office, sizeof(office));
+    }
+    writer_put(b->candidates, b->num_candidates * sizeof(ballot_candidate_t));
+    writer_end();
+}
+
+static bool load_ballot(ballot_t *b) {
+    const saved_ballot_t *header = (const saved_ballot_t *)flash_at(BALLOT_OFFSET);
+    if (header->magic != BALLOT_MAGIC || header->num_offices == 0 || header->num_offices > BALLOT_OFFICES_MAX ||
+        header->num_candidates > BALLOT_CANDIDATES_MAX) return false;
+    size_t size = sizeof(*header) + header->num_offices * sizeof(saved_office_t) +
+                  header->num_candidates * sizeof(ballot_candidate_t);
+    size_t skip = offsetof(saved_ballot_t, num_offices);
+    if (urna_link_crc32((const uint8_t *)header + skip, size - skip) != header->crc) return false;
+
+    // Refeita pela carga normal: o índice e as posições dos contadores saem iguais
+    const saved_office_t *offices = (const saved_office_t *)(header + 1);
+    const ballot_candidate_t *c = (const ballot_candidate_t *)(offices + header->num_offices);
+    ballot_clear(b);
+    for (int i = 0; i < header->num_offices; i++) {
+        ballot_add_office(b, offices[i].name);
+        for (int j = 0; j < offices[i].count; j++, c++) ballot_add_candidate(b, c->number, c->name);
+    }
+    // Cédula gravada por uma versão que aceitava números de tamanhos
+    // diferentes no mesmo cargo: os contadores não correspondem mais
+    if (b->num_candidates != header->num_candidates) {
+        ballot_clear(b);
+        return false;
+    }
+    journal.ballot_crc = header->crc;
+    return true;
+}
+
+static bool checkpoint_valid(const checkpoint_t *cp) {
+    if (cp->magic != CHECKPOINT_MAGIC || cp->tally_len > BALLOT_TALLY_MAX) return false;
+    size_t skip = offsetof(checkpoint_t, seq);
+    return urna_link_crc32((const uint8_t *)cp + skip, sizeof(*cp) - skip + 4u * cp->tally_len) == cp->crc;
+}
+
+static bool record_valid(const record_t *r) {
+    return r->type == RECORD_VOTE && urna_link_crc32((const uint8_t *)r, offsetof(record_t, crc)) == r->crc;
+}
+
+bool vote_journal_recover(ballot_t *b, uint8_t *phase) {
+    uint64_t start = time_us_64();
+    // Apagar a região apagaria o fim do próprio programa
+    uint32_t binary_size = (uint32_t)((uintptr_t)&__flash_binary_end - XIP_BASE);
+    if (binary_size > REGION_OFFSET) {
+        printf("ERRO: Programa de %lu bytes invade o diario dos votos (a partir de %lu); diario desligado\n",
+               (unsigned long)binary_size, (unsigned long)REGION_OFFSET);
+        journal.disabled = true;
+        return false;
+    }
+    if (!load_ballot(b)) journal.ballot_crc = ballot_crc(b);
+
+    // Checkpoint mais recente; um setor com checkpoint pela metade não conta
+    const checkpoint_t *cp = NULL;
+    for (uint8_t i = 0; i < VOTE_JOURNAL_SECTORS; i++) {
+        const checkpoint_t *c = (const checkpoint_t *)flash_at(sector_offset(i));
+        if (!checkpoint_valid(c) || (cp && (int32_t)(c->seq - cp->seq) <= 0)) continue;
+        cp = c;
+        journal.current = i;
+    }
+    journal.next_erased = false;
+    if (!cp) {
+        // Flash sem diário: o primeiro checkpoint vai para o setor 0
+        journal.current = VOTE_JOURNAL_SECTORS - 1;
+        journal.seq = 0;
+        journal.checkpoint_needed = true;
+        return false;
+    }
+    journal.seq = cp->seq;
+
+    bool matches = cp->ballot_crc == journal.ballot_crc && cp->tally_len == ballot_tally_len(b);
+    if (matches) memcpy(b->tally, cp + 1, 4u * cp->tally_len);
+    uint16_t pos = records_start(cp->tally_len);
+    const uint8_t *sector = flash_at(sector_offset(journal.current));
+    for (; pos + RECORD_SIZE <= FLASH_SECTOR_SIZE; pos += RECORD_SIZE) {
+        const record_t *r = (const record_t *)(sector + pos);
+        if (is_erased((const uint8_t *)r, RECORD_SIZE)) break;
+        // Registro cortado por uma queda no meio da gravação: fica para trás
+        if (!matches || !record_valid(r) || r->count != b->num_offices) continue;
+        bool in_range = true;
+        for (int i = 0; i < r->count; i++) in_range = in_range && r->slots[i] < cp->tally_len;
+        if (!in_range) continue;
+        for (int i = 0; i < r->count; i++) b->tally[r->slots[i]]++;
+        journal.stats.recovered++;
+    }
+    journal.write = pos;
+    // Contadores de outra cédula: recomeça do zero com um checkpoint desta
+    if (matches) *phase = cp->phase; else journal.checkpoint_needed = true;
+    journal.stats.recovery_us = (uint32_t)(time_us_64() - start);
+    return matches;
+}
+
+void vote_journal_vote(const ballot_t *b, const ballot_session_t *s) {
+    if (journal.checkpoint_needed) return; // O checkpoint já vai levar este voto
+    if (journal.queued == VOTE_JOURNAL_QUEUE_LEN) {
+        journal.checkpoint_needed = true;
+        return;
+    }
+    record_t *r = &journal.queue[journal.queued++];
+    memset(r, 0, sizeof(*r));
+    r->type = RECORD_VOTE;
+    r->count = b->num_offices;
+    for (int i = 0; i < b->num_offices; i++) r->slots[i] = s->slots[i];
+    r->crc = urna_link_crc32((const uint8_t *)r, offsetof(record_t, crc));
+}
+
+void vote_journal_checkpoint(void) {
+    journal.checkpoint_needed = true;
+}
+
+void vote_journal_ballot_changed(void) {
+    journal.ballot_dirty = true;
+    journal.checkpoint_needed = true;
+}
+
+void vote_journal_prepare(void) {
+    if (journal.disabled || journal.next_erased) return;
+    uint8_t next = (journal.current + 1) % VOTE_JOURNAL_SECTORS;
+    // Na primeira volta do anel o setor ainda está apagado: poupa um ciclo
+    if (!is_erased(flash_at(sector_offset(next)), FLASH_SECTOR_SIZE)) {
+        if (!flash_op(do_erase, sector_offset(next), NULL, FLASH_SECTOR_SIZE)) return;
+        journal.stats.erases++;
+    }
+    journal.next_erased = true;
+}
+
+// Checkpoint no setor seguinte com os contadores de agora, que já incluem a fila
+static void open_sector(const ballot_t *b, uint8_t phase) {
+    vote_journal_prepare();
+    if (!journal.next_erased) return;
+    uint8_t next = (journal.current + 1) % VOTE_JOURNAL_SECTORS;
+    uint16_t tally_len = ballot_tally_len(b);
+    checkpoint_t cp = {
+        .magic = CHECKPOINT_MAGIC,
+        .seq = journal.seq + 1,
+        .ballot_crc = journal.ballot_crc,
+        .tally_len = tally_len,
+        .phase = phase,
+    };
+    size_t skip = offsetof(checkpoint_t, seq);
+    cp.crc = urna_link_crc32((const uint8_t *)&cp + skip, sizeof(cp) - skip);
+    cp.crc = urna_link_crc32_update(cp.crc, (const uint8_t *)b->tally, 4u * tally_len);
+
+    writer_begin(sector_offset(next));
+    writer_put(&cp, sizeof(cp));
+    writer_put(b->tally, 4u * tally_len);
+    writer_end();
+
+    journal.current = next;
+    journal.seq = cp.seq;
+    journal.write = records_start(tally_len);
+    journal.next_erased = false;
+    journal.checkpoint_needed = false;
+    journal.queued = 0;
+    journal.stats.checkpoints++;
+}
+
+void vote_journal_flush(const ballot_t *b, uint8_t phase) {
+    if (journal.disabled) {
+        journal.queued = 0;
+        return;
+    }
+    if (journal.ballot_dirty) {
+        save_ballot(b);
+        journal.ballot_dirty = false;
+    }
+    // Setor cheio: o checkpoint do próximo leva os votos da fila
+    if (journal.write + journal.queued * RECORD_SIZE > FLASH_SECTOR_SIZE) journal.checkpoint_needed = true;
+    if (journal.checkpoint_needed) {
+        open_sector(b, phase);
+        return;
+    }
+    if (journal.queued == 0) return;
+
+    // Todos os registros da fila em uma gravação por página
+    writer_begin(sector_offset(journal.current) + journal.write);
+    writer_put(journal.queue, journal.queued * RECORD_SIZE);
+    writer_end();
+    journal.write += journal.queued * RECORD_SIZE;
+    journal.queued = 0;
+}
+
+void vote_journal_stats(vote_journal_stats_t *stats) {
+    *stats = journal.stats;
+    stats->sector_seq = journal.seq;
+    stats->sector_used = journal.write;
+    stats->pending = journal.queued;
+    stats->disabled = journal.disabled;
+}
@@ -0,0 +1,96 @@
+/**
+ * @file vote_journal.h
+ *
+ * Diário dos votos na flash da placa, para a apuração sobreviver a uma
+ * queda de energia.
+ *
+ * No fim da flash ficam a cédula (cargos e candidatos, gravada a cada
+ * /configure) e um anel de setores com a apuração. Cada setor começa com
+ * um checkpoint (todos os contadores, a fase da eleição e o CRC da cédula a
+ * que eles se referem) e segue com registros de 32 bytes, um por eleitor,
+ * com o contador escolhido em cada cargo. Um setor cheio, um START, um END
+ * ou uma cédula nova abrem o setor seguinte com um checkpoint novo: cada
+ * setor é apagado uma vez por volta do anel, o que espalha o desgaste.
+ *
+ * Na inicialização, a cédula é recarregada e a apuração é refeita a partir
+ * do checkpoint mais recente, somando os registros que vêm depois dele. É
+ * só uma leitura da flash mapeada na memória: poucos milissegundos.
+ *
+ * Os votos entram em uma fila na RAM e vão para a flash em lotes (vários
+ * registros na mesma página), em vote_journal_flush. Apagar um setor leva
+ * dezenas de milissegundos com a execução parada, então o próximo setor é
+ * apagado antes de ser preciso, em vote_journal_prepare, que o laço
+ * principal só chama quando nenhum eleitor está votando.
+ *
+ * As funções que enfileiram e as que gravam devem ser chamadas com o lwIP
+ * travado (nos callbacks ou entre cyw43_arch_lwip_begin/end), como as que
+ * mexem na apuração.
+ */
+
+#ifndef VOTE_JOURNAL_H
+#define VOTE_JOURNAL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ballot/ballot.h"
+
+#define VOTE_JOURNAL_SECTORS 16         // Anel da apuração
+#define VOTE_JOURNAL_BALLOT_SECTORS 3   // Cédula com BALLOT_CANDIDATES_MAX candidatos
+#define VOTE_JOURNAL_QUEUE_LEN 16       // Votos esperando a gravação
+
+typedef struct {
+    uint32_t sector_seq;        // Setores abertos desde a formatação
+    uint16_t sector_used;       // Bytes ocupados no setor atual
+    uint16_t pending;           // Votos na fila
+    uint32_t checkpoints;       // Checkpoints gravados desde o boot
+    uint32_t erases;            // Setores apagados desde o boot
+    uint32_t errors;            // Operações da flash que falharam
+    uint32_t recovered;         // Votos refeitos a partir dos registros no boot
+    uint32_t recovery_us;       // Duração da recuperação no boot
+    bool disabled;              // Programa grande demais: o diário não grava
+} vote_journal_stats_t;
+
+/**
+ * @brief Recarrega a cédula gravada (se houver, ela substitui a de 'b') e
+ * refaz a apuração dela. Deve ser chamada uma vez, no boot.
+ * @param phase Recebe a fase da eleição do último checkpoint.
+ * Se o programa passa do começo da região do diário na flash, o diário
+ * fica desligado (e nada é gravado) até o próximo boot.
+ * @return false se não há apuração gravada para esta cédula: os contadores
+ * ficam zerados e 'phase' não é alterada.
+ */
+bool vote_journal_recover(ballot_t *b, uint8_t *phase);
+
+/**
+ * @brief Enfileira as escolhas de um eleitor, já contadas em b->tally.
+ * Com a fila cheia, o próximo vote_journal_flush grava um checkpoint.
+ */
+void vote_journal_vote(const ballot_t *b, const ballot_session_t *s);
+
+/**
+ * @brief Pede um checkpoint (START, END): a fase ou os contadores mudaram
+ * de um jeito que os registros não descrevem.
+ */
+void vote_journal_checkpoint(void);
+
+/**
+ * @brief Pede a gravação da cédula, seguida de um checkpoint.
+ */
+void vote_journal_ballot_changed(void);
+
+/**
+ * @brief Grava o que está pendente: a cédula, um checkpoint com os
+ * contadores e a fase atuais, ou os votos da fila.
+ */
+void vote_journal_flush(const ballot_t *b, uint8_t phase);
+
+/**
+ * @brief Deixa apagado o setor que vem depois do atual. Pode parar a
+ * execução por dezenas de milissegundos.
+ */
+void vote_journal_prepare(void);
+
+void vote_journal_stats(vote_journal_stats_t *stats);
+
+#endif // VOTE_JOURNAL_H